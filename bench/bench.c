@@ -0,0 +1,374 @@
+#define _DEFAULT_SOURCE /* wait4(), ru_maxrss */
+#include "../include/header.h"
+
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+/* bench: StreamSeal benchmark suite (`make bench`).
+
+   Prints one JSON document on stdout:
+     kdf    Argon2id cost at the limits encrypt uses
+     stream MB/s of encrypt_file_stream / decrypt_file_stream per file size
+     ciphers MB/s of one chunked-layout file per available cipher suite
+     rss    peak RSS of the legacy and the streamed paths, with the
+            legacy path's per-file Argon2id taken back out
+     tree   path_handler wall time on synthetic trees, per engine
+   Progress goes to stderr. Everything the library prints to stdout (pool
+   and io_uring reports) is discarded so the JSON stays clean.
+
+   Environment:
+     BENCH_DIR     scratch directory (default: a fresh /tmp/ss-bench-*)
+     BENCH_MAX_MB  largest stream size in MiB (default 256; e.g. 4096)
+     BENCH_QUICK   non-empty: smaller trees and sizes for a smoke run
+     BENCH_KDF_PROFILE  --kdf-profile value (default: ./kdf.profile if present) */
+
+static FILE *J;                     /* JSON sink (original stdout) */
+static char  g_dir[PATH_MAX / 2];   /* scratch directory (room left for file names) */
+static char  g_pw[] = "bench-password";
+
+/* now_s: monotonic time in seconds. */
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* make_file: create `p` with `n` random bytes, written in 1 MiB blocks. */
+static int make_file(const char *p, uint64_t n){
+    FILE *f = fopen(p, "wb");
+    if (!f){ perror(p); return -1; }
+    unsigned char *buf = malloc(1 << 20);
+    if (!buf){ fclose(f); return -1; }
+    randombytes_buf(buf, 1 << 20); // one random block reused: AEAD cost does not depend on content
+    int rc = 0;
+    for (uint64_t left = n; left > 0 && rc == 0; ){
+        size_t k = left < (1u << 20) ? (size_t)left : (1u << 20);
+        if (fwrite(buf, 1, k, f) != k) rc = -1;
+        left -= k;
+    }
+    free(buf);
+    if (fclose(f) != 0) rc = -1;
+    return rc;
+}
+
+/* rm_tree: remove `p` recursively (files and directories only). */
+static void rm_tree(const char *p){
+    struct stat st;
+    if (lstat(p, &st) != 0) return;
+    if (S_ISDIR(st.st_mode)){
+        DIR *d = opendir(p);
+        struct dirent *e;
+        while (d && (e = readdir(d)) != NULL){
+            if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            char c[PATH_MAX];
+            snprintf(c, sizeof c, "%s/%s", p, e->d_name);
+            rm_tree(c);
+        }
+        if (d) closedir(d);
+        rmdir(p);
+    } else {
+        unlink(p);
+    }
+}
+
+/* rss_kib: peak RSS of a finished child in KiB. */
+static long rss_kib(const struct rusage *ru){
+#if defined(__APPLE__)
+    return (long)(ru->ru_maxrss / 1024); // macOS reports bytes
+#else
+    return (long)ru->ru_maxrss; // Linux reports KiB
+#endif
+}
+
+/* bench_kdf: time crypto_pwhash at the parameters encrypt records (the
+   KDF profile's, see main). */
+static void bench_kdf(void){
+    const int runs = 3;
+    unsigned char key[crypto_kdf_KEYBYTES], salt[crypto_pwhash_SALTBYTES];
+    double best = 1e9, sum = 0;
+    randombytes_buf(salt, sizeof salt);
+    fprintf(stderr, "kdf: %d Argon2id runs\n", runs);
+    for (int i = 0; i < runs; ++i){
+        double t = now_s();
+        if (crypto_pwhash(key, sizeof key, g_pw, strlen(g_pw), salt,
+                          (unsigned long long)g_kdf_opslimit, (size_t)g_kdf_mem_kib * 1024ULL,
+                          crypto_pwhash_ALG_ARGON2ID13) != 0){ fprintf(stderr, "kdf: out of memory\n"); return; }
+        t = now_s() - t;
+        sum += t;
+        if (t < best) best = t;
+    }
+    sodium_memzero(key, sizeof key);
+    fprintf(J, "  \"kdf\": {\"alg\": \"argon2id13\", \"opslimit\": %llu, \"memlimit_kib\": %llu, "
+               "\"runs\": %d, \"seconds_min\": %.4f, \"seconds_avg\": %.4f},\n",
+            (unsigned long long)g_kdf_opslimit, (unsigned long long)g_kdf_mem_kib, runs, best, sum / runs);
+}
+
+/* bench_stream: encrypt/decrypt MB/s for one size; small sizes are repeated
+   until enough bytes moved for a stable number. */
+static void bench_stream_size(uint64_t size, int first){
+    char p[PATH_MAX], e[PATH_MAX], d[PATH_MAX];
+    snprintf(p, sizeof p, "%s/s.bin", g_dir);
+    snprintf(e, sizeof e, "%s/s.enc", g_dir);
+    snprintf(d, sizeof d, "%s/s.dec", g_dir);
+    if (make_file(p, size) != 0) return;
+
+    uint64_t reps = size >= (64u << 20) ? 1 : (64u << 20) / (size ? size : 1);
+    if (reps > 2000) reps = 2000; // tiny files: per-file overhead dominates anyway
+    fprintf(stderr, "stream: %llu bytes x %llu\n", (unsigned long long)size, (unsigned long long)reps);
+
+    double te = now_s();
+    int rc = 0;
+    for (uint64_t i = 0; i < reps && rc == 0; ++i) rc = encrypt_file_stream(p, e, g_pw);
+    te = now_s() - te;
+    double td = now_s();
+    for (uint64_t i = 0; i < reps && rc == 0; ++i) rc = decrypt_file_stream(e, d, g_pw);
+    td = now_s() - td;
+
+    stream_hdr_t h;
+    FILE *f = fopen(e, "rb");
+    int hok = f && stream_hdr_read(f, &h) == 0;
+    if (f) fclose(f);
+    double mb = (double)size * (double)reps / (1024.0 * 1024.0);
+    fprintf(J, "%s    {\"size\": %llu, \"reps\": %llu, \"layout\": \"%s\", \"cipher\": \"%s\", \"chunk_size\": %u, "
+               "\"ok\": %s, \"encrypt_s\": %.4f, \"decrypt_s\": %.4f, \"encrypt_mbps\": %.1f, \"decrypt_mbps\": %.1f}",
+            first ? "" : ",\n", (unsigned long long)size, (unsigned long long)reps,
+            hok && (h.flags & STREAM_FLAG_CHUNKED) ? "chunked" : "secretstream",
+            cipher_name(hok ? (int)STREAM_CIPHER(h.flags) : CIPHER_XCHACHA20), hok ? h.chunk_size : 0,
+            rc == 0 ? "true" : "false", te, td, te > 0 ? mb / te : 0.0, td > 0 ? mb / td : 0.0);
+    unlink(p); unlink(e); unlink(d);
+}
+
+static void bench_stream(uint64_t max_mb){
+    fprintf(J, "  \"stream\": [\n");
+    int first = 1;
+    for (uint64_t size = 1024; size <= (max_mb << 20); size *= 16, first = 0)
+        bench_stream_size(size, first);
+    fprintf(J, "\n  ],\n");
+}
+
+/* bench_ciphers: encrypt/decrypt MB/s of one chunked-layout file of `size`
+   bytes under every cipher suite this build and CPU support. */
+static void bench_ciphers(uint64_t size){
+    char p[PATH_MAX], e[PATH_MAX], d[PATH_MAX];
+    snprintf(p, sizeof p, "%s/c.bin", g_dir);
+    snprintf(e, sizeof e, "%s/c.enc", g_dir);
+    snprintf(d, sizeof d, "%s/c.dec", g_dir);
+    if (size < STREAM_PARALLEL_MIN) size = STREAM_PARALLEL_MIN; // chunked layout only
+    if (make_file(p, size) != 0) return;
+
+    fprintf(J, "  \"ciphers\": {\"size\": %llu, \"auto\": \"%s\", \"suites\": [\n",
+            (unsigned long long)size, cipher_name(cipher_pick()));
+    int first = 1;
+    for (int c = 0; c < CIPHER_COUNT; ++c){
+        if (!cipher_available(c)) continue;
+        fprintf(stderr, "cipher: %s\n", cipher_name(c));
+        g_cipher = c;
+        double te = now_s();
+        int rc = encrypt_file_stream(p, e, g_pw);
+        te = now_s() - te;
+        double td = now_s();
+        if (rc == 0) rc = decrypt_file_stream(e, d, g_pw);
+        td = now_s() - td;
+        double mb = (double)size / (1024.0 * 1024.0);
+        fprintf(J, "%s    {\"cipher\": \"%s\", \"ok\": %s, \"encrypt_mbps\": %.1f, \"decrypt_mbps\": %.1f}",
+                first ? "" : ",\n", cipher_name(c), rc == 0 ? "true" : "false",
+                te > 0 ? mb / te : 0.0, td > 0 ? mb / td : 0.0);
+        first = 0;
+    }
+    g_cipher = CIPHER_AUTO;
+    fprintf(J, "\n  ]},\n");
+    unlink(p); unlink(e); unlink(d);
+}
+
+/* rss_child: run `op` in a child process and return its peak RSS in KiB
+   (the parent's own footprint does not leak into the number), or -1 if it
+   failed. "baseline" does nothing; "kdf_only" runs the one Argon2id the
+   legacy path pays per file (MODERATE limits, fresh salt); the other ops
+   work on plaintext `p`, ciphertext `e` and output `d`. */
+static long rss_child(const char *op, const char *p, const char *e, const char *d){
+    int legacy = strncmp(op, "legacy", 6) == 0;
+    int decrypt = strstr(op, "decrypt") != NULL;
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0){
+        int rc = 0;
+        if (strcmp(op, "kdf_only") == 0){
+            unsigned char key[crypto_kdf_KEYBYTES], salt[crypto_pwhash_SALTBYTES];
+            randombytes_buf(salt, sizeof salt);
+            rc = crypto_pwhash(key, sizeof key, g_pw, strlen(g_pw), salt,
+                               crypto_pwhash_OPSLIMIT_MODERATE, crypto_pwhash_MEMLIMIT_MODERATE,
+                               crypto_pwhash_ALG_ARGON2ID13);
+        } else if (strcmp(op, "baseline") != 0){
+            rc = decrypt ? (legacy ? decrypt_file(e, d, g_pw) : decrypt_file_stream(e, d, g_pw))
+                         : (legacy ? encrypt_file(p, e, g_pw) : encrypt_file_stream(p, e, g_pw));
+        }
+        _exit(rc == 0 ? 0 : 1);
+    }
+    int status = 0;
+    struct rusage ru;
+    memset(&ru, 0, sizeof ru);
+    int ok = pid > 0 && wait4(pid, &status, 0, &ru) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return ok ? rss_kib(&ru) : -1;
+}
+
+/* bench_rss_one: peak RSS of one operation on a `size`-byte file. The
+   legacy children derive their key with a fresh salt, so their peak holds
+   an Argon2id working set the stream children (warm session) do not pay;
+   net_rss_kib takes `kdf_kib` (the kdf_only child over the baseline) back
+   out, never going below `base`. */
+static void bench_rss_one(const char *op, uint64_t size, long base, long kdf_kib){
+    char p[PATH_MAX], e[PATH_MAX], d[PATH_MAX];
+    snprintf(p, sizeof p, "%s/r.bin", g_dir);
+    snprintf(e, sizeof e, "%s/r.enc", g_dir);
+    snprintf(d, sizeof d, "%s/r.dec", g_dir);
+    int legacy = strncmp(op, "legacy", 6) == 0;
+    int decrypt = strstr(op, "decrypt") != NULL;
+    if (make_file(p, size) != 0) return;
+    if (decrypt && (legacy ? encrypt_file(p, e, g_pw) : encrypt_file_stream(p, e, g_pw)) != 0) return;
+    fprintf(stderr, "rss: %s %llu bytes\n", op, (unsigned long long)size);
+
+    long peak = rss_child(op, p, e, d);
+    long net = legacy && peak >= 0 ? peak - kdf_kib : peak;
+    if (legacy && net < base) net = base;
+    fprintf(J, ",\n    {\"op\": \"%s\", \"size\": %llu, \"ok\": %s, \"kdf_in_child\": %s, "
+            "\"peak_rss_kib\": %ld, \"net_rss_kib\": %ld}",
+            op, (unsigned long long)size, peak >= 0 ? "true" : "false", legacy ? "true" : "false", peak, net);
+    unlink(p); unlink(e); unlink(d);
+}
+
+/* bench_rss: baseline and KDF-only children first, then each path. The
+   session's master key is derived before any child forks, so the stream
+   children never run Argon2id themselves. */
+static void bench_rss(uint64_t size){
+    const char *ops[] = { "legacy_encrypt", "legacy_decrypt", "stream_encrypt", "stream_decrypt" };
+    unsigned char salt[16], key[crypto_kdf_KEYBYTES];
+    uint32_t ops_limit = 0, mem_kib = 0;
+    if (session_encrypt_params(g_pw, salt, &ops_limit, &mem_kib) != 0 ||
+        session_master_key(g_pw, salt, ops_limit, mem_kib, key) != 0) return; // warm the run's key
+    sodium_memzero(key, sizeof key);
+
+    long base = rss_child("baseline", NULL, NULL, NULL);
+    long kdf = rss_child("kdf_only", NULL, NULL, NULL);
+    long kdf_kib = base >= 0 && kdf > base ? kdf - base : 0; // what one legacy Argon2id adds
+    fprintf(J, "  \"rss\": [\n");
+    fprintf(J, "    {\"op\": \"baseline\", \"ok\": %s, \"peak_rss_kib\": %ld},\n", base >= 0 ? "true" : "false", base);
+    fprintf(J, "    {\"op\": \"kdf_only\", \"ok\": %s, \"peak_rss_kib\": %ld}", kdf >= 0 ? "true" : "false", kdf);
+    for (size_t i = 0; i < sizeof ops / sizeof ops[0]; ++i) bench_rss_one(ops[i], size, base, kdf_kib);
+    fprintf(J, "\n  ],\n");
+}
+
+/* build_tree: create `files` files of `size` bytes under `root`, nested
+   `depth` directories deep (files spread over the levels). Returns bytes. */
+static uint64_t build_tree(const char *root, int files, uint64_t size, int depth){
+    char dir[PATH_MAX - 16]; // leaves room for the file name below
+    snprintf(dir, sizeof dir, "%.*s", (int)sizeof dir - 1, root);
+    mkdir(dir, 0700);
+    uint64_t total = 0;
+    int per_level = files / depth + (files % depth != 0);
+    for (int lvl = 0, made = 0; lvl < depth && made < files; ++lvl){
+        if (lvl > 0){
+            size_t n = strlen(dir);
+            snprintf(dir + n, sizeof dir - n, "/d%d", lvl); // one level deeper
+            mkdir(dir, 0700);
+        }
+        for (int i = 0; i < per_level && made < files; ++i, ++made){
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "%s/f%05d.bin", dir, made);
+            if (make_file(p, size) == 0) total += size;
+        }
+    }
+    return total;
+}
+
+/* bench_tree_one: encrypt then decrypt a fresh tree through path_handler
+   with the given engine settings (sources removed on success, like --rm,
+   so the decrypt walk only sees ciphertext). */
+static void bench_tree_one(const char *name, int files, uint64_t size, int depth,
+                           const char *engine, int jobs, int uring, int first){
+    char root[PATH_MAX];
+    snprintf(root, sizeof root, "%s/tree", g_dir);
+    rm_tree(root);
+    uint64_t bytes = build_tree(root, files, size, depth);
+    fprintf(stderr, "tree: %s (%d files) engine=%s\n", name, files, engine);
+
+    g_jobs = jobs; g_uring_depth = uring; g_delete_on_success = 1;
+    double te = now_s();
+    int rce = path_handler(encrypt_inplace, WALK_ENCRYPT, root, g_pw, NULL);
+    te = now_s() - te;
+    double td = now_s();
+    int rcd = path_handler(decrypt_inplace, WALK_DECRYPT, root, g_pw, ".dec");
+    td = now_s() - td;
+    g_jobs = 1; g_uring_depth = 0; g_delete_on_success = 0;
+
+    double mb = (double)bytes / (1024.0 * 1024.0);
+    fprintf(J, "%s    {\"workload\": \"%s\", \"engine\": \"%s\", \"files\": %d, \"file_size\": %llu, \"depth\": %d, "
+               "\"ok\": %s, \"encrypt_s\": %.4f, \"decrypt_s\": %.4f, \"encrypt_files_per_s\": %.1f, "
+               "\"decrypt_files_per_s\": %.1f, \"encrypt_mbps\": %.1f, \"decrypt_mbps\": %.1f}",
+            first ? "" : ",\n", name, engine, files, (unsigned long long)size, depth,
+            rce == 0 && rcd == 0 ? "true" : "false", te, td,
+            te > 0 ? files / te : 0.0, td > 0 ? files / td : 0.0, te > 0 ? mb / te : 0.0, td > 0 ? mb / td : 0.0);
+    rm_tree(root);
+}
+
+static void bench_tree(int quick, int cpus){
+    struct { const char *name; int files; uint64_t size; int depth; } w[] = {
+        { "many_small", quick ? 500 : 5000, 4096, 1 },
+        { "few_large",  4, quick ? (8u << 20) : (64u << 20), 1 },
+        { "deep",       quick ? 200 : 1000, 16384, 40 },
+    };
+    int first = 1;
+    fprintf(J, "  \"tree\": [\n");
+    for (size_t i = 0; i < sizeof w / sizeof w[0]; ++i){
+        bench_tree_one(w[i].name, w[i].files, w[i].size, w[i].depth, "serial", 1, 0, first); first = 0;
+        if (cpus > 1) bench_tree_one(w[i].name, w[i].files, w[i].size, w[i].depth, "jobs", cpus, 0, 0);
+        bench_tree_one(w[i].name, w[i].files, w[i].size, w[i].depth, "uring", 1, URING_DEPTH_DEFAULT, 0);
+    }
+    fprintf(J, "\n  ]\n");
+}
+
+/* main: run every benchmark group and emit one JSON document. */
+int main(void){
+    if (sodium_init() < 0) return 1;
+
+    // JSON goes to the original stdout; library reports go to /dev/null.
+    int jfd = dup(STDOUT_FILENO);
+    J = jfd >= 0 ? fdopen(jfd, "w") : NULL;
+    int nul = open("/dev/null", O_WRONLY);
+    if (!J || nul < 0){ perror("bench: stdout"); return 1; }
+    dup2(nul, STDOUT_FILENO); close(nul);
+
+    const char *env_dir = getenv("BENCH_DIR");
+    if (env_dir && *env_dir) snprintf(g_dir, sizeof g_dir, "%s/ss-bench-XXXXXX", env_dir);
+    else snprintf(g_dir, sizeof g_dir, "/tmp/ss-bench-XXXXXX");
+    if (!mkdtemp(g_dir)){ perror("bench: mkdtemp"); return 1; }
+
+    int quick = getenv("BENCH_QUICK") && *getenv("BENCH_QUICK");
+    uint64_t max_mb = quick ? 16 : 256;
+    if (getenv("BENCH_MAX_MB")) max_mb = strtoull(getenv("BENCH_MAX_MB"), NULL, 10);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+
+    struct utsname un;
+    memset(&un, 0, sizeof un);
+    uname(&un);
+    fprintf(J, "{\n  \"tool\": \"streamseal-bench\", \"format_version\": %d, \"timestamp\": %lld,\n"
+               "  \"host\": {\"sysname\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\", \"cpus\": %ld},\n",
+            STREAMSEAL_VERSION, (long long)time(NULL), un.sysname, un.release, un.machine, cpus);
+
+    if (kdf_profile_load(getenv("BENCH_KDF_PROFILE")) != 0) return 1; // else ./kdf.profile, as encrypt does
+    session_begin(g_pw); // one Argon2id for the whole suite, as in a real run
+    bench_kdf();
+    bench_stream(max_mb);
+    bench_ciphers(max_mb << 20);
+    bench_rss(quick ? (16u << 20) : (256u << 20));
+    bench_tree(quick, (int)cpus);
+    session_end();
+    fprintf(J, "}\n");
+    fclose(J);
+
+    rm_tree(g_dir);
+    return 0;
+}
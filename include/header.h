@@ -41,6 +41,16 @@ extern "C" {
 #define PATH_MAX 4096
 #endif
 
+/* Size of every password buffer (main, prompts, login). */
+#define PASSWORD_MAX 1024
+
+/* ST_NS: timestamp `f` (st_mtim, st_ctim) of a struct stat in nanoseconds. */
+#if defined(__APPLE__)
+#define ST_NS(st, f) ((int64_t)(st).f##espec.tv_sec * 1000000000 + (st).f##espec.tv_nsec)
+#else
+#define ST_NS(st, f) ((int64_t)(st).f.tv_sec * 1000000000 + (st).f.tv_nsec)
+#endif
+
 /* ---------- File format v1 (simple AEAD blob) ---------- */
 static const uint8_t MAGIC[6] = { 'S','I','M','P','L','1' };
 
@@ -50,44 +60,433 @@ typedef struct {
     unsigned char nonce[12];
 } simple_hdr_t;
 
+/* SIMPL1 payloads are sealed and opened SIMPLE_CHUNK bytes at a time (a
+   multiple of the SIMPLE_BLOCK-byte ChaCha20 block), so memory use does not
+   depend on the file size. */
+#define SIMPLE_BLOCK 64
+#define SIMPLE_CHUNK (1024 * 1024)
+
 /* ---------- File format v2 (streaming / secretstream) ---------- */
-#define STREAMSEAL_VERSION 1
-#define STREAM_CHUNK (64 * 1024)
+#define STREAMSEAL_VERSION    4   /* current: random data key wrapped in password key slots */
+#define STREAMSEAL_VERSION_V3 3   /* adds flags, chunk size, plaintext size */
+#define STREAMSEAL_VERSION_V2 2   /* per-run master key + per-file subkey */
+#define STREAMSEAL_VERSION_V1 1   /* legacy: one Argon2id run per file */
+#define STREAM_CHUNK (64 * 1024)       /* default, and implied by v1/v2 headers */
+
+/* Bounds on the header-recorded chunk size (v3+). Decrypt allocates a few
+   chunk-sized buffers per thread, so a hostile header cannot ask for more. */
+#define STREAM_CHUNK_MIN (4 * 1024)
+#define STREAM_CHUNK_MAX (16 * 1024 * 1024)
+
+/* Header flags (v3+). */
+#define STREAM_FLAG_CHUNKED 0x1u  /* independent AEAD chunks instead of secretstream */
+#define STREAM_FLAG_PACK    0x2u  /* secretstream payload is a pack container (vault_pack.c) */
+
+/* Per-chunk compression (--compress, vault_compress.c): the codec id sits
+   in flag bits 8..11 and every sealed chunk starts with a kind byte. */
+#define STREAM_CODEC_MASK   0xF00u
+#define STREAM_CODEC_SHIFT  8
+#define STREAM_CODEC(flags) (((flags) & STREAM_CODEC_MASK) >> STREAM_CODEC_SHIFT)
+enum { CODEC_NONE, CODEC_ZSTD, CODEC_LZ4, CODEC_COUNT };
+/* AEAD cipher suite of the chunked layout (--cipher, vault_cipher.c): the
+   suite id sits in flag bits 12..15; 0 is XChaCha20-Poly1305, the only
+   suite of secretstream files. CIPHER_AUTO picks the fastest one the CPU
+   runs in hardware. */
+#define STREAM_CIPHER_MASK   0xF000u
+#define STREAM_CIPHER_SHIFT  12
+#define STREAM_CIPHER(flags) (((flags) & STREAM_CIPHER_MASK) >> STREAM_CIPHER_SHIFT)
+enum { CIPHER_XCHACHA20, CIPHER_AES256GCM, CIPHER_AEGIS256, CIPHER_COUNT };
+#define CIPHER_AUTO (-1)
+#define CHUNK_RAW    0   /* chunk stored as read */
+#define CHUNK_PACKED 1   /* chunk compressed with the header's codec */
+
+/* Pack container records: type u8 | mode u32 | size u64 | path_len u16,
+   then the path and `size` content bytes. */
+#define PACK_REC_SIZE 15
+#define PACK_FILE     'F'   /* regular file */
+#define PACK_END      'E'   /* last record */
+
+/* Incremental sync (`vault sync`): the destination keeps an encrypted
+   manifest of what it holds; the walker never processes that file. */
+#define SYNC_MANIFEST   ".vault-manifest"
+#define SYNC_HASH_BYTES crypto_generichash_BYTES
+
+/* Regular files at least this large use the chunked (parallel) layout. */
+#define STREAM_PARALLEL_MIN (4 * 1024 * 1024)
+
+/* io_uring batch engine (--uring): files up to URING_FILE_MAX bytes are
+   read, sealed and written in memory with up to `depth` files in flight;
+   larger ones go through the regular per-file path. */
+#define URING_FILE_MAX      (256 * 1024)
+#define URING_DEPTH_DEFAULT 64
+#define URING_DEPTH_MAX     1024
+#define URING_FD_SPARE      16   /* stdio, the ring, agent socket, fallback outputs */
+
+/* Worker pool (--jobs): at most POOL_JOBS_MAX worker threads. */
+#define POOL_JOBS_MAX       1024
 static const uint8_t STREAM_MAGIC[6] = { 'S','E','A','L','v','1' };
 
-/* Header is partially bound as AAD (up to, but not including, ss_header). */
+/* Legacy v1 on-disk header, written as a raw struct.
+   Bound as AAD up to, but not including, ss_header. */
 typedef struct {
     uint8_t  magic[6];   /* "SEALv1" */
-    uint16_t version;    /* STREAMSEAL_VERSION */
+    uint16_t version;    /* STREAMSEAL_VERSION_V1 */
     uint32_t kdf_mem_kib;   /* Argon2id mem limit used (KiB) */
     uint32_t kdf_opslimit;  /* Argon2id ops limit used */
     unsigned char salt[16]; /* Argon2id salt */
     unsigned char ss_header[crypto_secretstream_xchacha20poly1305_HEADERBYTES]; /* secretstream header */
+} stream_hdr_v1_t;
+
+/* On-disk size of the current header (little-endian fields):
+   magic[6] | version u16 | flags u32 | chunk_size u32 | plain_size u64 |
+   ss_header[24] | slot[STREAM_KEY_SLOTS].
+   The prefix before ss_header is the payload AAD. The payload key is random
+   per file; each key slot holds it wrapped under one password:
+   kdf_mem_kib u32 | kdf_opslimit u32 | salt[16] | nonce[24] | wrapped[48],
+   and a slot with kdf_opslimit 0 is empty. `vault rekey` rewrites only the
+   slots. v3 was magic | version | kdf_mem_kib | kdf_opslimit | salt[16] |
+   file_id u64 | flags | chunk_size | plain_size | ss_header, AAD up to
+   ss_header; v2 ends after file_id + ss_header. */
+#define STREAM_PREFIX_SIZE (6 + 2 + 4 + 4 + 8)
+#define STREAM_KEY_SLOTS   2
+#define STREAM_SLOT_SIZE   (4 + 4 + 16 + crypto_aead_xchacha20poly1305_ietf_NPUBBYTES + \
+                            crypto_kdf_KEYBYTES + crypto_aead_xchacha20poly1305_ietf_ABYTES)
+#define STREAM_SLOT_OFF(i) (STREAM_PREFIX_SIZE + crypto_secretstream_xchacha20poly1305_HEADERBYTES + \
+                            (i) * STREAM_SLOT_SIZE)
+#define STREAM_HDR_SIZE    STREAM_SLOT_OFF(STREAM_KEY_SLOTS)
+#define STREAM_HDR_V3_SIZE (6 + 2 + 4 + 4 + 16 + 8 + 4 + 4 + 8 + crypto_secretstream_xchacha20poly1305_HEADERBYTES)
+#define STREAM_HDR_MAX     256
+
+/* One v4 key slot: the payload key sealed under a key-encryption key that
+   comes from Argon2id(password, salt, opslimit, mem_kib). */
+typedef struct {
+    uint32_t kdf_mem_kib;   /* Argon2id mem limit used (KiB) */
+    uint32_t kdf_opslimit;  /* Argon2id ops limit used; 0 = empty slot */
+    unsigned char salt[16]; /* Argon2id salt */
+    unsigned char nonce[crypto_aead_xchacha20poly1305_ietf_NPUBBYTES];
+    unsigned char wrapped[crypto_kdf_KEYBYTES + crypto_aead_xchacha20poly1305_ietf_ABYTES]; /* sealed payload key */
+} stream_slot_t;
+
+/* Parsed header (any version). `raw` holds the exact on-disk bytes so the
+   AAD can be rebound byte-for-byte on decrypt. */
+typedef struct {
+    uint16_t version;       /* STREAMSEAL_VERSION* */
+    uint32_t kdf_mem_kib;   /* Argon2id mem limit used (KiB, v1-v3) */
+    uint32_t kdf_opslimit;  /* Argon2id ops limit used (v1-v3) */
+    unsigned char salt[16]; /* Argon2id salt (per run since v2, v1-v3) */
+    uint64_t file_id;       /* per-file subkey id (v2, v3) */
+    uint32_t flags;         /* STREAM_FLAG_* (v3+) */
+    uint32_t chunk_size;    /* plaintext bytes per chunk (v3+) */
+    uint64_t plain_size;    /* total plaintext bytes (chunked layout only) */
+    unsigned char ss_header[crypto_secretstream_xchacha20poly1305_HEADERBYTES]; /* secretstream header,
+                               or the per-file nonce base when STREAM_FLAG_CHUNKED */
+
+    stream_slot_t slots[STREAM_KEY_SLOTS]; /* wrapped payload key (v4+) */
+
+    unsigned char raw[STREAM_HDR_MAX]; /* serialized header */
+    size_t raw_len;         /* bytes on disk */
+    size_t aad_len;         /* leading bytes of raw bound as AAD */
 } stream_hdr_t;
 
+/* ---------- Per-run key session ---------- */
+/* The password is stretched once per (salt, KDF params) into a master key;
+   each v2/v3 file key is crypto_kdf_derive_from_key(master, file_id, context),
+   and a v4 key slot is sealed under the master's subkey 0 in SESSION_WRAP_CONTEXT. */
+#define SESSION_KDF_CONTEXT  "SSealFil"
+#define SESSION_WRAP_CONTEXT "SSealKek"
+#define SESSION_CACHE_SLOTS 8
+
+/* Key agent (`vault agent`): after one login it keeps the password's master
+   keys in locked memory for up to a TTL and serves them to this user's later
+   runs over a 0600 Unix socket (peer uid checked both ways), so those runs
+   skip the login prompt and Argon2id. Socket: $VAULT_AGENT_SOCK, else
+   $XDG_RUNTIME_DIR/vault-agent.sock, else /tmp/vault-agent-<uid>.sock. */
+#define AGENT_SOCK_ENV    "VAULT_AGENT_SOCK"
+#define AGENT_TTL_DEFAULT 3600              /* seconds */
+#define AGENT_TTL_MAX     (31 * 24 * 3600)
+
+/* ---------- Argon2id cost profile ---------- */
+/* `vault calibrate` writes KDF_PROFILE_FILE next to user.pass; the walker
+   never processes it. Profiles outside these bounds are rejected, and so
+   are limits above KDF_MEM_MAX_KIB / KDF_OPSLIMIT_MAX in a file header or
+   an agent request (kdf_limits_ok), before any Argon2id runs. */
+#define KDF_PROFILE_FILE   "kdf.profile"
+#define KDF_TARGET_MS      500                 /* calibrate's default latency */
+#define KDF_MEM_MIN_KIB    (8 * 1024)          /* 8 MiB */
+#define KDF_MEM_CAP_KIB    (1024 * 1024)       /* default cap: 1 GiB (or RAM/8) */
+#define KDF_MEM_MAX_KIB    (2u * 1024 * 1024)  /* hard ceiling: 2 GiB */
+#define KDF_OPSLIMIT_MAX   256
+
+typedef struct {
+    uint32_t target_ms;     /* latency the limits were tuned for */
+    uint32_t mem_cap_kib;   /* memory budget calibrate was given */
+    uint32_t opslimit;      /* Argon2id passes */
+    uint32_t mem_kib;       /* Argon2id memory (KiB) */
+    uint32_t measured_ms;   /* one stretch at these limits (0 = not measured) */
+} kdf_profile_t;
+
+/* ---------- Read/crypt/write pipeline ---------- */
+/* Buffers in flight per side of the pipeline (--pipeline). */
+#define PIPELINE_DEPTH 4
+
+/* Pipeline transform: turn `n` input bytes (`eof` on the last chunk) into
+   at most the output capacity; set *done when no more input is wanted. */
+typedef int (*pipe_xform)(void *ctx, const unsigned char *in, size_t n, int eof,
+                          unsigned char *out, size_t *out_len, int *done);
+
+/* ---------- Crash-safe outputs ---------- */
+/* Results go to a temp file in the destination directory and are renamed
+   into place once durable. Directory runs group that work: every
+   COMMIT_GROUP_MAX outputs share one data sync and one fsync per directory. */
+#define COMMIT_GROUP_MAX 256
+#define OUT_TMP_PREFIX   ".sstmp-"   /* named temps; the walker skips them */
+
+typedef struct {
+    int   fd;                 /* output descriptor until commit/abort */
+    FILE *fp;                 /* stdio view (out_stream), or NULL */
+    int   anon;               /* O_TMPFILE: no name yet */
+    char  tmp[PATH_MAX];      /* temp name (named temps, or once linked) */
+    char  path[PATH_MAX];     /* final name */
+    unsigned long seq;        /* open order (commit_ticket) */
+} vault_out_t;
+
+/* Resumable chunked-layout runs (--resume, vault_resume.c): the output is
+   built in a partial file with a fixed name and a journal records how many
+   leading chunks are durable. The journal is rewritten every RESUME_WINDOW
+   plaintext bytes, after a data sync of the partial output. */
+#define RESUME_WINDOW (256u * 1024 * 1024)
+
+typedef struct {
+    uint32_t decrypt;        /* 0 = encrypt, 1 = decrypt */
+    uint64_t src_dev;        /* input identity: device, inode, size, mtime, ctime */
+    uint64_t src_ino;
+    uint64_t src_size;
+    int64_t  src_mtime_ns;
+    int64_t  src_ctime_ns;   /* not settable from userspace, unlike mtime */
+    unsigned char hdr_hash[16]; /* BLAKE2b-128 of the stream header */
+    uint64_t done;           /* chunks [0, done) are durable */
+} resume_jnl_t;
+
+/* ---------- Run statistics (--stats, --stats-json) ---------- */
+/* Timed phases: wall time, bytes and calls are summed per phase. */
+enum { STATS_LOGIN, STATS_KDF, STATS_WALK, STATS_READ, STATS_CRYPT, STATS_WRITE, STATS_CLOSE, STATS_PHASES };
+/* Plain counters (read/write calls come from the READ/WRITE phases). */
+enum { STATS_CHUNKS, STATS_SKIPPED, STATS_SYS_OPEN, STATS_SYS_CLOSE, STATS_SYS_STAT, STATS_SYS_MMAP,
+       STATS_SYS_URING, STATS_SYS_FSYNC, STATS_SYS_MLOCK, STATS_COUNTERS };
+
+/* Per-file record (opaque; see vault_stats.c). */
+typedef struct stats_file stats_file_t;
+
+/* ---------- Buffer pool ---------- */
+/* Whole-file and chunk buffers come from one per-process pool and return to
+   it when freed, so a directory run allocates them once, not per file.
+   BUF_SECRET buffers (plaintext, keys) are sodium_malloc'd: guard pages,
+   canary, mlock, wiped on release. BUF_PLAIN buffers (ciphertext) are plain
+   heap and use no locked memory. */
+#define BUF_PLAIN          0
+#define BUF_SECRET         1
+#define BUF_PAGE           4096
+#define BUF_POOL_IDLE      64                  /* idle buffers kept for reuse */
+#define BUF_POOL_IDLE_MAX  ((size_t)64 << 20)  /* idle bytes kept for reuse */
+
+/* ---------- mmap I/O backend ---------- */
+typedef struct {
+    unsigned char *base;  /* mapping (NULL for empty files) */
+    size_t len;           /* mapped length */
+    int    writable;      /* output mapping (MAP_SHARED) */
+    int    fd;            /* descriptor behind an output mapping (not owned) */
+} vault_map_t;
+
 /* ---------- Public API ---------- */
 
 typedef int (*encrypt_func)(const char*, char*, const char*);
+typedef int (*file_visitor)(const char *path, void *ctx);
+
+/* path_walk filters: which regular files a walk hands to its visitor.
+   user.pass, kdf.profile and uncommitted output temps are always skipped. */
+#define WALK_NO_MANIFEST 0x1u  /* skip sync manifests (per-file operations) */
+#define WALK_NO_ENC      0x2u  /* skip .enc files */
+#define WALK_NO_DEC      0x4u  /* skip .dec files */
+#define WALK_ENC_ONLY    0x8u  /* visit .enc files only */
+#define WALK_ALL         0u                                 /* whole-tree runs: pack, sync, rekey */
+#define WALK_ENCRYPT     (WALK_NO_MANIFEST | WALK_NO_ENC)   /* encrypt: not yet encrypted */
+#define WALK_DECRYPT     (WALK_NO_MANIFEST | WALK_NO_DEC)   /* decrypt: not a decrypt output */
+#define WALK_CIPHERTEXT  (WALK_NO_MANIFEST | WALK_ENC_ONLY) /* verify, migrate */
+#define WALK_OPEN_MAX    64  /* directory descriptors a walk keeps open */
 
-/* v1 whole-file operations */
+/* v1 (SIMPL1) operations; payloads in SIMPLE_CHUNK pieces (vault_simple.c) */
 int decrypt_file (const char *in_path, const char *out_path, char *pwd);
 int encrypt_file (const char *in_path, const char *out_path, char *pwd);
+int simple_mac_begin(crypto_onetimeauth_poly1305_state *st, const unsigned char nonce[12],
+                     const unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES]);
+void simple_mac_end(crypto_onetimeauth_poly1305_state *st, uint64_t clen,
+                    unsigned char tag[crypto_aead_chacha20poly1305_ietf_ABYTES]);
+int simple_xor(unsigned char *out, const unsigned char *in, size_t n, uint64_t off,
+               const unsigned char nonce[12], const unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES]);
 
 /* v2 streaming operations */
 int encrypt_file_stream(const char *in_path, const char *out_path, char *pwd);
 int decrypt_file_stream(const char *in_path, const char *out_path, char *pwd);
+int decrypt_stream_range(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key,
+                         uint64_t off, uint64_t len);
+
+/* one-pass streams (stdin/stdout for `-`) */
+int encrypt_pipe(FILE *in, FILE *out, char *pwd);
+int decrypt_pipe(FILE *in, FILE *out, char *pwd);
+
+/* shared header setup for the encryptors */
+uint32_t stream_chunk_for(uint64_t size);
+int stream_hdr_new(stream_hdr_t *h, uint32_t flags, uint64_t plain_size, uint32_t chunk_size, char *pwd,
+                   unsigned char key[crypto_kdf_KEYBYTES]);
+
+/* whole secretstream payloads in memory (mmap backend, io_uring engine) */
+size_t stream_sealed_size(size_t len, size_t cs);
+int    stream_push_buf(crypto_secretstream_xchacha20poly1305_state *st, const stream_hdr_t *h,
+                       const unsigned char *src, size_t len, unsigned char *dst);
+int    stream_opened_size(size_t clen, size_t cs, size_t *out);
+int    stream_pull_buf(const stream_hdr_t *h, const unsigned char *key,
+                       const unsigned char *src, size_t clen, unsigned char *dst);
+
+/* threaded read/crypt/write pipeline (used when g_pipeline is set) */
+int pipeline_run(FILE *in, FILE *out, size_t read_size, size_t out_cap, int plain_in, pipe_xform fn, void *ctx);
+
+/* crash-safe outputs (temp + fsync + rename, grouped in directory runs) */
+int   out_open(vault_out_t *o, const char *path, int rdwr);
+FILE *out_stream(vault_out_t *o, const char *mode);
+int   out_commit(vault_out_t *o);
+void  out_abort(vault_out_t *o);
+int   out_tmp_name(const char *path, char *tmp, size_t cap);
+void  commit_begin(void);
+int   commit_end(void);
+void  commit_source(const char *src);
+int   commit_named(int fd, unsigned long seq, const char *tmp, const char *path, const char *src);
+unsigned long commit_ticket(void);
+
+/* resume journals for the chunked layout (--resume) */
+int resume_paths(const char *out_path, char *part, char *journal, size_t cap);
+int resume_ident(resume_jnl_t *j, int decrypt, int fd, const stream_hdr_t *h);
+int resume_same(const resume_jnl_t *j, const resume_jnl_t *cur);
+int resume_save(const char *path, const resume_jnl_t *j, uint64_t out_off);
+int resume_load(const char *path, resume_jnl_t *j, uint64_t *out_off);
+int resume_skip(const char *in_path, const char *out_path);
+
+/* run statistics (no-ops unless g_stats is set) */
+int      stats_begin(int report, const char *json_path);
+void     stats_end(void);
+uint64_t stats_now(void);
+void     stats_add(int phase, uint64_t t0, uint64_t bytes);
+void     stats_count(int counter, uint64_t n);
+stats_file_t *stats_file_begin(const char *path);
+void     stats_file_end(stats_file_t *f, int rc);
+stats_file_t *stats_file_current(void);
+void     stats_file_attach(stats_file_t *f);
+
+/* buffer pool (vault_buf.c) */
+void *buf_alloc(size_t n, int secret);
+void  buf_free(void *p);
+void  buf_pool_drain(void);
+
+/* mmap backend (used when g_use_mmap is set) */
+int map_fd_input(int fd, vault_map_t *m);
+int map_fd_output(int fd, size_t len, vault_map_t *m);
+int unmap_file(vault_map_t *m, size_t keep);
+
+/* ranged plaintext read (`vault cat`) */
+int cat_file(const char *in_path, uint64_t offset, uint64_t length, FILE *out, char *pwd);
+
+/* streamed header codec */
+int stream_hdr_encode(stream_hdr_t *h);
+size_t stream_hdr_prefix(const stream_hdr_t *h, unsigned char p[STREAM_PREFIX_SIZE]);
+int stream_hdr_read(FILE *in, stream_hdr_t *h);
+int stream_hdr_parse(const unsigned char *buf, size_t len, stream_hdr_t *h);
+
+/* per-run key session (password stretched once, subkeys per file) */
+int  session_begin(const char *pwd);
+int  session_begin_agent(void);
+void session_end(void);
+int  session_encrypt_params(const char *pwd, unsigned char salt[16], uint32_t *opslimit, uint32_t *mem_kib);
+int  kdf_limits_ok(uint64_t opslimit, uint64_t mem_kib);
+int  session_master_key(const char *pwd, const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                        unsigned char key[crypto_kdf_KEYBYTES]);
+int  session_file_key(const char *pwd, const stream_hdr_t *h, unsigned char *key, size_t keylen);
+int  session_open_slot(const char *pwd, const stream_hdr_t *h, unsigned char key[crypto_kdf_KEYBYTES]);
+int  stream_slot_seal(stream_hdr_t *h, int i, const unsigned char master[crypto_kdf_KEYBYTES],
+                      const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                      const unsigned char key[crypto_kdf_KEYBYTES]);
+int  stream_slot_open(const stream_hdr_t *h, int i, const unsigned char master[crypto_kdf_KEYBYTES],
+                      unsigned char key[crypto_kdf_KEYBYTES]);
+
+/* per-chunk compression (variable-length secretstream frames) */
+int codec_parse(const char *spec, int *id, int *level);
+int codec_available(int id);
+const char *codec_name(int id);
+int stream_push_codec(FILE *in, FILE *out, const stream_hdr_t *h, crypto_secretstream_xchacha20poly1305_state *st);
+int stream_pull_codec(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key,
+                      uint64_t off, uint64_t len);
+
+/* AEAD cipher suites of the chunked layout */
+int cipher_parse(const char *spec, int *id);
+int cipher_available(int id);
+int cipher_pick(void);
+const char *cipher_name(int id);
+size_t cipher_abytes(int id);
+int cipher_seal(int id, unsigned char *c, const unsigned char *m, size_t mlen, const unsigned char *ad, size_t adlen,
+                const unsigned char *base, uint64_t i, int final, const unsigned char *key);
+int cipher_open(int id, unsigned char *m, const unsigned char *c, size_t clen, const unsigned char *ad, size_t adlen,
+                const unsigned char *base, uint64_t i, int final, const unsigned char *key);
+
+/* pack containers: a whole tree in one stream (`vault pack` / `unpack`) */
+int pack_dir(const char *dir, const char *out_path, char *pwd);
+int unpack_dir(const char *in_path, const char *dir, char *pwd);
+
+/* incremental directory sync with a manifest (`vault sync`) */
+int sync_dir(const char *src, const char *dst, char *pwd, int hash);
+
+/* key agent daemon and its client side (`vault agent`) */
+int agent_serve(char *pwd, uint64_t ttl);
+int agent_stop(void);
+int agent_run_salt(unsigned char salt[16]);
+int agent_master_key(const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                     unsigned char key[crypto_kdf_KEYBYTES]);
+
+/* Argon2id limits for new keys (`vault calibrate`, --kdf-profile) */
+int kdf_calibrate(uint32_t target_ms, uint32_t mem_cap_kib, kdf_profile_t *p);
+int kdf_profile_read(const char *path, kdf_profile_t *p);
+int kdf_profile_write(const char *path, const kdf_profile_t *p);
+int kdf_profile_load(const char *spec);
+uint32_t kdf_mem_default(void);
+
+/* password change over a tree of v4 files (`vault rekey`) */
+int rekey_tree(const char *path, char *old_pwd, const char *new_pwd);
+
+/* chunk-independent layout (vault_chunked.c) */
+int encrypt_file_chunked(const char *in_path, const char *out_path, char *pwd, int threads);
+int decrypt_chunked(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key, int threads);
+int decrypt_chunked_range(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key,
+                          uint64_t off, uint64_t len);
+int decrypt_chunked_seq(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key);
+int decrypt_chunked_resume(FILE *in, const char *out_path, const stream_hdr_t *h, const unsigned char *key,
+                           int threads);
+int chunk_threads(void);
 
 /* in-place helpers (dispatches to v1/v2 as needed) */
 int decrypt_inplace(const char *in_path, char *pwd, const char *wanted_ext);
 int encrypt_inplace(const char *in_path, char *pwd, const char *garbage);
+int verify_file(const char *in_path, char *pwd, const char *garbage);
+int migrate_file(const char *in_path, char *pwd, const char *garbage);
 
 /* filesystem / io helpers */
 int read_file (const char *path, unsigned char **buff, size_t *len);
+int read_file_as(const char *path, unsigned char **buff, size_t *len, int secret);
 int write_file(const char *path, const unsigned char *buf, size_t len);
 int write_file_atomic_0600(const char *path, const unsigned char *buf, size_t len);
 int safe_delete(const char *path);
+int make_parents(char *path, size_t keep);
 int build_path(const char *in_path, const char *suffix, char *out_path, size_t out_sz);
-int path_handler(encrypt_func f, const char *path, char *pwd, const char *suffix);
+int path_handler(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix);
+int path_walk(unsigned walk, const char *path, file_visitor visit, void *ctx);
+int uring_run(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix, int depth);
+int pool_run(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix, int jobs);
 int ends_with(const char *s, const char *suffix);
 const char *base_name(const char *path);
 int read_magic(const char *p, unsigned char out[6]);
@@ -95,6 +494,7 @@ int read_magic(const char *p, unsigned char out[6]);
 /* user management */
 int init_user(void);
 int login_user(char *pwd);
+int user_set_password(const char *pwd);
 int user_created(const char *path);
 
 /* ui / misc */
@@ -102,8 +502,26 @@ int  prompt_password(const char *label, char *out, size_t outsz, int confirm);
 void usage(const char *prog);
 void print_hex(const char *label, const unsigned char *buf, size_t len);
 
-/* global flag (opt-in delete) */
+/* global flags (opt-in delete, worker count for directory runs, mmap I/O,
+   io_uring queue depth with 0 = engine off, pipelined streaming, chunk
+   size override with 0 = automatic, run statistics, directory walk order,
+   compression codec with CODEC_NONE = off and its level, chunked-layout
+   cipher suite with CIPHER_AUTO = picked per CPU, Argon2id limits for new
+   keys from the KDF profile, resumable chunked-layout runs) */
 extern int g_delete_on_success;
+extern int g_jobs;
+extern int g_use_mmap;
+extern int g_uring_depth;
+extern int g_pipeline;
+extern uint32_t g_chunk_size;
+extern int g_stats;
+extern int g_walk_inode_order;
+extern int g_codec;
+extern int g_codec_level;
+extern int g_cipher;
+extern uint32_t g_kdf_opslimit;
+extern uint32_t g_kdf_mem_kib;
+extern int g_resume;
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -1,9 +1,53 @@
 #include "../include/header.h"
 
+/* parse_u64: parse a non-negative decimal integer option value.
+   Returns 0 on success, -1 if `s` is not a complete number. */
+static int parse_u64(const char *s, uint64_t *out){
+    if (!s || !*s || *s == '-') return -1; // reject empty and negative input
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10); // base-10 only
+    if (errno != 0 || *end != '\0') return -1; // overflow or trailing junk
+    *out = (uint64_t)v;
+    return 0;
+}
+
+/* parse_size: parse a byte count with an optional K, M or G suffix (KiB/MiB/GiB).
+   Returns 0 on success, -1 on bad syntax or overflow. */
+static int parse_size(const char *s, uint64_t *out){
+    char buf[32];
+    size_t n = s ? strlen(s) : 0;
+    if (n == 0 || n >= sizeof buf) return -1;
+    memcpy(buf, s, n + 1);
+    unsigned shift = 0;
+    char last = buf[n - 1];
+    if (last == 'K' || last == 'k') shift = 10; // KiB
+    if (last == 'M' || last == 'm') shift = 20; // MiB
+    if (last == 'G' || last == 'g') shift = 30; // GiB
+    if (shift) buf[n - 1] = '\0'; // strip suffix
+    if (parse_u64(buf, out) != 0 || *out > (UINT64_MAX >> shift)) return -1;
+    *out <<= shift;
+    return 0;
+}
+
+/* unlock: start this run's key session. A running `vault agent` of this
+   user supplies the master keys, so there is no prompt and no Argon2id and
+   `pwd` is left empty; otherwise (or with `use_agent` off) log in and hold
+   the typed password. Returns 0 on success, -1 on failure. */
+static int unlock(char *pwd, int use_agent){
+    if (use_agent && session_begin_agent() == 0){
+        pwd[0] = '\0'; // the agent session belongs to the empty password
+        fprintf(stderr, "Using vault agent\n");
+        return 0;
+    }
+    if (login_user(pwd) != 0) return -1;
+    return session_begin(pwd); // one Argon2id per salt for the whole run
+}
+
 /* main: entry point. Initializes libsodium, parses command and flags,
    prompts for password when needed, and dispatches to encrypt/decrypt/init. */
 int main(int argc, char **argv){
-    char pwd[1024]; // password buffer (writable; may be zeroed by callees)
+    char pwd[PASSWORD_MAX]; // password buffer (writable; may be zeroed by callees)
 
     // Initialize libsodium; bail out if the crypto library can't start.
     if (sodium_init() < 0){
@@ -19,60 +63,360 @@ int main(int argc, char **argv){
 
     const char *cmd = argv[1]; // first argument is the subcommand
 
-    // Global flag scan: enable opt-in deletion if --rm/--delete is present.
+    // Global flag scan: options may appear anywhere after the subcommand;
+    // everything else is collected as a positional argument.
+    const char *pos[8]; // positional arguments (path, suffix)
+    int npos = 0;
+    uint64_t cat_offset = 0, cat_length = UINT64_MAX; // `cat` window (default: whole file)
+    int stats_report = 0; const char *stats_json = NULL; // --stats / --stats-json
+    int sync_hash = 0; // `sync --hash`
+    int jobs_set = 0; // --jobs given (verify defaults to one worker per CPU)
+    int use_agent = 1; uint64_t agent_ttl = AGENT_TTL_DEFAULT; // --no-agent / `agent --ttl`
+    const char *kdf_profile = NULL; // --kdf-profile (NULL: KDF_PROFILE_FILE if present)
+    uint64_t kdf_target = KDF_TARGET_MS, kdf_mem = 0; // `calibrate --target-ms / --max-mem` (0: default cap)
     for (int i = 2; i < argc; ++i) {
         if (strcmp(argv[i], "--rm") == 0 || strcmp(argv[i], "--delete") == 0) {
             g_delete_on_success = 1; // set global toggle for delete-on-success
+        } else if (strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) {
+            // Worker count for directory runs; 0 means one per online CPU.
+            uint64_t jobs = 0;
+            if (i + 1 >= argc || parse_u64(argv[++i], &jobs) != 0 || jobs > POOL_JOBS_MAX) { usage(argv[0]); return -1; }
+            g_jobs = (int)jobs;
+            jobs_set = 1;
+            if (g_jobs == 0) {
+                long n = sysconf(_SC_NPROCESSORS_ONLN); // detect cores
+                g_jobs = n > 0 ? (int)n : 1;
+            }
+        } else if (strcmp(argv[i], "--uring") == 0) {
+            if (g_uring_depth == 0) g_uring_depth = URING_DEPTH_DEFAULT; // io_uring batch engine
+        } else if (strcmp(argv[i], "--uring-depth") == 0) {
+            // Files in flight for --uring (implies --uring).
+            uint64_t depth = 0;
+            if (i + 1 >= argc || parse_u64(argv[++i], &depth) != 0 || depth < 1 || depth > URING_DEPTH_MAX) { usage(argv[0]); return -1; }
+            g_uring_depth = (int)depth;
+        } else if (strcmp(argv[i], "--chunk-size") == 0) {
+            // Plaintext bytes per chunk for new files (default: chosen per file).
+            uint64_t cs = 0;
+            if (i + 1 >= argc || parse_size(argv[++i], &cs) != 0 ||
+                cs < STREAM_CHUNK_MIN || cs > STREAM_CHUNK_MAX) { usage(argv[0]); return -1; }
+            g_chunk_size = (uint32_t)cs;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            // Per-chunk compression for new files: zstd[:LEVEL] or lz4[:LEVEL].
+            if (i + 1 >= argc || codec_parse(argv[++i], &g_codec, &g_codec_level) != 0) { usage(argv[0]); return -1; }
+            if (!codec_available(g_codec)) {
+                fprintf(stderr, "%s compression is not supported by this build\n", codec_name(g_codec));
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--cipher") == 0) {
+            // AEAD suite of new chunked files: auto, xchacha20, aes256gcm or aegis256.
+            if (i + 1 >= argc || cipher_parse(argv[++i], &g_cipher) != 0) { usage(argv[0]); return -1; }
+            if (g_cipher != CIPHER_AUTO && !cipher_available(g_cipher)) {
+                fprintf(stderr, "%s is not supported by this build or CPU\n", cipher_name(g_cipher));
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            g_resume = 1; // journal large chunked files; continue interrupted runs
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            g_pipeline = 1; // reader/crypto/writer threads per file
+        } else if (strcmp(argv[i], "--inode-order") == 0) {
+            g_walk_inode_order = 1; // visit directory entries in inode order
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            g_use_mmap = 1; // memory-mapped I/O backend
+        } else if (strcmp(argv[i], "--no-agent") == 0) {
+            use_agent = 0; // always prompt, even if an agent is running
+        } else if (strcmp(argv[i], "--ttl") == 0) {
+            // Seconds `vault agent` keeps the keys.
+            if (i + 1 >= argc || parse_u64(argv[++i], &agent_ttl) != 0 ||
+                agent_ttl < 1 || agent_ttl > AGENT_TTL_MAX) { usage(argv[0]); return -1; }
+        } else if (strcmp(argv[i], "--kdf-profile") == 0) {
+            // Argon2id limits for new keys: a preset name or a profile file.
+            if (i + 1 >= argc) { usage(argv[0]); return -1; } // value required
+            kdf_profile = argv[++i]; // consume value
+        } else if (strcmp(argv[i], "--target-ms") == 0) {
+            // Latency `calibrate` tunes one Argon2id stretch to.
+            if (i + 1 >= argc || parse_u64(argv[++i], &kdf_target) != 0 ||
+                kdf_target < 10 || kdf_target > 600000) { usage(argv[0]); return -1; }
+        } else if (strcmp(argv[i], "--max-mem") == 0) {
+            // Memory cap for `calibrate` (K/M/G suffix).
+            if (i + 1 >= argc || parse_size(argv[++i], &kdf_mem) != 0 ||
+                kdf_mem < KDF_MEM_MIN_KIB * 1024ULL || kdf_mem / 1024 > KDF_MEM_MAX_KIB) { usage(argv[0]); return -1; }
+        } else if (strcmp(argv[i], "--hash") == 0) {
+            sync_hash = 1; // sync: compare keyed content hashes too
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_report = 1; // per-phase summary on stderr
+        } else if (strcmp(argv[i], "--stats-json") == 0) {
+            // Per-file JSON lines plus a summary line ("-" = stderr).
+            if (i + 1 >= argc) { usage(argv[0]); return -1; } // value required
+            stats_json = argv[++i]; // consume value
+        } else if (strcmp(argv[i], "--offset") == 0 || strcmp(argv[i], "--length") == 0) {
+            // Byte window for `cat`.
+            uint64_t *dst = argv[i][2] == 'o' ? &cat_offset : &cat_length;
+            if (i + 1 >= argc || parse_u64(argv[i + 1], dst) != 0) { usage(argv[0]); return -1; } // value required
+            ++i; // consume value
+        } else if (npos < (int)(sizeof pos / sizeof pos[0])) {
+            pos[npos++] = argv[i]; // positional argument
         }
     }
 
+    // Only the chunked layout can be journaled; compressed and io_uring runs cannot.
+    if (g_resume && (g_codec != CODEC_NONE || g_uring_depth > 0)) {
+        fprintf(stderr, "--resume cannot be combined with --compress or --uring\n");
+        return -1;
+    }
+
+    // Run statistics cover login through the last file; reported at exit.
+    if (stats_report || stats_json) {
+        if (stats_begin(stats_report, stats_json) != 0) return -1;
+        atexit(stats_end); // every return path below reports
+    }
+
+    // Commands that create keys use the KDF profile's Argon2id limits.
+    static const char *const keyed[] = { "init-user", "encrypt", "pack", "sync", "migrate", "rekey", "agent" };
+    for (size_t i = 0; i < sizeof keyed / sizeof keyed[0]; ++i)
+        if (strcmp(cmd, keyed[i]) == 0 && kdf_profile_load(kdf_profile) != 0) return -1;
+
+    // Handle "calibrate": time Argon2id here and write the KDF profile.
+    if (strcmp(cmd, "calibrate") == 0) {
+        const char *out = kdf_profile ? kdf_profile : KDF_PROFILE_FILE; // profile to write
+        uint32_t cap = kdf_mem ? (uint32_t)(kdf_mem / 1024) : kdf_mem_default();
+        kdf_profile_t p;
+        printf("Calibrating Argon2id: target %u ms, memory cap %u MiB...\n", (unsigned)kdf_target, (unsigned)(cap / 1024));
+        if (kdf_calibrate((uint32_t)kdf_target, cap, &p) != 0) {
+            fprintf(stderr, "Argon2id failed (out of memory?); try a lower --max-mem\n");
+            return 1;
+        }
+        if (kdf_profile_write(out, &p) != 0) return 1;
+        printf("opslimit %u, memory %u MiB: %u ms per stretch\n", (unsigned)p.opslimit,
+               (unsigned)(p.mem_kib / 1024), (unsigned)p.measured_ms);
+        printf("Profile written to %s\n", out);
+        return 0;
+
     // Handle "init-user": create user.pass with hashed password.
-    if (strcmp(cmd, "init-user") == 0) {
+    } else if (strcmp(cmd, "init-user") == 0) {
         return init_user() == 0 ? 0 : 1; // run initializer and map result to exit code
 
     // Handle "encrypt": require login, then encrypt file/dir.
     } else if (strcmp(cmd, "encrypt") == 0) {
-        if (login_user(pwd) == 0){
+        if (unlock(pwd, use_agent) == 0){
             const char *in_path = NULL; // path to input (file or directory)
 
             // Require a path argument.
-            if (argc < 3) { 
+            if (npos < 1) { 
                 printf("File not provided!\n"); // notify missing input
                 usage(argv[0]); // show usage for correct invocation
                 return -1; 
             }
 
-            in_path = argv[2]; // capture input path argument
+            in_path = pos[0]; // capture input path argument
+
+            // "-": stdin -> stdout, nothing but ciphertext on stdout.
+            int piped = strcmp(in_path, "-") == 0;
+            if (piped && isatty(STDOUT_FILENO)) {
+                fprintf(stderr, "Refusing to write ciphertext to a terminal; redirect stdout.\n");
+                return -1;
+            }
 
-            printf("Encrypting...\n"); // user feedback
-            return path_handler(encrypt_inplace, in_path, pwd, NULL) == 0 ? 0 : 2; // recurse/dispatch over path
+            if (!piped) printf("Encrypting...\n"); // user feedback
+            int rc;
+            if (piped) {
+                stats_file_t *st = stats_file_begin("-"); // --stats: per-file record
+                rc = encrypt_pipe(stdin, stdout, pwd) == 0 ? 0 : 2; // one forward pass
+                stats_file_end(st, rc);
+            } else {
+                rc = path_handler(encrypt_inplace, WALK_ENCRYPT, in_path, pwd, NULL) == 0 ? 0 : 2; // recurse/dispatch over path
+            }
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
         } else {
             return -1; // login failed
         }
 
     // Handle "decrypt": require login, then decrypt file/dir (optional suffix).
     } else if (strcmp(cmd, "decrypt") == 0) {
-        if (login_user(pwd) == 0){
+        if (unlock(pwd, use_agent) == 0){
             const char *in_path = NULL, *suffix = NULL; // input path and output suffix
 
             // Require a path argument.
-            if (argc < 3) { 
+            if (npos < 1) { 
                 printf("File not provided!\n"); // notify missing input
                 usage(argv[0]); // show usage for correct invocation
                 return -1; 
             }
 
             // Parse optional suffix argument; default to ".dec".
-            if (argc > 3) {
-                suffix = argv[3]; // caller-provided suffix for output
+            if (npos > 1) {
+                suffix = pos[1]; // caller-provided suffix for output
             } else {
                 suffix = ".dec"; // default suffix
             }
 
-            in_path = argv[2]; // capture input path argument
+            in_path = pos[0]; // capture input path argument
+            int piped = strcmp(in_path, "-") == 0; // "-": stdin -> stdout (suffix unused)
+
+            if (!piped) printf("Decrypting...\n"); // user feedback
+            int rc;
+            if (piped) {
+                stats_file_t *st = stats_file_begin("-"); // --stats: per-file record
+                rc = decrypt_pipe(stdin, stdout, pwd) == 0 ? 0 : 3; // plaintext as each chunk authenticates
+                stats_file_end(st, rc);
+            } else {
+                rc = path_handler(decrypt_inplace, WALK_DECRYPT, in_path, pwd, suffix) == 0 ? 0 : 3; // recurse/dispatch over path
+            }
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
+        } else {
+            return -1; // login failed
+        }
+
+    // Handle "cat": decrypt only the requested byte range to stdout.
+    } else if (strcmp(cmd, "cat") == 0) {
+        if (npos < 1) { 
+            fprintf(stderr, "File not provided!\n"); // keep stdout for plaintext
+            usage(argv[0]); // show usage for correct invocation
+            return -1; 
+        }
+        if (unlock(pwd, use_agent) == 0){
+            int rc = cat_file(pos[0], cat_offset, cat_length, stdout, pwd) == 0 ? 0 : 4; // ranged decrypt
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
+        } else {
+            return -1; // login failed
+        }
 
-            printf("Decrypting...\n"); // user feedback
-            return path_handler(decrypt_inplace, in_path, pwd, suffix) == 0 ? 0 : 3; // recurse/dispatch over path
+    // Handle "pack" / "unpack": a whole tree in one container ("-" = stdout/stdin).
+    } else if (strcmp(cmd, "pack") == 0 || strcmp(cmd, "unpack") == 0) {
+        int pack = cmd[0] == 'p';
+        if (npos < 2) {
+            fprintf(stderr, "%s not provided!\n", pack ? "Directory or container" : "Container or directory");
+            usage(argv[0]); // show usage for correct invocation
+            return -1;
+        }
+        if (pack && strcmp(pos[1], "-") == 0 && isatty(STDOUT_FILENO)) {
+            fprintf(stderr, "Refusing to write ciphertext to a terminal; redirect stdout.\n");
+            return -1;
+        }
+        if (unlock(pwd, use_agent) == 0){
+            stats_file_t *st = stats_file_begin(pos[0]); // --stats: one record for the run
+            int rc = pack ? (pack_dir(pos[0], pos[1], pwd) == 0 ? 0 : 2)
+                          : (unpack_dir(pos[0], pos[1], pwd) == 0 ? 0 : 3);
+            stats_file_end(st, rc);
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
+        } else {
+            return -1; // login failed
+        }
+
+    // Handle "verify": authenticate .enc files without writing plaintext.
+    } else if (strcmp(cmd, "verify") == 0) {
+        if (npos < 1) {
+            printf("File not provided!\n"); // notify missing input
+            usage(argv[0]); // show usage for correct invocation
+            return -1;
+        }
+        if (unlock(pwd, use_agent) == 0){
+            struct stat st;
+            int rc;
+            if (stat(pos[0], &st) == 0 && S_ISDIR(st.st_mode)) {
+                if (!jobs_set) { // reads only: use every core by default
+                    long n = sysconf(_SC_NPROCESSORS_ONLN);
+                    g_jobs = n > 0 ? (int)n : 1;
+                }
+                rc = pool_run(verify_file, WALK_CIPHERTEXT, pos[0], pwd, NULL, g_jobs) == 0 ? 0 : 5; // per-file report
+            } else {
+                rc = verify_file(pos[0], pwd, NULL) == 0 ? 0 : 5;
+                printf("[%s] %s\n", rc == 0 ? " OK " : "FAIL", pos[0]);
+            }
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
+        } else {
+            return -1; // login failed
+        }
+
+    // Handle "migrate": re-encrypt legacy SIMPL1 files into the streamed format.
+    } else if (strcmp(cmd, "migrate") == 0) {
+        if (npos < 1) {
+            printf("Path not provided!\n"); // notify missing input
+            usage(argv[0]); // show usage for correct invocation
+            return -1;
+        }
+        if (unlock(pwd, use_agent) == 0){
+            struct stat st;
+            int rc;
+            if (stat(pos[0], &st) == 0 && S_ISDIR(st.st_mode)) {
+                if (!jobs_set) { // CPU-bound: one worker per CPU by default
+                    long n = sysconf(_SC_NPROCESSORS_ONLN);
+                    g_jobs = n > 0 ? (int)n : 1;
+                }
+                commit_begin(); // replacements share the directory-run group commit
+                rc = pool_run(migrate_file, WALK_CIPHERTEXT, pos[0], pwd, NULL, g_jobs) == 0 ? 0 : 7; // per-file report
+                if (commit_end() != 0) rc = 7;
+            } else {
+                rc = migrate_file(pos[0], pwd, NULL) == 0 ? 0 : 7;
+                printf("[%s] %s\n", rc == 0 ? " OK " : "FAIL", pos[0]);
+            }
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
+        } else {
+            return -1; // login failed
+        }
+
+    // Handle "sync": encrypt only what changed since the last sync into <dst>.
+    } else if (strcmp(cmd, "sync") == 0) {
+        if (npos < 2) {
+            fprintf(stderr, "Source or destination directory not provided!\n");
+            usage(argv[0]); // show usage for correct invocation
+            return -1;
+        }
+        if (unlock(pwd, use_agent) == 0){
+            int rc = sync_dir(pos[0], pos[1], pwd, sync_hash) == 0 ? 0 : 2;
+            session_end(); // scrub cached keys
+            sodium_memzero(pwd, sizeof pwd); // done with password
+            return rc;
+        } else {
+            return -1; // login failed
+        }
+
+    // Handle "rekey": change the password, rewriting only file headers.
+    } else if (strcmp(cmd, "rekey") == 0) {
+        if (npos < 1) {
+            printf("Path not provided!\n"); // notify missing input
+            usage(argv[0]); // show usage for correct invocation
+            return -1;
+        }
+        if (login_user(pwd) == 0){
+            char new_pwd[PASSWORD_MAX]; // replacement password
+            if (prompt_password("New Password: ", new_pwd, sizeof new_pwd, 1) != 0){ // read & confirm
+                sodium_memzero(pwd, sizeof pwd);
+                return -1;
+            }
+            if (session_begin(pwd) != 0){ sodium_memzero(new_pwd, sizeof new_pwd); return -1; } // old master keys cached per salt
+            int rc = rekey_tree(pos[0], pwd, new_pwd) == 0 ? 0 : 6;
+            if (agent_stop() == 0) printf("Agent stopped (it held the old password)\n");
+            session_end(); // scrub cached keys
+            sodium_memzero(new_pwd, sizeof new_pwd);
+            sodium_memzero(pwd, sizeof pwd); // done with passwords
+            return rc;
+        } else {
+            return -1; // login failed
+        }
+
+    // Handle "agent": hold the keys for later runs ("agent stop" ends it).
+    } else if (strcmp(cmd, "agent") == 0) {
+        if (npos > 0 && strcmp(pos[0], "stop") == 0) {
+            if (agent_stop() != 0) { fprintf(stderr, "No agent running\n"); return -1; }
+            printf("Agent stopped\n");
+            return 0;
+        }
+        if (login_user(pwd) == 0){
+            int rc = agent_serve(pwd, agent_ttl) == 0 ? 0 : -1; // forks the agent
+            sodium_memzero(pwd, sizeof pwd); // the agent keeps its own locked copy
+            return rc;
         } else {
             return -1; // login failed
         }
@@ -0,0 +1,289 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* struct ucred for SO_PEERCRED */
+#endif
+#include "../include/header.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* Wire format, one request per connection:
+   request  op u8 | salt[16] | opslimit u32 | mem_kib u32   (little-endian)
+   reply    status u8 (0 = ok) | data[32]
+   'S' returns the agent's run salt in data[0..16), 'K' the master key
+   Argon2id(password, salt, opslimit, mem_kib) for limits kdf_limits_ok
+   accepts, 'Q' wipes keys and exits. */
+#define AGENT_REQ_SIZE  (1 + 16 + 4 + 4)
+#define AGENT_RESP_SIZE (1 + crypto_kdf_KEYBYTES)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 /* macOS: SO_NOSIGPIPE is set on the socket instead */
+#endif
+
+static volatile sig_atomic_t s_stop = 0; // SIGTERM/SIGINT/SIGHUP seen by the agent
+
+/* on_signal: ask the serve loop to wipe its keys and exit. */
+static void on_signal(int sig){
+    (void)sig;
+    s_stop = 1;
+}
+
+/* agent_path: socket path into `sa`: $VAULT_AGENT_SOCK, else
+   $XDG_RUNTIME_DIR/vault-agent.sock, else /tmp/vault-agent-<uid>.sock.
+   Returns 0, or -1 if the path does not fit a sockaddr_un. */
+static int agent_path(struct sockaddr_un *sa){
+    const char *env = getenv(AGENT_SOCK_ENV), *run = getenv("XDG_RUNTIME_DIR");
+    memset(sa, 0, sizeof *sa);
+    sa->sun_family = AF_UNIX;
+    int n;
+    if (env && *env) n = snprintf(sa->sun_path, sizeof sa->sun_path, "%s", env);
+    else if (run && *run) n = snprintf(sa->sun_path, sizeof sa->sun_path, "%s/vault-agent.sock", run);
+    else n = snprintf(sa->sun_path, sizeof sa->sun_path, "/tmp/vault-agent-%lu.sock", (unsigned long)getuid());
+    if (n <= 0 || (size_t)n >= sizeof sa->sun_path){
+        fprintf(stderr, "agent socket path too long\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* peer_is_us: non-zero if the process at the other end of `fd` runs as our uid. */
+static int peer_is_us(int fd){
+    uid_t uid;
+#if defined(__linux__)
+    struct ucred cr;
+    socklen_t len = sizeof cr;
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &len) != 0) return 0;
+    uid = cr.uid;
+#else
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) != 0) return 0;
+#endif
+    return uid == getuid();
+}
+
+/* sock_io: send or receive exactly `n` bytes on `fd` (`wr` selects which).
+   Returns 0, or -1 on error, timeout or a closed peer. */
+static int sock_io(int fd, unsigned char *p, size_t n, int wr){
+    while (n > 0){
+        ssize_t k = wr ? send(fd, p, n, MSG_NOSIGNAL) : recv(fd, p, n, 0);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return -1;
+        p += k;
+        n -= (size_t)k;
+    }
+    return 0;
+}
+
+/* sock_timeout: bound every receive on `fd` to `sec` seconds. */
+static void sock_timeout(int fd, long sec){
+    struct timeval tv = { sec, 0 };
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    (void)setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+}
+
+/* agent_call: send one request to this user's agent and copy the reply
+   data to `data` (`len` bytes). Quietly returns -1 when no agent runs; a
+   socket or peer owned by someone else is refused with a warning. */
+static int agent_call(unsigned char op, const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                      unsigned char *data, size_t len){
+    struct sockaddr_un sa;
+    struct stat st;
+    if (agent_path(&sa) != 0 || lstat(sa.sun_path, &st) != 0) return -1; // no agent
+    if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()){
+        fprintf(stderr, "%s: not an agent socket of this user, ignored\n", sa.sun_path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof sa) != 0){ close(fd); return -1; } // stale socket
+    if (!peer_is_us(fd)){
+        fprintf(stderr, "%s: agent runs as another user, ignored\n", sa.sun_path);
+        close(fd);
+        return -1;
+    }
+    sock_timeout(fd, 300); // a cache miss costs the agent one Argon2id
+
+    unsigned char req[AGENT_REQ_SIZE] = { 0 }, resp[AGENT_RESP_SIZE];
+    req[0] = op;
+    if (salt) memcpy(req + 1, salt, 16);
+    for (int i = 0; i < 4; ++i){
+        req[17 + i] = (unsigned char)(opslimit >> (8 * i)); // little-endian
+        req[21 + i] = (unsigned char)(mem_kib  >> (8 * i));
+    }
+    int rc = sock_io(fd, req, sizeof req, 1) == 0 && sock_io(fd, resp, sizeof resp, 0) == 0 && resp[0] == 0 ? 0 : -1;
+    close(fd);
+    if (rc == 0 && data) memcpy(data, resp + 1, len);
+    sodium_memzero(resp, sizeof resp); // may hold a master key
+    return rc;
+}
+
+/* agent_run_salt: the running agent's run salt. Returns 0, or -1 if no agent answers. */
+int agent_run_salt(unsigned char salt[16]){
+    return agent_call('S', NULL, 0, 0, salt, 16);
+}
+
+/* agent_master_key: Argon2id(password, salt, opslimit, mem_kib) from the
+   running agent. Returns 0, or -1 if no agent answers or it failed. */
+int agent_master_key(const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                     unsigned char key[crypto_kdf_KEYBYTES]){
+    return agent_call('K', salt, opslimit, mem_kib, key, crypto_kdf_KEYBYTES);
+}
+
+/* agent_stop: ask the running agent to wipe its keys and exit.
+   Returns 0 if one did, -1 if none answered. */
+int agent_stop(void){
+    return agent_call('Q', NULL, 0, 0, NULL, 0);
+}
+
+/* agent_reply: answer one request on connection `fd` with keys of `pwd`.
+   Returns 1 when the client asked the agent to quit, else 0. */
+static int agent_reply(int fd, const char *pwd){
+    unsigned char req[AGENT_REQ_SIZE], resp[AGENT_RESP_SIZE] = { 1 }; // refused unless served
+    if (!peer_is_us(fd) || sock_io(fd, req, sizeof req, 0) != 0) return 0; // other users get nothing
+    uint32_t ops = 0, mem = 0;
+    for (int i = 3; i >= 0; --i){
+        ops = (ops << 8) | req[17 + i];
+        mem = (mem << 8) | req[21 + i];
+    }
+    int quit = 0;
+    if (req[0] == 'S'){
+        if (session_encrypt_params(pwd, resp + 1, &ops, &mem) == 0) resp[0] = 0; // run salt
+    } else if (req[0] == 'K'){
+        if (kdf_limits_ok(ops, mem) && // no client makes the agent allocate or spin unbounded
+            session_master_key(pwd, req + 1, ops, mem, resp + 1) == 0) resp[0] = 0; // cached per salt
+    } else if (req[0] == 'Q'){
+        resp[0] = 0;
+        quit = 1;
+    }
+    (void)sock_io(fd, resp, sizeof resp, 1);
+    sodium_memzero(resp, sizeof resp); // scrub key
+    return quit;
+}
+
+/* now_sec: monotonic clock in seconds (immune to wall-clock changes). */
+static uint64_t now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+/* agent_loop: serve requests on listening socket `lfd` until the TTL runs
+   out, a client sends 'Q' or a signal arrives; then wipe every key. */
+static void agent_loop(int lfd, const char *pwd, uint64_t ttl){
+    unsigned char salt[16], key[crypto_kdf_KEYBYTES];
+    uint32_t ops = 0, mem = 0;
+    if (session_begin(pwd) != 0) return;
+    if (session_encrypt_params(pwd, salt, &ops, &mem) == 0) // stretch the run salt now,
+        (void)session_master_key(pwd, salt, ops, mem, key); // not in the first client
+    sodium_memzero(key, sizeof key);
+
+    const uint64_t deadline = now_sec() + ttl;
+    int quit = 0;
+    while (!quit && !s_stop){
+        uint64_t now = now_sec();
+        if (now >= deadline) break; // TTL over: lock
+        uint64_t left = deadline - now;
+        struct pollfd p = { lfd, POLLIN, 0 };
+        int n = poll(&p, 1, left > 60 ? 60000 : (int)left * 1000); // wake up to recheck the TTL
+        if (n < 0 && errno != EINTR) break;
+        if (n <= 0) continue;
+        int cfd = accept(lfd, NULL, NULL);
+        if (cfd < 0) continue;
+        sock_timeout(cfd, 5); // a stalled client cannot hold the agent
+        quit = agent_reply(cfd, pwd);
+        close(cfd);
+    }
+    session_end(); // wipe password and master keys
+}
+
+/* agent_serve: `vault agent`. Bind the socket (0600, refusing to replace a
+   live agent or a path owned by someone else), then fork a detached agent
+   that keeps `pwd` and its master keys in locked memory for `ttl` seconds
+   and serves them to this user's `vault` runs. The parent returns 0 once the
+   agent is listening; the agent process never returns. Returns -1 on error. */
+int agent_serve(char *pwd, uint64_t ttl){
+    struct sockaddr_un sa;
+    struct stat st;
+    if (!pwd || ttl == 0 || agent_path(&sa) != 0) return -1;
+    if (agent_run_salt(NULL) == 0){
+        fprintf(stderr, "An agent is already running on %s\n", sa.sun_path);
+        return -1;
+    }
+    if (lstat(sa.sun_path, &st) == 0){ // leftover from an agent that died
+        if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()){
+            fprintf(stderr, "%s exists and is not our agent socket\n", sa.sun_path);
+            return -1;
+        }
+        (void)unlink(sa.sun_path);
+    }
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0){ perror("socket"); return -1; }
+    mode_t old = umask(077); // socket file is created 0600
+    int rc = bind(lfd, (struct sockaddr *)&sa, sizeof sa);
+    umask(old);
+    if (rc != 0 || listen(lfd, 16) != 0){
+        perror(sa.sun_path);
+        close(lfd);
+        return -1;
+    }
+
+    fflush(stdout); fflush(stderr); // nothing buffered is written twice
+    pid_t pid = fork();
+    if (pid < 0){
+        perror("fork");
+        close(lfd);
+        unlink(sa.sun_path);
+        return -1;
+    }
+    if (pid > 0){
+        close(lfd);
+        printf("Agent running (pid %ld) on %s for %llu s\n", (long)pid, sa.sun_path, (unsigned long long)ttl);
+        return 0;
+    }
+
+    // Agent: detach from the terminal, keep no core dumps, refuse ptrace and
+    // /proc/<pid>/mem reads from same-uid processes (Linux), serve.
+    (void)setsid();
+    int dn = open("/dev/null", O_RDWR);
+    if (dn >= 0){
+        dup2(dn, STDIN_FILENO); dup2(dn, STDOUT_FILENO); dup2(dn, STDERR_FILENO);
+        if (dn > STDERR_FILENO) close(dn);
+    }
+    struct rlimit nocore = { 0, 0 };
+    (void)setrlimit(RLIMIT_CORE, &nocore);
+#if defined(__linux__)
+    (void)prctl(PR_SET_DUMPABLE, 0, 0, 0, 0); // the password stays here for the whole TTL
+#endif
+    struct sigaction sa_stop, sa_ign;
+    memset(&sa_stop, 0, sizeof sa_stop);
+    memset(&sa_ign, 0, sizeof sa_ign);
+    sa_stop.sa_handler = on_signal; // no SA_RESTART: poll returns EINTR
+    sa_ign.sa_handler = SIG_IGN;
+    sigaction(SIGTERM, &sa_stop, NULL);
+    sigaction(SIGINT, &sa_stop, NULL);
+    sigaction(SIGHUP, &sa_stop, NULL);
+    sigaction(SIGPIPE, &sa_ign, NULL);
+
+    buf_pool_drain(); // idle buffers from the login: the agent idles for hours
+    size_t n = strlen(pwd);
+    char *kept = n < PASSWORD_MAX ? sodium_malloc(PASSWORD_MAX) : NULL; // guarded, mlocked
+    if (kept){
+        memcpy(kept, pwd, n + 1);
+        sodium_memzero(pwd, n); // the caller's copy in this process
+        agent_loop(lfd, kept, ttl);
+        sodium_free(kept);
+    }
+    close(lfd);
+    unlink(sa.sun_path);
+    _exit(kept ? 0 : 1);
+}
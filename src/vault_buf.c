@@ -0,0 +1,96 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* Block header, stored just before the caller's bytes. 16 bytes, so the
+   caller's bytes of a secret block end exactly at sodium_malloc's guard
+   page (its size is a page multiple) and stay 16-byte aligned. */
+typedef struct {
+    uint64_t cap;     /* usable bytes, a multiple of BUF_PAGE */
+    uint32_t secret;  /* BUF_SECRET: sodium_malloc'd */
+    uint32_t magic;   /* BUF_LIVE while handed out, BUF_IDLE in the pool */
+} buf_blk_t;
+
+#define BUF_HDR  sizeof(buf_blk_t)
+#define BUF_LIVE 0x5bf11e5u
+#define BUF_IDLE 0x1d1eb0fu
+
+static pthread_mutex_t s_mu = PTHREAD_MUTEX_INITIALIZER; /* guards the idle list */
+static buf_blk_t *s_idle[BUF_POOL_IDLE];                 /* released blocks */
+static size_t s_nidle, s_idle_bytes;
+
+/* blk_release: give block `b` back to the system (sodium_free wipes it). */
+static void blk_release(buf_blk_t *b){
+    if (b->secret) sodium_free(b);
+    else free(b);
+}
+
+/* buf_alloc: a buffer of at least `n` bytes. BUF_SECRET buffers (plaintext,
+   keys) are guarded and mlocked, BUF_PLAIN ones (ciphertext) are plain heap
+   and take no locked memory. An idle pooled block of the same kind is
+   reused when it is no more than twice the size needed, so a run pays the
+   mmap/mprotect/mlock of sodium_malloc once per buffer, not once per file.
+   Returns NULL when out of memory; release with buf_free. */
+void *buf_alloc(size_t n, int secret){
+    if (n > SIZE_MAX - BUF_HDR - BUF_PAGE) return NULL;
+    const size_t cap = n ? (n + BUF_PAGE - 1) / BUF_PAGE * BUF_PAGE : BUF_PAGE; // page multiple
+    secret = secret ? BUF_SECRET : BUF_PLAIN;
+
+    buf_blk_t *b = NULL;
+    pthread_mutex_lock(&s_mu);
+    size_t best = s_nidle;
+    for (size_t i = 0; i < s_nidle; ++i){ // best fit
+        const buf_blk_t *c = s_idle[i];
+        if ((int)c->secret == secret && c->cap >= cap && c->cap / 2 <= cap &&
+            (best == s_nidle || c->cap < s_idle[best]->cap))
+            best = i;
+    }
+    if (best < s_nidle){
+        b = s_idle[best];
+        s_idle[best] = s_idle[--s_nidle];
+        s_idle_bytes -= (size_t)b->cap;
+    }
+    pthread_mutex_unlock(&s_mu);
+
+    if (!b){
+        b = secret ? sodium_malloc(BUF_HDR + cap) : malloc(BUF_HDR + cap);
+        if (!b) return NULL;
+        if (secret) stats_count(STATS_SYS_MLOCK, 1);
+        b->cap = cap;
+        b->secret = (uint32_t)secret;
+    }
+    b->magic = BUF_LIVE;
+    return (unsigned char *)b + BUF_HDR;
+}
+
+/* buf_free: return a buf_alloc buffer (NULL is ignored). Secret buffers are
+   wiped first. The pool keeps up to BUF_POOL_IDLE blocks and
+   BUF_POOL_IDLE_MAX bytes for reuse; the rest go back to the system. */
+void buf_free(void *p){
+    if (!p) return;
+    buf_blk_t *b = (buf_blk_t *)((unsigned char *)p - BUF_HDR);
+    if (b->magic != BUF_LIVE){
+        fprintf(stderr, "buf_free: not a live pool buffer\n");
+        abort(); // double free or foreign pointer: never reuse it
+    }
+    b->magic = BUF_IDLE;
+    if (b->secret) sodium_memzero(p, (size_t)b->cap); // no plaintext left in idle blocks
+
+    pthread_mutex_lock(&s_mu);
+    int kept = s_nidle < BUF_POOL_IDLE && s_idle_bytes + b->cap <= BUF_POOL_IDLE_MAX;
+    if (kept){
+        s_idle[s_nidle++] = b;
+        s_idle_bytes += (size_t)b->cap;
+    }
+    pthread_mutex_unlock(&s_mu);
+    if (!kept) blk_release(b);
+}
+
+/* buf_pool_drain: release every idle block (end of run, or to hand locked
+   memory back before a long idle period). */
+void buf_pool_drain(void){
+    pthread_mutex_lock(&s_mu);
+    while (s_nidle > 0) blk_release(s_idle[--s_nidle]);
+    s_idle_bytes = 0;
+    pthread_mutex_unlock(&s_mu);
+}
@@ -0,0 +1,39 @@
+#include "../include/header.h"
+
+/* cat_file: decrypt plaintext bytes [offset, offset + length) of `in_path`
+   and write them to `out` (stdout for `vault cat`).
+   - Chunk-independent files: only the chunks covering the range are read
+     and authenticated (offsets are computed from the header).
+   - Secretstream files: chunks are pulled in order, each authenticated
+     before use, and the walk stops as soon as the range is complete.
+   - Legacy SIMPL1 files are not supported (one AEAD over the whole file).
+   Returns 0 on success, -1 on failure. */
+int cat_file(const char *in_path, uint64_t offset, uint64_t length, FILE *out, char *pwd){
+    FILE *in = fopen(in_path, "rb"); // open input for reading
+    if (!in){ perror("fopen in"); return -1; } // fail if cannot open
+
+    stream_hdr_t hdr;
+    if (stream_hdr_read(in, &hdr) != 0){ // parse streamed header
+        fprintf(stderr, "bad or short header (not a StreamSeal stream file)\n");
+        fclose(in);
+        return -1;
+    }
+
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if (session_file_key(pwd, &hdr, key, sizeof key) != 0){ // cached master -> file key
+        fprintf(stderr, "KDF failed\n");
+        fclose(in);
+        return -1;
+    }
+
+    int rc;
+    if (hdr.flags & STREAM_FLAG_CHUNKED)
+        rc = decrypt_chunked_range(in, out, &hdr, key, offset, length); // seek straight to the range
+    else
+        rc = decrypt_stream_range(in, out, &hdr, key, offset, length); // sequential pull, early stop
+
+    sodium_memzero(key, sizeof key); // scrub key
+    fclose(in); // close input
+    if (fflush(out) != 0) rc = -1; // surface write errors on the output stream
+    return rc;
+}
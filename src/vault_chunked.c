@@ -0,0 +1,576 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* Chunk-independent layout (STREAM_FLAG_CHUNKED):
+
+     header | c_0 | c_1 | ... | c_{n-1}
+
+   c_i = AEAD(key, nonce_i, p_i, AAD = header prefix) with the header's
+   cipher suite (XChaCha20-Poly1305, AES-256-GCM or AEGIS-256, see
+   vault_cipher.c), every chunk but the last holds exactly chunk_size
+   plaintext bytes, and n = max(1, ceil(plain_size / chunk_size)). nonce_i
+   is the header's nonce base with i xored into its last 8 bytes and the
+   byte before them flipped for the final chunk, so a chunk only opens at
+   its own index and the final marker cannot move. plain_size is bound in
+   the AAD, which pins the chunk count and rejects truncated or extended
+   files before any chunk is opened. */
+
+/* CHUNK_ABYTES: tag bytes per chunk of the file with header `h`. */
+#define CHUNK_ABYTES(h) cipher_abytes((int)STREAM_CIPHER((h)->flags))
+
+/* chunk_count: number of chunks for a plaintext of `size` bytes. */
+static uint64_t chunk_count(uint64_t size, uint32_t chunk){
+    return size == 0 ? 1 : (size + chunk - 1) / chunk; // empty files still carry one (final) chunk
+}
+
+/* pread_full/pwrite_full: positional I/O that retries short transfers.
+   Return 0 when exactly n bytes moved, -1 otherwise. */
+static int pread_full(int fd, void *buf, size_t n, off_t off){
+    unsigned char *p = buf;
+    while (n > 0){
+        ssize_t r = pread(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue; // retry interrupted reads
+        if (r <= 0) return -1; // error or unexpected EOF
+        p += r; n -= (size_t)r; off += r;
+    }
+    return 0;
+}
+static int pwrite_full(int fd, const void *buf, size_t n, off_t off){
+    const unsigned char *p = buf;
+    while (n > 0){
+        ssize_t w = pwrite(fd, p, n, off);
+        if (w < 0 && errno == EINTR) continue; // retry interrupted writes
+        if (w <= 0) return -1;
+        p += w; n -= (size_t)w; off += w;
+    }
+    return 0;
+}
+
+/* check_cipher: the header's cipher suite must be one this build and CPU
+   can open. Returns 0 if it is, -1 otherwise. */
+static int check_cipher(const stream_hdr_t *h){
+    int id = (int)STREAM_CIPHER(h->flags);
+    if (cipher_available(id)) return 0;
+    fprintf(stderr, "%s is not supported by this build or CPU\n", cipher_name(id));
+    return -1;
+}
+
+/* check_chunked_size: the ciphertext length must match exactly what the
+   authenticated plain_size implies. Returns 0 if it does, -1 otherwise. */
+static int check_chunked_size(int fd, const stream_hdr_t *h){
+    uint64_t n = chunk_count(h->plain_size, h->chunk_size);
+    uint64_t want = (uint64_t)h->raw_len + h->plain_size + n * CHUNK_ABYTES(h); // exact ciphertext size
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != want){
+        fprintf(stderr, "decryption failed (truncated or extended file)\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Work description shared by all chunk threads of one file. */
+typedef struct {
+    int in_fd, out_fd;               /* positional I/O on both sides */
+    int decrypt;                     /* 0 = seal, 1 = open */
+    const stream_hdr_t *h;           /* header (nonce base, AAD, sizes) */
+    const unsigned char *key;        /* payload key */
+    uint64_t n_chunks;               /* total chunks */
+    int failed;                      /* set by any thread on error */
+    pthread_mutex_t mu;              /* guards failed */
+    const vault_map_t *in_map;       /* --mmap: whole input mapped, or NULL */
+    const vault_map_t *out_map;      /* --mmap: whole output mapped, or NULL */
+    stats_file_t *stats;             /* caller's per-file record (--stats), or NULL */
+} chunk_job_t;
+
+/* Per-thread slice: chunks [first, last). */
+typedef struct {
+    chunk_job_t *job;
+    uint64_t first, last;
+} chunk_slice_t;
+
+/* chunk_worker: seal or open a contiguous run of chunks with pread/pwrite,
+   or directly between the mappings when the job has them. */
+static void *chunk_worker(void *arg){
+    chunk_slice_t *s = arg;
+    chunk_job_t *j = s->job;
+    stats_file_t *prev = stats_file_current();
+    stats_file_attach(j->stats); // helpers account to the caller's file
+    const uint32_t cs = j->h->chunk_size; // plaintext bytes per chunk
+    const int cid = (int)STREAM_CIPHER(j->h->flags); // cipher suite
+    const size_t ab = cipher_abytes(cid); // tag bytes per chunk
+    const off_t hdr_len = (off_t)j->h->raw_len; // payload starts after header
+
+    const int mapped = j->in_map && j->out_map; // AEAD straight between mappings
+    unsigned char *plain  = mapped ? NULL : buf_alloc(cs, BUF_SECRET); // plaintext chunk (locked, pooled)
+    unsigned char *cipher = mapped ? NULL : buf_alloc((size_t)cs + ab, BUF_PLAIN); // ciphertext chunk
+    int rc = (mapped || (plain && cipher)) ? 0 : -1;
+
+    for (uint64_t i = s->first; rc == 0 && i < s->last; ++i){
+        pthread_mutex_lock(&j->mu);
+        int stop = j->failed; // another slice already failed
+        pthread_mutex_unlock(&j->mu);
+        if (stop) break;
+
+        int final = (i == j->n_chunks - 1); // last chunk carries the marker
+        size_t plen = final ? (size_t)(j->h->plain_size - i * (uint64_t)cs) : cs; // short tail allowed
+        off_t p_off = (off_t)(i * (uint64_t)cs); // plaintext offset
+        off_t c_off = hdr_len + (off_t)(i * ((uint64_t)cs + ab)); // ciphertext offset
+        const unsigned char *base = j->h->ss_header; // nonce base
+
+        if (mapped){
+            unsigned char empty[1]; // empty file: nothing is mapped on the plaintext side
+            unsigned char *pm = j->decrypt ? j->out_map->base : j->in_map->base;
+            unsigned char *cm = j->decrypt ? j->in_map->base : j->out_map->base;
+            pm = pm ? pm + p_off : empty;
+            cm += c_off;
+            uint64_t t = stats_now();
+            int bad = j->decrypt
+                ? cipher_open(cid, pm, cm, plen + ab, j->h->raw, j->h->aad_len, base, i, final, j->key)
+                : cipher_seal(cid, cm, pm, plen, j->h->raw, j->h->aad_len, base, i, final, j->key);
+            if (bad){
+                fprintf(stderr, j->decrypt ? "decryption failed (wrong password or corrupted data)\n"
+                                           : "chunk encryption failed\n");
+                rc = -1;
+            }
+            stats_add(STATS_CRYPT, t, plen); // page faults do the I/O, so it lands here too
+        } else if (!j->decrypt){
+            const size_t clen = plen + ab; // sealed chunk size
+            uint64_t t = stats_now();
+            if (pread_full(j->in_fd, plain, plen, p_off) != 0){ perror("pread"); rc = -1; break; }
+            stats_add(STATS_READ, t, plen);
+            t = stats_now();
+            if (cipher_seal(cid, cipher, plain, plen, j->h->raw, j->h->aad_len, base, i, final, j->key) != 0){ // seal chunk
+                fprintf(stderr, "chunk encryption failed\n");
+                rc = -1; break;
+            }
+            stats_add(STATS_CRYPT, t, plen);
+            t = stats_now();
+            if (pwrite_full(j->out_fd, cipher, clen, c_off) != 0){ perror("pwrite"); rc = -1; }
+            stats_add(STATS_WRITE, t, clen);
+        } else {
+            const size_t mlen = plen; // opened chunk size
+            uint64_t t = stats_now();
+            if (pread_full(j->in_fd, cipher, plen + ab, c_off) != 0){ perror("pread"); rc = -1; break; }
+            stats_add(STATS_READ, t, plen + ab);
+            t = stats_now();
+            if (cipher_open(cid, plain, cipher, plen + ab, j->h->raw, j->h->aad_len, base, i, final, j->key) != 0){
+                fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+                rc = -1; break;
+            }
+            stats_add(STATS_CRYPT, t, mlen);
+            if (j->out_fd >= 0){ // no output (verify): the plaintext is dropped
+                t = stats_now();
+                if (pwrite_full(j->out_fd, plain, mlen, p_off) != 0){ perror("pwrite"); rc = -1; }
+                stats_add(STATS_WRITE, t, mlen);
+            }
+        }
+        if (rc == 0) stats_count(STATS_CHUNKS, 1);
+    }
+
+    buf_free(plain); buf_free(cipher); // plaintext is wiped on release
+    if (rc != 0){
+        pthread_mutex_lock(&j->mu);
+        j->failed = 1; // tell the other slices to stop
+        pthread_mutex_unlock(&j->mu);
+    }
+    stats_file_attach(prev); // the calling thread runs a slice too
+    return NULL;
+}
+
+/* run_chunks: split chunks [first, last) into `threads` contiguous slices
+   and process them concurrently. Returns 0 on success, -1 if any slice failed. */
+static int run_chunks(chunk_job_t *j, uint64_t first, uint64_t last, int threads){
+    if (threads < 1) threads = 1;
+    if ((uint64_t)threads > last - first) threads = (int)(last - first); // no idle threads
+
+    pthread_t *tids = malloc((size_t)threads * sizeof *tids);
+    chunk_slice_t *slices = malloc((size_t)threads * sizeof *slices);
+    int *spawned = calloc((size_t)threads, sizeof *spawned);
+    if (!tids || !slices || !spawned){ free(tids); free(slices); free(spawned); return -1; }
+    pthread_mutex_init(&j->mu, NULL);
+    j->stats = stats_file_current(); // helpers report to the same file
+
+    for (int t = 0; t < threads; ++t){
+        slices[t].job   = j;
+        slices[t].first = first + (last - first) * (uint64_t)t / (uint64_t)threads; // contiguous ranges keep I/O sequential per thread
+        slices[t].last  = first + (last - first) * (uint64_t)(t + 1) / (uint64_t)threads;
+    }
+    for (int t = 1; t < threads; ++t)
+        spawned[t] = pthread_create(&tids[t], NULL, chunk_worker, &slices[t]) == 0; // helpers
+    chunk_worker(&slices[0]); // calling thread takes the first slice
+    for (int t = 1; t < threads; ++t){
+        if (spawned[t]) pthread_join(tids[t], NULL);
+        else chunk_worker(&slices[t]); // could not spawn: do it inline
+    }
+
+    pthread_mutex_destroy(&j->mu);
+    free(tids); free(slices); free(spawned);
+    return j->failed ? -1 : 0;
+}
+
+/* chunk_threads: worker threads for one file's chunks: the online CPUs,
+   shared between the directory workers when --jobs is in use. */
+int chunk_threads(void){
+    long n = sysconf(_SC_NPROCESSORS_ONLN); // online cores
+    if (n < 1) n = 1;
+    n /= (g_jobs > 1 ? g_jobs : 1); // leave room for sibling files
+    return n < 1 ? 1 : (int)n;
+}
+
+/* resume_off: output bytes covered by the first `done` chunks of job `j`
+   (ciphertext with its header for encrypt, plaintext for decrypt). */
+static uint64_t resume_off(const chunk_job_t *j, uint64_t done){
+    uint64_t plain = done * (uint64_t)j->h->chunk_size;
+    if (plain > j->h->plain_size) plain = j->h->plain_size; // short last chunk
+    return j->decrypt ? plain : j->h->raw_len + plain + done * CHUNK_ABYTES(j->h);
+}
+
+/* run_resumable: process chunks [jn->done, n) of job `j` in windows of
+   RESUME_WINDOW plaintext bytes. After each window the partial output
+   `out_fd` is synced and only then does the journal at `jpath` move past
+   it, so an interrupted run loses at most one window. Returns 0 once every
+   chunk is durable, -1 on failure (the journal still matches the disk). */
+static int run_resumable(chunk_job_t *j, int out_fd, const char *jpath, resume_jnl_t *jn, int threads){
+    uint64_t win = RESUME_WINDOW / j->h->chunk_size; // chunks per checkpoint
+    if (win < (uint64_t)threads) win = (uint64_t)threads; // keep every core busy
+    while (jn->done < j->n_chunks){
+        uint64_t last = j->n_chunks - jn->done > win ? jn->done + win : j->n_chunks;
+        if (run_chunks(j, jn->done, last, threads) != 0) return -1;
+        uint64_t t = stats_now();
+        stats_count(STATS_SYS_FSYNC, 1);
+        if (fsync(out_fd) != 0){ perror("fsync"); return -1; } // window durable before the journal says so
+        stats_add(STATS_CLOSE, t, 0);
+        jn->done = last;
+        if (resume_save(jpath, jn, resume_off(j, last)) != 0) return -1;
+    }
+    return 0;
+}
+
+/* resume_finish: end a resumable run on partial output `fd` named `part`.
+   With `rc` 0 it replaces `out_path` like any output (out_commit: synced,
+   renamed, grouped in directory runs) and the journal goes; otherwise both
+   stay for the next --resume run. Returns 0 or -1. */
+static int resume_finish(int fd, const char *part, const char *out_path, const char *jpath,
+                         const resume_jnl_t *jn, uint64_t n, int rc){
+    if (rc != 0){
+        close(fd);
+        stats_count(STATS_SYS_CLOSE, 1);
+        fprintf(stderr, "%s: stopped with %llu of %llu chunks done; run again with --resume to continue\n",
+                out_path, (unsigned long long)jn->done, (unsigned long long)n);
+        return -1;
+    }
+    vault_out_t o; // adopt the partial file as a named temp
+    memset(&o, 0, sizeof o);
+    o.fd = fd;
+    snprintf(o.tmp, sizeof o.tmp, "%s", part);
+    snprintf(o.path, sizeof o.path, "%s", out_path);
+    rc = out_commit(&o);
+    unlink(jpath); // committed, or dropped with the partial by out_commit
+    return rc;
+}
+
+/* encrypt_chunked_resume: encrypt_file_chunked under --resume for the input
+   open on `in_fd` (`size` bytes). A journal left by an earlier run on the
+   same, unchanged input lets it start at the first chunk that was not yet
+   durable, keeping the partial output's header and the payload key its
+   key slot opens with `pwd`; anything else starts a fresh partial file.
+   Returns 0 on success, -1 on failure. */
+static int encrypt_chunked_resume(int in_fd, uint64_t size, const char *out_path, char *pwd, int threads){
+    char part[PATH_MAX], jpath[PATH_MAX];
+    if (resume_paths(out_path, part, jpath, sizeof part) != 0){ fprintf(stderr, "path too long: %s\n", out_path); return -1; }
+    stream_hdr_t hdr;
+    unsigned char key[crypto_kdf_KEYBYTES]; // payload key, 32 bytes for every suite
+    resume_jnl_t jn, cur;
+    uint64_t off = 0;
+    int fd = -1;
+
+    // An earlier run of this input: its partial header must be intact and open with pwd.
+    if (resume_load(jpath, &jn, &off) == 0 && !jn.decrypt && (fd = open(part, O_RDWR)) >= 0){
+        unsigned char raw[STREAM_HDR_SIZE];
+        struct stat ps;
+        if (fstat(fd, &ps) != 0 || (uint64_t)ps.st_size < off ||
+            pread_full(fd, raw, sizeof raw, 0) != 0 || stream_hdr_parse(raw, sizeof raw, &hdr) != 0 ||
+            !(hdr.flags & STREAM_FLAG_CHUNKED) || hdr.plain_size != size ||
+            jn.done > chunk_count(size, hdr.chunk_size) || resume_ident(&cur, 0, in_fd, &hdr) != 0 ||
+            !resume_same(&jn, &cur) || check_cipher(&hdr) != 0 || session_file_key(pwd, &hdr, key, sizeof key) != 0){
+            close(fd); // stale or foreign: start over
+            fd = -1;
+        } else {
+            stats_count(STATS_SYS_OPEN, 1);
+            fprintf(stderr, "Resuming %s at chunk %llu of %llu\n", out_path, (unsigned long long)jn.done,
+                    (unsigned long long)chunk_count(size, hdr.chunk_size));
+        }
+    }
+    if (fd < 0){
+        uint32_t flags = STREAM_FLAG_CHUNKED | (uint32_t)cipher_pick() << STREAM_CIPHER_SHIFT; // layout + suite
+        int hrc = stream_hdr_new(&hdr, flags, size, stream_chunk_for(size), pwd, key);
+        if (hrc == 0){
+            randombytes_buf(hdr.ss_header, sizeof hdr.ss_header); // per-file nonce base
+            hrc = stream_hdr_encode(&hdr);
+        }
+        if (hrc == 0 && (fd = open(part, O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0){ perror(part); hrc = -1; }
+        if (hrc == 0){
+            stats_count(STATS_SYS_OPEN, 1);
+            stats_count(STATS_SYS_FSYNC, 1);
+            if (fchmod(fd, S_IRUSR | S_IWUSR) != 0 || pwrite_full(fd, hdr.raw, hdr.raw_len, 0) != 0 ||
+                fsync(fd) != 0){ perror(part); hrc = -1; } // header durable before the journal names it
+        }
+        if (hrc == 0 && (resume_ident(&jn, 0, in_fd, &hdr) != 0 || resume_save(jpath, &jn, hdr.raw_len) != 0))
+            hrc = -1;
+        if (hrc != 0){
+            sodium_memzero(key, sizeof key);
+            if (fd >= 0){ close(fd); unlink(part); }
+            return -1;
+        }
+    }
+
+    chunk_job_t job;
+    memset(&job, 0, sizeof job);
+    job.in_fd = in_fd; job.out_fd = fd; job.decrypt = 0;
+    job.h = &hdr; job.key = key;
+    job.n_chunks = chunk_count(hdr.plain_size, hdr.chunk_size);
+    int rc = run_resumable(&job, fd, jpath, &jn, threads);
+    sodium_memzero(key, sizeof key); // scrub key
+    return resume_finish(fd, part, out_path, jpath, &jn, job.n_chunks, rc);
+}
+
+/* encrypt_file_chunked: encrypt a regular file into the chunk-independent
+   layout, sealing chunks on `threads` cores and writing them with pwrite
+   (or straight into a mapped output with g_use_mmap). With g_resume the
+   output is checkpointed instead (encrypt_chunked_resume).
+   Returns 0 on success, -1 on failure. */
+int encrypt_file_chunked(const char *in_path, const char *out_path, char *pwd, int threads){
+    int in_fd = open(in_path, O_RDONLY); // positional reads need a plain fd
+    if (in_fd < 0){ perror("open in"); return -1; }
+    struct stat st;
+    if (fstat(in_fd, &st) != 0 || !S_ISREG(st.st_mode)){ perror("fstat"); close(in_fd); return -1; }
+    stats_count(STATS_SYS_OPEN, 1);
+    if (g_resume){ // journaled partial output instead of a temp
+        int rc = encrypt_chunked_resume(in_fd, (uint64_t)st.st_size, out_path, pwd, threads);
+        close(in_fd);
+        stats_count(STATS_SYS_CLOSE, 1);
+        return rc;
+    }
+    vault_out_t o; // 0600 temp, renamed over out_path on success
+    if (out_open(&o, out_path, g_use_mmap) != 0){ close(in_fd); return -1; }
+    int out_fd = o.fd;
+
+    stream_hdr_t hdr;
+    unsigned char key[crypto_kdf_KEYBYTES]; // payload key, 32 bytes for every suite
+    uint32_t flags = STREAM_FLAG_CHUNKED | (uint32_t)cipher_pick() << STREAM_CIPHER_SHIFT; // layout + suite
+    int hrc = stream_hdr_new(&hdr, flags, (uint64_t)st.st_size, // plain_size pins the chunk count
+                             stream_chunk_for((uint64_t)st.st_size), pwd, key);
+    if (hrc == 0){
+        randombytes_buf(hdr.ss_header, sizeof hdr.ss_header); // per-file nonce base
+        hrc = stream_hdr_encode(&hdr); // serialize header (fills raw/aad_len)
+    }
+    if (hrc != 0){
+        sodium_memzero(key, sizeof key);
+        close(in_fd); out_abort(&o);
+        return -1;
+    }
+
+    chunk_job_t job;
+    memset(&job, 0, sizeof job);
+    job.in_fd = in_fd; job.out_fd = out_fd; job.decrypt = 0;
+    job.h = &hdr; job.key = key;
+    job.n_chunks = chunk_count(hdr.plain_size, hdr.chunk_size);
+
+    int rc;
+    if (g_use_mmap){
+        vault_map_t im, om;
+        size_t out_len = hdr.raw_len + (size_t)hdr.plain_size + (size_t)job.n_chunks * CHUNK_ABYTES(&hdr); // exact ciphertext size
+        rc = map_fd_input(in_fd, &im);
+        if (rc == 0 && map_fd_output(out_fd, out_len, &om) != 0){ unmap_file(&im, 0); rc = -1; }
+        if (rc == 0){
+            memcpy(om.base, hdr.raw, hdr.raw_len); // header first
+            job.in_map = &im; job.out_map = &om;
+            rc = run_chunks(&job, 0, job.n_chunks, threads); // seal all chunks in place
+            unmap_file(&im, 0);
+            if (unmap_file(&om, rc == 0 ? out_len : 0) != 0) rc = -1;
+        }
+    } else {
+        rc = pwrite_full(out_fd, hdr.raw, hdr.raw_len, 0); // header first
+        if (rc != 0) perror("write header");
+        if (rc == 0) rc = run_chunks(&job, 0, job.n_chunks, threads); // seal all chunks
+    }
+
+    sodium_memzero(key, sizeof key); // scrub key
+    uint64_t t = stats_now();
+    close(in_fd);
+    stats_count(STATS_SYS_CLOSE, 1);
+    if (rc == 0) rc = out_commit(&o); // fsync + rename (grouped in directory runs)
+    else out_abort(&o);
+    stats_add(STATS_CLOSE, t, 0);
+    return rc;
+}
+
+/* decrypt_chunked: open every chunk of a STREAM_FLAG_CHUNKED file whose
+   header `h` was already read from `in`, writing plaintext to `out` with
+   pwrite (or into a mapped `out` with g_use_mmap). On failure the output is truncated so no unauthenticated prefix
+   is left behind. A NULL `out` only authenticates every chunk (vault verify).
+   Returns 0 on success, -1 on failure. */
+int decrypt_chunked(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key, int threads){
+    uint64_t n = chunk_count(h->plain_size, h->chunk_size);
+    if (check_cipher(h) != 0 || check_chunked_size(fileno(in), h) != 0) return -1; // truncated or extended
+
+    chunk_job_t job;
+    memset(&job, 0, sizeof job);
+    job.in_fd = fileno(in); job.out_fd = out ? fileno(out) : -1; job.decrypt = 1;
+    job.h = h; job.key = key; job.n_chunks = n;
+
+    if (out) fflush(out); // nothing buffered should race the pwrites
+    int rc;
+    if (g_use_mmap && out){
+        vault_map_t im, om;
+        rc = map_fd_input(job.in_fd, &im);
+        if (rc == 0 && map_fd_output(job.out_fd, (size_t)h->plain_size, &om) != 0){ unmap_file(&im, 0); rc = -1; }
+        if (rc == 0){
+            job.in_map = &im; job.out_map = &om;
+            rc = run_chunks(&job, 0, job.n_chunks, threads); // open all chunks in place
+            unmap_file(&im, 0);
+            if (unmap_file(&om, rc == 0 ? om.len : 0) != 0) rc = -1;
+        }
+    } else {
+        rc = run_chunks(&job, 0, job.n_chunks, threads);
+    }
+    if (rc != 0 && out && ftruncate(fileno(out), 0) != 0) perror("ftruncate"); // drop partial plaintext
+    return rc;
+}
+
+/* decrypt_chunked_resume: decrypt_chunked under --resume: plaintext goes
+   to the fixed partial file of `out_path` (resume_paths), journaled like an
+   encrypt, and a later run on the same, unchanged input carries on at the
+   first chunk that was not yet durable. Only authenticated chunks are ever
+   written, so a kept partial file holds no unauthenticated plaintext.
+   Returns 0 on success, -1 on failure. */
+int decrypt_chunked_resume(FILE *in, const char *out_path, const stream_hdr_t *h, const unsigned char *key,
+                           int threads){
+    if (check_cipher(h) != 0 || check_chunked_size(fileno(in), h) != 0) return -1; // truncated or extended
+    char part[PATH_MAX], jpath[PATH_MAX];
+    if (resume_paths(out_path, part, jpath, sizeof part) != 0){ fprintf(stderr, "path too long: %s\n", out_path); return -1; }
+    const uint64_t n = chunk_count(h->plain_size, h->chunk_size);
+    resume_jnl_t jn, cur;
+    uint64_t off = 0;
+    int fd = -1;
+    if (resume_ident(&cur, 1, fileno(in), h) != 0) return -1;
+
+    // An earlier run on this input whose plaintext is still there.
+    if (resume_load(jpath, &jn, &off) == 0 && resume_same(&jn, &cur) && jn.done <= n &&
+        (fd = open(part, O_RDWR)) >= 0){
+        struct stat ps;
+        if (fstat(fd, &ps) != 0 || (uint64_t)ps.st_size < off){
+            close(fd); // shorter than the journal says: start over
+            fd = -1;
+        } else {
+            stats_count(STATS_SYS_OPEN, 1);
+            fprintf(stderr, "Resuming %s at chunk %llu of %llu\n", out_path, (unsigned long long)jn.done, (unsigned long long)n);
+        }
+    }
+    if (fd < 0){
+        fd = open(part, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0){ perror(part); return -1; }
+        stats_count(STATS_SYS_OPEN, 1);
+        jn = cur; // done = 0
+        if (fchmod(fd, S_IRUSR | S_IWUSR) != 0 || resume_save(jpath, &jn, 0) != 0){
+            close(fd); unlink(part);
+            return -1;
+        }
+    }
+
+    chunk_job_t job;
+    memset(&job, 0, sizeof job);
+    job.in_fd = fileno(in); job.out_fd = fd; job.decrypt = 1;
+    job.h = h; job.key = key; job.n_chunks = n;
+    int rc = run_resumable(&job, fd, jpath, &jn, threads);
+    return resume_finish(fd, part, out_path, jpath, &jn, n, rc);
+}
+
+/* decrypt_chunked_range: write plaintext bytes [off, off + len) of a
+   STREAM_FLAG_CHUNKED file to `out`, opening only the chunks that cover the
+   range (ciphertext offsets are computed, nothing before them is read).
+   Returns 0 on success (an empty window is fine), -1 on failure. */
+int decrypt_chunked_range(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key,
+                          uint64_t off, uint64_t len){
+    if (check_cipher(h) != 0 || check_chunked_size(fileno(in), h) != 0) return -1; // truncated or extended
+    if (off >= h->plain_size || len == 0) return 0; // nothing to emit
+
+    const uint32_t cs = h->chunk_size; // plaintext bytes per chunk
+    const uint64_t n = chunk_count(h->plain_size, cs);
+    const int cid = (int)STREAM_CIPHER(h->flags); // cipher suite
+    const size_t ab = cipher_abytes(cid); // tag bytes per chunk
+    uint64_t end = (len > h->plain_size - off) ? h->plain_size : off + len; // clamp to EOF
+
+    unsigned char *plain  = buf_alloc(cs, BUF_SECRET); // plaintext chunk (locked, pooled)
+    unsigned char *cipher = buf_alloc((size_t)cs + ab, BUF_PLAIN); // ciphertext chunk
+    int rc = (plain && cipher) ? 0 : -1;
+
+    for (uint64_t i = off / cs; rc == 0 && i * (uint64_t)cs < end; ++i){
+        int final = (i == n - 1); // last chunk carries the marker
+        size_t plen = final ? (size_t)(h->plain_size - i * (uint64_t)cs) : cs; // short tail allowed
+        off_t c_off = (off_t)h->raw_len + (off_t)(i * ((uint64_t)cs + ab)); // computed offset
+
+        if (pread_full(fileno(in), cipher, plen + ab, c_off) != 0){ perror("pread"); rc = -1; break; }
+        if (cipher_open(cid, plain, cipher, plen + ab, h->raw, h->aad_len, h->ss_header, i, final, key) != 0){
+            fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+            rc = -1; break;
+        }
+
+        // Emit the overlap of this chunk with [off, end).
+        uint64_t base = i * (uint64_t)cs; // plaintext offset of chunk start
+        uint64_t lo = off > base ? off - base : 0;
+        uint64_t hi = end - base < plen ? end - base : plen;
+        if (fwrite(plain + lo, 1, (size_t)(hi - lo), out) != (size_t)(hi - lo)){ perror("write"); rc = -1; }
+    }
+
+    buf_free(plain); buf_free(cipher); // plaintext is wiped on release
+    return rc;
+}
+
+/* decrypt_chunked_seq: open the chunks of a STREAM_FLAG_CHUNKED file whose
+   header `h` was already read from `in`, in order and without seeking (for
+   pipes). Each chunk's plaintext goes to `out` once it authenticates, and
+   `in` must end right after the last chunk. Returns 0 on success, -1 on
+   failure. */
+int decrypt_chunked_seq(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key){
+    const uint32_t cs = h->chunk_size; // plaintext bytes per chunk
+    const uint64_t n = chunk_count(h->plain_size, cs);
+    const int cid = (int)STREAM_CIPHER(h->flags); // cipher suite
+    const size_t ab = cipher_abytes(cid); // tag bytes per chunk
+    if (check_cipher(h) != 0) return -1;
+    unsigned char *plain  = buf_alloc(cs, BUF_SECRET); // plaintext chunk (locked, pooled)
+    unsigned char *cipher = buf_alloc((size_t)cs + ab, BUF_PLAIN); // ciphertext chunk
+    int rc = (plain && cipher) ? 0 : -1;
+    if (rc != 0) fprintf(stderr, "out of memory\n");
+
+    for (uint64_t i = 0; rc == 0 && i < n; ++i){
+        int final = (i == n - 1); // last chunk carries the marker
+        size_t plen = final ? (size_t)(h->plain_size - i * (uint64_t)cs) : cs; // short tail allowed
+
+        uint64_t t = stats_now();
+        if (fread(cipher, 1, plen + ab, in) != plen + ab){
+            fprintf(stderr, "decryption failed (truncated file)\n");
+            rc = -1; break;
+        }
+        stats_add(STATS_READ, t, plen + ab);
+        t = stats_now();
+        if (cipher_open(cid, plain, cipher, plen + ab, h->raw, h->aad_len, h->ss_header, i, final, key) != 0){
+            fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+            rc = -1; break;
+        }
+        stats_add(STATS_CRYPT, t, plen);
+        stats_count(STATS_CHUNKS, 1);
+        t = stats_now();
+        if (fwrite(plain, 1, plen, out) != plen){ perror("write"); rc = -1; break; }
+        stats_add(STATS_WRITE, t, plen);
+    }
+    if (rc == 0 && fgetc(in) != EOF){ // plain_size pins the length
+        fprintf(stderr, "decryption failed (extended file)\n");
+        rc = -1;
+    }
+
+    buf_free(plain); buf_free(cipher); // plaintext is wiped on release
+    return rc;
+}
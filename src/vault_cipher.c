@@ -0,0 +1,138 @@
+#include "../include/header.h"
+
+/* AEAD cipher suites of the chunk-independent layout (--cipher).
+
+   The suite id is recorded in the header flags (STREAM_CIPHER_MASK), so it
+   is bound as AAD like every other header field and decrypt dispatches on
+   it. Every suite takes the random 32-byte payload key as is. Chunk nonces
+   come from the header's 24-byte nonce base: the base fills the suite's
+   nonce (AEGIS-256's 32 bytes are zero-padded), the chunk index is xored
+   into its last 8 bytes and the byte before them is flipped for the final
+   chunk. For XChaCha20 those are the nonces the layout always used. The
+   key is random per file, so nonces only need to be distinct within one
+   file, which AES-256-GCM's 12 bytes give as well.
+
+   AES-256-GCM needs AES-NI and PCLMUL (or ARMv8 crypto); AEGIS-256 needs
+   libsodium 1.0.19 or later and is fastest with the same instructions. */
+
+#if defined(crypto_aead_aegis256_KEYBYTES)
+#define HAVE_AEGIS256 1
+#endif
+
+#define NPUB_MAX 32   /* largest suite nonce (AEGIS-256) */
+
+/* cipher_name: display name for suite `id` (also the --cipher value). */
+const char *cipher_name(int id){
+    switch (id){
+    case CIPHER_XCHACHA20: return "xchacha20";
+    case CIPHER_AES256GCM: return "aes256gcm";
+    case CIPHER_AEGIS256:  return "aegis256";
+    default:               return "unknown";
+    }
+}
+
+/* cipher_available: non-zero if this build and CPU can seal and open `id`. */
+int cipher_available(int id){
+    if (id == CIPHER_AES256GCM) return crypto_aead_aes256gcm_is_available();
+#if defined(HAVE_AEGIS256)
+    if (id == CIPHER_AEGIS256) return 1;
+#endif
+    return id == CIPHER_XCHACHA20;
+}
+
+/* cipher_parse: parse a --cipher value: "auto" or a suite name.
+   Returns 0 on success, -1 on an unknown name. */
+int cipher_parse(const char *spec, int *id){
+    if (strcmp(spec, "auto") == 0){ *id = CIPHER_AUTO; return 0; }
+    for (int i = 0; i < CIPHER_COUNT; ++i)
+        if (strcmp(spec, cipher_name(i)) == 0){ *id = i; return 0; }
+    return -1;
+}
+
+/* cipher_pick: suite for new chunked files. --cipher wins; otherwise a CPU
+   with AES instructions (which is what crypto_aead_aes256gcm_is_available
+   probes) gets AEGIS-256 when libsodium has it, else AES-256-GCM, and
+   anything else keeps the portable XChaCha20-Poly1305. */
+int cipher_pick(void){
+    if (g_cipher != CIPHER_AUTO) return g_cipher;
+    if (!crypto_aead_aes256gcm_is_available()) return CIPHER_XCHACHA20;
+    return cipher_available(CIPHER_AEGIS256) ? CIPHER_AEGIS256 : CIPHER_AES256GCM;
+}
+
+/* cipher_abytes: tag bytes suite `id` adds to every chunk. */
+size_t cipher_abytes(int id){
+#if defined(HAVE_AEGIS256)
+    if (id == CIPHER_AEGIS256) return crypto_aead_aegis256_ABYTES;
+#endif
+    return id == CIPHER_AES256GCM ? crypto_aead_aes256gcm_ABYTES : crypto_aead_xchacha20poly1305_ietf_ABYTES;
+}
+
+/* cipher_nonce: chunk `i`'s nonce for suite `id` from the 24-byte `base`.
+   Returns the nonce length, or 0 for a suite this build lacks. */
+static size_t cipher_nonce(int id, unsigned char nonce[NPUB_MAX], const unsigned char *base, uint64_t i, int final){
+    size_t n = 0;
+    if (id == CIPHER_XCHACHA20) n = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES;
+    if (id == CIPHER_AES256GCM) n = crypto_aead_aes256gcm_NPUBBYTES;
+#if defined(HAVE_AEGIS256)
+    if (id == CIPHER_AEGIS256)  n = crypto_aead_aegis256_NPUBBYTES;
+#endif
+    if (n == 0) return 0;
+    const size_t nb = crypto_secretstream_xchacha20poly1305_HEADERBYTES; // nonce base size
+    memset(nonce, 0, NPUB_MAX);
+    memcpy(nonce, base, n < nb ? n : nb); // start from the random base
+    for (int b = 0; b < 8; ++b) nonce[n - 8 + (size_t)b] ^= (unsigned char)(i >> (8 * b)); // chunk index
+    if (final) nonce[n - 9] ^= 0x01; // final-chunk marker
+    return n;
+}
+
+/* cipher_seal: seal `mlen` bytes of chunk `i` (`final` for the last one)
+   from `m` into `c` (mlen + cipher_abytes(id) bytes) under suite `id`.
+   Returns 0 on success, -1 on failure. */
+int cipher_seal(int id, unsigned char *c, const unsigned char *m, size_t mlen, const unsigned char *ad, size_t adlen,
+                const unsigned char *base, uint64_t i, int final, const unsigned char *key){
+    unsigned char nonce[NPUB_MAX];
+    if (cipher_nonce(id, nonce, base, i, final) == 0) return -1;
+    int rc = -1;
+    switch (id){
+    case CIPHER_XCHACHA20:
+        rc = crypto_aead_xchacha20poly1305_ietf_encrypt(c, NULL, m, mlen, ad, adlen, NULL, nonce, key);
+        break;
+    case CIPHER_AES256GCM:
+        rc = crypto_aead_aes256gcm_encrypt(c, NULL, m, mlen, ad, adlen, NULL, nonce, key);
+        break;
+#if defined(HAVE_AEGIS256)
+    case CIPHER_AEGIS256:
+        rc = crypto_aead_aegis256_encrypt(c, NULL, m, mlen, ad, adlen, NULL, nonce, key);
+        break;
+#endif
+    default:
+        break;
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+/* cipher_open: open chunk `i` (`final` for the last one), `clen` bytes at
+   `c`, into `m` (clen - cipher_abytes(id) bytes) under suite `id`.
+   Returns 0 if it authenticates, -1 otherwise. */
+int cipher_open(int id, unsigned char *m, const unsigned char *c, size_t clen, const unsigned char *ad, size_t adlen,
+                const unsigned char *base, uint64_t i, int final, const unsigned char *key){
+    unsigned char nonce[NPUB_MAX];
+    if (cipher_nonce(id, nonce, base, i, final) == 0) return -1;
+    int rc = -1;
+    switch (id){
+    case CIPHER_XCHACHA20:
+        rc = crypto_aead_xchacha20poly1305_ietf_decrypt(m, NULL, NULL, c, clen, ad, adlen, nonce, key);
+        break;
+    case CIPHER_AES256GCM:
+        rc = crypto_aead_aes256gcm_decrypt(m, NULL, NULL, c, clen, ad, adlen, nonce, key);
+        break;
+#if defined(HAVE_AEGIS256)
+    case CIPHER_AEGIS256:
+        rc = crypto_aead_aegis256_decrypt(m, NULL, NULL, c, clen, ad, adlen, nonce, key);
+        break;
+#endif
+    default:
+        break;
+    }
+    return rc == 0 ? 0 : -1;
+}
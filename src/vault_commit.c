@@ -0,0 +1,392 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* O_TMPFILE, syncfs() */
+#endif
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* Crash-safe outputs.
+
+   Every encrypt/decrypt result is written to a temp file in the destination
+   directory and renamed over its final name only once the data is on stable
+   storage, so a crash leaves the old state or the complete new file, never
+   a truncated .enc/.dec. On Linux the temp is an unnamed O_TMPFILE inode
+   (nothing to clean up after a crash) that is linked to a hidden name just
+   before it is closed; elsewhere, and on filesystems without O_TMPFILE, it
+   is a ".sstmp-<name>-<random>" file from the start. The walker skips
+   those names.
+
+   Outside a group (single-file runs) each output is fsynced, renamed, and
+   its directory fsynced at commit. Between commit_begin and commit_end
+   (directory runs) finished outputs are queued instead, and each batch of
+   COMMIT_GROUP_MAX is made durable together: one syncfs() per filesystem
+   for the data (Linux; elsewhere every file was already fsynced at commit),
+   then the renames, then one fsync per destination directory. Queued
+   outputs keep their descriptors open until that syncfs, which runs on the
+   oldest of them so it reports every writeback error since the first
+   output of the batch on that filesystem was opened. --rm sources handed
+   over with commit_source are deleted only after their output's batch
+   completed.
+
+   A failure is reported against the output it belongs to: to its own
+   out_commit if that is the call flushing the batch, otherwise by
+   commit_end, and never to the unrelated commit that happened to fill the
+   batch. */
+
+typedef struct {
+    char *tmp, *path;   /* rename tmp -> path */
+    char *src;          /* --rm: delete once durable, or NULL */
+    int   fd;           /* output descriptor, closed after the data sync */
+    unsigned long seq;  /* open order (commit_ticket) */
+    dev_t dev;          /* filesystem of the output */
+    int   dev_ok;       /* dev is valid (else fsync the file itself) */
+    int   synced;       /* data already fsynced */
+    int   failed;
+} commit_ent_t;
+
+static pthread_mutex_t c_mu = PTHREAD_MUTEX_INITIALIZER; /* guards the queue */
+static commit_ent_t   *c_ents;
+static size_t          c_n, c_cap;
+static int             c_group;     /* commit_begin depth */
+static size_t          c_failed;    /* deferred outputs of this group that failed */
+static unsigned long   c_seq;       /* last commit_ticket */
+
+static pthread_once_t  c_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   c_src_key;   /* thread -> pending --rm source */
+static int             c_proc_ok;   /* /proc/self/fd usable for linkat */
+
+static void commit_init(void){
+    (void)pthread_key_create(&c_src_key, free);
+#if defined(O_TMPFILE)
+    c_proc_ok = access("/proc/self/fd", X_OK) == 0;
+#endif
+}
+
+/* dir_of: directory part of `path` ("." when there is none). */
+static void dir_of(const char *path, char *dir, size_t cap){
+    const char *slash = strrchr(path, '/');
+    if (!slash){ snprintf(dir, cap, "."); return; }
+    size_t dlen = slash == path ? 1 : (size_t)(slash - path); // keep "/" for root
+    if (dlen >= cap) dlen = cap - 1;
+    memcpy(dir, path, dlen);
+    dir[dlen] = '\0';
+}
+
+/* sync_fd: flush a descriptor's data to stable storage. */
+static int sync_fd(int fd){
+    stats_count(STATS_SYS_FSYNC, 1);
+#if defined(__APPLE__)
+    if (fcntl(fd, F_FULLFSYNC, 0) == 0) return 0; // drive cache too
+#endif
+    return fsync(fd);
+}
+
+/* sync_path: open `path` read-only and sync it. */
+static int sync_path(const char *path){
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    int rc = sync_fd(fd);
+    close(fd);
+    return rc;
+}
+
+/* commit_ticket: number a freshly opened output descriptor, so a batch can
+   sync through the oldest one (see flush_batch). */
+unsigned long commit_ticket(void){
+    pthread_mutex_lock(&c_mu);
+    unsigned long seq = ++c_seq;
+    pthread_mutex_unlock(&c_mu);
+    return seq;
+}
+
+/* out_tmp_name: a fresh hidden temp name next to `path`. Returns 0, or -1
+   if it does not fit in `cap`. */
+int out_tmp_name(const char *path, char *tmp, size_t cap){
+    char dir[PATH_MAX], rnd[13];
+    unsigned char r[6];
+    dir_of(path, dir, sizeof dir);
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    randombytes_buf(r, sizeof r);
+    sodium_bin2hex(rnd, sizeof rnd, r, sizeof r);
+    // the base is cut so the temp name stays within NAME_MAX
+    int n = snprintf(tmp, cap, "%s/" OUT_TMP_PREFIX "%.200s-%s", dir, base, rnd);
+    return (n < 0 || (size_t)n >= cap) ? -1 : 0;
+}
+
+/* out_open: start an output that will replace `path` on commit. `rdwr`
+   asks for a readable descriptor (mmap output). Returns 0, or -1. */
+int out_open(vault_out_t *o, const char *path, int rdwr){
+    memset(o, 0, sizeof *o);
+    o->fd = -1;
+    if (strlen(path) >= sizeof o->path){ fprintf(stderr, "path too long: %s\n", path); return -1; }
+    strcpy(o->path, path);
+    pthread_once(&c_once, commit_init);
+    int acc = rdwr ? O_RDWR : O_WRONLY;
+
+#if defined(O_TMPFILE)
+    if (c_proc_ok){
+        char dir[PATH_MAX];
+        dir_of(path, dir, sizeof dir);
+        o->fd = open(dir, O_TMPFILE | acc, 0600);
+        if (o->fd >= 0){ o->anon = 1; o->seq = commit_ticket(); stats_count(STATS_SYS_OPEN, 1); return 0; }
+        // EOPNOTSUPP/EISDIR: no O_TMPFILE on this filesystem; use a named temp
+    }
+#endif
+    for (int tries = 0; tries < 8; ++tries){
+        if (out_tmp_name(path, o->tmp, sizeof o->tmp) != 0){
+            fprintf(stderr, "path too long: %s\n", path);
+            return -1;
+        }
+        o->fd = open(o->tmp, acc | O_CREAT | O_EXCL, 0600);
+        if (o->fd >= 0 || errno != EEXIST) break;
+    }
+    if (o->fd < 0){ perror(path); o->tmp[0] = '\0'; return -1; }
+    o->seq = commit_ticket();
+    stats_count(STATS_SYS_OPEN, 1);
+    return 0;
+}
+
+/* out_stream: stdio view of the output (closed by commit/abort). */
+FILE *out_stream(vault_out_t *o, const char *mode){
+    o->fp = fdopen(o->fd, mode);
+    if (!o->fp) perror(o->path);
+    return o->fp;
+}
+
+/* out_link: give an O_TMPFILE output its hidden name. */
+static int out_link(vault_out_t *o){
+    if (!o->anon) return 0;
+    char proc[64];
+    snprintf(proc, sizeof proc, "/proc/self/fd/%d", o->fd);
+    for (int tries = 0; tries < 8; ++tries){
+        if (out_tmp_name(o->path, o->tmp, sizeof o->tmp) != 0) break;
+        if (linkat(AT_FDCWD, proc, AT_FDCWD, o->tmp, AT_SYMLINK_FOLLOW) == 0){ o->anon = 0; return 0; }
+        if (errno != EEXIST) break;
+    }
+    perror(o->path);
+    return -1;
+}
+
+/* out_close: close the descriptor (or stream) exactly once. */
+static int out_close(vault_out_t *o){
+    if (o->fd < 0 && !o->fp) return 0;
+    int rc = o->fp ? fclose(o->fp) : close(o->fd);
+    o->fp = NULL; o->fd = -1;
+    stats_count(STATS_SYS_CLOSE, 1);
+    return rc;
+}
+
+/* out_abort: drop an unfinished output; the final path is untouched. */
+void out_abort(vault_out_t *o){
+    (void)out_close(o);
+    if (!o->anon && o->tmp[0]) unlink(o->tmp);
+    o->tmp[0] = '\0';
+}
+
+/* flush_batch: make `n` queued outputs durable, rename them into place,
+   then delete their --rm sources. Frees the entries. `own` is the entry of
+   the out_commit doing the flush (n: none, as for commit_end); the other
+   entries' failures are counted for commit_end. Returns 0, or -1 if `own`
+   could not be committed. */
+static int flush_batch(commit_ent_t *e, size_t n, size_t own){
+    char dir[PATH_MAX];
+
+    // 1) Data. One syncfs per filesystem, on its oldest descriptor in the
+    //    batch; an error there fails every output of the batch on it.
+#if defined(__linux__)
+    for (size_t i = 0; i < n; ++i){
+        if (e[i].synced || !e[i].dev_ok) continue;
+        size_t old = i;
+        for (size_t j = i + 1; j < n; ++j)
+            if (!e[j].synced && e[j].dev_ok && e[j].dev == e[i].dev && e[j].seq < e[old].seq) old = j;
+        stats_count(STATS_SYS_FSYNC, 1);
+        int err = syncfs(e[old].fd) == 0 ? 0 : errno;
+        for (size_t j = i; j < n; ++j){
+            if (e[j].synced || !e[j].dev_ok || e[j].dev != e[i].dev) continue;
+            e[j].synced = 1; // covered by this syncfs
+            if (err){ fprintf(stderr, "commit failed: %s: %s\n", e[j].path, strerror(err)); e[j].failed = 1; }
+        }
+    }
+#endif
+    for (size_t i = 0; i < n; ++i){ // no syncfs: one fsync per file
+        if (!e[i].synced && sync_fd(e[i].fd) != 0){
+            fprintf(stderr, "commit failed: %s: %s\n", e[i].path, strerror(errno));
+            e[i].failed = 1;
+        }
+        if (close(e[i].fd) != 0 && !e[i].failed){ // late write errors (network filesystems)
+            fprintf(stderr, "commit failed: %s: %s\n", e[i].path, strerror(errno));
+            e[i].failed = 1;
+        }
+        stats_count(STATS_SYS_CLOSE, 1);
+    }
+
+    // 2) Renames: each output appears whole or not at all.
+    for (size_t i = 0; i < n; ++i){
+        if (!e[i].failed && rename(e[i].tmp, e[i].path) != 0){
+            fprintf(stderr, "commit failed: %s: %s\n", e[i].path, strerror(errno));
+            e[i].failed = 1;
+        }
+        if (e[i].failed) unlink(e[i].tmp);
+    }
+
+    // 3) Directory entries: one fsync per distinct destination directory.
+    //    If it fails, none of that directory's outputs is known durable.
+    for (size_t i = 0; i < n; ++i){
+        if (e[i].failed) continue;
+        dir_of(e[i].path, dir, sizeof dir);
+        size_t j = 0;
+        char prev[PATH_MAX];
+        for (; j < i; ++j){
+            if (e[j].failed) continue;
+            dir_of(e[j].path, prev, sizeof prev);
+            if (strcmp(prev, dir) == 0) break;
+        }
+        if (j < i) continue; // already synced in this batch
+        if (sync_path(dir) == 0) continue;
+        int err = errno;
+        for (j = i; j < n; ++j){
+            if (e[j].failed) continue;
+            dir_of(e[j].path, prev, sizeof prev);
+            if (strcmp(prev, dir) != 0) continue;
+            fprintf(stderr, "commit failed: %s: %s\n", e[j].path, strerror(err));
+            e[j].failed = 1;
+        }
+    }
+
+    // 4) --rm: sources go only once their replacement is durable.
+    int rc = 0;
+    size_t bad = 0; // failures of outputs whose out_commit already returned
+    for (size_t i = 0; i < n; ++i){
+        if (!e[i].failed && e[i].src && safe_delete(e[i].src) != 0)
+            fprintf(stderr, "Warning: could not delete original file: %s\n", e[i].src);
+        if (e[i].failed){ if (i == own) rc = -1; else bad++; }
+        free(e[i].tmp); free(e[i].path); free(e[i].src);
+    }
+    free(e);
+    if (bad){
+        pthread_mutex_lock(&c_mu);
+        c_failed += bad;
+        pthread_mutex_unlock(&c_mu);
+    }
+    return rc;
+}
+
+/* take_batch: detach the queue (caller holds c_mu). */
+static commit_ent_t *take_batch(size_t *n){
+    commit_ent_t *b = c_ents;
+    *n = c_n;
+    c_ents = NULL; c_n = c_cap = 0;
+    return b;
+}
+
+/* commit_queue: queue one finished output and flush when not grouping or
+   the batch is full. Takes ownership of `fd` and `src`. Returns this
+   output's status: 0 while it waits in a group, else whether it committed. */
+static int commit_queue(int fd, unsigned long seq, const char *tmp, const char *path, char *src, int synced){
+    commit_ent_t ent = { strdup(tmp), strdup(path), src, fd, seq, 0, 0, synced, 0 };
+    struct stat st;
+    if (fstat(fd, &st) == 0){ ent.dev = st.st_dev; ent.dev_ok = 1; }
+    if (!ent.tmp || !ent.path){
+        perror("commit");
+        close(fd); unlink(tmp);
+        free(ent.tmp); free(ent.path); free(src);
+        return -1;
+    }
+    commit_ent_t *batch = NULL;
+    size_t n = 0;
+    pthread_mutex_lock(&c_mu);
+    if (c_n == c_cap){
+        size_t cap = c_cap ? c_cap * 2 : 16;
+        commit_ent_t *p = realloc(c_ents, cap * sizeof *p);
+        if (!p){
+            pthread_mutex_unlock(&c_mu);
+            perror("commit");
+            close(fd); unlink(tmp);
+            free(ent.tmp); free(ent.path); free(src);
+            return -1;
+        }
+        c_ents = p; c_cap = cap;
+    }
+    c_ents[c_n++] = ent;
+    if (!c_group || c_n >= COMMIT_GROUP_MAX) batch = take_batch(&n);
+    pthread_mutex_unlock(&c_mu);
+    return batch ? flush_batch(batch, n, n - 1) : 0; // ours is the last entry
+}
+
+/* take_source: the calling thread's pending --rm source, if any. */
+static char *take_source(void){
+    pthread_once(&c_once, commit_init);
+    char *src = pthread_getspecific(c_src_key);
+    (void)pthread_setspecific(c_src_key, NULL);
+    return src;
+}
+
+/* out_commit: finish the output and hand it (and its descriptor) to the
+   committer. Outside a group it is durable under its final name on return.
+   Returns 0, or -1 (the temp is removed and the final path left as it was). */
+int out_commit(vault_out_t *o){
+    int rc = 0;
+    if (o->fp && fflush(o->fp) != 0){ perror(o->path); rc = -1; }
+
+    pthread_mutex_lock(&c_mu);
+    int defer = c_group > 0;
+    pthread_mutex_unlock(&c_mu);
+#if !defined(__linux__)
+    defer = 0; // no syncfs to share: each file pays its own sync
+#endif
+    if (rc == 0 && !defer && sync_fd(o->fd) != 0){ perror(o->path); rc = -1; }
+    if (rc == 0 && out_link(o) != 0) rc = -1;
+    int keep = -1; // stays open until the batch's data sync
+    if (rc == 0 && o->fp && (keep = dup(o->fd)) < 0){ perror(o->path); rc = -1; }
+    if (rc == 0 && !o->fp){ keep = o->fd; o->fd = -1; }
+    if (out_close(o) != 0){ perror(o->path); rc = -1; } // stdio write errors land here
+    if (rc != 0){
+        if (keep >= 0) close(keep);
+        out_abort(o);
+        return -1;
+    }
+    return commit_queue(keep, o->seq, o->tmp, o->path, take_source(), !defer);
+}
+
+/* commit_named: queue a written temp `tmp` (io_uring outputs) to replace
+   `path`, deleting `src` (if not NULL) once durable. Takes ownership of its
+   descriptor `fd`, numbered `seq` by commit_ticket when it was opened. */
+int commit_named(int fd, unsigned long seq, const char *tmp, const char *path, const char *src){
+    char *s = NULL;
+    if (src && !(s = strdup(src))){ perror("commit"); close(fd); unlink(tmp); return -1; }
+    return commit_queue(fd, seq, tmp, path, s, 0);
+}
+
+/* commit_source: the next output committed on this thread replaces `src`,
+   which is deleted once that output is durable (--rm). NULL cancels. */
+void commit_source(const char *src){
+    pthread_once(&c_once, commit_init);
+    free(pthread_getspecific(c_src_key));
+    (void)pthread_setspecific(c_src_key, src ? strdup(src) : NULL);
+}
+
+/* commit_begin / commit_end: group commits for a directory run. commit_end
+   flushes whatever is queued; it returns -1 if any output whose out_commit
+   had already returned 0 failed later. Callers join their workers before
+   commit_end. */
+void commit_begin(void){
+    pthread_mutex_lock(&c_mu);
+    if (c_group++ == 0) c_failed = 0;
+    pthread_mutex_unlock(&c_mu);
+}
+
+int commit_end(void){
+    size_t n = 0;
+    pthread_mutex_lock(&c_mu);
+    if (c_group > 0) c_group--;
+    commit_ent_t *batch = take_batch(&n);
+    pthread_mutex_unlock(&c_mu);
+    if (n) (void)flush_batch(batch, n, n); // every entry's commit already returned
+    else free(batch);
+    pthread_mutex_lock(&c_mu);
+    int rc = c_failed ? -1 : 0;
+    if (c_group == 0) c_failed = 0;
+    pthread_mutex_unlock(&c_mu);
+    return rc;
+}
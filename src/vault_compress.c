@@ -0,0 +1,317 @@
+#include "../include/header.h"
+
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(HAVE_LZ4)
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+/* Per-chunk compression (--compress).
+
+   The codec is recorded in the header flags (STREAM_CODEC_MASK), so it is
+   bound as AAD like every other header field. Such files use the
+   secretstream layout with variable-length frames:
+
+       len u32 | sealed(kind u8 | payload)
+
+   `len` is the sealed size. `kind` is CHUNK_RAW (payload is the plaintext
+   chunk as read) or CHUNK_PACKED (payload is that chunk compressed); a
+   chunk that does not shrink is stored raw, so incompressible data costs
+   one byte per chunk. `kind` sits inside the sealed message and is
+   authenticated with it; a forged `len` only makes the next pull fail.
+   Every chunk still decompresses to at most chunk_size bytes, so decrypt
+   memory stays bounded by the header. */
+
+#define FRAME_LEN 4   /* frame length prefix */
+
+/* Codec state for one file. */
+typedef struct {
+    int   id, level;        /* CODEC_*; compression level */
+    void *cctx, *dctx;      /* zstd contexts, reused across chunks */
+} codec_t;
+
+/* codec_name: display name for codec `id`. */
+const char *codec_name(int id){
+    switch (id){
+    case CODEC_ZSTD: return "zstd";
+    case CODEC_LZ4:  return "lz4";
+    default:         return "none";
+    }
+}
+
+/* codec_available: non-zero if this build can compress and decompress `id`. */
+int codec_available(int id){
+#if defined(HAVE_ZSTD)
+    if (id == CODEC_ZSTD) return 1;
+#endif
+#if defined(HAVE_LZ4)
+    if (id == CODEC_LZ4) return 1;
+#endif
+    return id == CODEC_NONE;
+}
+
+/* codec_parse: parse a --compress value, "zstd[:LEVEL]" or "lz4[:LEVEL]"
+   (zstd 1..19, default 3; lz4 1 = fast, 2..12 = HC, default 1).
+   Returns 0 on success, -1 on bad syntax or an out-of-range level. */
+int codec_parse(const char *spec, int *id, int *level){
+    const char *colon = strchr(spec, ':');
+    size_t nlen = colon ? (size_t)(colon - spec) : strlen(spec);
+    int lo, hi;
+    if (nlen == 4 && strncmp(spec, "zstd", 4) == 0){ *id = CODEC_ZSTD; *level = 3; lo = 1; hi = 19; }
+    else if (nlen == 3 && strncmp(spec, "lz4", 3) == 0){ *id = CODEC_LZ4; *level = 1; lo = 1; hi = 12; }
+    else return -1;
+    if (colon){
+        char *end = NULL;
+        long v = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != '\0' || v < lo || v > hi) return -1;
+        *level = (int)v;
+    }
+    return 0;
+}
+
+/* codec_free: release codec state. */
+static void codec_free(codec_t *c){
+#if defined(HAVE_ZSTD)
+    if (c->cctx) ZSTD_freeCCtx(c->cctx);
+    if (c->dctx) ZSTD_freeDCtx(c->dctx);
+#endif
+    c->cctx = c->dctx = NULL;
+}
+
+/* codec_init: per-file codec state for codec `id` at `level` (level is
+   ignored for decompression). Returns 0, or -1 if the codec is not built
+   in or out of memory. */
+static int codec_init(codec_t *c, int id, int level){
+    memset(c, 0, sizeof *c);
+    c->id = id; c->level = level;
+    if (!codec_available(id)){
+        fprintf(stderr, "%s compression is not supported by this build\n", codec_name(id));
+        return -1;
+    }
+#if defined(HAVE_ZSTD)
+    if (id == CODEC_ZSTD){
+        c->cctx = ZSTD_createCCtx();
+        c->dctx = ZSTD_createDCtx();
+        if (!c->cctx || !c->dctx){ codec_free(c); fprintf(stderr, "out of memory\n"); return -1; }
+    }
+#endif
+    return 0;
+}
+
+/* codec_compress: compress `n` bytes of `src` into at most `cap` bytes of
+   `dst`. Returns the compressed size, or 0 if it does not fit (the caller
+   stores the chunk raw). */
+static size_t codec_compress(codec_t *c, const unsigned char *src, size_t n, unsigned char *dst, size_t cap){
+    if (n == 0 || cap == 0) return 0;
+#if defined(HAVE_ZSTD)
+    if (c->id == CODEC_ZSTD){
+        size_t z = ZSTD_compressCCtx(c->cctx, dst, cap, src, n, c->level);
+        return ZSTD_isError(z) ? 0 : z; // dstSize_tooSmall: not compressible enough
+    }
+#endif
+#if defined(HAVE_LZ4)
+    if (c->id == CODEC_LZ4 && n <= (size_t)LZ4_MAX_INPUT_SIZE){
+        int ccap = cap > (size_t)INT_MAX ? INT_MAX : (int)cap;
+        int z = c->level > 1 ? LZ4_compress_HC((const char *)src, (char *)dst, (int)n, ccap, c->level)
+                             : LZ4_compress_default((const char *)src, (char *)dst, (int)n, ccap);
+        return z > 0 ? (size_t)z : 0;
+    }
+#endif
+    (void)src; (void)dst;
+    return 0;
+}
+
+/* codec_decompress: expand `n` bytes of `src` into `dst` (at most `cap`
+   bytes). Returns 0 and sets *out, or -1 on corrupt or oversized input. */
+static int codec_decompress(codec_t *c, const unsigned char *src, size_t n, unsigned char *dst, size_t cap,
+                            size_t *out){
+#if defined(HAVE_ZSTD)
+    if (c->id == CODEC_ZSTD){
+        size_t z = ZSTD_decompressDCtx(c->dctx, dst, cap, src, n);
+        if (ZSTD_isError(z)) return -1;
+        *out = z;
+        return 0;
+    }
+#endif
+#if defined(HAVE_LZ4)
+    if (c->id == CODEC_LZ4 && n <= (size_t)INT_MAX){
+        int z = LZ4_decompress_safe((const char *)src, (char *)dst, (int)n, cap > (size_t)INT_MAX ? INT_MAX : (int)cap);
+        if (z < 0) return -1;
+        *out = (size_t)z;
+        return 0;
+    }
+#endif
+    (void)src; (void)n; (void)dst; (void)cap; (void)out;
+    return -1;
+}
+
+/* put_len / get_len: frame length prefix (little-endian). */
+static void put_len(unsigned char *p, uint32_t v){
+    p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); p[2] = (unsigned char)(v >> 16); p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_len(const unsigned char *p){
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Buffers for one compressed stream. */
+typedef struct {
+    codec_t c;
+    size_t cs;              /* plaintext bytes per chunk */
+    unsigned char *raw;     /* kind byte + chunk as read (push), kind + payload (pull) */
+    unsigned char *zip;     /* kind byte + compressed chunk (push), decompressed chunk (pull) */
+    unsigned char *frame;   /* length prefix + sealed message */
+} codec_io_t;
+
+/* io_open: codec state and buffers for chunk size `cs`. The plaintext and
+   compressed-plaintext buffers are BUF_SECRET; the frame only ever holds
+   sealed bytes. (The codec's own workspace is allocated by the library.) */
+static int io_open(codec_io_t *x, int id, int level, size_t cs){
+    memset(x, 0, sizeof *x);
+    if (codec_init(&x->c, id, level) != 0) return -1;
+    x->cs = cs;
+    x->raw = buf_alloc(1 + cs, BUF_SECRET);
+    x->zip = buf_alloc(1 + cs, BUF_SECRET);
+    x->frame = buf_alloc(FRAME_LEN + 1 + cs + crypto_secretstream_xchacha20poly1305_ABYTES, BUF_PLAIN);
+    if (!x->raw || !x->zip || !x->frame){
+        fprintf(stderr, "out of memory\n");
+        buf_free(x->raw); buf_free(x->zip); buf_free(x->frame);
+        codec_free(&x->c);
+        return -1;
+    }
+    return 0;
+}
+
+/* io_close: release what io_open set up (buf_free wipes the plaintext). */
+static void io_close(codec_io_t *x){
+    buf_free(x->raw); buf_free(x->zip); buf_free(x->frame);
+    codec_free(&x->c);
+}
+
+/* stream_push_codec: write header `h` (codec in its flags, level
+   g_codec_level) and the compressed secretstream frames of `in` to `out`.
+   Returns 0 on success, -1 on failure. */
+int stream_push_codec(FILE *in, FILE *out, const stream_hdr_t *h, crypto_secretstream_xchacha20poly1305_state *st){
+    if (fwrite(h->raw, 1, h->raw_len, out) != h->raw_len){ perror("write header"); return -1; }
+    codec_io_t x;
+    if (io_open(&x, (int)STREAM_CODEC(h->flags), g_codec_level, h->chunk_size) != 0) return -1;
+    x.raw[0] = CHUNK_RAW; x.zip[0] = CHUNK_PACKED;
+
+    int rc = -1;
+    for (;;){
+        uint64_t t = stats_now();
+        size_t n = fread(x.raw + 1, 1, x.cs, in);
+        if (ferror(in)){ perror("fread"); break; }
+        stats_add(STATS_READ, t, n);
+        unsigned char tag = feof(in) ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0; // mark final chunk
+
+        t = stats_now();
+        size_t z = codec_compress(&x.c, x.raw + 1, n, x.zip + 1, n > 0 ? n - 1 : 0); // must save a byte
+        const unsigned char *msg = z ? x.zip : x.raw; // raw when it did not shrink
+        size_t mlen = 1 + (z ? z : n);
+        unsigned long long clen = 0ULL;
+        if (crypto_secretstream_xchacha20poly1305_push(st, x.frame + FRAME_LEN, &clen, msg, mlen,
+                                                       h->raw, h->aad_len, tag) != 0){
+            fprintf(stderr, "crypto_secretstream push failed\n");
+            break;
+        }
+        stats_add(STATS_CRYPT, t, n);
+        stats_count(STATS_CHUNKS, 1);
+        put_len(x.frame, (uint32_t)clen);
+        t = stats_now();
+        if (fwrite(x.frame, 1, FRAME_LEN + (size_t)clen, out) != FRAME_LEN + (size_t)clen){
+            perror("write chunk");
+            break;
+        }
+        stats_add(STATS_WRITE, t, FRAME_LEN + clen);
+        if (tag){ rc = 0; break; } // done after writing final chunk
+    }
+    io_close(&x);
+    return rc;
+}
+
+/* read_frame: read one length-prefixed sealed frame into x->frame.
+   Returns its length, or 0 on EOF, truncation or a bad length. */
+static size_t read_frame(codec_io_t *x, FILE *in){
+    const size_t fmax = 1 + x->cs + crypto_secretstream_xchacha20poly1305_ABYTES; // largest sealed message
+    size_t n = fread(x->frame, 1, FRAME_LEN, in);
+    if (n == FRAME_LEN){
+        size_t flen = get_len(x->frame);
+        if (flen < 1 + crypto_secretstream_xchacha20poly1305_ABYTES || flen > fmax){
+            fprintf(stderr, "decryption failed (corrupted data)\n");
+            return 0;
+        }
+        if (fread(x->frame, 1, flen, in) == flen) return flen;
+    }
+    if (ferror(in)) perror("fread");
+    else if (n == 0) fprintf(stderr, "decryption failed (stream ended before its FINAL chunk)\n");
+    else fprintf(stderr, "decryption failed (truncated stream)\n");
+    return 0;
+}
+
+/* stream_pull_codec: decrypt_stream_range for compressed files: pull the
+   frames after header `h` from `in` and write plaintext bytes
+   [off, off + len) to `out` (NULL: authenticate and decompress only).
+   Each chunk is authenticated before it is decompressed or written.
+   Returns 0 on success, -1 on failure. */
+int stream_pull_codec(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key,
+                      uint64_t off, uint64_t len){
+    crypto_secretstream_xchacha20poly1305_state st;
+    if (crypto_secretstream_xchacha20poly1305_init_pull(&st, h->ss_header, key) != 0){
+        fprintf(stderr, "secretstream init_pull failed\n");
+        return -1;
+    }
+    codec_io_t x;
+    if (io_open(&x, (int)STREAM_CODEC(h->flags), 0, h->chunk_size) != 0){ sodium_memzero(&st, sizeof st); return -1; }
+
+    const uint64_t end = (len > UINT64_MAX - off) ? UINT64_MAX : off + len; // window end (saturating)
+    uint64_t pos = 0; // plaintext offset of the current chunk
+    int rc = -1;
+    for (;;){
+        if (pos >= end){ rc = 0; break; } // window complete
+        uint64_t t = stats_now();
+        size_t flen = read_frame(&x, in);
+        if (flen == 0) break;
+        stats_add(STATS_READ, t, FRAME_LEN + flen);
+
+        unsigned long long mlen = 0ULL;
+        unsigned char tag = 0;
+        t = stats_now();
+        if (crypto_secretstream_xchacha20poly1305_pull(&st, x.raw, &mlen, &tag, x.frame, flen, h->raw, h->aad_len) != 0){
+            fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+            break;
+        }
+        const unsigned char *data = x.raw + 1;
+        size_t dlen = (size_t)mlen - 1;
+        if (x.raw[0] == CHUNK_PACKED){ // authenticated, now expand (bounded by chunk_size)
+            if (codec_decompress(&x.c, x.raw + 1, dlen, x.zip, x.cs, &dlen) != 0){
+                fprintf(stderr, "decryption failed (bad compressed chunk)\n");
+                break;
+            }
+            data = x.zip;
+        } else if (x.raw[0] != CHUNK_RAW){
+            fprintf(stderr, "decryption failed (corrupted data)\n");
+            break;
+        }
+        stats_add(STATS_CRYPT, t, dlen);
+        stats_count(STATS_CHUNKS, 1);
+
+        // Emit the part of this chunk that overlaps [off, end).
+        uint64_t lo = off > pos ? off - pos : 0; // first wanted byte in chunk
+        uint64_t hi = end - pos < dlen ? end - pos : dlen; // one past last wanted byte
+        if (!out) lo = hi; // verify: nothing to emit
+        t = stats_now();
+        if (lo < hi && fwrite(data + lo, 1, (size_t)(hi - lo), out) != (size_t)(hi - lo)){
+            perror("write chunk");
+            break;
+        }
+        if (lo < hi) stats_add(STATS_WRITE, t, hi - lo);
+        pos += dlen;
+        if (tag & crypto_secretstream_xchacha20poly1305_TAG_FINAL){ rc = 0; break; }
+    }
+    io_close(&x);
+    sodium_memzero(&st, sizeof st); // scrub stream state
+    return rc;
+}
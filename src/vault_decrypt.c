@@ -1,100 +1,188 @@
 #include "../include/header.h"
 
-/* decrypt_file: legacy whole-file decryption.
-   Reads entire ciphertext from `in_path`, validates header, derives a key with Argon2id,
-   decrypts with ChaCha20-Poly1305 (IETF), and writes plaintext to `out_path`.
-   Returns 0 on success, -1 on error. */
-int decrypt_file (const char *in_path, const char *out_path, char *pwd){
-    int rc = -1; // default to failure until we complete successfully
+/* simple_key: the SIMPL1 key for header `hdr`, Argon2id(pwd, salt) with the
+   moderate limits. It is exactly a session master key, so it comes from the
+   session cache (or `vault agent`) like the stream formats' keys. */
+static int simple_key(char *pwd, const simple_hdr_t *hdr, unsigned char key[crypto_kdf_KEYBYTES]){
+    return session_master_key(pwd, hdr->salt, (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE,
+                              (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024), key);
+}
 
-    unsigned char *enc = NULL; size_t elen = 0;
-    // Read entire input file into memory; on failure, scrub pwd and bail.
-    if (read_file(in_path, &enc, &elen) != 0) {  // read ciphertext file
-        sodium_memzero(pwd, strlen(pwd)); // scrub password before returning
-        return -1; 
-    }
-    
-    // Sanity check: file must at least contain the header.
-    if (elen < sizeof(simple_hdr_t)) {
+/* decrypt_file_mapped: decrypt_file on the mmap backend (--mmap). The input
+   is mapped read-only and the AEAD opens it straight into a mapped output
+   sized to the plaintext, so no whole-file heap copies are made. The output
+   only appears at out_path once it is complete. Returns 0 on success, -1 on
+   error. */
+static int decrypt_file_mapped(const char *in_path, const char *out_path, char *pwd){
+    int in_fd = open(in_path, O_RDONLY); // open input for mapping
+    if (in_fd < 0){ perror("open in"); return -1; }
+    vault_map_t im, om;
+    if (map_fd_input(in_fd, &im) != 0){ close(in_fd); return -1; }
+
+    simple_hdr_t hdr;
+    const size_t ab = crypto_aead_chacha20poly1305_ietf_ABYTES;
+    if (im.len < sizeof hdr + ab) { // header plus tag at minimum
         printf("File too small to be valid.\n");
-        sodium_memzero(pwd, strlen(pwd)); // scrub password
-        sodium_free(enc); // free ciphertext buffer
+        unmap_file(&im, 0); close(in_fd);
         return -1;
     }
-
-    simple_hdr_t hdr;
-    memcpy(&hdr, enc, sizeof hdr);  // copy header from start of buffer
-    // Validate magic to ensure we're dealing with our format.
+    memcpy(&hdr, im.base, sizeof hdr); // copy header from start of mapping
     if (memcmp(hdr.magic, MAGIC, sizeof MAGIC) != 0) {
         printf("Bad magic: not our format.\n");
-        sodium_memzero(pwd, strlen(pwd)); // scrub password
-        sodium_free(enc); // free ciphertext buffer
+        unmap_file(&im, 0); close(in_fd);
         return -1;
     }
-
-    unsigned char *cipher = enc + sizeof hdr; // ciphertext payload after header
-    size_t clen = elen - sizeof hdr; // ciphertext length without header
+    const size_t clen = im.len - sizeof hdr; // ciphertext length without header
 
     unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES];
-    // Derive encryption key from password and header salt (Argon2id with moderate limits).
-    if (crypto_pwhash(
-            key, sizeof key,
-            pwd, strlen(pwd),
-            hdr.salt,
-            crypto_pwhash_OPSLIMIT_MODERATE,
-            crypto_pwhash_MEMLIMIT_MODERATE,
-            crypto_pwhash_ALG_ARGON2ID13) != 0) {  // derive key with Argon2id
-
+    if (simple_key(pwd, &hdr, key) != 0) {  // Argon2id, cached per salt
         printf("crypto_pwhash failed (OOM)\n");
-        sodium_memzero(pwd, strlen(pwd)); // scrub password
-        sodium_free(enc); // free ciphertext buffer
+        unmap_file(&im, 0); close(in_fd);
         return -1;
     }
 
-    sodium_memzero(pwd, strlen(pwd)); // done with password; scrub it
-
-    // Compute maximum possible plaintext length (ciphertext minus AEAD tag).
-    size_t max_plen = (clen >= crypto_aead_chacha20poly1305_ietf_ABYTES)
-        ? (clen - crypto_aead_chacha20poly1305_ietf_ABYTES)
-        : 0;
-    unsigned char *plain = (unsigned char*)sodium_malloc(max_plen); // allocate plaintext buffer
-    if (!plain) { 
-        printf("Malloc Plain Failed\n"); 
-        sodium_memzero(key, sizeof key); // scrub key
-        sodium_free(enc); // free ciphertext buffer
-        return -1; 
+    int rc = -1; // default to failure
+    vault_out_t o; // temp output; mapping needs read+write
+    if (out_open(&o, out_path, 1) == 0 && map_fd_output(o.fd, clen - ab, &om) == 0) {
+        unsigned char empty[1]; // empty plaintext: nothing is mapped
+        // Verify-then-decrypt: nothing is written to the mapping unless the tag checks out.
+        if (crypto_aead_chacha20poly1305_ietf_decrypt(om.base ? om.base : empty, NULL, NULL,
+                im.base + sizeof hdr, (unsigned long long)clen, NULL, 0, hdr.nonce, key) != 0)
+            printf("Decryption FAILED (wrong password or tampered file).\n");
+        else
+            rc = 0;
+        if (unmap_file(&om, rc == 0 ? clen - ab : 0) != 0) rc = -1; // keep nothing on failure
     }
 
-    unsigned long long real_plen = 0ULL;
-    // Decrypt and authenticate; fails if password is wrong or data was tampered.
-    if (crypto_aead_chacha20poly1305_ietf_decrypt(
-            plain, &real_plen, 
-            NULL,
-            cipher, (unsigned long long)clen, 
-            NULL, 0, 
-            hdr.nonce,
-            key) != 0) {  // perform AEAD decryption/verification
+    sodium_memzero(key, sizeof key); // scrub key material
+    unmap_file(&im, 0);
+    close(in_fd);
+    if (rc == 0) rc = out_commit(&o); // fsync + rename; surfaces deferred write errors
+    else out_abort(&o);
+    return rc;
+}
+
+/* simple_pass: one pass over the `clen`-byte SIMPL1 payload at the current
+   position of `in` and the tag after it: recompute the tag and, when `out`
+   is set, decrypt every piece into it. Returns 0 if the stored tag matches,
+   -1 on a mismatch or error; `out` then holds unauthenticated bytes and
+   must be dropped. */
+static int simple_pass(FILE *in, FILE *out, uint64_t clen, const simple_hdr_t *hdr, const unsigned char *key,
+                       unsigned char *cbuf, unsigned char *pbuf){
+    crypto_onetimeauth_poly1305_state st;
+    if (simple_mac_begin(&st, hdr->nonce, key) != 0) return -1;
 
+    int rc = 0;
+    for (uint64_t off = 0; rc == 0 && off < clen; ){
+        size_t n = clen - off < SIMPLE_CHUNK ? (size_t)(clen - off) : SIMPLE_CHUNK; // next piece
+        uint64_t t = stats_now();
+        if (fread(cbuf, 1, n, in) != n){ printf("File Not Read Properly!\n"); rc = -1; break; }
+        stats_add(STATS_READ, t, n);
+        t = stats_now();
+        crypto_onetimeauth_poly1305_update(&st, cbuf, n);
+        if (out && simple_xor(pbuf, cbuf, n, off, hdr->nonce, key) != 0){ printf("Decryption Failed!\n"); rc = -1; }
+        stats_add(STATS_CRYPT, t, n);
+        t = stats_now();
+        if (rc == 0 && out && fwrite(pbuf, 1, n, out) != n){ perror("write"); rc = -1; }
+        if (out) stats_add(STATS_WRITE, t, n);
+        off += n;
+    }
+
+    unsigned char tag[crypto_aead_chacha20poly1305_ietf_ABYTES], want[sizeof tag];
+    simple_mac_end(&st, clen, tag); // also wipes the state
+    if (rc == 0 && fread(want, 1, sizeof want, in) != sizeof want){ printf("File Not Read Properly!\n"); rc = -1; }
+    if (rc == 0 && crypto_verify_16(tag, want) != 0){
         printf("Decryption FAILED (wrong password or tampered file).\n");
-        sodium_memzero(key, sizeof key); // scrub key
-        sodium_free(enc);  // free ciphertext buffer
-        sodium_free(plain); // free plaintext buffer
+        rc = -1;
+    }
+    return rc;
+}
+
+/* simple_write: pass 2 of decrypt_file. Decrypt the payload of `in` (read
+   from the start again) into a temp output; the tag is checked once more in
+   case the file changed after pass 1, and the output only appears at
+   `out_path` if it matches. Returns 0 or -1. */
+static int simple_write(FILE *in, const char *out_path, uint64_t clen, const simple_hdr_t *hdr,
+                        const unsigned char *key, unsigned char *cbuf, unsigned char *pbuf){
+    vault_out_t o;
+    FILE *out = out_open(&o, out_path, 0) == 0 ? out_stream(&o, "wb") : NULL; // temp next to out_path
+    if (!out){
+        printf("Could Not Open File!\n");
+        out_abort(&o);
+        return -1;
+    }
+    if (fseek(in, (long)sizeof *hdr, SEEK_SET) != 0 || // back to the first payload byte
+        simple_pass(in, out, clen, hdr, key, cbuf, pbuf) != 0){
+        out_abort(&o); // drop unauthenticated output
+        return -1;
+    }
+    return out_commit(&o); // fsync + rename
+}
+
+/* simple_open: decrypt_file on the SIMPL1 file open on `in`. */
+static int simple_open(FILE *in, const char *out_path, char *pwd){
+    const size_t ab = crypto_aead_chacha20poly1305_ietf_ABYTES;
+    simple_hdr_t hdr;
+    struct stat st;
+    // Sanity check: file must at least contain the header and the tag.
+    if (fstat(fileno(in), &st) != 0 || st.st_size < (off_t)(sizeof hdr + ab) ||
+        fread(&hdr, 1, sizeof hdr, in) != sizeof hdr){
+        printf("File too small to be valid.\n");
+        return -1;
+    }
+    // Validate magic to ensure we're dealing with our format.
+    if (memcmp(hdr.magic, MAGIC, sizeof MAGIC) != 0) {
+        printf("Bad magic: not our format.\n");
+        return -1;
+    }
+    const uint64_t clen = (uint64_t)st.st_size - sizeof hdr - ab; // ciphertext without the tag
+    if (clen > crypto_aead_chacha20poly1305_ietf_MESSAGEBYTES_MAX){
+        printf("File too large to be valid.\n");
         return -1;
     }
 
-    // Write the recovered plaintext to the output path.
-    if (write_file(out_path, plain, (size_t)real_plen) != 0) {  // write plaintext file
-        sodium_memzero(key, sizeof key); // scrub key
-        sodium_free(enc);  // free ciphertext buffer
-        sodium_free(plain); // free plaintext buffer
+    unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES];
+    // Derive encryption key from password and header salt (Argon2id with moderate limits).
+    if (simple_key(pwd, &hdr, key) != 0) {  // derive key with Argon2id
+        printf("crypto_pwhash failed (OOM)\n");
         return -1;
     }
 
-    sodium_memzero(key, sizeof key); // scrub key material
-    sodium_free(enc); // free ciphertext buffer
-    sodium_free(plain); // free plaintext buffer
+    // Two fixed-size buffers, whatever the file size.
+    unsigned char *cbuf = buf_alloc(SIMPLE_CHUNK, BUF_PLAIN); // ciphertext piece
+    unsigned char *pbuf = out_path ? buf_alloc(SIMPLE_CHUNK, BUF_SECRET) : NULL; // plaintext piece (locked)
+    int rc = -1; // default to failure
+    if (!cbuf || (out_path && !pbuf)){
+        printf("Malloc Plain Failed\n");
+    } else if (simple_pass(in, NULL, clen, &hdr, key, cbuf, NULL) == 0){ // pass 1: tag only
+        rc = out_path ? simple_write(in, out_path, clen, &hdr, key, cbuf, pbuf) : 0; // verify stops here
+    }
 
-    rc = 0; // success
+    sodium_memzero(key, sizeof key); // scrub key material
+    buf_free(cbuf);
+    buf_free(pbuf); // wiped on release
     return rc;
 }
 
+/* decrypt_file: legacy SIMPL1 decryption in constant memory.
+   Validates the header of `in_path`, derives a key with Argon2id, checks the
+   ChaCha20-Poly1305 (IETF) tag over the whole payload in a first pass, then
+   decrypts it SIMPLE_CHUNK bytes at a time into `out_path` in a second pass,
+   so no plaintext is written before the tag checks out.
+   With g_use_mmap the work is done on mapped files (decrypt_file_mapped).
+   A NULL `out_path` only authenticates the file (vault verify).
+   Returns 0 on success, -1 on error. */
+int decrypt_file (const char *in_path, const char *out_path, char *pwd){
+    if (g_use_mmap && out_path) return decrypt_file_mapped(in_path, out_path, pwd); // zero-copy backend
+
+    FILE *in = fopen(in_path, "rb"); // open ciphertext
+    if (!in){
+        printf("Error Opening File!\n");
+        return -1;
+    }
+    stats_count(STATS_SYS_OPEN, 1);
+    int rc = simple_open(in, out_path, pwd);
+    fclose(in);
+    stats_count(STATS_SYS_CLOSE, 1);
+    return rc;
+}
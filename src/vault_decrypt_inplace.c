@@ -12,7 +12,8 @@ int read_magic(const char *p, unsigned char out[6]){
 }
 
 /* decrypt_inplace: decrypt `in_path` to a sibling path with suffix `wanted_ext`
-   (default ".dec"); optionally deletes source if g_delete_on_success is set.
+   (default ".dec"); optionally deletes the source once the output is durable
+   if g_delete_on_success is set. With g_resume an up-to-date output is skipped.
    Supports legacy header (MAGIC) and streamed format autodetection. */
 int decrypt_inplace(const char *in_path, char *pwd, const char *wanted_ext) {
     // Guard: validate inputs.
@@ -28,24 +29,22 @@ int decrypt_inplace(const char *in_path, char *pwd, const char *wanted_ext) {
         strcat(out_path, ".out"); // disambiguate output filename
     }
 
+    // --resume: a finished output from an interrupted run is kept as is.
+    if (g_resume && resume_skip(in_path, out_path)){ stats_count(STATS_SKIPPED, 1); return 0; }
+
     unsigned char m[6];
     int rc;
+    // Opt-in deletion: the committer removes the source once the output is durable.
+    if (g_delete_on_success) commit_source(in_path);
+    stats_file_t *st = stats_file_begin(in_path); // --stats: per-file record
     // Branch: legacy SIMPL1 format uses old decryptor; otherwise use streaming.
     if (read_magic(in_path, m) == 0 && memcmp(m, MAGIC, 6) == 0)
         rc = decrypt_file(in_path, out_path, pwd); // legacy decrypt (AEAD ChaCha20-Poly1305)
     else
         rc = decrypt_file_stream(in_path, out_path, pwd); // streamed decrypt (secretstream)
-
-    // Post-decrypt: optionally delete source on success.
-    if (rc == 0) {
-        // If opt-in deletion is enabled, try to remove the input file.
-        if (g_delete_on_success) {   
-            if (safe_delete(in_path) != 0) // unlink source file
-                fprintf(stderr, "Warning: could not delete original file: %s\n", in_path); // warn if deletion fails
-        }
-        return 0; // success
-    }
-    return -1; // failure
+    stats_file_end(st, rc);
+    commit_source(NULL); // not consumed on failure
+    return rc == 0 ? 0 : -1;
 }
 
 
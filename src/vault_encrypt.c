@@ -1,17 +1,53 @@
 #include "../include/header.h"
 
-/* encrypt_file: legacy whole-file encryption.
+/* simple_seal: write the SIMPL1 payload of `in` to `out`: ChaCha20 (IETF)
+   SIMPLE_CHUNK bytes at a time, then the Poly1305 tag. Returns 0 or -1. */
+static int simple_seal(FILE *in, FILE *out, const simple_hdr_t *hdr, const unsigned char *key,
+                       unsigned char *pbuf, unsigned char *cbuf){
+    crypto_onetimeauth_poly1305_state st;
+    if (simple_mac_begin(&st, hdr->nonce, key) != 0) return -1;
+
+    int rc = 0;
+    uint64_t off = 0; // payload bytes sealed so far
+    for (;;){
+        uint64_t t = stats_now();
+        size_t n = fread(pbuf, 1, SIMPLE_CHUNK, in); // next piece (short only at EOF)
+        if (ferror(in)){ printf("File Not Read Properly!\n"); rc = -1; break; }
+        stats_add(STATS_READ, t, n);
+        if (n == 0) break;
+        if (off + n > crypto_aead_chacha20poly1305_ietf_MESSAGEBYTES_MAX){
+            printf("File too large for this format.\n");
+            rc = -1; break;
+        }
+        t = stats_now();
+        if (simple_xor(cbuf, pbuf, n, off, hdr->nonce, key) != 0){ printf("Encryption Failed!\n"); rc = -1; break; }
+        crypto_onetimeauth_poly1305_update(&st, cbuf, n);
+        stats_add(STATS_CRYPT, t, n);
+        t = stats_now();
+        if (fwrite(cbuf, 1, n, out) != n){ printf("Could Not Write To File!\n"); rc = -1; break; }
+        stats_add(STATS_WRITE, t, n);
+        off += n;
+        if (n < SIMPLE_CHUNK) break; // EOF
+    }
+
+    unsigned char tag[crypto_aead_chacha20poly1305_ietf_ABYTES];
+    simple_mac_end(&st, off, tag); // also wipes the state
+    if (rc == 0 && fwrite(tag, 1, sizeof tag, out) != sizeof tag){ printf("Could Not Write To File!\n"); rc = -1; }
+    return rc;
+}
+
+/* encrypt_file: legacy SIMPL1 encryption in constant memory.
    Reads plaintext from `in_path`, derives a key with Argon2id, encrypts with
-   ChaCha20-Poly1305 (IETF), prepends a simple header, and writes to `out_path`.
+   ChaCha20-Poly1305 (IETF) SIMPLE_CHUNK bytes at a time behind a simple
+   header, and writes to `out_path`, which only appears once complete.
    Returns 0 on success, -1 on error. */
 int encrypt_file (const char *in_path, const char *out_path, char *pwd) {
-    int rc = -1; // default to failure until we complete successfully
-
-    unsigned char *plain = NULL; size_t plen = 0;
-    if (read_file (in_path, &plain, &plen) != 0){ // read entire plaintext file into memory
-        sodium_memzero(pwd, strlen(pwd)); // scrub password on failure
+    FILE *in = fopen(in_path, "rb"); // open plaintext
+    if (!in){
+        printf("Error Opening File!\n");
         return -1;
     }
+    stats_count(STATS_SYS_OPEN, 1);
 
     simple_hdr_t hdr;
     memcpy(hdr.magic, MAGIC, sizeof(MAGIC)); // set magic identifier
@@ -19,6 +55,7 @@ int encrypt_file (const char *in_path, const char *out_path, char *pwd) {
     randombytes_buf(hdr.nonce, sizeof(hdr.nonce)); // generate AEAD nonce
 
     unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES];
+    uint64_t t = stats_now();
     // Derive key from password using Argon2id with moderate limits.
     if (crypto_pwhash(
             key, sizeof(key),
@@ -29,64 +66,32 @@ int encrypt_file (const char *in_path, const char *out_path, char *pwd) {
             crypto_pwhash_ALG_ARGON2ID13) != 0){ // key derivation (Argon2id)
 
         printf("Encryption Failed!\n");
-        sodium_memzero(pwd, strlen(pwd)); // scrub password
-        sodium_free(plain); // free plaintext buffer
-        return -1;
-    }
-
-    sodium_memzero(pwd, strlen(pwd)); // done with password; scrub it
-
-    size_t clen = plen + crypto_aead_chacha20poly1305_ietf_ABYTES; // ciphertext = plaintext + tag
-    unsigned char *cipher = sodium_malloc(clen); // allocate ciphertext buffer
-    if (!cipher){
-        printf("Malloc Failure!\n");
-        sodium_memzero(key, sizeof(key)); // scrub derived key
+        fclose(in); stats_count(STATS_SYS_CLOSE, 1);
         return -1;
     }
-    
-    unsigned long long real_clen = 0ULL;
-    // Encrypt and authenticate plaintext using AEAD (no AAD in this legacy format).
-    if (crypto_aead_chacha20poly1305_ietf_encrypt(
-            cipher, &real_clen,
-            plain, plen,
-            NULL, 0,
-            NULL,
-            hdr.nonce,
-            key) != 0){ // perform AEAD encryption
+    stats_add(STATS_KDF, t, 0);
 
-        printf("Encryption Failed!\n");
-        sodium_memzero(key, sizeof(key)); // scrub key
-        sodium_free(plain); // free plaintext buffer
-        sodium_free(cipher); // free ciphertext buffer
-        return -1;
-    }
-
-    size_t total_out = sizeof(hdr) + real_clen; // header + ciphertext size
-    unsigned char *outbuf = sodium_malloc(total_out); // allocate output buffer
-    if (!outbuf){
+    // Two fixed-size buffers, whatever the file size.
+    unsigned char *pbuf = buf_alloc(SIMPLE_CHUNK, BUF_SECRET); // plaintext piece (locked)
+    unsigned char *cbuf = buf_alloc(SIMPLE_CHUNK, BUF_PLAIN);  // ciphertext piece
+    vault_out_t o;
+    FILE *out = NULL;
+    int rc = -1; // default to failure until we complete successfully
+    if (!pbuf || !cbuf){
         printf("Malloc Failure!\n");
-        sodium_memzero(key, sizeof(key)); // scrub key
-        return -1;
-    }
-
-    memcpy(outbuf, &hdr, sizeof(hdr)); // write header at start of output
-    memcpy(outbuf + sizeof(hdr), cipher, real_clen); // append ciphertext after header
-
-    // Write the combined header+ciphertext to destination path.
-    if (write_file(out_path, outbuf, total_out) != 0){ // write output file
-        sodium_memzero(key, sizeof(key)); // scrub key
-        sodium_free(plain); // free plaintext buffer
-        sodium_free(cipher); // free ciphertext buffer
-        sodium_free(outbuf); // free output buffer
-        return -1;
+    } else if (out_open(&o, out_path, 0) != 0 || !(out = out_stream(&o, "wb"))){
+        printf("Could Not Open File!\n");
+        out_abort(&o);
+    } else if (fwrite(&hdr, 1, sizeof hdr, out) != sizeof hdr || simple_seal(in, out, &hdr, key, pbuf, cbuf) != 0){
+        out_abort(&o); // drop the temp; out_path is untouched
+    } else {
+        rc = out_commit(&o); // flush, sync and rename into place
     }
 
     sodium_memzero(key, sizeof key); // scrub key material
-    sodium_free(plain); // free plaintext buffer
-    sodium_free(cipher); // free ciphertext buffer
-    sodium_free(outbuf); // free output buffer
-
-    rc = 0; // success
+    buf_free(pbuf); // wiped on release
+    buf_free(cbuf);
+    fclose(in);
+    stats_count(STATS_SYS_CLOSE, 1);
     return rc;
 }
-
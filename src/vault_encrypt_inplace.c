@@ -1,7 +1,8 @@
 #include "../include/header.h"
 
 /* encrypt_inplace: encrypt `in_path` to a sibling file with ".enc" suffix using
-   streaming; optionally deletes the source if g_delete_on_success is set.
+   streaming; optionally deletes the source once the output is durable if
+   g_delete_on_success is set. With g_resume an up-to-date output is skipped.
    `garbage` is unused. Returns 0 on success, -1 on error. */
 int encrypt_inplace(const char *in_path, char *pwd, const char *garbage) {
     if (!in_path || !pwd) return -1; // guard: validate pointers
@@ -14,15 +15,14 @@ int encrypt_inplace(const char *in_path, char *pwd, const char *garbage) {
         if (build_path(in_path, ".enc", out_path, sizeof out_path) != 0) return -1; // rebuild output path
     }
 
+    // --resume: a finished output from an interrupted run is kept as is.
+    if (g_resume && resume_skip(in_path, out_path)){ stats_count(STATS_SKIPPED, 1); return 0; }
+    // Opt-in deletion: the committer removes the original once the .enc is durable.
+    if (g_delete_on_success) commit_source(in_path);
+    stats_file_t *st = stats_file_begin(in_path); // --stats: per-file record
     int rc = encrypt_file_stream(in_path, out_path, pwd); // stream-encrypt file into out_path
-    // On success, optionally delete the original file if user opted in.
-    if (rc == 0) {
-        if (g_delete_on_success) {  // opt-in deletion of source on success
-            if (safe_delete(in_path) != 0) // try to unlink original
-                fprintf(stderr, "Warning: could not delete original file: %s\n", in_path); // warn if deletion failed
-        }
-        return 0; // success
-    }
-    return -1; // failure
+    stats_file_end(st, rc);
+    commit_source(NULL); // not consumed on failure
+    return rc == 0 ? 0 : -1;
 }
 
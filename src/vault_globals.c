@@ -1,2 +1,15 @@
 #include "../include/header.h"
 int g_delete_on_success = 0;
+int g_jobs = 1;
+int g_use_mmap = 0;
+int g_uring_depth = 0;
+int g_pipeline = 0;
+uint32_t g_chunk_size = 0;
+int g_stats = 0;
+int g_walk_inode_order = 0;
+int g_codec = CODEC_NONE;
+int g_codec_level = 0;
+int g_cipher = CIPHER_AUTO;
+uint32_t g_kdf_opslimit = (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE;
+uint32_t g_kdf_mem_kib = (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024);
+int g_resume = 0;
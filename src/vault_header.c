@@ -0,0 +1,177 @@
+#include "../include/header.h"
+
+/* put_le16/put_le32/put_le64: store an unsigned integer little-endian at p. */
+static void put_le16(unsigned char *p, uint16_t v){
+    p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); // low byte first
+}
+static void put_le32(unsigned char *p, uint32_t v){
+    for (int i = 0; i < 4; ++i) p[i] = (unsigned char)(v >> (8 * i)); // low byte first
+}
+static void put_le64(unsigned char *p, uint64_t v){
+    for (int i = 0; i < 8; ++i) p[i] = (unsigned char)(v >> (8 * i)); // low byte first
+}
+
+/* get_le16/get_le32/get_le64: load a little-endian unsigned integer from p. */
+static uint16_t get_le16(const unsigned char *p){
+    return (uint16_t)(p[0] | (p[1] << 8)); // assemble low byte first
+}
+static uint32_t get_le32(const unsigned char *p){
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; // assemble from high byte down
+    return v;
+}
+static uint64_t get_le64(const unsigned char *p){
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; // assemble from high byte down
+    return v;
+}
+
+/* stream_hdr_prefix: serialize the current-version prefix of `h` (magic,
+   version, flags, chunk_size, plain_size) into `p`: the AAD of the payload
+   and of every key slot. Returns its length, STREAM_PREFIX_SIZE. */
+size_t stream_hdr_prefix(const stream_hdr_t *h, unsigned char p[STREAM_PREFIX_SIZE]){
+    unsigned char *q = p; // write cursor
+    memcpy(q, STREAM_MAGIC, sizeof(STREAM_MAGIC)); q += sizeof(STREAM_MAGIC); // magic
+    put_le16(q, STREAMSEAL_VERSION); q += 2; // format version
+    put_le32(q, h->flags);           q += 4; // layout flags
+    put_le32(q, h->chunk_size);      q += 4; // plaintext bytes per chunk
+    put_le64(q, h->plain_size);      q += 8; // total plaintext (chunked layout)
+    return (size_t)(q - p);
+}
+
+/* stream_hdr_encode: serialize the current-version fields of `h` into h->raw
+   and set raw_len/aad_len. Returns 0 on success, -1 on unsupported version. */
+int stream_hdr_encode(stream_hdr_t *h){
+    if (!h || h->version != STREAMSEAL_VERSION) return -1; // only the current format is ever written
+
+    unsigned char *p = h->raw; // write cursor
+    p += stream_hdr_prefix(h, p); // magic .. plain_size
+    h->aad_len = (size_t)(p - h->raw); // everything so far is authenticated as AAD
+    memcpy(p, h->ss_header, sizeof h->ss_header); p += sizeof h->ss_header; // secretstream header
+    for (int i = 0; i < STREAM_KEY_SLOTS; ++i){
+        const stream_slot_t *s = &h->slots[i];
+        put_le32(p, s->kdf_mem_kib);  p += 4; // Argon2id memory (KiB)
+        put_le32(p, s->kdf_opslimit); p += 4; // Argon2id passes (0: empty)
+        memcpy(p, s->salt, sizeof s->salt);       p += sizeof s->salt;    // password salt
+        memcpy(p, s->nonce, sizeof s->nonce);     p += sizeof s->nonce;   // wrap nonce
+        memcpy(p, s->wrapped, sizeof s->wrapped); p += sizeof s->wrapped; // sealed payload key
+    }
+    h->raw_len = (size_t)(p - h->raw); // total bytes on disk
+    assert(h->raw_len == STREAM_HDR_SIZE); // layout must match the documented size
+    return 0;
+}
+
+/* stream_hdr_len: full header length announced by the first 8 bytes
+   (magic + version), or 0 if they are not a StreamSeal stream header. */
+static size_t stream_hdr_len(const unsigned char *p){
+    if (memcmp(p, STREAM_MAGIC, sizeof(STREAM_MAGIC)) != 0) return 0; // not StreamSeal
+    uint16_t version = get_le16(p + 6); // v2+ are little-endian
+    if (version == STREAMSEAL_VERSION) return STREAM_HDR_SIZE;
+    if (version == STREAMSEAL_VERSION_V3) return STREAM_HDR_V3_SIZE;
+    if (version == STREAMSEAL_VERSION_V2) return STREAM_HDR_V3_SIZE - 16; // v2 lacks flags/sizes
+    stream_hdr_v1_t v1;
+    memcpy(&v1, p, 8); // v1 stored the version in host order
+    return v1.version == STREAMSEAL_VERSION_V1 ? sizeof v1 : 0;
+}
+
+/* layout_ok: non-zero if the v3+ flags and chunk size of `h` are ones this
+   build writes: known flag bits, a known codec on a plain secretstream, a
+   known cipher suite on the chunked layout, and a chunk size inside the
+   allocation bounds. */
+static int layout_ok(const stream_hdr_t *h){
+    const uint32_t known = STREAM_FLAG_CHUNKED | STREAM_FLAG_PACK | STREAM_CODEC_MASK | STREAM_CIPHER_MASK;
+    if ((h->flags & ~known) != 0) return 0; // unknown flag bits
+    if ((h->flags & STREAM_FLAG_CHUNKED) && (h->flags & STREAM_FLAG_PACK)) return 0; // packs are secretstreams
+    if (STREAM_CODEC(h->flags) >= CODEC_COUNT) return 0; // unknown codec
+    if (STREAM_CODEC(h->flags) && (h->flags & (STREAM_FLAG_CHUNKED | STREAM_FLAG_PACK))) return 0; // secretstream files only
+    if (STREAM_CIPHER(h->flags) >= CIPHER_COUNT) return 0; // unknown cipher suite
+    if (STREAM_CIPHER(h->flags) && !(h->flags & STREAM_FLAG_CHUNKED)) return 0; // secretstream is XChaCha20 only
+    return h->chunk_size >= STREAM_CHUNK_MIN && h->chunk_size <= STREAM_CHUNK_MAX; // bounds allocations
+}
+
+/* stream_hdr_parse: parse a streamed header from the first `len` bytes of
+   `buf` (the header alone or a whole file in memory).
+   Accepts the legacy v1 raw struct, the v2/v3 little-endian layouts and the
+   v4 key-slot layout;
+   fills `h` including the raw bytes needed to rebind the AAD.
+   Argon2id limits beyond kdf_limits_ok are refused here, before any caller
+   stretches a password with them.
+   Returns 0 on success, -1 if too short, bad magic/version or limits. */
+int stream_hdr_parse(const unsigned char *buf, size_t len, stream_hdr_t *h){
+    memset(h, 0, sizeof *h); // start from a clean header
+    if (len < 8) return -1; // no room for magic + version
+    size_t need = stream_hdr_len(buf);
+    if (need == 0 || len < need) return -1; // unknown or short header
+    memcpy(h->raw, buf, need); // keep exact bytes for the AAD
+    unsigned char *p = h->raw; // parse cursor
+
+    uint16_t version = get_le16(p + 6); // format version
+    if (version == STREAMSEAL_VERSION) {
+        h->version = version;
+        p += 8;
+        h->flags      = get_le32(p); p += 4; // layout flags
+        h->chunk_size = get_le32(p); p += 4; // plaintext bytes per chunk
+        h->plain_size = get_le64(p); p += 8; // total plaintext (chunked layout)
+        if (!layout_ok(h)) return -1;
+        h->aad_len = (size_t)(p - h->raw); // AAD ends before ss_header
+        memcpy(h->ss_header, p, sizeof h->ss_header); p += sizeof h->ss_header; // secretstream header
+        for (int i = 0; i < STREAM_KEY_SLOTS; ++i){
+            stream_slot_t *s = &h->slots[i];
+            s->kdf_mem_kib  = get_le32(p); p += 4; // Argon2id memory (KiB)
+            s->kdf_opslimit = get_le32(p); p += 4; // Argon2id passes (0: empty)
+            memcpy(s->salt, p, sizeof s->salt);       p += sizeof s->salt;    // password salt
+            memcpy(s->nonce, p, sizeof s->nonce);     p += sizeof s->nonce;   // wrap nonce
+            memcpy(s->wrapped, p, sizeof s->wrapped); p += sizeof s->wrapped; // sealed payload key
+            if (s->kdf_opslimit && !kdf_limits_ok(s->kdf_opslimit, s->kdf_mem_kib)) return -1; // bounds Argon2id
+        }
+        h->raw_len = (size_t)(p - h->raw);
+        return 0;
+    }
+    if (version == STREAMSEAL_VERSION_V3 || version == STREAMSEAL_VERSION_V2) {
+        h->version = version;
+        p += 8;
+        h->kdf_mem_kib  = get_le32(p); p += 4; // Argon2id memory (KiB)
+        h->kdf_opslimit = get_le32(p); p += 4; // Argon2id passes
+        memcpy(h->salt, p, sizeof h->salt); p += sizeof h->salt; // run salt
+        h->file_id = get_le64(p); p += 8; // per-file subkey id
+        h->chunk_size = STREAM_CHUNK; // v2 implied size
+        if (version >= 3) {
+            h->flags      = get_le32(p); p += 4; // layout flags
+            h->chunk_size = get_le32(p); p += 4; // plaintext bytes per chunk
+            h->plain_size = get_le64(p); p += 8; // total plaintext (chunked layout)
+            if (!layout_ok(h)) return -1;
+        }
+        if (!kdf_limits_ok(h->kdf_opslimit, h->kdf_mem_kib)) return -1; // bounds Argon2id
+        h->aad_len = (size_t)(p - h->raw); // AAD ends before ss_header
+        memcpy(h->ss_header, p, sizeof h->ss_header); p += sizeof h->ss_header; // secretstream header
+        h->raw_len = (size_t)(p - h->raw);
+        return 0;
+    }
+
+    // Legacy v1: raw host-order struct, AAD up to ss_header.
+    stream_hdr_v1_t v1;
+    memcpy(&v1, p, sizeof v1); // reinterpret as legacy struct
+    h->version      = STREAMSEAL_VERSION_V1;
+    h->chunk_size   = STREAM_CHUNK;
+    h->kdf_mem_kib  = v1.kdf_mem_kib;
+    h->kdf_opslimit = v1.kdf_opslimit;
+    memcpy(h->salt, v1.salt, sizeof h->salt);
+    memcpy(h->ss_header, v1.ss_header, sizeof h->ss_header);
+    if (!kdf_limits_ok(h->kdf_opslimit, h->kdf_mem_kib)) return -1; // bounds Argon2id
+    h->aad_len = offsetof(stream_hdr_v1_t, ss_header); // same AAD as the v1 writer used
+    h->raw_len = sizeof v1;
+    return 0;
+}
+
+/* stream_hdr_read: read exactly one streamed header from `in` and parse it
+   with stream_hdr_parse, leaving `in` at the first payload byte.
+   Returns 0 on success, -1 on short read or bad magic/version. */
+int stream_hdr_read(FILE *in, stream_hdr_t *h){
+    unsigned char buf[STREAM_HDR_MAX];
+    memset(h, 0, sizeof *h); // callers may inspect h even on failure
+    if (fread(buf, 1, 8, in) != 8) return -1; // short or missing header
+    size_t need = stream_hdr_len(buf); // magic + version decide how much more to read
+    if (need == 0) return -1; // not StreamSeal
+    if (fread(buf + 8, 1, need - 8, in) != need - 8) return -1; // rest of header
+    return stream_hdr_parse(buf, need, h);
+}
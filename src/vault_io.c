@@ -1,9 +1,16 @@
 #include "../include/header.h"
 
-/* read_file: read any file at `path` into a newly-allocated buffer.
-   On success, sets *buff to sodium_malloc'd data and *len to its size.
-   Returns 0 on success, -1 on failure. */
+/* read_file: read any file at `path` into a locked pool buffer (see
+   read_file_as; the contents may be plaintext). */
 int read_file (const char*path, unsigned char **buff, size_t *len){
+    return read_file_as(path, buff, len, BUF_SECRET);
+}
+
+/* read_file_as: read any file at `path` into a newly-allocated buffer from
+   the pool, locked if `secret` (BUF_SECRET) and plain heap for ciphertext
+   (BUF_PLAIN). On success, sets *buff to the data (release with buf_free)
+   and *len to its size. Returns 0 on success, -1 on failure. */
+int read_file_as(const char *path, unsigned char **buff, size_t *len, int secret){
     *buff = NULL; *len = 0; // initialize outputs to safe defaults
 
     FILE *fptr = fopen(path, "rb"); // open file for binary reading
@@ -35,32 +42,26 @@ int read_file (const char*path, unsigned char **buff, size_t *len){
         return -1;
     }
 
-    // Allocate buffer (at least 1 byte to avoid zero-sized allocation).
-    if (fileSize > 0){
-        *buff = sodium_malloc((size_t)fileSize); // allocate buffer for file content
-        if (!*buff){ // check for allocation failure
-            printf("Could Not Malloc!\n");
-            fclose(fptr); // close file handle
-            return -1;
-        }
-    } else {
-        *buff = sodium_malloc(1); // allocate minimal buffer for empty file
-        if (!*buff){ // check for allocation failure
-            printf("Could Not Malloc!\n");
-            fclose(fptr); // close file handle
-            return -1;
-        }
+    // Allocate buffer (the pool hands out at least one page, even for empty files).
+    *buff = buf_alloc((size_t)fileSize, secret); // allocate buffer for file content
+    if (!*buff){ // check for allocation failure
+        printf("Could Not Malloc!\n");
+        fclose(fptr); // close file handle
+        return -1;
     }
-    
+
     // Read the entire file content into the buffer.
+    uint64_t t = stats_now();
     size_t numRead = fread(*buff, 1, (size_t)fileSize, fptr); // read file bytes
     if (numRead != (size_t)fileSize){ // verify full read
         printf("File Not Read Properly!\n");
         fclose(fptr); // close file handle
-        sodium_free(*buff); // free allocated buffer on failure
+        buf_free(*buff); // free allocated buffer on failure
+        *buff = NULL;
         return -1;
     }
 
+    stats_add(STATS_READ, t, numRead);
     fclose(fptr); // close file after successful read
     *len = numRead; // report number of bytes read
     return 0; // success
@@ -68,26 +69,30 @@ int read_file (const char*path, unsigned char **buff, size_t *len){
 
 
 /* write_file: write `len` bytes from `buf` to a binary file at `path`.
-   Overwrites or creates the file. Returns 0 on success, -1 on failure. */
+   Creates or atomically replaces the file (temp + fsync + rename).
+   Returns 0 on success, -1 on failure. */
 int write_file(const char *path, const unsigned char *buf, size_t len){
 
-    FILE* fptr = fopen(path, "wb"); // open file for binary writing
+    vault_out_t o;
+    FILE* fptr = out_open(&o, path, 0) == 0 ? out_stream(&o, "wb") : NULL; // temp next to path
     // If open fails, bail.
     if (fptr == NULL){
         printf("Could Not Open File!\n");
+        out_abort(&o);
         return -1;
     }
 
+    uint64_t t = stats_now();
     size_t numWritten = fwrite(buf, 1, len, fptr); // write all bytes
     // Validate that the full buffer was written.
     if (numWritten != len){ // ensure complete write
         printf("Could Not Write To File!\n");
-        fclose(fptr); // close file handle
+        out_abort(&o); // drop the temp; path is untouched
         return -1;
     }
 
-    fclose(fptr); // close on success
-    return 0; // success
+    stats_add(STATS_WRITE, t, len);
+    return out_commit(&o); // flush, sync and rename into place
 }
 
 /* write_file_atomic_0600: atomically write `len` bytes from `buf` to `path`
@@ -162,3 +167,21 @@ int write_file_atomic_0600(const char *path, const unsigned char *buf, size_t le
     return 0; // success
 }
 
+/* make_parents: create the missing directories of `path` below its first
+   `keep` bytes (the destination). Existing components must be real
+   directories, so a symlink in the destination cannot redirect a file. */
+int make_parents(char *path, size_t keep){
+    for (char *s = path + keep + 1; (s = strchr(s, '/')) != NULL; ++s){
+        *s = '\0';
+        struct stat st;
+        int rc = mkdir(path, 0700);
+        if (rc != 0 && errno == EEXIST && lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) rc = 0;
+        if (rc != 0){
+            if (errno == EEXIST) errno = ENOTDIR;
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        }
+        *s = '/';
+        if (rc != 0) return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "../include/header.h"
+
+#include <time.h>
+
+/* Argon2id cost profile (`vault calibrate`, --kdf-profile).
+
+   New key slots, init-user's password hash and rekey's new slots use
+   g_kdf_opslimit / g_kdf_mem_kib. They default to libsodium's MODERATE
+   limits; a profile written by `vault calibrate` replaces them with limits
+   measured on this host. Files record the limits they were sealed with, so
+   decrypt never needs the profile. The profile is a text file of
+   "key value" lines:
+
+     target_ms 500        latency calibrate aimed for
+     mem_cap_kib 1048576  memory budget it was given
+     opslimit 4           Argon2id passes
+     mem_kib 1048576      Argon2id memory
+     measured_ms 486      one stretch at these limits, when measured */
+
+/* elapsed_ms: milliseconds since `t0` on the monotonic clock. */
+static uint32_t elapsed_ms(const struct timespec *t0){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    double ms = (double)(t.tv_sec - t0->tv_sec) * 1e3 + (double)(t.tv_nsec - t0->tv_nsec) / 1e6;
+    return ms < 1.0 ? 1u : (uint32_t)ms; // never 0: callers divide by it
+}
+
+/* kdf_time: wall time of one Argon2id stretch at (`opslimit`, `mem_kib`).
+   Returns the milliseconds, or 0 if the stretch failed (out of memory). */
+static uint32_t kdf_time(uint32_t opslimit, uint32_t mem_kib){
+    static const char pw[] = "vault calibrate";
+    unsigned char key[crypto_kdf_KEYBYTES], salt[crypto_pwhash_SALTBYTES];
+    randombytes_buf(salt, sizeof salt);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (crypto_pwhash(key, sizeof key, pw, sizeof pw - 1, salt, (unsigned long long)opslimit,
+                      (size_t)mem_kib * 1024ULL, crypto_pwhash_ALG_ARGON2ID13) != 0) return 0;
+    uint32_t ms = elapsed_ms(&t0);
+    sodium_memzero(key, sizeof key);
+    return ms;
+}
+
+/* profile_ok: non-zero if the limits suit new keys: ones any reader
+   accepts (kdf_limits_ok) with at least KDF_MEM_MIN_KIB of memory. */
+static int profile_ok(uint64_t opslimit, uint64_t mem_kib){
+    return mem_kib >= KDF_MEM_MIN_KIB && kdf_limits_ok(opslimit, mem_kib);
+}
+
+/* kdf_mem_default: default memory cap for calibrate: an eighth of the
+   physical RAM, at most KDF_MEM_CAP_KIB and at least KDF_MEM_MIN_KIB. */
+uint32_t kdf_mem_default(void){
+    uint64_t kib = KDF_MEM_CAP_KIB;
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long pages = sysconf(_SC_PHYS_PAGES), psz = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && psz > 0){
+        uint64_t ram = (uint64_t)pages * (uint64_t)psz / 1024 / 8; // 1/8 of RAM, in KiB
+        if (ram < kib) kib = ram;
+    }
+#endif
+    return (uint32_t)(kib < KDF_MEM_MIN_KIB ? KDF_MEM_MIN_KIB : kib);
+}
+
+/* kdf_calibrate: measure Argon2id on this host and pick limits for one
+   stretch of about `target_ms` using at most `mem_cap_kib` of memory.
+   Memory is the stronger cost, so one pass over as much memory as fits the
+   target comes first (down to KDF_MEM_MIN_KIB); if the whole cap fits with
+   time to spare, extra passes use it up. Each step rescales from the last
+   measurement, since page faults make the cost less than linear. Fills
+   `p`, including the time measured at the chosen limits. Returns 0 on
+   success, -1 if Argon2id cannot run (out of memory). */
+int kdf_calibrate(uint32_t target_ms, uint32_t mem_cap_kib, kdf_profile_t *p){
+    const uint32_t cap = mem_cap_kib / 1024 * 1024, slack = target_ms / 10; // whole MiB, ±10%
+    uint32_t mem = cap, ops = crypto_pwhash_OPSLIMIT_MIN;
+    if (target_ms == 0 || !profile_ok(ops, mem)) return -1;
+
+    uint32_t ms = kdf_time(ops, mem);
+    for (int i = 0; i < 6 && ms > 0 && (ms > target_ms + slack || ms + slack < target_ms); ++i){
+        uint64_t m = (uint64_t)mem * target_ms / ms / 1024 * 1024; // one pass, rescaled memory
+        if (m < KDF_MEM_MIN_KIB) m = KDF_MEM_MIN_KIB;
+        if (m > cap) m = cap;
+        if (m == mem) break; // at a bound
+        mem = (uint32_t)m;
+        ms = kdf_time(ops, mem);
+    }
+    for (int i = 0; i < 4 && ms > 0 && ms + slack < target_ms; ++i){ // the cap fits: add passes
+        uint64_t n = (uint64_t)ops * target_ms / ms;
+        if (n > KDF_OPSLIMIT_MAX) n = KDF_OPSLIMIT_MAX;
+        if (n <= ops) break;
+        ops = (uint32_t)n;
+        ms = kdf_time(ops, mem);
+    }
+    if (ms > target_ms + target_ms / 4 && ops > crypto_pwhash_OPSLIMIT_MIN){ // overshot: one pass fewer
+        --ops;
+        ms = kdf_time(ops, mem);
+    }
+    if (ms == 0) return -1;
+
+    memset(p, 0, sizeof *p);
+    p->target_ms   = target_ms;
+    p->mem_cap_kib = mem_cap_kib;
+    p->opslimit    = ops;
+    p->mem_kib     = mem;
+    p->measured_ms = ms;
+    return 0;
+}
+
+/* kdf_profile_write: write profile `p` to `path` atomically (0600).
+   Returns 0 on success, -1 on failure. */
+int kdf_profile_write(const char *path, const kdf_profile_t *p){
+    char buf[256];
+    int n = snprintf(buf, sizeof buf,
+                     "# Argon2id limits for new keys (vault calibrate)\n"
+                     "target_ms %u\nmem_cap_kib %u\nopslimit %u\nmem_kib %u\nmeasured_ms %u\n",
+                     (unsigned)p->target_ms, (unsigned)p->mem_cap_kib, (unsigned)p->opslimit,
+                     (unsigned)p->mem_kib, (unsigned)p->measured_ms);
+    if (n < 0 || (size_t)n >= sizeof buf) return -1;
+    if (write_file_atomic_0600(path, (const unsigned char *)buf, (size_t)n) != 0){ perror(path); return -1; }
+    return 0;
+}
+
+/* kdf_profile_read: parse the profile at `path` into `p`. Unknown keys
+   and '#' comments are ignored; opslimit and mem_kib are required and
+   must be limits new keys may use (profile_ok). Returns 0, or -1 (with a message). */
+int kdf_profile_read(const char *path, kdf_profile_t *p){
+    FILE *f = fopen(path, "r");
+    if (!f){ perror(path); return -1; }
+    memset(p, 0, sizeof *p);
+    char line[256], key[32];
+    unsigned long long v;
+    int bad = 0;
+    while (fgets(line, sizeof line, f)){
+        if (line[0] == '#' || line[0] == '\n') continue; // comment, blank line
+        if (sscanf(line, "%31s %llu", key, &v) != 2 || v > UINT32_MAX){ bad = 1; break; }
+        if      (strcmp(key, "target_ms") == 0)   p->target_ms   = (uint32_t)v;
+        else if (strcmp(key, "mem_cap_kib") == 0) p->mem_cap_kib = (uint32_t)v;
+        else if (strcmp(key, "opslimit") == 0)    p->opslimit    = (uint32_t)v;
+        else if (strcmp(key, "mem_kib") == 0)     p->mem_kib     = (uint32_t)v;
+        else if (strcmp(key, "measured_ms") == 0) p->measured_ms = (uint32_t)v;
+    }
+    fclose(f);
+    if (bad || !profile_ok(p->opslimit, p->mem_kib)){
+        fprintf(stderr, "%s: not a valid KDF profile\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* kdf_profile_load: set g_kdf_opslimit / g_kdf_mem_kib for this run.
+   `spec` is "interactive", "moderate" or "sensitive" (libsodium's presets)
+   or a profile path; NULL means KDF_PROFILE_FILE if it exists, else the
+   MODERATE defaults. Returns 0, or -1 if the profile cannot be used. */
+int kdf_profile_load(const char *spec){
+    static const struct { const char *name; unsigned long long ops; size_t mem; } presets[] = {
+        { "interactive", crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE },
+        { "moderate",    crypto_pwhash_OPSLIMIT_MODERATE,    crypto_pwhash_MEMLIMIT_MODERATE },
+        { "sensitive",   crypto_pwhash_OPSLIMIT_SENSITIVE,   crypto_pwhash_MEMLIMIT_SENSITIVE },
+    };
+    if (spec){
+        for (size_t i = 0; i < sizeof presets / sizeof presets[0]; ++i){
+            if (strcmp(spec, presets[i].name) != 0) continue;
+            g_kdf_opslimit = (uint32_t)presets[i].ops;
+            g_kdf_mem_kib  = (uint32_t)(presets[i].mem / 1024);
+            return 0;
+        }
+    }
+    const char *path = spec ? spec : KDF_PROFILE_FILE;
+    if (!spec && access(path, F_OK) != 0) return 0; // no profile: keep the defaults
+    kdf_profile_t p;
+    if (kdf_profile_read(path, &p) != 0) return -1;
+    g_kdf_opslimit = p.opslimit;
+    g_kdf_mem_kib  = p.mem_kib;
+    return 0;
+}
@@ -1,5 +1,30 @@
 #include "../include/header.h"
 
+/* user_set_password: (re)write the credential file "user.pass" with an
+   Argon2id hash of `pwd` at the KDF profile's limits, atomically with 0600
+   permissions.
+   Returns 0 on success, -1 on error. */
+int user_set_password(const char *pwd){
+    char hashed[crypto_pwhash_STRBYTES]; // storage for Argon2id hash string
+
+    // Derive password hash with Argon2id; bail on failure (e.g., OOM).
+    if (crypto_pwhash_str(hashed, pwd, strlen(pwd),
+                          (unsigned long long)g_kdf_opslimit,
+                          (size_t)g_kdf_mem_kib * 1024ULL) != 0){ // hash password with Argon2id
+        printf("Could Not Create Hash!\n");
+        return -1;
+    }
+
+    // Atomically write the hash to disk with strict perms.
+    if (write_file_atomic_0600("user.pass", (const unsigned char *)hashed, strlen(hashed)) != 0){ // atomic 0600 write
+        sodium_memzero(hashed, sizeof(hashed)); // scrub hash buffer
+        perror("write_file_atomic_0600"); // surface errno reason
+        return -1;
+    }
+    sodium_memzero(hashed, sizeof(hashed)); // scrub hash buffer
+    return 0;
+}
+
 /* init_user: create a new credential file "user.pass" with an Argon2id-hashed
    password, written atomically with 0600 permissions. Returns 0 on success, -1 on error. */
 int init_user(void){
@@ -10,35 +35,21 @@ int init_user(void){
         return 0;
     }
 
-    char pwd[1024];  // password input buffer
-    char hashed[crypto_pwhash_STRBYTES]; // storage for Argon2id hash string
+    char pwd[PASSWORD_MAX];  // password input buffer
 
     // Prompt for password (with confirmation); fail on input error.
     if (prompt_password("Create Password: ", pwd, sizeof(pwd), 1) != 0) return -1; // read & confirm password
 
-    // Derive password hash with Argon2id; bail on failure (e.g., OOM).
-    if (crypto_pwhash_str(hashed, pwd, strlen(pwd),
-                          crypto_pwhash_OPSLIMIT_MODERATE,
-                          crypto_pwhash_MEMLIMIT_MODERATE) != 0){ // hash password with Argon2id
-        printf("Could Not Create Hash!\n");
-        sodium_memzero(pwd, sizeof(pwd)); // scrub plaintext password
-        return -1;
-    }
+    int rc = user_set_password(pwd); // hash + atomic 0600 write
     sodium_memzero(pwd, sizeof(pwd)); // scrub plaintext password after hashing
-
-    // Atomically write the hash to disk with strict perms.
-    if (write_file_atomic_0600(path, (const unsigned char *)hashed, strlen(hashed)) != 0){ // atomic 0600 write
-        sodium_memzero(hashed, sizeof(hashed)); // scrub hash buffer
-        perror("write_file_atomic_0600"); // surface errno reason
-        return -1;
-    }
-    sodium_memzero(hashed, sizeof(hashed)); // scrub hash buffer
+    if (rc != 0) return -1;
 
     printf("User Created\n"); // success feedback
     return 0;
 }
 
 /* login_user: verify a password against the stored Argon2id hash in "user.pass".
+   `pwd` must hold PASSWORD_MAX bytes; it receives the password.
    Returns 0 on success, -1 on failure (not initialized, bad input, or mismatch). */
 int login_user(char *pwd){
     unsigned char *filebuf = NULL; const char *path = "user.pass"; size_t filelen = 0; // Initialize Variables
@@ -55,39 +66,41 @@ int login_user(char *pwd){
 
     // Load the stored hash string into memory.
     if (read_file(path, &filebuf, &filelen) != 0){ // read password file
-        printf("User not initialized yet!\n");
+        fprintf(stderr, "User not initialized yet!\n"); // stderr: stdout may carry plaintext (cat)
         return -1;
     }
 
     // Allocate a NUL-terminated copy (crypto_pwhash_str_verify expects a C string).
-    unsigned char *filebuf2 = sodium_malloc(filelen+1); // +1 for NUL
+    unsigned char *filebuf2 = buf_alloc(filelen+1, BUF_SECRET); // +1 for NUL
     if (!filebuf2){
-        printf("Malloc Failed!\n");
-        sodium_free(filebuf); // free original buffer
+        fprintf(stderr, "Malloc Failed!\n");
+        buf_free(filebuf); // free original buffer
         return -1;
     }
     memcpy(filebuf2, filebuf, filelen); // copy hash bytes
     filebuf2[filelen] = '\0'; // ensure NUL termination
-    sodium_free(filebuf); // discard original buffer
+    buf_free(filebuf); // discard original buffer
     filebuf = filebuf2; // use the NUL-terminated buffer
 
     // Prompt for password (no confirmation).
-    if (prompt_password("Enter Password: ", pwd, sizeof(pwd), 0) != 0){ // read password
-        sodium_free(filebuf); // free hash buffer
+    if (prompt_password("Enter Password: ", pwd, PASSWORD_MAX, 0) != 0){ // read password
+        buf_free(filebuf); // free hash buffer
         return -1;
     }
 
     // Verify password against the stored hash.
+    uint64_t t = stats_now(); // --stats: time the verify, not the prompt
     int success = crypto_pwhash_str_verify((const char *)filebuf, pwd, strlen(pwd)); // verify Argon2id hash
+    stats_add(STATS_LOGIN, t, 0);
 
-    sodium_free(filebuf); // free hash buffer
+    buf_free(filebuf); // free hash buffer
 
     // Branch: success is 0 when verification passes.
     if (success == 0){
-        printf("Login Success\n");
+        fprintf(stderr, "Login Success\n");
         return 0; // Success
     } else {
-        printf("Login Failed\n");
+        fprintf(stderr, "Login Failed\n");
         return -1;
     }
 }
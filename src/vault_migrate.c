@@ -0,0 +1,141 @@
+#include "../include/header.h"
+
+/* migrate_seal: the fused pipeline of migrate_file. Each chunk of the
+   `clen`-byte SIMPL1 payload on `in` goes into the SIMPL1 tag, is decrypted
+   into locked memory and sealed straight into the secretstream `st` of
+   header `h` on `out`; the last one carries the FINAL tag. Plaintext only
+   ever exists one chunk at a time, in memory. The stored SIMPL1 tag is
+   checked at the end, so `out` must be dropped unless this returns 0.
+   Returns 0 or -1. */
+static int migrate_seal(FILE *in, FILE *out, uint64_t clen, const simple_hdr_t *sh, const unsigned char *skey,
+                        const stream_hdr_t *h, crypto_secretstream_xchacha20poly1305_state *st,
+                        unsigned char *cbuf, unsigned char *pbuf, unsigned char *sbuf){
+    crypto_onetimeauth_poly1305_state mac;
+    if (simple_mac_begin(&mac, sh->nonce, skey) != 0) return -1;
+
+    int rc = 0;
+    const size_t cs = h->chunk_size; // a SIMPLE_BLOCK multiple (see migrate_file)
+    uint64_t off = 0;
+    do {
+        size_t n = clen - off < cs ? (size_t)(clen - off) : cs; // short only for the last chunk
+        uint64_t t = stats_now();
+        if (fread(cbuf, 1, n, in) != n){ fprintf(stderr, "short read\n"); rc = -1; break; }
+        stats_add(STATS_READ, t, n);
+        t = stats_now();
+        crypto_onetimeauth_poly1305_update(&mac, cbuf, n);
+        unsigned char tag = off + n == clen ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0;
+        unsigned long long slen = 0ULL;
+        if (simple_xor(pbuf, cbuf, n, off, sh->nonce, skey) != 0 ||
+            crypto_secretstream_xchacha20poly1305_push(st, sbuf, &slen, pbuf, n, h->raw, h->aad_len, tag) != 0){
+            fprintf(stderr, "re-encryption failed\n");
+            rc = -1; break;
+        }
+        stats_add(STATS_CRYPT, t, n);
+        stats_count(STATS_CHUNKS, 1);
+        t = stats_now();
+        if (fwrite(sbuf, 1, (size_t)slen, out) != (size_t)slen){ perror("write"); rc = -1; break; }
+        stats_add(STATS_WRITE, t, slen);
+        off += n;
+    } while (off < clen);
+
+    unsigned char tag[crypto_aead_chacha20poly1305_ietf_ABYTES], want[sizeof tag];
+    simple_mac_end(&mac, clen, tag); // also wipes the state
+    if (rc == 0 && fread(want, 1, sizeof want, in) != sizeof want){ fprintf(stderr, "short read\n"); rc = -1; }
+    if (rc == 0 && crypto_verify_16(tag, want) != 0){
+        fprintf(stderr, "decryption failed (wrong password or tampered file)\n");
+        rc = -1;
+    }
+    return rc;
+}
+
+/* migrate_open: migrate_file on the SIMPL1 file open on `in` (header
+   already read into `sh`, status in `sb`), `clen` payload bytes. The new
+   file takes the old one's permission bits. Returns 0 or -1. */
+static int migrate_open(FILE *in, const char *path, const struct stat *sb, const simple_hdr_t *sh, uint64_t clen,
+                        char *pwd){
+    unsigned char skey[crypto_kdf_KEYBYTES];
+    if (session_master_key(pwd, sh->salt, (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE, // SIMPL1 key (cached per salt)
+                           (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024), skey) != 0){
+        fprintf(stderr, "KDF failed\n");
+        return -1;
+    }
+
+    // SIMPL1 pieces must start on a ChaCha20 block, so round an odd --chunk-size down.
+    const uint32_t cs = stream_chunk_for(clen) / SIMPLE_BLOCK * SIMPLE_BLOCK;
+    stream_hdr_t h;
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    crypto_secretstream_xchacha20poly1305_state st;
+    unsigned char *cbuf = buf_alloc(cs, BUF_PLAIN);  // SIMPL1 ciphertext chunk
+    unsigned char *pbuf = buf_alloc(cs, BUF_SECRET); // plaintext chunk (locked)
+    unsigned char *sbuf = buf_alloc((size_t)cs + crypto_secretstream_xchacha20poly1305_ABYTES, BUF_PLAIN); // sealed chunk
+    vault_out_t o;
+    FILE *out = NULL;
+    int rc = -1;
+    if (!cbuf || !pbuf || !sbuf){
+        fprintf(stderr, "out of memory\n");
+    } else if (stream_hdr_new(&h, 0, 0, cs, pwd, key) != 0){ // header fields + new file key
+        sodium_memzero(key, sizeof key);
+    } else if (crypto_secretstream_xchacha20poly1305_init_push(&st, h.ss_header, key) != 0 ||
+               stream_hdr_encode(&h) != 0){ // AAD = header prefix
+        fprintf(stderr, "secretstream init_push failed\n");
+    } else if (out_open(&o, path, 0) != 0 || !(out = out_stream(&o, "wb"))){ // temp next to the old file
+        out_abort(&o);
+    } else if (fwrite(h.raw, 1, h.raw_len, out) != h.raw_len ||
+               migrate_seal(in, out, clen, sh, skey, &h, &st, cbuf, pbuf, sbuf) != 0){
+        out_abort(&o); // the SIMPL1 file stays as it was
+    } else if (fchmod(o.fd, sb->st_mode & 07777) != 0){ // temp is 0600
+        perror(path);
+        out_abort(&o);
+    } else {
+        rc = out_commit(&o); // fsync + rename over the SIMPL1 file
+    }
+
+    sodium_memzero(key, sizeof key); // scrub keys and stream state
+    sodium_memzero(skey, sizeof skey);
+    sodium_memzero(&st, sizeof st);
+    buf_free(cbuf);
+    buf_free(pbuf); // wiped on release
+    buf_free(sbuf);
+    return rc;
+}
+
+/* migrate_file: re-encrypt the legacy SIMPL1 file `in_path` into the current
+   streamed format under the same password, in place. One forward read: each
+   chunk is decrypted and re-sealed in memory (migrate_seal), so no plaintext
+   reaches the disk, and the new file replaces the old one atomically only
+   if the whole SIMPL1 payload authenticated. Files that are not SIMPL1 are
+   left alone. `garbage` is unused (encrypt_func signature, for the worker
+   pool). Returns 0 if the file was migrated or skipped, -1 on failure. */
+int migrate_file(const char *in_path, char *pwd, const char *garbage){
+    (void)garbage;
+    if (!in_path || !pwd) return -1;
+
+    unsigned char m[6];
+    if (read_magic(in_path, m) != 0 || memcmp(m, MAGIC, 6) != 0){ // streamed already, or not ours
+        stats_count(STATS_SKIPPED, 1);
+        return 0;
+    }
+
+    FILE *in = fopen(in_path, "rb");
+    if (!in){ perror(in_path); return -1; }
+    stats_count(STATS_SYS_OPEN, 1);
+    stats_file_t *sf = stats_file_begin(in_path); // --stats: per-file record
+
+    const size_t ab = crypto_aead_chacha20poly1305_ietf_ABYTES;
+    simple_hdr_t sh;
+    struct stat sb;
+    int rc = -1;
+    if (fstat(fileno(in), &sb) != 0 || sb.st_size < (off_t)(sizeof sh + ab) ||
+        fread(&sh, 1, sizeof sh, in) != sizeof sh || memcmp(sh.magic, MAGIC, sizeof MAGIC) != 0){
+        fprintf(stderr, "%s: not a valid SIMPL1 file\n", in_path);
+    } else if ((uint64_t)sb.st_size - sizeof sh - ab > crypto_aead_chacha20poly1305_ietf_MESSAGEBYTES_MAX){
+        fprintf(stderr, "%s: too large to be valid\n", in_path);
+    } else {
+        rc = migrate_open(in, in_path, &sb, &sh, (uint64_t)sb.st_size - sizeof sh - ab, pwd);
+    }
+
+    stats_file_end(sf, rc);
+    fclose(in);
+    stats_count(STATS_SYS_CLOSE, 1);
+    return rc;
+}
@@ -0,0 +1,57 @@
+#include "../include/header.h"
+
+#include <sys/mman.h>
+
+/* map_fd_input: map the whole regular file behind `fd` read-only for
+   sequential access. Empty files get base == NULL, len == 0. The caller
+   keeps ownership of `fd`. Returns 0 on success, -1 on failure. */
+int map_fd_input(int fd, vault_map_t *m){
+    memset(m, 0, sizeof *m);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > SIZE_MAX){
+        fprintf(stderr, "mmap: input is not a mappable regular file\n");
+        return -1;
+    }
+    m->len = (size_t)st.st_size;
+    if (m->len == 0) return 0; // nothing to map
+
+    void *p = mmap(NULL, m->len, PROT_READ, MAP_PRIVATE, fd, 0); // read-only view of the page cache
+    if (p == MAP_FAILED){ perror("mmap in"); return -1; }
+    stats_count(STATS_SYS_MMAP, 1);
+    m->base = p;
+    (void)posix_madvise(m->base, m->len, POSIX_MADV_SEQUENTIAL); // aggressive readahead, early reclaim
+    return 0;
+}
+
+/* map_fd_output: size the file behind `fd` to exactly `len` bytes and map it
+   writable, so results are produced in place instead of through a buffer.
+   The caller keeps ownership of `fd`. Returns 0 on success, -1 on failure. */
+int map_fd_output(int fd, size_t len, vault_map_t *m){
+    memset(m, 0, sizeof *m);
+    m->fd = fd;
+    m->writable = 1;
+    m->len = len;
+    if (ftruncate(fd, (off_t)len) != 0){ perror("ftruncate"); return -1; } // preallocate final size
+    if (len == 0) return 0; // nothing to map
+
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); // stores land in the file
+    if (p == MAP_FAILED){ perror("mmap out"); return -1; }
+    stats_count(STATS_SYS_MMAP, 1);
+    m->base = p;
+    (void)posix_madvise(m->base, m->len, POSIX_MADV_SEQUENTIAL);
+    return 0;
+}
+
+/* unmap_file: release a mapping. For outputs `keep` is the final file length:
+   shorter than the mapping when a stream ended early, 0 after a failure so
+   no partial result survives. Returns 0 on success, -1 on error. */
+int unmap_file(vault_map_t *m, size_t keep){
+    int rc = 0;
+    if (m->base){
+        if (!m->writable) (void)posix_madvise(m->base, m->len, POSIX_MADV_DONTNEED); // input pages no longer needed
+        if (munmap(m->base, m->len) != 0) rc = -1;
+    }
+    if (m->writable && keep != m->len && ftruncate(m->fd, (off_t)keep) != 0) rc = -1; // trim to what was produced
+    memset(m, 0, sizeof *m);
+    return rc;
+}
@@ -0,0 +1,365 @@
+#include "../include/header.h"
+
+/* Pack containers (`vault pack` / `vault unpack`).
+
+   A whole directory tree goes into one secretstream under one header
+   flagged STREAM_FLAG_PACK, so a tree of small files costs one header, one
+   key derivation and one output file instead of one of each per file. The
+   plaintext is a sequence of records (little-endian):
+
+       type u8 | mode u32 | size u64 | path_len u16 | path | size bytes
+
+   PACK_FILE records carry a regular file: its path relative to the packed
+   directory ('/'-separated), its permission bits and its contents. One
+   PACK_END record (all other fields zero) closes the container. Records
+   run across chunk boundaries; every chunk but the FINAL one is full.
+
+   Unpack pulls one chunk at a time and writes file data straight out of
+   it, so memory stays at one chunk whatever the file sizes. Extracted
+   files go through the crash-safe output path, grouped like a directory
+   run. A container that ends early, or has data after PACK_END, fails. */
+
+/* Sealing side: one plaintext chunk being filled. */
+typedef struct {
+    FILE *out;
+    const stream_hdr_t *h;
+    crypto_secretstream_xchacha20poly1305_state st;
+    unsigned char *buf;     /* plaintext chunk */
+    unsigned char *cbuf;    /* sealed chunk */
+    size_t cs, fill;
+} pack_writer_t;
+
+/* Visitor state for pack_one. */
+typedef struct {
+    pack_writer_t *w;
+    size_t root_len;        /* strip this prefix (the packed directory) */
+    int    skip;            /* an old container inside the tree: leave it out */
+    dev_t  skip_dev;
+    ino_t  skip_ino;
+} pack_ctx_t;
+
+/* Opening side: the current authenticated chunk. */
+typedef struct {
+    FILE *in;
+    const stream_hdr_t *h;
+    crypto_secretstream_xchacha20poly1305_state st;
+    unsigned char *buf;     /* plaintext chunk */
+    unsigned char *cbuf;    /* sealed chunk */
+    size_t frame, len, pos; /* sealed size; bytes in buf; next unread */
+    int final;              /* buf came with the FINAL tag */
+} pack_reader_t;
+
+/* put_le: store `v` as `n` little-endian bytes. */
+static void put_le(unsigned char *p, uint64_t v, int n){
+    for (int i = 0; i < n; ++i) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+/* get_le: load `n` little-endian bytes. */
+static uint64_t get_le(const unsigned char *p, int n){
+    uint64_t v = 0;
+    for (int i = n - 1; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+/* pw_flush: seal and write the current chunk (`final` tags it FINAL). */
+static int pw_flush(pack_writer_t *w, int final){
+    unsigned char tag = final ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0;
+    unsigned long long clen = 0ULL;
+    uint64_t t = stats_now();
+    if (crypto_secretstream_xchacha20poly1305_push(&w->st, w->cbuf, &clen, w->buf, w->fill,
+                                                   w->h->raw, w->h->aad_len, tag) != 0){
+        fprintf(stderr, "crypto_secretstream push failed\n");
+        return -1;
+    }
+    stats_add(STATS_CRYPT, t, w->fill);
+    stats_count(STATS_CHUNKS, 1);
+    t = stats_now();
+    if (fwrite(w->cbuf, 1, (size_t)clen, w->out) != (size_t)clen){ perror("write"); return -1; }
+    stats_add(STATS_WRITE, t, clen);
+    w->fill = 0;
+    return 0;
+}
+
+/* pw_put: append `n` bytes, sealing each chunk as it fills up. */
+static int pw_put(pack_writer_t *w, const void *src, size_t n){
+    const unsigned char *s = src;
+    while (n > 0){
+        if (w->fill == w->cs && pw_flush(w, 0) != 0) return -1; // full and more follows
+        size_t k = w->cs - w->fill < n ? w->cs - w->fill : n;
+        memcpy(w->buf + w->fill, s, k);
+        w->fill += k; s += k; n -= k;
+    }
+    return 0;
+}
+
+/* pw_record: append a record header. */
+static int pw_record(pack_writer_t *w, int type, uint32_t mode, uint64_t size, const char *path, size_t plen){
+    unsigned char rec[PACK_REC_SIZE];
+    rec[0] = (unsigned char)type;
+    put_le(rec + 1, mode, 4);
+    put_le(rec + 5, size, 8);
+    put_le(rec + 13, plen, 2);
+    if (pw_put(w, rec, sizeof rec) != 0) return -1;
+    return pw_put(w, path, plen);
+}
+
+/* pack_one: path_walk visitor; append one regular file as a PACK_FILE
+   record, reading its contents straight into the chunk buffer. */
+static int pack_one(const char *path, void *ctx){
+    pack_ctx_t *c = ctx;
+    pack_writer_t *w = c->w;
+    const char *rel = path + c->root_len;
+    while (*rel == '/') ++rel; // relative to the packed directory
+    size_t plen = strlen(rel);
+    if (plen == 0 || plen >= PATH_MAX){ fprintf(stderr, "%s: path too long to pack\n", path); return -1; }
+
+    uint64_t t = stats_now();
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0){ perror(path); return -1; }
+    stats_count(STATS_SYS_OPEN, 1);
+    struct stat st;
+    if (fstat(fd, &st) != 0){ perror(path); close(fd); return -1; }
+    stats_add(STATS_READ, t, 0);
+    if (!S_ISREG(st.st_mode) || (c->skip && st.st_dev == c->skip_dev && st.st_ino == c->skip_ino)){
+        close(fd); // replaced meanwhile, or the container being rewritten
+        stats_count(STATS_SKIPPED, 1);
+        return 0;
+    }
+
+    int rc = pw_record(w, PACK_FILE, (uint32_t)(st.st_mode & 0777), (uint64_t)st.st_size, rel, plen);
+    for (uint64_t left = (uint64_t)st.st_size; rc == 0 && left > 0; ){
+        if (w->fill == w->cs && (rc = pw_flush(w, 0)) != 0) break;
+        size_t k = w->cs - w->fill < left ? w->cs - w->fill : (size_t)left;
+        t = stats_now();
+        ssize_t n = read(fd, w->buf + w->fill, k);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0){ perror(path); rc = -1; break; }
+        if (n == 0){ fprintf(stderr, "%s: file shrank while packing\n", path); rc = -1; break; }
+        stats_add(STATS_READ, t, (uint64_t)n);
+        w->fill += (size_t)n;
+        left -= (uint64_t)n;
+    }
+    close(fd);
+    stats_count(STATS_SYS_CLOSE, 1);
+    return rc;
+}
+
+/* pack_stream: write directory `dir` as a pack container to `out`. A file
+   matching `skip` (the container's old version) is left out. Returns 0 on
+   success, -1 on failure. */
+static int pack_stream(const char *dir, FILE *out, char *pwd, const struct stat *skip){
+    stream_hdr_t hdr;
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if (stream_hdr_new(&hdr, STREAM_FLAG_PACK, 0, stream_chunk_for(STREAM_CHUNK), pwd, key) != 0){
+        sodium_memzero(key, sizeof key);
+        return -1;
+    }
+
+    pack_writer_t w;
+    memset(&w, 0, sizeof w);
+    w.out = out; w.h = &hdr; w.cs = hdr.chunk_size;
+    w.buf = buf_alloc(w.cs, BUF_SECRET); // plaintext (locked, pooled)
+    w.cbuf = buf_alloc(w.cs + crypto_secretstream_xchacha20poly1305_ABYTES, BUF_PLAIN);
+    int rc = -1;
+    if (!w.buf || !w.cbuf)
+        fprintf(stderr, "out of memory\n");
+    else if (crypto_secretstream_xchacha20poly1305_init_push(&w.st, hdr.ss_header, key) != 0 ||
+             stream_hdr_encode(&hdr) != 0) // AAD = header prefix
+        fprintf(stderr, "secretstream init_push failed\n");
+    else if (fwrite(hdr.raw, 1, hdr.raw_len, out) != hdr.raw_len)
+        perror("write header");
+    else {
+        pack_ctx_t c = { &w, strlen(dir), skip != NULL, skip ? skip->st_dev : 0, skip ? skip->st_ino : 0 };
+        if (path_walk(WALK_ALL, dir, pack_one, &c) == 0 &&
+            pw_record(&w, PACK_END, 0, 0, "", 0) == 0 &&
+            pw_flush(&w, 1) == 0)
+            rc = 0;
+    }
+
+    buf_free(w.buf); buf_free(w.cbuf); // plaintext is wiped on release
+    sodium_memzero(key, sizeof key);
+    sodium_memzero(&w.st, sizeof w.st);
+    if (fflush(out) != 0){ perror("write"); rc = -1; }
+    return rc;
+}
+
+/* pack_dir: pack the regular files under directory `dir` (same skip rules
+   as a directory run) into container `out_path` ("-" = stdout). Returns 0
+   on success, -1 on failure; a failed pack leaves `out_path` untouched. */
+int pack_dir(const char *dir, const char *out_path, char *pwd){
+    struct stat st;
+    if (lstat(dir, &st) != 0){ perror(dir); return -1; }
+    if (!S_ISDIR(st.st_mode)){ fprintf(stderr, "%s: not a directory\n", dir); return -1; }
+    if (strcmp(out_path, "-") == 0) return pack_stream(dir, stdout, pwd, NULL);
+
+    struct stat old;
+    int have_old = stat(out_path, &old) == 0; // repacking into the tree itself
+    vault_out_t o;
+    if (out_open(&o, out_path, 0) != 0) return -1;
+    FILE *out = out_stream(&o, "wb");
+    if (!out){ out_abort(&o); return -1; }
+    if (pack_stream(dir, out, pwd, have_old ? &old : NULL) != 0){ out_abort(&o); return -1; }
+    return out_commit(&o);
+}
+
+/* pr_next: pull and authenticate the next chunk. */
+static int pr_next(pack_reader_t *r){
+    if (r->final){ fprintf(stderr, "unpack: container ends inside a record\n"); return -1; }
+    uint64_t t = stats_now();
+    size_t n = fread(r->cbuf, 1, r->frame, r->in);
+    if (n == 0){
+        if (feof(r->in)) fprintf(stderr, "decryption failed (stream ended before its FINAL chunk)\n");
+        else perror("fread");
+        return -1;
+    }
+    stats_add(STATS_READ, t, n);
+    unsigned long long plen = 0ULL;
+    unsigned char tag = 0;
+    t = stats_now();
+    if (crypto_secretstream_xchacha20poly1305_pull(&r->st, r->buf, &plen, &tag, r->cbuf, (unsigned long long)n,
+                                                   r->h->raw, r->h->aad_len) != 0){
+        fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+        return -1;
+    }
+    stats_add(STATS_CRYPT, t, plen);
+    stats_count(STATS_CHUNKS, 1);
+    r->len = (size_t)plen;
+    r->pos = 0;
+    r->final = (tag & crypto_secretstream_xchacha20poly1305_TAG_FINAL) != 0;
+    return 0;
+}
+
+/* pr_get: copy the next `n` plaintext bytes into `dst`. */
+static int pr_get(pack_reader_t *r, void *dst, size_t n){
+    unsigned char *d = dst;
+    while (n > 0){
+        if (r->pos == r->len && pr_next(r) != 0) return -1;
+        size_t k = r->len - r->pos < n ? r->len - r->pos : n;
+        memcpy(d, r->buf + r->pos, k);
+        r->pos += k; d += k; n -= k;
+    }
+    return 0;
+}
+
+/* rel_ok: non-zero if `p` is a safe relative path: not absolute, no empty,
+   "." or ".." components, no trailing slash. */
+static int rel_ok(const char *p){
+    if (*p == '\0' || *p == '/') return 0;
+    for (;;){
+        const char *e = strchr(p, '/');
+        size_t n = e ? (size_t)(e - p) : strlen(p);
+        if (n == 0 || (n == 1 && p[0] == '.') || (n == 2 && p[0] == '.' && p[1] == '.')) return 0;
+        if (!e) return 1;
+        p = e + 1;
+    }
+}
+
+/* unpack_file: extract one PACK_FILE record's contents to `path`. */
+static int unpack_file(pack_reader_t *r, const char *path, uint32_t mode, uint64_t size){
+    vault_out_t o;
+    if (out_open(&o, path, 0) != 0) return -1;
+    FILE *out = out_stream(&o, "wb");
+    if (!out){ out_abort(&o); return -1; }
+    while (size > 0){ // straight from the authenticated chunk
+        if (r->pos == r->len && pr_next(r) != 0){ out_abort(&o); return -1; }
+        size_t k = r->len - r->pos < size ? r->len - r->pos : (size_t)size;
+        uint64_t t = stats_now();
+        if (fwrite(r->buf + r->pos, 1, k, out) != k){ perror(path); out_abort(&o); return -1; }
+        stats_add(STATS_WRITE, t, k);
+        r->pos += k;
+        size -= k;
+    }
+    if (fchmod(o.fd, (mode_t)(mode & 0777)) != 0){ perror(path); out_abort(&o); return -1; }
+    return out_commit(&o);
+}
+
+/* unpack_records: extract every record up to PACK_END under `dir`. */
+static int unpack_records(pack_reader_t *r, const char *dir){
+    char path[PATH_MAX];
+    size_t dlen = strlen(dir);
+    while (dlen > 1 && dir[dlen - 1] == '/') --dlen; // "out/" -> "out"
+    if (dlen >= sizeof path - 1){ fprintf(stderr, "%s: path too long\n", dir); return -1; }
+    memcpy(path, dir, dlen);
+    path[dlen] = '/';
+
+    for (;;){
+        unsigned char rec[PACK_REC_SIZE];
+        if (pr_get(r, rec, sizeof rec) != 0) return -1;
+        uint32_t mode = (uint32_t)get_le(rec + 1, 4);
+        uint64_t size = get_le(rec + 5, 8);
+        size_t   plen = (size_t)get_le(rec + 13, 2);
+        if (rec[0] == PACK_END && plen == 0 && size == 0) return 0;
+        if (rec[0] != PACK_FILE || plen == 0 || dlen + 1 + plen >= sizeof path){
+            fprintf(stderr, "unpack: bad record\n");
+            return -1;
+        }
+        char *rel = path + dlen + 1;
+        if (pr_get(r, rel, plen) != 0) return -1;
+        rel[plen] = '\0';
+        if (memchr(rel, '\0', plen) || !rel_ok(rel)){
+            fprintf(stderr, "unpack: unsafe path in container: %s\n", rel);
+            return -1;
+        }
+        if (make_parents(path, dlen) != 0 || unpack_file(r, path, mode, size) != 0) return -1;
+    }
+}
+
+/* unpack_stream: extract the pack container read from `in` under `dir`
+   (created if missing). Files extracted before a failure stay; they were
+   authenticated. Returns 0 on success, -1 on failure. */
+static int unpack_stream(FILE *in, const char *dir, char *pwd){
+    stream_hdr_t hdr;
+    if (stream_hdr_read(in, &hdr) != 0 || !(hdr.flags & STREAM_FLAG_PACK)){
+        fprintf(stderr, "not a pack container\n");
+        return -1;
+    }
+    struct stat st;
+    if (mkdir(dir, 0700) != 0 && !(errno == EEXIST && stat(dir, &st) == 0 && S_ISDIR(st.st_mode))){
+        perror(dir);
+        return -1;
+    }
+
+    pack_reader_t r;
+    memset(&r, 0, sizeof r);
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if (session_file_key(pwd, &hdr, key, sizeof key) != 0){ // cached master -> file key
+        fprintf(stderr, "KDF failed\n");
+        return -1;
+    }
+    int rc = -1;
+    r.in = in; r.h = &hdr;
+    r.frame = hdr.chunk_size + crypto_secretstream_xchacha20poly1305_ABYTES;
+    r.buf = buf_alloc(hdr.chunk_size, BUF_SECRET); // plaintext (locked, pooled)
+    r.cbuf = buf_alloc(r.frame, BUF_PLAIN);
+    if (!r.buf || !r.cbuf)
+        fprintf(stderr, "out of memory\n");
+    else if (crypto_secretstream_xchacha20poly1305_init_pull(&r.st, hdr.ss_header, key) != 0)
+        fprintf(stderr, "secretstream init_pull failed (bad header/key)\n");
+    else {
+        commit_begin(); // extracted files share the directory-run group commit
+        rc = unpack_records(&r, dir);
+        if (rc == 0 && (r.pos != r.len || !r.final || fgetc(in) != EOF)){
+            fprintf(stderr, "unpack: data after the end of the container\n");
+            rc = -1;
+        }
+        if (commit_end() != 0) rc = -1;
+    }
+
+    buf_free(r.buf); buf_free(r.cbuf); // plaintext is wiped on release
+    sodium_memzero(key, sizeof key);
+    sodium_memzero(&r.st, sizeof r.st);
+    return rc;
+}
+
+/* unpack_dir: extract container `in_path` ("-" = stdin) under `dir`.
+   Returns 0 on success, -1 on failure. */
+int unpack_dir(const char *in_path, const char *dir, char *pwd){
+    if (strcmp(in_path, "-") == 0) return unpack_stream(stdin, dir, pwd);
+    FILE *in = fopen(in_path, "rb");
+    if (!in){ perror(in_path); return -1; }
+    stats_count(STATS_SYS_OPEN, 1);
+    int rc = unpack_stream(in, dir, pwd);
+    fclose(in);
+    stats_count(STATS_SYS_CLOSE, 1);
+    return rc;
+}
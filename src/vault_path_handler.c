@@ -1,59 +1,44 @@
 #include "../include/header.h"
 
-/* path_handler: dispatches an encrypt/decrypt function `f` over a path.
-   - For regular files: applies `f` (skips user.pass, already .enc/.dec).
-   - For directories: recurses into entries (skips . and ..).
-   - Skips symlinks/devices/FIFOs/sockets by using lstat and only handling
-     S_ISREG and S_ISDIR.
-   Returns 0 on success/skip, -1 on error or child error. */
-int path_handler(encrypt_func f, const char *path, char *pwd, const char *suffix){
-    struct stat st;
-
-    // Stat the path without following symlinks (POSIX lstat; Windows stat fallback).
-    /* use lstat so symlinks are not followed; on Windows fall back to stat */
-#if defined(_WIN32)
-    if (stat(path, &st) != 0) { perror("stat"); return -1; } // fetch metadata (Windows)
-#else
-    if (lstat(path, &st) != 0) { perror("lstat"); return -1; } // fetch metadata without following symlinks (POSIX)
-#endif
-
-    // Branch: handle regular files.
-    if (S_ISREG(st.st_mode)) {               /* regular file only */
-        const char *name = base_name(path); // get basename from path
-
-        // Never operate on credential file.
-        if (strcmp(name, "user.pass") == 0) return 0;  /* never touch creds */
-
-        // Skip files that are already in the target state.
-        if (f == encrypt_inplace && ends_with(name, ".enc")) return 0; // skip already-encrypted files
-        if (f == decrypt_inplace && ends_with(name, ".dec")) return 0; // skip .dec files during decrypt
-
-        return f(path, pwd, suffix); // apply operation to this regular file
-
-    // Branch: handle directories (recurse).
-    } else if (S_ISDIR(st.st_mode)) {        /* recurse directories */
-        DIR *dir = opendir(path); // open directory stream
-        if (!dir){ perror("opendir"); return -1; } // fail if cannot open
-
-        int rc = 0;
-        struct dirent *entry;
-        // Iterate directory entries (skip "." and "..").
-        while ((entry = readdir(dir)) != 0){
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-                continue; // skip self/parent entries
-
-            char full_path[1024];
-            snprintf(full_path, sizeof full_path, "%s/%s", path, entry->d_name); // build child path
+/* Arguments threaded through path_walk for the serial handler. */
+typedef struct {
+    encrypt_func f;      /* operation to apply */
+    char        *pwd;    /* password (read-only for the run) */
+    const char  *suffix; /* decrypt output suffix */
+} serial_args_t;
+
+/* run_one: visitor that applies the operation immediately. */
+static int run_one(const char *file, void *ctx){
+    serial_args_t *a = ctx;
+    return a->f(file, a->pwd, a->suffix); // apply operation to this regular file
+}
 
-            int child = path_handler(f, full_path, pwd, suffix); // recurse into child path
-            if (child != 0) { rc = child; break; } // propagate first non-zero (error) and stop
-        }
-        closedir(dir); // close directory stream
-        return rc; // return aggregate result from recursion
+/* dispatch: pick the engine for `path` (see path_handler). */
+static int dispatch(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix){
+    if (g_uring_depth > 0){
+        int rc = uring_run(f, walk, path, pwd, suffix, g_uring_depth); // batched small-file engine
+        if (rc != -2) return rc;
+        fprintf(stderr, "io_uring unavailable; using the regular engine\n"); // fall through
     }
+    if (g_jobs > 1) return pool_run(f, walk, path, pwd, suffix, g_jobs); // parallel mode
 
-    // Not a regular file or directory (symlink, device, fifo, socket) → skip.
-    /* Not a regular file or directory: symlink, device, fifo, socket → skip */
-    return 0; // treat as no-op
+    serial_args_t a = { f, pwd, suffix };
+    return path_walk(walk, path, run_one, &a); // serial depth-first walk
 }
 
+/* path_handler: dispatches an encrypt/decrypt function `f` over the files
+   under a path that filter `walk` admits (WALK_ENCRYPT, WALK_DECRYPT).
+   With g_uring_depth > 0 the tree goes to the io_uring batch engine
+   (vault_uring.c) if the system has one; with g_jobs > 1 it is handed to the
+   worker pool (vault_pool.c); otherwise files are processed one at a time,
+   stopping at the first error. Directory runs group their outputs' fsyncs
+   and renames (vault_commit.c); every output is in place when this returns.
+   Returns 0 on success/skip, -1 on error or child error. */
+int path_handler(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix){
+    struct stat st;
+    int group = stat(path, &st) == 0 && S_ISDIR(st.st_mode); // single files commit on their own
+    if (group) commit_begin();
+    int rc = dispatch(f, walk, path, pwd, suffix);
+    if (group && commit_end() != 0) rc = -1; // last batch: sync, rename, --rm
+    return rc;
+}
@@ -0,0 +1,193 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* Read/crypt/write pipeline (--pipeline).
+
+     reader thread --in_full--> caller (transform) --out_full--> writer thread
+          ^                        |        ^                        |
+          +--------in_free---------+        +--------out_free--------+
+
+   PIPELINE_DEPTH reusable buffers circulate on each side, so while one
+   chunk is being transformed the next is already being read and the
+   previous one written. Single-file throughput then tends to
+   max(I/O, crypto) instead of their sum. Chunks stay in file order because
+   every queue is FIFO and each stage is a single thread. */
+
+/* One reusable chunk buffer. */
+typedef struct {
+    unsigned char *data;
+    size_t len;                  /* valid bytes */
+    int eof;                     /* reader hit end of input (short read) */
+    int err;                     /* reader hit an I/O error */
+} pipe_buf_t;
+
+/* Bounded FIFO of buffer pointers. Closing wakes every waiter; pops drain
+   what is left and then return NULL, pushes fail. */
+typedef struct {
+    pipe_buf_t *slot[PIPELINE_DEPTH];
+    size_t head, count;
+    int closed;
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+} pipe_q_t;
+
+/* Pipeline state shared by the three stages. */
+typedef struct {
+    FILE *in, *out;
+    size_t read_size;            /* bytes per reader buffer */
+    pipe_q_t in_free, in_full, out_free, out_full;
+    int write_failed;            /* set by the writer, read under out_full.mu */
+    stats_file_t *stats;         /* caller's per-file record (--stats), or NULL */
+} pipe_t;
+
+static void q_init(pipe_q_t *q){
+    memset(q, 0, sizeof *q);
+    pthread_mutex_init(&q->mu, NULL);
+    pthread_cond_init(&q->cv, NULL);
+}
+static void q_destroy(pipe_q_t *q){
+    pthread_cond_destroy(&q->cv);
+    pthread_mutex_destroy(&q->mu);
+}
+static void q_close(pipe_q_t *q){
+    pthread_mutex_lock(&q->mu);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->cv); // release every waiter
+    pthread_mutex_unlock(&q->mu);
+}
+
+/* q_push: append `b`; never blocks for long since a queue can hold every
+   buffer of its side. Returns 0, or -1 if the queue was closed. */
+static int q_push(pipe_q_t *q, pipe_buf_t *b){
+    pthread_mutex_lock(&q->mu);
+    while (q->count == PIPELINE_DEPTH && !q->closed) pthread_cond_wait(&q->cv, &q->mu);
+    int rc = q->closed ? -1 : 0;
+    if (rc == 0){
+        q->slot[(q->head + q->count) % PIPELINE_DEPTH] = b;
+        q->count++;
+        pthread_cond_broadcast(&q->cv);
+    }
+    pthread_mutex_unlock(&q->mu);
+    return rc;
+}
+
+/* q_pop: take the oldest buffer, waiting while empty. NULL once closed and drained. */
+static pipe_buf_t *q_pop(pipe_q_t *q){
+    pthread_mutex_lock(&q->mu);
+    while (q->count == 0 && !q->closed) pthread_cond_wait(&q->cv, &q->mu);
+    pipe_buf_t *b = NULL;
+    if (q->count > 0){
+        b = q->slot[q->head];
+        q->head = (q->head + 1) % PIPELINE_DEPTH;
+        q->count--;
+        pthread_cond_broadcast(&q->cv);
+    }
+    pthread_mutex_unlock(&q->mu);
+    return b;
+}
+
+/* reader_main: fill free input buffers in file order until EOF or error. */
+static void *reader_main(void *arg){
+    pipe_t *p = arg;
+    stats_file_attach(p->stats); // account reads to the caller's file
+    for (;;){
+        pipe_buf_t *b = q_pop(&p->in_free);
+        if (!b) break; // pipeline shut down
+        uint64_t t = stats_now();
+        b->len = fread(b->data, 1, p->read_size, p->in); // fread retries until full or EOF
+        stats_add(STATS_READ, t, b->len);
+        b->err = ferror(p->in) != 0;
+        b->eof = b->len < p->read_size; // short read: nothing follows
+        if (q_push(&p->in_full, b) != 0 || b->eof) break;
+    }
+    return NULL;
+}
+
+/* writer_main: write transformed buffers in order; after a failure keep
+   recycling buffers so the transform stage never blocks. */
+static void *writer_main(void *arg){
+    pipe_t *p = arg;
+    stats_file_attach(p->stats); // account writes to the caller's file
+    for (;;){
+        pipe_buf_t *b = q_pop(&p->out_full);
+        if (!b) break; // all output handed over
+        int failed;
+        pthread_mutex_lock(&p->out_full.mu);
+        failed = p->write_failed;
+        pthread_mutex_unlock(&p->out_full.mu);
+        uint64_t t = stats_now();
+        if (!failed && b->len > 0 && fwrite(b->data, 1, b->len, p->out) != b->len){
+            perror("write chunk");
+            pthread_mutex_lock(&p->out_full.mu);
+            p->write_failed = 1; // surfaced to the transform stage
+            pthread_mutex_unlock(&p->out_full.mu);
+        } else if (!failed && b->len > 0){
+            stats_add(STATS_WRITE, t, b->len);
+        }
+        q_push(&p->out_free, b);
+    }
+    return NULL;
+}
+
+/* pipeline_run: stream `in` to `out` through `fn`, reading `read_size`
+   bytes per chunk on a reader thread and writing on a writer thread while
+   the calling thread runs `fn` (the crypto). `fn` gets each chunk and
+   whether it is the last one, produces at most `out_cap` bytes and sets
+   *done when no further input is wanted. `plain_in` says which side holds
+   plaintext (the input when encrypting, the output when decrypting); its
+   buffers are BUF_SECRET.
+   Returns 0 on success, -1 on a read, write or transform failure. */
+int pipeline_run(FILE *in, FILE *out, size_t read_size, size_t out_cap, int plain_in, pipe_xform fn, void *ctx){
+    pipe_t p;
+    memset(&p, 0, sizeof p);
+    p.in = in; p.out = out; p.read_size = read_size;
+    p.stats = stats_file_current(); // helper threads report to the same file
+    q_init(&p.in_free); q_init(&p.in_full); q_init(&p.out_free); q_init(&p.out_full);
+
+    pipe_buf_t bufs[2 * PIPELINE_DEPTH]; // input side, then output side
+    int rc = 0;
+    memset(bufs, 0, sizeof bufs);
+    for (int i = 0; i < 2 * PIPELINE_DEPTH; ++i){
+        const int in_side = i < PIPELINE_DEPTH;
+        bufs[i].data = buf_alloc(in_side ? read_size : out_cap, in_side == (plain_in != 0) ? BUF_SECRET : BUF_PLAIN);
+        if (!bufs[i].data) rc = -1;
+        else q_push(i < PIPELINE_DEPTH ? &p.in_free : &p.out_free, &bufs[i]);
+    }
+
+    pthread_t reader, writer;
+    int have_reader = 0, have_writer = 0;
+    if (rc == 0) have_reader = pthread_create(&reader, NULL, reader_main, &p) == 0;
+    if (rc == 0 && have_reader) have_writer = pthread_create(&writer, NULL, writer_main, &p) == 0;
+    if (rc == 0 && !(have_reader && have_writer)){ fprintf(stderr, "pipeline: could not start threads\n"); rc = -1; }
+    if (rc != 0 && !have_reader) fprintf(stderr, "pipeline: out of memory\n");
+
+    // Transform stage: in order, one chunk at a time.
+    for (int done = 0; rc == 0 && !done; ){
+        pipe_buf_t *ib = q_pop(&p.in_full);
+        if (!ib){ rc = -1; break; } // cannot happen before EOF; defensive
+        if (ib->err){ perror("fread"); rc = -1; break; }
+
+        pipe_buf_t *ob = q_pop(&p.out_free);
+        ob->len = 0;
+        if (fn(ctx, ib->data, ib->len, ib->eof, ob->data, &ob->len, &done) != 0) rc = -1;
+        if (!done && ib->eof && rc == 0) rc = -1; // transform wanted more than the input had
+        q_push(&p.in_free, ib); // buffer back to the reader
+        q_push(&p.out_full, ob); // result on to the writer
+
+        pthread_mutex_lock(&p.out_full.mu);
+        if (p.write_failed) rc = -1; // stop reading once output is broken
+        pthread_mutex_unlock(&p.out_full.mu);
+    }
+
+    // Shut down: the writer drains what it has, the reader stops waiting.
+    q_close(&p.out_full);
+    if (have_writer) pthread_join(writer, NULL);
+    q_close(&p.in_free);
+    if (have_reader) pthread_join(reader, NULL);
+    if (p.write_failed) rc = -1;
+
+    for (int i = 0; i < 2 * PIPELINE_DEPTH; ++i) buf_free(bufs[i].data); // wipes the plaintext side
+    q_destroy(&p.in_free); q_destroy(&p.in_full); q_destroy(&p.out_free); q_destroy(&p.out_full);
+    return rc;
+}
@@ -0,0 +1,150 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* One scanned file and, once a worker is done with it, its result. */
+typedef struct {
+    char *path;  /* heap copy of the file path */
+    int   rc;    /* operation result (0 ok, non-zero failed) */
+} pool_item_t;
+
+/* Shared pool state: a bounded ring of pending item indices plus the
+   growing result table the report is printed from. */
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t  not_empty;   /* signalled when the ring gains work or scanning ends */
+    pthread_cond_t  not_full;    /* signalled when a worker frees a ring slot */
+
+    size_t *ring;                /* pending indices into items */
+    size_t  cap, head, count;    /* ring capacity, read position, fill level */
+    int     scan_done;           /* scanner finished (no more pushes) */
+    int     scan_rc;             /* walk error from the scanner */
+
+    pool_item_t *items;          /* every file the scanner found, in walk order */
+    size_t  n_items, items_cap;
+
+    encrypt_func f;              /* operation each worker applies */
+    unsigned     walk;           /* path_walk filter (WALK_*) */
+    const char  *root;           /* path passed to pool_run */
+    char        *pwd;            /* password, read-only for the run */
+    const char  *suffix;         /* decrypt output suffix */
+} pool_t;
+
+/* enqueue: scanner visitor. Records the file and blocks while the ring is
+   full, so the scanner stays at most a few files ahead of the workers. The
+   items table still keeps every path for the final report: memory grows
+   with the number of files (one path each), not with their sizes. */
+static int enqueue(const char *file, void *ctx){
+    pool_t *p = ctx;
+    char *copy = malloc(strlen(file) + 1); // private copy outlives the walk buffer
+    if (!copy){ fprintf(stderr, "pool: out of memory\n"); return -1; }
+    strcpy(copy, file);
+
+    pthread_mutex_lock(&p->mu);
+    // Grow the result table if needed.
+    if (p->n_items == p->items_cap){
+        size_t ncap = p->items_cap ? p->items_cap * 2 : 256; // geometric growth
+        pool_item_t *n = realloc(p->items, ncap * sizeof *n);
+        if (!n){ pthread_mutex_unlock(&p->mu); free(copy); fprintf(stderr, "pool: out of memory\n"); return -1; }
+        p->items = n; p->items_cap = ncap;
+    }
+    size_t idx = p->n_items++; // index of the new item
+    p->items[idx].path = copy;
+    p->items[idx].rc = -1; // pessimistic until a worker reports
+
+    // Wait for room in the ring, then publish the index.
+    while (p->count == p->cap) pthread_cond_wait(&p->not_full, &p->mu);
+    p->ring[(p->head + p->count) % p->cap] = idx;
+    p->count++;
+    pthread_cond_signal(&p->not_empty); // wake one worker
+    pthread_mutex_unlock(&p->mu);
+    return 0;
+}
+
+/* scanner_main: walk the tree and feed the queue, then mark scanning done. */
+static void *scanner_main(void *arg){
+    pool_t *p = arg;
+    int rc = path_walk(p->walk, p->root, enqueue, p); // same filtering as the serial walk
+
+    pthread_mutex_lock(&p->mu);
+    p->scan_rc = rc; // remember walk errors for the exit status
+    p->scan_done = 1;
+    pthread_cond_broadcast(&p->not_empty); // let idle workers exit
+    pthread_mutex_unlock(&p->mu);
+    return NULL;
+}
+
+/* worker_main: pop files until the scanner is done and the ring is empty. */
+static void *worker_main(void *arg){
+    pool_t *p = arg;
+    for (;;){
+        pthread_mutex_lock(&p->mu);
+        while (p->count == 0 && !p->scan_done) pthread_cond_wait(&p->not_empty, &p->mu);
+        if (p->count == 0){ pthread_mutex_unlock(&p->mu); break; } // drained and done
+        size_t idx = p->ring[p->head];
+        p->head = (p->head + 1) % p->cap; // consume slot
+        p->count--;
+        const char *path = p->items[idx].path; // stable: only the scanner writes new items
+        pthread_cond_signal(&p->not_full); // room for the scanner
+        pthread_mutex_unlock(&p->mu);
+
+        int rc = p->f(path, p->pwd, p->suffix); // encrypt_inplace / decrypt_inplace
+
+        pthread_mutex_lock(&p->mu);
+        p->items[idx].rc = rc; // items may have been reallocated meanwhile; index under lock
+        pthread_mutex_unlock(&p->mu);
+    }
+    return NULL;
+}
+
+/* pool_run: process every file under `path` with `jobs` worker threads fed
+   by one scanner thread through a bounded queue. Unlike the serial walk it
+   does not stop at the first failure; a per-file report is printed at the
+   end. Returns 0 if every file succeeded, -1 otherwise. */
+int pool_run(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix, int jobs){
+    if (jobs < 1) jobs = 1; // guard: at least one worker
+
+    pool_t p;
+    memset(&p, 0, sizeof p);
+    p.f = f; p.walk = walk; p.root = path; p.pwd = pwd; p.suffix = suffix;
+    p.cap = (size_t)jobs * 4; // a few items per worker keeps everyone busy
+    p.ring = malloc(p.cap * sizeof *p.ring);
+    pthread_t *workers = malloc((size_t)jobs * sizeof *workers);
+    if (!p.ring || !workers){ free(p.ring); free(workers); fprintf(stderr, "pool: out of memory\n"); return -1; }
+    pthread_mutex_init(&p.mu, NULL);
+    pthread_cond_init(&p.not_empty, NULL);
+    pthread_cond_init(&p.not_full, NULL);
+
+    // Start workers first, then the scanner that feeds them.
+    int started = 0;
+    for (; started < jobs; ++started)
+        if (pthread_create(&workers[started], NULL, worker_main, &p) != 0) break; // run with what we got
+    pthread_t scanner;
+    int rc = 0;
+    if (started == 0 || pthread_create(&scanner, NULL, scanner_main, &p) != 0){
+        fprintf(stderr, "pool: could not start threads\n");
+        pthread_mutex_lock(&p.mu);
+        p.scan_done = 1; p.scan_rc = -1; // release any started worker
+        pthread_cond_broadcast(&p.not_empty);
+        pthread_mutex_unlock(&p.mu);
+    } else {
+        pthread_join(scanner, NULL); // scanning finished (queue may still hold work)
+    }
+    for (int i = 0; i < started; ++i) pthread_join(workers[i], NULL); // drain
+
+    // Per-file report in walk order, then a summary line.
+    size_t ok = 0, failed = 0;
+    for (size_t i = 0; i < p.n_items; ++i){
+        if (p.items[i].rc == 0) ok++; else failed++;
+        printf("[%s] %s\n", p.items[i].rc == 0 ? " OK " : "FAIL", p.items[i].path);
+        free(p.items[i].path);
+    }
+    printf("%zu file(s): %zu ok, %zu failed (%d jobs)\n", p.n_items, ok, failed, started);
+
+    if (failed || p.scan_rc != 0) rc = -1; // any failure fails the run
+    free(p.items); free(p.ring); free(workers);
+    pthread_cond_destroy(&p.not_full);
+    pthread_cond_destroy(&p.not_empty);
+    pthread_mutex_destroy(&p.mu);
+    return rc;
+}
@@ -0,0 +1,189 @@
+#include "../include/header.h"
+
+/* State for one `vault rekey` run. */
+typedef struct {
+    char *old_pwd;              /* password the files open with today */
+    unsigned char *master;      /* Argon2id(new password, salt), locked memory */
+    unsigned char salt[16];     /* new password's salt (one per run) */
+    uint32_t opslimit;          /* new password's Argon2id passes */
+    uint32_t mem_kib;           /* new password's Argon2id memory (KiB) */
+    int phase;                  /* 0: check, 1: add the new slot, 2: drop the old ones */
+    size_t files, skipped, failed;
+} rekey_t;
+
+/* hdr_load: read `path`'s header through a read-only descriptor and parse
+   its v4 header into `h`; with `rw`, a v4 file is then reopened read-write
+   for the slot rewrite. Returns the descriptor; -2 for files that are not StreamSeal streams
+   (nothing to rekey); -1 on errors, including older formats, whose key
+   comes straight from the password and cannot be rewrapped. */
+static int hdr_load(const char *path, stream_hdr_t *h, int rw){
+    int fd = open(path, O_RDONLY | O_NOFOLLOW); // plaintext may be read-only or busy
+    if (fd < 0){ perror(path); return -1; }
+    stats_count(STATS_SYS_OPEN, 1);
+
+    unsigned char buf[STREAM_HDR_MAX];
+    ssize_t n = pread(fd, buf, sizeof buf, 0); // header is at most STREAM_HDR_MAX bytes
+    int rc = fd;
+    if (n >= 6 && memcmp(buf, MAGIC, 6) == 0){
+        fprintf(stderr, "%s: legacy SIMPL1 file, decrypt and re-encrypt it first\n", path);
+        rc = -1;
+    } else if (n < 8 || memcmp(buf, STREAM_MAGIC, sizeof(STREAM_MAGIC)) != 0){
+        rc = -2; // plaintext or foreign file
+    } else if (stream_hdr_parse(buf, (size_t)n, h) != 0){
+        fprintf(stderr, "%s: bad or short header\n", path);
+        rc = -1;
+    } else if (h->version != STREAMSEAL_VERSION){
+        fprintf(stderr, "%s: format v%u has no key slots, decrypt and re-encrypt it first\n",
+                path, (unsigned)h->version);
+        rc = -1;
+    } else if (rw){
+        struct stat a, b;
+        int wfd = open(path, O_RDWR | O_NOFOLLOW);
+        if (wfd < 0){ perror(path); rc = -1; }
+        else {
+            stats_count(STATS_SYS_OPEN, 1);
+            if (fstat(fd, &a) != 0 || fstat(wfd, &b) != 0 || a.st_dev != b.st_dev || a.st_ino != b.st_ino){
+                fprintf(stderr, "%s: replaced during rekey\n", path); // header came from another inode
+                close(wfd);
+                stats_count(STATS_SYS_CLOSE, 1);
+                rc = -1;
+            } else rc = wfd;
+        }
+    }
+    if (rc != fd){ close(fd); stats_count(STATS_SYS_CLOSE, 1); }
+    return rc;
+}
+
+/* slot_write: store key slot `i` of `h` in place on `fd` and sync it, so a
+   crash leaves either the old or the new slot, never a torn one. */
+static int slot_write(int fd, stream_hdr_t *h, int i, const char *path){
+    if (stream_hdr_encode(h) != 0) return -1;
+    const size_t off = STREAM_SLOT_OFF(i);
+    if (pwrite(fd, h->raw + off, STREAM_SLOT_SIZE, (off_t)off) != (ssize_t)STREAM_SLOT_SIZE || fsync(fd) != 0){
+        perror(path);
+        return -1;
+    }
+    stats_count(STATS_SYS_FSYNC, 1);
+    return 0;
+}
+
+/* slot_add: phase 1 (phase 0 stops after the unwrap). Unwrap the payload
+   key with the old password and wrap it into another slot under the new
+   one; the old slot keeps working until user.pass changes. */
+static int slot_add(rekey_t *r, int fd, stream_hdr_t *h, const char *path){
+    unsigned char key[crypto_kdf_KEYBYTES];
+    int k = session_open_slot(r->old_pwd, h, key);
+    if (k < 0){
+        fprintf(stderr, "%s: no key slot opens with the current password\n", path);
+        return -1;
+    }
+    if (r->phase == 0){ sodium_memzero(key, sizeof key); return 0; } // check only
+    int t = (k + 1) % STREAM_KEY_SLOTS; // the slot not in use
+    int rc = stream_slot_seal(h, t, r->master, r->salt, r->opslimit, r->mem_kib, key);
+    sodium_memzero(key, sizeof key); // scrub payload key
+    if (rc == 0) rc = slot_write(fd, h, t, path);
+    return rc;
+}
+
+/* slot_drop: phase 2. Check that the new password's slot opens, then clear
+   every other slot so the old password no longer unlocks the file. */
+static int slot_drop(rekey_t *r, int fd, stream_hdr_t *h, const char *path){
+    unsigned char key[crypto_kdf_KEYBYTES];
+    int keep = -1;
+    for (int i = 0; i < STREAM_KEY_SLOTS && keep < 0; ++i){
+        const stream_slot_t *s = &h->slots[i];
+        if (s->kdf_opslimit == r->opslimit && s->kdf_mem_kib == r->mem_kib &&
+            memcmp(s->salt, r->salt, sizeof s->salt) == 0 && stream_slot_open(h, i, r->master, key) == 0)
+            keep = i;
+    }
+    sodium_memzero(key, sizeof key); // scrub payload key
+    if (keep < 0){
+        fprintf(stderr, "%s: no key slot for the new password (changed during rekey?)\n", path);
+        return -1;
+    }
+    int rc = 0;
+    for (int i = 0; i < STREAM_KEY_SLOTS && rc == 0; ++i){
+        if (i == keep || h->slots[i].kdf_opslimit == 0) continue; // nothing to clear
+        sodium_memzero(&h->slots[i], sizeof h->slots[i]); // empty slot
+        rc = slot_write(fd, h, i, path);
+    }
+    return rc;
+}
+
+/* rekey_one: walk visitor; runs the current phase on one file. Failures are
+   counted rather than stopping the walk, so every problem file is listed. */
+static int rekey_one(const char *path, void *ctx){
+    rekey_t *r = ctx;
+    stream_hdr_t h;
+    int fd = hdr_load(path, &h, r->phase > 0); // phase 0 only reads
+    if (fd == -2){ ++r->skipped; return 0; }
+    int rc = -1;
+    if (fd >= 0 && r->phase == 0 && access(path, W_OK) != 0) perror(path); // phase 1 must write it
+    else if (fd >= 0)
+        rc = r->phase < 2 ? slot_add(r, fd, &h, path) : slot_drop(r, fd, &h, path);
+    if (fd >= 0){
+        close(fd);
+        stats_count(STATS_SYS_CLOSE, 1);
+    }
+    if (rc == 0) ++r->files;
+    else ++r->failed;
+    return 0;
+}
+
+/* rekey_tree: change the password of every StreamSeal file under `path`
+   from `old_pwd` to `new_pwd` by rewriting only their key slots; no payload
+   is read or written, so the cost is one Argon2id per password plus a few
+   hundred bytes of I/O per file.
+   - Phase 0 checks that every file can take a new slot; older formats or
+     a file the old password does not open abort the run unchanged.
+   - Phase 1 adds a slot for the new password next to the old one, then
+     user.pass is rewritten with the new password.
+   - Phase 2 clears the old slots.
+   A crash at any point leaves every file readable with the password that
+   user.pass holds. Files outside `path` keep the old password.
+   Returns 0 on success, -1 on failure. */
+int rekey_tree(const char *path, char *old_pwd, const char *new_pwd){
+    if (!path || !old_pwd || !new_pwd) return -1;
+
+    rekey_t r;
+    memset(&r, 0, sizeof r);
+    r.old_pwd  = old_pwd;
+    r.opslimit = g_kdf_opslimit; // same limits as encrypt (KDF profile)
+    r.mem_kib  = g_kdf_mem_kib;
+    randombytes_buf(r.salt, sizeof r.salt); // fresh salt for the new password
+    r.master = sodium_malloc(crypto_kdf_KEYBYTES); // guarded, mlocked
+    if (!r.master){ fprintf(stderr, "rekey: out of locked memory\n"); return -1; }
+
+    uint64_t t = stats_now();
+    if (crypto_pwhash(r.master, crypto_kdf_KEYBYTES, new_pwd, strlen(new_pwd), r.salt,
+                      (unsigned long long)r.opslimit, (size_t)r.mem_kib * 1024ULL,
+                      crypto_pwhash_ALG_ARGON2ID13) != 0){
+        fprintf(stderr, "KDF failed\n");
+        sodium_free(r.master);
+        return -1;
+    }
+    stats_add(STATS_KDF, t, 0);
+
+    int rc = path_walk(WALK_ALL, path, rekey_one, &r); // phase 0: check
+    if (rc == 0 && r.failed == 0){
+        r.phase = 1;
+        r.files = r.skipped = 0;
+        rc = path_walk(WALK_ALL, path, rekey_one, &r); // on failure the old password still opens everything
+    }
+    if (rc != 0 || r.failed > 0){
+        fprintf(stderr, "rekey: %zu file(s) cannot be rekeyed; password unchanged\n", r.failed);
+        rc = -1;
+    } else if (user_set_password(new_pwd) != 0){
+        fprintf(stderr, "rekey: could not update user.pass; password unchanged\n");
+        rc = -1;
+    } else {
+        size_t added = r.files;
+        r.phase = 2;
+        r.files = r.skipped = 0;
+        rc = path_walk(WALK_ALL, path, rekey_one, &r);
+        printf("rekey: %zu rekeyed, %zu skipped, %zu failed\n", added, r.skipped, r.failed);
+        if (r.failed > 0) rc = -1;
+    }
+    sodium_free(r.master); // sodium_free wipes the key
+    return rc == 0 ? 0 : -1;
+}
@@ -0,0 +1,140 @@
+#include "../include/header.h"
+
+/* Resume journals (--resume) for the chunk-independent layout.
+
+   A resumable run writes its output to a partial file with a fixed name,
+   OUT_TMP_PREFIX<base>.part next to the final path, and keeps a journal,
+   OUT_TMP_PREFIX<base>.journal, that says how many leading chunks of it
+   are durable. Every chunk sits at an offset computed from its index and
+   is sealed or opened on its own, so a later run only has to read the
+   header back from the partial output (encrypt) or the input (decrypt)
+   and carry on at the journal's chunk. No key material is journaled: a
+   resumed encrypt unwraps the payload key from the partial file's own key
+   slot with the password. The secretstream layout is never resumed, since
+   that would mean writing its state (the key) to disk.
+
+   Journal (RESUME_JNL_SIZE bytes, little-endian):
+     magic[6] | decrypt u8 | 0 u8 | src_dev u64 | src_ino u64 | src_size u64 |
+     src_mtime_ns i64 | src_ctime_ns i64 | hdr_hash[16] | done u64 |
+     out_off u64 | check[16]
+   The input's ctime is part of its identity because userspace can set
+   mtime back (touch -d, cp -p, rsync --times) but not ctime: a resumed
+   encrypt reuses the payload key and nonce base, so sealing changed
+   plaintext at an offset the old run already used would reuse nonces.
+   check is BLAKE2b-128 of everything before it, so a torn or foreign file
+   is never trusted. The journal is replaced atomically after the partial
+   output's data has been synced, so `done` never runs ahead of the disk. */
+
+static const unsigned char RESUME_MAGIC[6] = { 'S','S','J','n','l','1' };
+#define RESUME_HASH_BYTES 16
+#define RESUME_JNL_SIZE   (6 + 2 + 5 * 8 + RESUME_HASH_BYTES + 8 + 8 + RESUME_HASH_BYTES)
+
+/* put_u64/get_u64: little-endian 64-bit field codec. */
+static void put_u64(unsigned char *p, uint64_t v){
+    for (int i = 0; i < 8; ++i) p[i] = (unsigned char)(v >> (8 * i));
+}
+static uint64_t get_u64(const unsigned char *p){
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = v << 8 | p[i];
+    return v;
+}
+
+/* resume_paths: partial output and journal names for `out_path`, next to
+   it (the base is cut like out_tmp_name's). Returns 0, or -1 if either
+   does not fit in `cap`. */
+int resume_paths(const char *out_path, char *part, char *journal, size_t cap){
+    const char *slash = strrchr(out_path, '/');
+    int dlen = slash ? (int)(slash - out_path) + 1 : 0; // keep the directory and its '/'
+    const char *base = slash ? slash + 1 : out_path;
+    int a = snprintf(part, cap, "%.*s" OUT_TMP_PREFIX "%.200s.part", dlen, out_path, base);
+    int b = snprintf(journal, cap, "%.*s" OUT_TMP_PREFIX "%.200s.journal", dlen, out_path, base);
+    return (a < 0 || (size_t)a >= cap || b < 0 || (size_t)b >= cap) ? -1 : 0;
+}
+
+/* resume_ident: fill the direction and input identity of `j` from the
+   open input `fd` and its header `h` (the output's header for encrypt).
+   `done` starts at 0. Returns 0, or -1 if fstat fails. */
+int resume_ident(resume_jnl_t *j, int decrypt, int fd, const stream_hdr_t *h){
+    struct stat st;
+    memset(j, 0, sizeof *j);
+    if (fstat(fd, &st) != 0){ perror("fstat"); return -1; }
+    j->decrypt  = (uint32_t)decrypt;
+    j->src_dev  = (uint64_t)st.st_dev;
+    j->src_ino  = (uint64_t)st.st_ino;
+    j->src_size = (uint64_t)st.st_size;
+    j->src_mtime_ns = ST_NS(st, st_mtim);
+    j->src_ctime_ns = ST_NS(st, st_ctim); // cannot be set back, unlike mtime
+    if (h) crypto_generichash(j->hdr_hash, sizeof j->hdr_hash, h->raw, h->raw_len, NULL, 0);
+    return 0;
+}
+
+/* resume_same: non-zero if journal `j` belongs to the same direction,
+   input (device, inode, size, mtime, ctime) and header as `cur`. */
+int resume_same(const resume_jnl_t *j, const resume_jnl_t *cur){
+    return j->decrypt == cur->decrypt && j->src_dev == cur->src_dev && j->src_ino == cur->src_ino &&
+           j->src_size == cur->src_size && j->src_mtime_ns == cur->src_mtime_ns &&
+           j->src_ctime_ns == cur->src_ctime_ns &&
+           sodium_memcmp(j->hdr_hash, cur->hdr_hash, sizeof j->hdr_hash) == 0;
+}
+
+/* resume_save: durably replace the journal at `path` with `j`, whose
+   chunks [0, j->done) end at output offset `out_off`. Returns 0 or -1. */
+int resume_save(const char *path, const resume_jnl_t *j, uint64_t out_off){
+    unsigned char b[RESUME_JNL_SIZE], *p = b;
+    memcpy(p, RESUME_MAGIC, sizeof RESUME_MAGIC); p += sizeof RESUME_MAGIC;
+    *p++ = (unsigned char)j->decrypt;
+    *p++ = 0;
+    put_u64(p, j->src_dev);  p += 8;
+    put_u64(p, j->src_ino);  p += 8;
+    put_u64(p, j->src_size); p += 8;
+    put_u64(p, (uint64_t)j->src_mtime_ns); p += 8;
+    put_u64(p, (uint64_t)j->src_ctime_ns); p += 8;
+    memcpy(p, j->hdr_hash, RESUME_HASH_BYTES); p += RESUME_HASH_BYTES;
+    put_u64(p, j->done);     p += 8;
+    put_u64(p, out_off);     p += 8;
+    crypto_generichash(p, RESUME_HASH_BYTES, b, (size_t)(p - b), NULL, 0); // torn-write check
+    stats_count(STATS_SYS_FSYNC, 1);
+    if (write_file_atomic_0600(path, b, sizeof b) != 0){ perror(path); return -1; }
+    return 0;
+}
+
+/* resume_load: read the journal at `path` into `j` (its output offset into
+   `out_off`). Returns 0, or -1 if it is missing, torn or not a journal. */
+int resume_load(const char *path, resume_jnl_t *j, uint64_t *out_off){
+    unsigned char b[RESUME_JNL_SIZE + 1], check[RESUME_HASH_BYTES];
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t n = fread(b, 1, sizeof b, f);
+    fclose(f);
+    if (n != RESUME_JNL_SIZE || memcmp(b, RESUME_MAGIC, sizeof RESUME_MAGIC) != 0) return -1;
+    crypto_generichash(check, sizeof check, b, RESUME_JNL_SIZE - RESUME_HASH_BYTES, NULL, 0);
+    if (sodium_memcmp(check, b + RESUME_JNL_SIZE - RESUME_HASH_BYTES, sizeof check) != 0) return -1;
+
+    const unsigned char *p = b + sizeof RESUME_MAGIC;
+    memset(j, 0, sizeof *j);
+    j->decrypt = p[0]; p += 2;
+    j->src_dev  = get_u64(p); p += 8;
+    j->src_ino  = get_u64(p); p += 8;
+    j->src_size = get_u64(p); p += 8;
+    j->src_mtime_ns = (int64_t)get_u64(p); p += 8;
+    j->src_ctime_ns = (int64_t)get_u64(p); p += 8;
+    memcpy(j->hdr_hash, p, RESUME_HASH_BYTES); p += RESUME_HASH_BYTES;
+    j->done  = get_u64(p); p += 8;
+    *out_off = get_u64(p);
+    return 0;
+}
+
+/* resume_skip: non-zero if a --resume run should leave `in_path` alone:
+   its output `out_path` exists, was last written no earlier than the
+   input's last change (ctime, in ns, so a same-second edit or a mtime set
+   back still counts) and has no journal (so it was committed whole).
+   Finished files of an interrupted directory run are then not redone,
+   for encrypt and decrypt alike. */
+int resume_skip(const char *in_path, const char *out_path){
+    char part[PATH_MAX], journal[PATH_MAX];
+    struct stat si, so;
+    if (resume_paths(out_path, part, journal, sizeof part) != 0) return 0;
+    if (access(journal, F_OK) == 0) return 0; // unfinished: resume it
+    if (stat(in_path, &si) != 0 || stat(out_path, &so) != 0 || !S_ISREG(so.st_mode)) return 0;
+    return ST_NS(si, st_ctim) <= ST_NS(so, st_mtim);
+}
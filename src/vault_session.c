@@ -0,0 +1,279 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* One cached master key: Argon2id(pwd, salt, opslimit, mem_kib). */
+typedef struct {
+    int      used;          /* slot holds a valid key */
+    int      pending;       /* being stretched with the lock dropped */
+    uint32_t opslimit;      /* Argon2id passes */
+    uint32_t mem_kib;       /* Argon2id memory (KiB) */
+    unsigned char salt[16]; /* Argon2id salt */
+    unsigned char key[crypto_kdf_KEYBYTES]; /* stretched master key */
+} master_slot_t;
+
+/* Session state lives in one sodium_malloc block (guarded, locked). */
+typedef struct {
+    char     pwd[1024];          /* copy of the password the keys belong to */
+    size_t   pwd_len;            /* strlen(pwd) */
+    unsigned char run_salt[16];  /* salt used for every file encrypted this run */
+    int      agent;              /* master keys come from `vault agent` (no password here) */
+    unsigned next;               /* round-robin eviction cursor */
+    master_slot_t slots[SESSION_CACHE_SLOTS];
+} session_t;
+
+static session_t *s_sess = NULL; // current session (NULL until first use)
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER; // guards s_sess for pool workers
+static pthread_cond_t  s_done = PTHREAD_COND_INITIALIZER;  // a pending derivation finished
+static unsigned long   s_gen;  // bumped whenever s_sess is replaced or dropped
+
+/* session_matches: non-zero if the open session belongs to `pwd`. */
+static int session_matches(const char *pwd){
+    size_t n = strlen(pwd); // candidate length
+    return s_sess && s_sess->pwd_len == n && sodium_memcmp(s_sess->pwd, pwd, n) == 0; // constant-time compare
+}
+
+/* session_begin: start a run for `pwd`: copy it into locked memory and pick
+   a fresh run salt. Any previous session is discarded. Returns 0 or -1. */
+int session_begin(const char *pwd){
+    if (!pwd) return -1; // guard: need a password
+    size_t n = strlen(pwd);
+    session_end(); // drop keys from any earlier password
+    s_gen++;
+
+    s_sess = sodium_malloc(sizeof *s_sess); // guarded, mlocked allocation
+    if (!s_sess){ fprintf(stderr, "session: out of locked memory\n"); return -1; }
+    sodium_memzero(s_sess, sizeof *s_sess); // clear slots
+
+    if (n >= sizeof s_sess->pwd){ session_end(); return -1; } // password too long to hold
+    memcpy(s_sess->pwd, pwd, n); // keep a private copy
+    s_sess->pwd_len = n;
+    randombytes_buf(s_sess->run_salt, sizeof s_sess->run_salt); // one salt for the whole run
+    return 0;
+}
+
+/* session_begin_agent: start a run whose master keys come from a running
+   `vault agent` instead of a password: the session holds the empty password
+   (callers pass "") and the agent's run salt, so files encrypted by several
+   short runs share one master key. Returns 0, or -1 if no agent answers. */
+int session_begin_agent(void){
+    unsigned char salt[16];
+    if (agent_run_salt(salt) != 0) return -1; // no agent, or not ours
+    pthread_mutex_lock(&s_lock);
+    int rc = session_begin("");
+    if (rc == 0){
+        memcpy(s_sess->run_salt, salt, sizeof salt); // agent's salt, not a fresh one
+        s_sess->agent = 1;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return rc;
+}
+
+/* session_end: scrub and release all cached key material. */
+void session_end(void){
+    if (!s_sess) return; // nothing to do
+    sodium_memzero(s_sess, sizeof *s_sess); // wipe password and keys
+    sodium_free(s_sess);
+    s_sess = NULL;
+    s_gen++; // derivations in flight for it are dropped
+}
+
+/* session_ensure: make sure the open session belongs to `pwd`, starting a
+   new one if needed (e.g. direct library callers). Returns 0 or -1. */
+static int session_ensure(const char *pwd){
+    if (session_matches(pwd)) return 0; // reuse current session
+    return session_begin(pwd); // different (or no) password: new session
+}
+
+/* session_encrypt_params: report the salt and Argon2id limits (the KDF
+   profile's) every file encrypted in this run shares. Returns 0 on success, -1 on failure. */
+int session_encrypt_params(const char *pwd, unsigned char salt[16], uint32_t *opslimit, uint32_t *mem_kib){
+    if (!pwd) return -1;
+    pthread_mutex_lock(&s_lock);
+    if (session_ensure(pwd) != 0){ pthread_mutex_unlock(&s_lock); return -1; } // need a session for pwd
+    memcpy(salt, s_sess->run_salt, sizeof s_sess->run_salt); // shared run salt
+    pthread_mutex_unlock(&s_lock);
+    *opslimit = g_kdf_opslimit; // Argon2id passes
+    *mem_kib  = g_kdf_mem_kib;  // Argon2id memory (KiB)
+    return 0;
+}
+
+/* kdf_limits_ok: non-zero if (`opslimit`, `mem_kib`) are Argon2id limits
+   this build will stretch with: accepted by libsodium and at most
+   KDF_OPSLIMIT_MAX passes over KDF_MEM_MAX_KIB. Limits come from file
+   headers and agent requests, so they are checked before any allocation. */
+int kdf_limits_ok(uint64_t opslimit, uint64_t mem_kib){
+    return opslimit >= crypto_pwhash_OPSLIMIT_MIN && opslimit <= KDF_OPSLIMIT_MAX &&
+           mem_kib * 1024ULL >= (uint64_t)crypto_pwhash_MEMLIMIT_MIN && mem_kib <= KDF_MEM_MAX_KIB &&
+           mem_kib * 1024ULL <= (uint64_t)crypto_pwhash_MEMLIMIT_MAX;
+}
+
+/* slot_match: non-zero if cache slot `s` holds (or is deriving) the key
+   for `salt`, `opslimit` and `mem_kib`. */
+static int slot_match(const master_slot_t *s, const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib){
+    return (s->used || s->pending) && s->opslimit == opslimit && s->mem_kib == mem_kib &&
+           memcmp(s->salt, salt, sizeof s->salt) == 0;
+}
+
+/* session_master_key: return Argon2id(pwd, salt, opslimit, mem_kib), running
+   the KDF only on a cache miss. A miss claims a cache slot under the session
+   lock and stretches with the lock dropped: pool workers asking for the same
+   salt wait for that one derivation instead of racing N copies of the same
+   256 MiB Argon2id, while hits and other salts go ahead meanwhile.
+   Returns 0 on success, -1 on KDF failure. */
+int session_master_key(const char *pwd, const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                       unsigned char key[crypto_kdf_KEYBYTES]){
+    if (!pwd) return -1;
+    pthread_mutex_lock(&s_lock);
+    master_slot_t *s;
+    for (;;){
+        if (session_ensure(pwd) != 0){ pthread_mutex_unlock(&s_lock); return -1; } // need a session for pwd
+        unsigned busy = 0;
+        s = NULL;
+        for (unsigned i = 0; i < SESSION_CACHE_SLOTS; ++i){
+            if (slot_match(&s_sess->slots[i], salt, opslimit, mem_kib)){ s = &s_sess->slots[i]; break; }
+            busy += s_sess->slots[i].pending != 0;
+        }
+        if (s && s->used){ // hit: no Argon2id
+            memcpy(key, s->key, crypto_kdf_KEYBYTES);
+            pthread_mutex_unlock(&s_lock);
+            return 0;
+        }
+        if (!s && busy < SESSION_CACHE_SLOTS) break; // miss with a slot to claim
+        pthread_cond_wait(&s_done, &s_lock); // this key (or every slot) is being derived
+    }
+
+    // Miss: claim the next slot nobody is deriving into (round-robin eviction).
+    while (s_sess->slots[s_sess->next].pending) s_sess->next = (s_sess->next + 1) % SESSION_CACHE_SLOTS;
+    s = &s_sess->slots[s_sess->next];
+    s_sess->next = (s_sess->next + 1) % SESSION_CACHE_SLOTS; // advance eviction cursor
+    sodium_memzero(s, sizeof *s); // drop evicted key
+    s->pending = 1;
+    s->opslimit = opslimit;
+    s->mem_kib = mem_kib;
+    memcpy(s->salt, salt, sizeof s->salt);
+    const int agent = s_sess->agent;
+    const unsigned long gen = s_gen;
+    pthread_mutex_unlock(&s_lock);
+
+    unsigned char mk[crypto_kdf_KEYBYTES];
+    int rc = 0;
+    uint64_t t = stats_now();
+    if (agent){
+        if (agent_master_key(salt, opslimit, mem_kib, mk) != 0){ // agent stretches with its password
+            fprintf(stderr, "vault agent did not return a key\n");
+            rc = -1;
+        }
+    } else if (crypto_pwhash(mk, sizeof mk, pwd, strlen(pwd), salt, // pwd matches the session's copy
+                             (unsigned long long)opslimit,
+                             (size_t)mem_kib * 1024ULL,
+                             crypto_pwhash_ALG_ARGON2ID13) != 0){
+        fprintf(stderr, "KDF failed\n");
+        rc = -1;
+    }
+    if (rc == 0) stats_add(STATS_KDF, t, 0);
+
+    pthread_mutex_lock(&s_lock);
+    if (gen == s_gen){ // same session: publish the key, or free the slot for a retry
+        if (rc == 0){ memcpy(s->key, mk, sizeof mk); s->used = 1; s->pending = 0; }
+        else sodium_memzero(s, sizeof *s);
+    }
+    pthread_cond_broadcast(&s_done); // wake the workers waiting for it
+    pthread_mutex_unlock(&s_lock);
+    if (rc == 0) memcpy(key, mk, sizeof mk); // hand out a copy
+    sodium_memzero(mk, sizeof mk);
+    return rc;
+}
+
+/* slot_kek: key-encryption key for v4 key slots under password master `master`. */
+static int slot_kek(const unsigned char master[crypto_kdf_KEYBYTES],
+                    unsigned char kek[crypto_aead_xchacha20poly1305_ietf_KEYBYTES]){
+    return crypto_kdf_derive_from_key(kek, crypto_aead_xchacha20poly1305_ietf_KEYBYTES, 0,
+                                      SESSION_WRAP_CONTEXT, master);
+}
+
+/* stream_slot_seal: wrap payload key `key` into key slot `i` of `h` under
+   password master `master`, recording the Argon2id salt and limits it was
+   stretched with. The wrap binds the header prefix (flags, sizes), so the
+   slot cannot be moved onto another layout. Returns 0 or -1. */
+int stream_slot_seal(stream_hdr_t *h, int i, const unsigned char master[crypto_kdf_KEYBYTES],
+                     const unsigned char salt[16], uint32_t opslimit, uint32_t mem_kib,
+                     const unsigned char key[crypto_kdf_KEYBYTES]){
+    if (i < 0 || i >= STREAM_KEY_SLOTS || opslimit == 0) return -1;
+    stream_slot_t *s = &h->slots[i];
+    unsigned char kek[crypto_aead_xchacha20poly1305_ietf_KEYBYTES];
+    unsigned char ad[STREAM_PREFIX_SIZE];
+    size_t adlen = stream_hdr_prefix(h, ad); // slot AAD
+
+    s->kdf_mem_kib  = mem_kib;
+    s->kdf_opslimit = opslimit;
+    memcpy(s->salt, salt, sizeof s->salt);
+    randombytes_buf(s->nonce, sizeof s->nonce); // fresh nonce per wrap
+    int rc = slot_kek(master, kek);
+    if (rc == 0)
+        rc = crypto_aead_xchacha20poly1305_ietf_encrypt(s->wrapped, NULL, key, crypto_kdf_KEYBYTES,
+                                                        ad, adlen, NULL, s->nonce, kek);
+    sodium_memzero(kek, sizeof kek); // scrub wrapping key
+    if (rc != 0) sodium_memzero(s, sizeof *s); // leave the slot empty
+    return rc == 0 ? 0 : -1;
+}
+
+/* stream_slot_open: unwrap key slot `i` of `h` with password master
+   `master` into `key`. Returns 0, or -1 if the slot is empty or does not
+   authenticate (other password, or a tampered header). */
+int stream_slot_open(const stream_hdr_t *h, int i, const unsigned char master[crypto_kdf_KEYBYTES],
+                     unsigned char key[crypto_kdf_KEYBYTES]){
+    if (i < 0 || i >= STREAM_KEY_SLOTS || h->slots[i].kdf_opslimit == 0) return -1;
+    const stream_slot_t *s = &h->slots[i];
+    unsigned char kek[crypto_aead_xchacha20poly1305_ietf_KEYBYTES];
+    unsigned char ad[STREAM_PREFIX_SIZE];
+    size_t adlen = stream_hdr_prefix(h, ad); // slot AAD
+    int rc = slot_kek(master, kek);
+    if (rc == 0)
+        rc = crypto_aead_xchacha20poly1305_ietf_decrypt(key, NULL, NULL, s->wrapped, sizeof s->wrapped,
+                                                        ad, adlen, s->nonce, kek);
+    sodium_memzero(kek, sizeof kek); // scrub wrapping key
+    return rc == 0 ? 0 : -1;
+}
+
+/* session_open_slot: unwrap the payload key of v4 header `h` with `pwd`,
+   trying each non-empty key slot (the master key is cached per slot salt).
+   Returns the index of the slot that opened, or -1 if none did. */
+int session_open_slot(const char *pwd, const stream_hdr_t *h, unsigned char key[crypto_kdf_KEYBYTES]){
+    unsigned char master[crypto_kdf_KEYBYTES];
+    int found = -1;
+    for (int i = 0; i < STREAM_KEY_SLOTS && found < 0; ++i){
+        const stream_slot_t *s = &h->slots[i];
+        if (s->kdf_opslimit == 0) continue; // empty slot
+        if (session_master_key(pwd, s->salt, s->kdf_opslimit, s->kdf_mem_kib, master) == 0 &&
+            stream_slot_open(h, i, master, key) == 0)
+            found = i;
+    }
+    sodium_memzero(master, sizeof master); // scrub local copy
+    return found;
+}
+
+/* session_file_key: derive the payload key for header `h`.
+   v4:    unwrapped from the first key slot `pwd` opens.
+   v2/v3: subkey = KDF(master, file_id, SESSION_KDF_CONTEXT).
+   v1:    the Argon2id output itself (legacy per-file stretch).
+   Writes `keylen` bytes to `key`. Returns 0 on success, -1 on failure. */
+int session_file_key(const char *pwd, const stream_hdr_t *h, unsigned char *key, size_t keylen){
+    unsigned char master[crypto_kdf_KEYBYTES];
+    if (keylen != sizeof master) return -1; // all payload keys are 32 bytes
+    if (h->version >= STREAMSEAL_VERSION){
+        if (session_open_slot(pwd, h, key) >= 0) return 0;
+        fprintf(stderr, "no key slot opens with this password\n");
+        return -1;
+    }
+    if (session_master_key(pwd, h->salt, h->kdf_opslimit, h->kdf_mem_kib, master) != 0) return -1;
+
+    int rc = 0;
+    if (h->version == STREAMSEAL_VERSION_V1){
+        memcpy(key, master, keylen); // legacy: key straight from Argon2id
+    } else {
+        rc = crypto_kdf_derive_from_key(key, keylen, h->file_id, SESSION_KDF_CONTEXT, master); // fast subkey
+    }
+    sodium_memzero(master, sizeof master); // scrub local copy
+    return rc == 0 ? 0 : -1;
+}
@@ -0,0 +1,39 @@
+#include "../include/header.h"
+
+/* SIMPL1 payloads are one ChaCha20-Poly1305 (IETF) AEAD with no AAD. The
+   helpers below compute it in pieces, exactly as libsodium's one-shot
+   construction does (RFC 8439): the Poly1305 key is the first keystream
+   block, the payload is XORed from block 1 on, and the tag covers the
+   ciphertext, zero padding to 16 bytes, then le64(0) and le64(length). */
+
+/* simple_mac_begin: start the tag of a payload sealed under `nonce`/`key`. */
+int simple_mac_begin(crypto_onetimeauth_poly1305_state *st, const unsigned char nonce[12],
+                     const unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES]){
+    unsigned char block0[64];
+    int rc = crypto_stream_chacha20_ietf(block0, sizeof block0, nonce, key);
+    if (rc == 0) rc = crypto_onetimeauth_poly1305_init(st, block0);
+    sodium_memzero(block0, sizeof block0); // one-time key
+    return rc == 0 ? 0 : -1;
+}
+
+/* simple_mac_end: finish the tag over `clen` ciphertext bytes (all of them
+   fed to crypto_onetimeauth_poly1305_update in order) into `tag`. */
+void simple_mac_end(crypto_onetimeauth_poly1305_state *st, uint64_t clen,
+                    unsigned char tag[crypto_aead_chacha20poly1305_ietf_ABYTES]){
+    static const unsigned char zero[16] = { 0 };
+    unsigned char lens[16] = { 0 }; // le64(aad length = 0) | le64(clen)
+    for (int i = 0; i < 8; ++i) lens[8 + i] = (unsigned char)(clen >> (8 * i));
+    crypto_onetimeauth_poly1305_update(st, zero, (size_t)((16 - (clen & 15)) & 15)); // pad to 16
+    crypto_onetimeauth_poly1305_update(st, lens, sizeof lens);
+    crypto_onetimeauth_poly1305_final(st, tag);
+    sodium_memzero(st, sizeof *st);
+}
+
+/* simple_xor: encrypt or decrypt `n` payload bytes at payload offset `off`
+   (a multiple of SIMPLE_BLOCK) from `in` to `out`. Returns 0 or -1. */
+int simple_xor(unsigned char *out, const unsigned char *in, size_t n, uint64_t off,
+               const unsigned char nonce[12], const unsigned char key[crypto_aead_chacha20poly1305_ietf_KEYBYTES]){
+    if (off % SIMPLE_BLOCK != 0 || off / SIMPLE_BLOCK + 1 > UINT32_MAX) return -1;
+    const uint32_t ic = (uint32_t)(off / SIMPLE_BLOCK + 1); // block 0 is the Poly1305 key
+    return crypto_stream_chacha20_ietf_xor_ic(out, in, (unsigned long long)n, nonce, ic, key) == 0 ? 0 : -1;
+}
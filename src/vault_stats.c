@@ -0,0 +1,216 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/* Run statistics (--stats, --stats-json).
+
+   The hot paths bracket their work as
+
+       uint64_t t = stats_now();  ...read/seal/write...  stats_add(STATS_READ, t, n);
+
+   which sums time, bytes and calls per phase for the run and for the file
+   the calling thread is working on. Helper threads (chunk workers, the
+   pipeline's reader and writer) attach to their file's record with
+   stats_file_attach. Phase times are summed over threads, so with --jobs
+   or chunk workers they can exceed the wall time.
+
+   With g_stats off stats_now returns 0 without reading the clock and every
+   other call returns at once, so the instrumented paths cost a branch.
+   With it on, the counters are bumped with relaxed atomic adds instead of
+   a lock: they are only read once the threads that feed them are joined
+   (stats_file_end, stats_end). */
+
+struct stats_file {
+    char    *path;                    /* heap copy */
+    uint64_t t0;                      /* stats_now() at begin */
+    uint64_t ns[STATS_PHASES];        /* time per phase */
+    uint64_t bytes[STATS_PHASES];     /* bytes per phase */
+    uint64_t chunks;                  /* chunks sealed/opened */
+};
+
+static const char *const s_phase_name[STATS_PHASES] = {
+    "login", "kdf", "walk", "read", "crypt", "write", "close"
+};
+static const char *const s_count_name[STATS_COUNTERS] = {
+    "chunks", "skipped", "open", "close", "stat", "mmap", "io_uring_enter", "fsync", "mlock"
+};
+
+static pthread_mutex_t s_mu = PTHREAD_MUTEX_INITIALIZER; /* guards the file totals and the JSON sink */
+static pthread_once_t  s_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   s_key;         /* thread -> current stats_file_t */
+static uint64_t s_ns[STATS_PHASES], s_bytes[STATS_PHASES], s_calls[STATS_PHASES]; /* bump() only */
+static uint64_t s_count[STATS_COUNTERS];                                            /* bump() only */
+static uint64_t s_ok, s_failed, s_t0;
+static int      s_report;             /* human summary on stderr */
+static FILE    *s_json;               /* JSON lines sink, or NULL */
+
+static void key_init(void){ (void)pthread_key_create(&s_key, NULL); }
+
+/* bump: add `n` to a counter shared between threads (no ordering needed). */
+static inline void bump(uint64_t *c, uint64_t n){
+    (void)__atomic_fetch_add(c, n, __ATOMIC_RELAXED);
+}
+
+/* stats_now: monotonic nanoseconds, or 0 when statistics are off. */
+uint64_t stats_now(void){
+    if (!g_stats) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* secs: nanoseconds -> seconds for printing. */
+static double secs(uint64_t ns){ return (double)ns / 1e9; }
+
+/* json_str: write `s` as a JSON string literal. */
+static void json_str(FILE *f, const char *s){
+    fputc('"', f);
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p){
+        if (*p == '"' || *p == '\\') fprintf(f, "\\%c", *p);
+        else if (*p < 0x20) fprintf(f, "\\u%04x", *p); // control bytes
+        else fputc(*p, f); // other bytes pass through (paths are not always UTF-8)
+    }
+    fputc('"', f);
+}
+
+/* stats_begin: switch statistics on for this run. `report` prints a summary
+   on stderr at stats_end; `json_path` (or "-" for stderr) receives one JSON
+   line per file and a final summary line. Returns 0, or -1 if the JSON file
+   cannot be created. */
+int stats_begin(int report, const char *json_path){
+    if (json_path){
+        s_json = strcmp(json_path, "-") == 0 ? stderr : fopen(json_path, "w");
+        if (!s_json){ perror(json_path); return -1; }
+    }
+    pthread_once(&s_once, key_init);
+    s_report = report;
+    g_stats = 1;
+    s_t0 = stats_now(); // after g_stats, or it reads 0
+    return 0;
+}
+
+/* stats_add: account `bytes` and the time since `t0` (from stats_now) to
+   `phase`, for the run and for the calling thread's current file. */
+void stats_add(int phase, uint64_t t0, uint64_t bytes){
+    if (!g_stats) return;
+    uint64_t ns = stats_now() - t0;
+    stats_file_t *f = pthread_getspecific(s_key);
+    bump(&s_ns[phase], ns); bump(&s_bytes[phase], bytes); bump(&s_calls[phase], 1);
+    if (f){ bump(&f->ns[phase], ns); bump(&f->bytes[phase], bytes); } // chunk workers share it
+}
+
+/* stats_count: bump `counter` by `n` (chunks also go to the current file). */
+void stats_count(int counter, uint64_t n){
+    if (!g_stats) return;
+    stats_file_t *f = counter == STATS_CHUNKS ? pthread_getspecific(s_key) : NULL;
+    bump(&s_count[counter], n);
+    if (f) bump(&f->chunks, n);
+}
+
+/* stats_file_current / stats_file_attach: the record the calling thread
+   accounts to; helper threads attach to their file's record. */
+stats_file_t *stats_file_current(void){
+    return g_stats ? pthread_getspecific(s_key) : NULL;
+}
+void stats_file_attach(stats_file_t *f){
+    if (g_stats) (void)pthread_setspecific(s_key, f);
+}
+
+/* stats_file_begin: start a per-file record for `path` and attach it to
+   the calling thread. Returns NULL when statistics are off or a file is
+   already being recorded on this thread (the outer caller owns it). */
+stats_file_t *stats_file_begin(const char *path){
+    if (!g_stats || pthread_getspecific(s_key)) return NULL;
+    stats_file_t *f = calloc(1, sizeof *f);
+    if (!f) return NULL; // statistics are best effort
+    f->path = malloc(strlen(path) + 1);
+    if (f->path) strcpy(f->path, path);
+    f->t0 = stats_now();
+    (void)pthread_setspecific(s_key, f);
+    return f;
+}
+
+/* stats_file_end: finish record `f` with result `rc`, emit its JSON line
+   and detach it from the calling thread. NULL is a no-op. */
+void stats_file_end(stats_file_t *f, int rc){
+    if (!f) return;
+    uint64_t wall = stats_now() - f->t0;
+    pthread_mutex_lock(&s_mu);
+    if (rc == 0) s_ok++; else s_failed++;
+    if (s_json){
+        fprintf(s_json, "{\"type\":\"file\",\"path\":");
+        json_str(s_json, f->path ? f->path : "");
+        fprintf(s_json, ",\"ok\":%s,\"wall_s\":%.6f", rc == 0 ? "true" : "false", secs(wall));
+        for (int p = 0; p < STATS_PHASES; ++p){
+            if (p == STATS_LOGIN || p == STATS_WALK) continue; // run-level phases
+            fprintf(s_json, ",\"%s_s\":%.6f,\"%s_bytes\":%llu", s_phase_name[p], secs(f->ns[p]),
+                    s_phase_name[p], (unsigned long long)f->bytes[p]);
+        }
+        fprintf(s_json, ",\"chunks\":%llu}\n", (unsigned long long)f->chunks);
+    }
+    pthread_mutex_unlock(&s_mu);
+    if (pthread_getspecific(s_key) == f) (void)pthread_setspecific(s_key, NULL);
+    free(f->path);
+    free(f);
+}
+
+/* stats_end: print the run summary (stderr and/or the JSON sink) and turn
+   statistics off. */
+void stats_end(void){
+    if (!g_stats) return;
+    double wall = secs(stats_now() - s_t0);
+    struct rusage ru;
+    memset(&ru, 0, sizeof ru);
+    (void)getrusage(RUSAGE_SELF, &ru);
+#if defined(__APPLE__)
+    long rss_kib = (long)(ru.ru_maxrss / 1024); // macOS reports bytes
+#else
+    long rss_kib = (long)ru.ru_maxrss; // Linux reports KiB
+#endif
+    double user = (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6;
+    double sys  = (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+
+    pthread_mutex_lock(&s_mu);
+    if (s_report){
+        fprintf(stderr, "stats: %llu file(s) ok, %llu failed, %llu skipped in %.3f s; "
+                        "peak RSS %ld KiB; cpu %.3f s user + %.3f s sys\n",
+                (unsigned long long)s_ok, (unsigned long long)s_failed,
+                (unsigned long long)s_count[STATS_SKIPPED], wall, rss_kib, user, sys);
+        fprintf(stderr, "  %-7s %10s %14s %10s %10s\n", "phase", "seconds", "bytes", "calls", "MiB/s");
+        for (int p = 0; p < STATS_PHASES; ++p){
+            double t = secs(s_ns[p]);
+            fprintf(stderr, "  %-7s %10.4f %14llu %10llu", s_phase_name[p], t,
+                    (unsigned long long)s_bytes[p], (unsigned long long)s_calls[p]);
+            if (s_bytes[p] && t > 0) fprintf(stderr, " %10.1f\n", (double)s_bytes[p] / (1024.0 * 1024.0) / t);
+            else fprintf(stderr, " %10s\n", "-");
+        }
+        fprintf(stderr, "  chunks %llu; calls: read %llu, write %llu",
+                (unsigned long long)s_count[STATS_CHUNKS],
+                (unsigned long long)s_calls[STATS_READ], (unsigned long long)s_calls[STATS_WRITE]);
+        for (int c = STATS_SYS_OPEN; c < STATS_COUNTERS; ++c)
+            fprintf(stderr, ", %s %llu", s_count_name[c], (unsigned long long)s_count[c]);
+        fprintf(stderr, "\n");
+    }
+    if (s_json){
+        fprintf(s_json, "{\"type\":\"summary\",\"wall_s\":%.6f,\"files_ok\":%llu,\"files_failed\":%llu,"
+                        "\"files_skipped\":%llu,\"chunks\":%llu,\"peak_rss_kib\":%ld,\"user_s\":%.6f,\"sys_s\":%.6f,"
+                        "\"phases\":{",
+                wall, (unsigned long long)s_ok, (unsigned long long)s_failed,
+                (unsigned long long)s_count[STATS_SKIPPED], (unsigned long long)s_count[STATS_CHUNKS],
+                rss_kib, user, sys);
+        for (int p = 0; p < STATS_PHASES; ++p)
+            fprintf(s_json, "%s\"%s\":{\"s\":%.6f,\"bytes\":%llu,\"calls\":%llu}", p ? "," : "",
+                    s_phase_name[p], secs(s_ns[p]), (unsigned long long)s_bytes[p], (unsigned long long)s_calls[p]);
+        fprintf(s_json, "},\"syscalls\":{\"read\":%llu,\"write\":%llu",
+                (unsigned long long)s_calls[STATS_READ], (unsigned long long)s_calls[STATS_WRITE]);
+        for (int c = STATS_SYS_OPEN; c < STATS_COUNTERS; ++c)
+            fprintf(s_json, ",\"%s\":%llu", s_count_name[c], (unsigned long long)s_count[c]);
+        fprintf(s_json, "}}\n");
+        if (s_json != stderr) fclose(s_json);
+        s_json = NULL;
+    }
+    pthread_mutex_unlock(&s_mu);
+    g_stats = 0;
+}
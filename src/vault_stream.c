@@ -2,169 +2,513 @@
 
 /* write_all: write exactly n bytes from buf to stream f.
    Returns 0 on success (all bytes written), -1 on short write/error. */
-/* Read Any File In Binary Form and Store Its Data Into buff Variable */
 static int write_all(FILE *f, const void *buf, size_t n){
     return fwrite(buf, 1, n, f) == n ? 0 : -1; // attempt full write and check count
 }
-/* read_all: read exactly n bytes from stream f into buf.
-   Returns 0 on success (all bytes read), -1 on short read/error. */
-static int read_all(FILE *f, void *buf, size_t n){
-    return fread(buf, 1, n, f) == n ? 0 : -1; // attempt full read and check count
-}
 
-/* encrypt_file_stream: streamed encryption using libsodium secretstream.
-   - Derives a key via Argon2id (from pwd + salt in header)
-   - Binds header fields as AAD
-   - Streams chunks with constant memory and final tag
-   Writes result to out_path. Returns 0 on success, -1 on failure. */
-int encrypt_file_stream(const char *in_path, const char *out_path, char *pwd){
-    FILE *in = fopen(in_path, "rb"); // open input for reading
-    if (!in){ perror("fopen in"); return -1; } // fail if cannot open
-    FILE *out = fopen(out_path, "wb"); // open output for writing
-    if (!out){ perror("fopen out"); fclose(in); return -1; } // clean up input on failure
+/* stream_chunk_for: plaintext bytes per chunk for a file of `size` bytes
+   (recorded in the header, so any choice decrypts). --chunk-size wins;
+   otherwise tiny files get one small chunk (small decrypt buffers), mid
+   sizes keep the 64 KiB default and large files use 256 KiB-8 MiB chunks
+   to cut per-chunk tag, nonce and syscall overhead. */
+uint32_t stream_chunk_for(uint64_t size){
+    if (g_chunk_size) return g_chunk_size; // explicit override
+    if (size < STREAM_CHUNK){ // tiny: smallest power of two holding it in one chunk
+        uint32_t c = STREAM_CHUNK_MIN;
+        while (c <= size) c <<= 1;
+        return c;
+    }
+    if (size < STREAM_PARALLEL_MIN)        return STREAM_CHUNK;
+    if (size < ((uint64_t)16  << 20))      return 256 * 1024;
+    if (size < ((uint64_t)256 << 20))      return 1024 * 1024;
+    if (size < ((uint64_t)2   << 30))      return 4 * 1024 * 1024;
+    return 8 * 1024 * 1024;
+}
 
-    stream_hdr_t hdr;
-    memcpy(hdr.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)); // set streaming magic
-    hdr.version       = STREAMSEAL_VERSION; // set format version
-    hdr.kdf_mem_kib   = (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024); // record KDF mem
-    hdr.kdf_opslimit  = (uint32_t) crypto_pwhash_OPSLIMIT_MODERATE; // record KDF ops
-    randombytes_buf(hdr.salt, sizeof hdr.salt); // generate salt
+/* stream_hdr_new: start a current-version header for one file: the given
+   layout `flags`, `plain_size` and `chunk_size`, and a random payload key in
+   `key`, wrapped into key slot 0 under the run's master key (run salt and
+   KDF params from the session). The caller fills ss_header and then
+   serializes with stream_hdr_encode. Returns 0 on success, -1 on failure. */
+int stream_hdr_new(stream_hdr_t *h, uint32_t flags, uint64_t plain_size, uint32_t chunk_size, char *pwd,
+                   unsigned char key[crypto_kdf_KEYBYTES]){
+    memset(h, 0, sizeof *h);
+    h->version    = STREAMSEAL_VERSION; // set format version
+    h->flags      = flags; // layout
+    h->chunk_size = chunk_size; // plaintext bytes per chunk
+    h->plain_size = plain_size; // pinned size (chunked layout)
+    randombytes_buf(key, crypto_kdf_KEYBYTES); // this file's payload key
 
-    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
-    if (crypto_pwhash(key, sizeof key,
-                      pwd, strlen(pwd),
-                      hdr.salt,
-                      crypto_pwhash_OPSLIMIT_MODERATE,
-                      crypto_pwhash_MEMLIMIT_MODERATE,
-                      crypto_pwhash_ALG_ARGON2ID13) != 0){
+    unsigned char salt[16], master[crypto_kdf_KEYBYTES];
+    uint32_t ops = 0, mem = 0;
+    int rc = -1;
+    if (session_encrypt_params(pwd, salt, &ops, &mem) == 0 && // run salt + KDF params
+        session_master_key(pwd, salt, ops, mem, master) == 0) // cached after the first file
+        rc = stream_slot_seal(h, 0, master, salt, ops, mem, key); // wrap into slot 0
+    sodium_memzero(master, sizeof master); // scrub local copy
+    if (rc != 0){
+        sodium_memzero(key, crypto_kdf_KEYBYTES);
         fprintf(stderr, "KDF failed\n");
-        fclose(in); fclose(out); // close streams on failure
         return -1;
     }
-    sodium_memzero(pwd, strlen(pwd)); /* done with password */ // scrub pwd promptly
+    return 0;
+}
 
-    crypto_secretstream_xchacha20poly1305_state st;
-    if (crypto_secretstream_xchacha20poly1305_init_push(&st, hdr.ss_header, key) != 0){
-        fprintf(stderr, "secretstream init_push failed\n");
-        sodium_memzero(key, sizeof key); // scrub key on failure
-        fclose(in); fclose(out); // close streams
+/* Transform state for the pipelined secretstream loops (--pipeline). */
+typedef struct {
+    crypto_secretstream_xchacha20poly1305_state *st;
+    const stream_hdr_t *h;
+    uint64_t off, end, pos;      /* decrypt window and plaintext position */
+} stream_xform_t;
+
+/* seal_chunk: pipeline transform for encryption; the short (EOF) read
+   becomes the FINAL chunk, exactly as in push_stdio. */
+static int seal_chunk(void *ctx, const unsigned char *in, size_t n, int eof,
+                      unsigned char *out, size_t *out_len, int *done){
+    stream_xform_t *x = ctx;
+    unsigned char tag = eof ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0; // mark final chunk
+    unsigned long long clen = 0ULL;
+    uint64_t t = stats_now();
+    if (crypto_secretstream_xchacha20poly1305_push(x->st, out, &clen, in, n, x->h->raw, x->h->aad_len, tag) != 0){
+        fprintf(stderr, "crypto_secretstream push failed\n");
         return -1;
     }
+    stats_add(STATS_CRYPT, t, n);
+    stats_count(STATS_CHUNKS, 1);
+    *out_len = (size_t)clen;
+    *done = eof; // nothing follows the final chunk
+    return 0;
+}
 
-    /* AAD = header prefix (binds magic+version+KDF params+salt) */
-    const unsigned char *aad = (const unsigned char *)&hdr; // point to header bytes
-    const size_t aad_len = offsetof(stream_hdr_t, ss_header); // AAD excludes ss_header
+/* open_chunk: pipeline transform for decryption; authenticates one frame
+   and keeps only its overlap with the [off, end) window. End of input
+   before the FINAL tag is an error. */
+static int open_chunk(void *ctx, const unsigned char *in, size_t n, int eof,
+                      unsigned char *out, size_t *out_len, int *done){
+    stream_xform_t *x = ctx;
+    if (n == 0){ // input ended between frames
+        fprintf(stderr, "decryption failed (truncated stream: no FINAL tag)\n");
+        return -1;
+    }
+    unsigned long long plen = 0ULL;
+    unsigned char tag = 0;
+    uint64_t t = stats_now();
+    if (crypto_secretstream_xchacha20poly1305_pull(x->st, out, &plen, &tag, in, n, x->h->raw, x->h->aad_len) != 0){
+        fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+        return -1;
+    }
+    stats_add(STATS_CRYPT, t, plen);
+    stats_count(STATS_CHUNKS, 1);
+    uint64_t lo = x->off > x->pos ? x->off - x->pos : 0; // first wanted byte in chunk
+    uint64_t hi = x->end - x->pos < plen ? x->end - x->pos : plen; // one past last wanted byte
+    if (lo >= hi) hi = lo = 0; // chunk entirely outside the window
+    if (lo > 0) memmove(out, out + lo, (size_t)(hi - lo)); // window starts mid-chunk
+    *out_len = (size_t)(hi - lo);
+    x->pos += plen;
+    *done = (tag & crypto_secretstream_xchacha20poly1305_TAG_FINAL) || x->pos >= x->end;
+    if (!*done && eof){
+        fprintf(stderr, "decryption failed (truncated stream: no FINAL tag)\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* push_pipelined: same output as push_stdio, with reading and writing on
+   their own threads (vault_pipeline.c). Returns 0 or -1. */
+static int push_pipelined(FILE *in, FILE *out, const stream_hdr_t *h, crypto_secretstream_xchacha20poly1305_state *st){
+    if (write_all(out, h->raw, h->raw_len) != 0){ // header first
+        perror("write header");
+        return -1;
+    }
+    stream_xform_t x = { st, h, 0, 0, 0 };
+    return pipeline_run(in, out, h->chunk_size, (size_t)h->chunk_size + crypto_secretstream_xchacha20poly1305_ABYTES,
+                        1, seal_chunk, &x); // plaintext in
+}
+
+/* push_stdio: write header `h` and the secretstream chunks of `in` to `out`
+   through stdio buffers. Returns 0 on success, -1 on failure. */
+static int push_stdio(FILE *in, FILE *out, const stream_hdr_t *h, crypto_secretstream_xchacha20poly1305_state *st){
+    const unsigned char *aad = h->raw; // point to header bytes
+    const size_t aad_len = h->aad_len; // AAD excludes ss_header
 
     /* write full header first (includes ss_header) */
-    if (write_all(out, &hdr, sizeof hdr) != 0){
+    if (write_all(out, h->raw, h->raw_len) != 0){
         perror("write header");
-        sodium_memzero(key, sizeof key); // scrub key
-        fclose(in); fclose(out); // close streams
         return -1;
     }
 
-    unsigned char inbuf[STREAM_CHUNK]; // chunk buffer for plaintext
-    unsigned char outbuf[STREAM_CHUNK + crypto_secretstream_xchacha20poly1305_ABYTES]; // ciphertext chunk
+    const size_t cs = h->chunk_size; // plaintext bytes per chunk (header-recorded)
+    unsigned char *inbuf = buf_alloc(cs, BUF_SECRET); // chunk buffer for plaintext (locked, pooled)
+    unsigned char *outbuf = buf_alloc(cs + crypto_secretstream_xchacha20poly1305_ABYTES, BUF_PLAIN); // ciphertext chunk
     int rc = -1; // default to failure
+    if (!inbuf || !outbuf){ fprintf(stderr, "out of memory\n"); buf_free(inbuf); buf_free(outbuf); return -1; }
 
     // Stream loop: read plaintext chunks, push encrypted chunks.
     for (;;) {
-        size_t n = fread(inbuf, 1, sizeof inbuf, in); // read next chunk
+        uint64_t t = stats_now();
+        size_t n = fread(inbuf, 1, cs, in); // read next chunk
         if (ferror(in)){ perror("fread"); break; } // stop on read error
+        stats_add(STATS_READ, t, n);
 
         unsigned char tag = feof(in) ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0; // mark final chunk
         unsigned long long clen = 0ULL;
 
+        t = stats_now();
         if (crypto_secretstream_xchacha20poly1305_push(
-                &st, outbuf, &clen, inbuf, n, aad, aad_len, tag) != 0){
+                st, outbuf, &clen, inbuf, n, aad, aad_len, tag) != 0){
             fprintf(stderr, "crypto_secretstream push failed\n");
             break;
         }
+        stats_add(STATS_CRYPT, t, n);
+        stats_count(STATS_CHUNKS, 1);
+        t = stats_now();
         if (write_all(out, outbuf, (size_t)clen) != 0){
             perror("write chunk");
             break;
         }
+        stats_add(STATS_WRITE, t, clen);
         if (feof(in)){ rc = 0; break; } // done after writing final chunk
     }
+    buf_free(inbuf); buf_free(outbuf); // plaintext is wiped on release
+    return rc;
+}
 
-    sodium_memzero(key, sizeof key); // scrub key
+/* stream_sealed_size: secretstream payload size for `len` plaintext bytes
+   in `cs`-byte chunks: every full chunk, then a final chunk holding the
+   remainder (possibly empty), each with one ABYTES tag.
+   Returns 0 on size overflow. */
+size_t stream_sealed_size(size_t len, size_t cs){
+    const size_t ab = crypto_secretstream_xchacha20poly1305_ABYTES;
+    size_t n = len / cs + 1; // chunk count incl. final
+    if (n > (SIZE_MAX - len) / ab) return 0; // would not fit in size_t
+    return len + n * ab;
+}
+
+/* stream_push_buf: seal `len` bytes of `src` as a whole secretstream payload
+   into `dst` (stream_sealed_size(len, h->chunk_size) bytes), header `h`
+   bound as AAD.
+   Used when both sides are in memory (mapped files, batched small files).
+   Returns 0 on success, -1 on failure. */
+int stream_push_buf(crypto_secretstream_xchacha20poly1305_state *st, const stream_hdr_t *h,
+                    const unsigned char *src, size_t len, unsigned char *dst){
+    const size_t cs = h->chunk_size; // plaintext bytes per chunk
+    const size_t nfull = len / cs; // full chunks before the final one
+    for (size_t i = 0; i <= nfull; ++i){
+        size_t n = (i < nfull) ? cs : len - nfull * cs; // remainder last
+        unsigned char tag = (i == nfull) ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : 0;
+        unsigned long long clen = 0ULL;
+        if (crypto_secretstream_xchacha20poly1305_push(st, dst, &clen,
+                src ? src + i * cs : NULL, n, h->raw, h->aad_len, tag) != 0){
+            fprintf(stderr, "crypto_secretstream push failed\n");
+            return -1;
+        }
+        dst += clen;
+    }
+    return 0;
+}
+
+/* push_mapped: same output as push_stdio, but the input is mmap'd and each
+   chunk is sealed straight into a preallocated mapping of the output, so
+   payload bytes are never copied through stdio buffers. Returns 0 or -1. */
+static int push_mapped(int in_fd, int out_fd, const stream_hdr_t *h, crypto_secretstream_xchacha20poly1305_state *st){
+    vault_map_t im, om;
+    if (map_fd_input(in_fd, &im) != 0) return -1;
+
+    const size_t sealed = stream_sealed_size(im.len, h->chunk_size);
+    if (sealed == 0 || sealed > SIZE_MAX - h->raw_len){ unmap_file(&im, 0); return -1; } // size overflow
+    const size_t out_len = h->raw_len + sealed; // exact ciphertext size
+    if (map_fd_output(out_fd, out_len, &om) != 0){ unmap_file(&im, 0); return -1; }
+
+    memcpy(om.base, h->raw, h->raw_len); // header first
+    uint64_t t = stats_now();
+    int rc = stream_push_buf(st, h, im.base, im.len, om.base + h->raw_len);
+    stats_add(STATS_CRYPT, t, im.len); // page faults do the I/O, so it lands here too
+    stats_count(STATS_CHUNKS, im.len / h->chunk_size + 1);
+
+    unmap_file(&im, 0);
+    if (unmap_file(&om, rc == 0 ? out_len : 0) != 0) rc = -1; // drop output on failure
+    return rc;
+}
+
+/* close_streams: close the input, then commit the output if `rc` is 0
+   (fsync + rename, grouped in directory runs) or drop it. Returns the
+   final status. */
+static int close_streams(FILE *in, vault_out_t *o, int rc){
+    uint64_t t = stats_now();
     fclose(in); // close input
-    if (fclose(out) != 0) rc = -1; // close output and propagate error if any
-    return rc; // 0 on success, -1 on failure
+    stats_count(STATS_SYS_CLOSE, 1);
+    if (rc == 0) rc = out_commit(o); // output appears whole or not at all
+    else out_abort(o);
+    stats_add(STATS_CLOSE, t, 0);
+    return rc;
+}
+
+/* encrypt_file_stream: streamed encryption using libsodium secretstream.
+   - Uses a random per-file payload key, wrapped in the header under the
+     run's master key (one Argon2id per run, see vault_session.c)
+   - Binds header fields as AAD
+   - Streams chunks with constant memory and final tag
+   - With g_use_mmap (--mmap) input and output are memory-mapped; with
+     g_pipeline (--pipeline) reads and writes overlap the crypto
+   Regular files of STREAM_PARALLEL_MIN bytes or more use the chunk-independent
+   layout instead, so their chunks can be sealed on all cores. With g_codec
+   (--compress) every file is a compressed secretstream (vault_compress.c),
+   written by the buffered loop.
+   Writes result to out_path. Returns 0 on success, -1 on failure. */
+int encrypt_file_stream(const char *in_path, const char *out_path, char *pwd){
+    struct stat sb;
+    int known = stat(in_path, &sb) == 0 && S_ISREG(sb.st_mode); // size known up front
+    if (known && sb.st_size >= STREAM_PARALLEL_MIN && g_codec == CODEC_NONE)
+        return encrypt_file_chunked(in_path, out_path, pwd, chunk_threads()); // large file: parallel chunks
+
+    FILE *in = fopen(in_path, "rb"); // open input for reading
+    if (!in){ perror("fopen in"); return -1; } // fail if cannot open
+    stats_count(STATS_SYS_OPEN, 1);
+    vault_out_t o; // temp output, renamed over out_path on success
+    FILE *out = out_open(&o, out_path, g_use_mmap) == 0 ? out_stream(&o, g_use_mmap ? "w+b" : "wb") : NULL;
+    if (!out){ out_abort(&o); fclose(in); return -1; } // clean up input on failure
+
+    stream_hdr_t hdr;
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    uint32_t cs = known ? stream_chunk_for((uint64_t)sb.st_size) : stream_chunk_for(STREAM_CHUNK); // unknown: default
+    uint32_t flags = (uint32_t)g_codec << STREAM_CODEC_SHIFT; // compression (0 = off)
+    if (stream_hdr_new(&hdr, flags, 0, cs, pwd, key) != 0){ // header fields + file key
+        sodium_memzero(key, sizeof key); // scrub partial key
+        fclose(in); out_abort(&o); // close streams on failure
+        return -1;
+    }
+
+    crypto_secretstream_xchacha20poly1305_state st;
+    if (crypto_secretstream_xchacha20poly1305_init_push(&st, hdr.ss_header, key) != 0 ||
+        stream_hdr_encode(&hdr) != 0){ // AAD = header prefix (binds every field before ss_header)
+        fprintf(stderr, "secretstream init_push failed\n");
+        sodium_memzero(key, sizeof key); // scrub key on failure
+        fclose(in); out_abort(&o); // close streams, drop the temp
+        return -1;
+    }
+
+    int rc = g_codec     ? stream_push_codec(in, out, &hdr, &st) // variable-length frames
+           : g_use_mmap  ? push_mapped(fileno(in), fileno(out), &hdr, &st) // zero-copy path
+           : g_pipeline ? push_pipelined(in, out, &hdr, &st) // overlapped read/crypt/write
+                        : push_stdio(in, out, &hdr, &st); // buffered path
+
+    sodium_memzero(key, sizeof key); // scrub key
+    sodium_memzero(&st, sizeof st); // scrub stream state
+    return close_streams(in, &o, rc); // 0 on success, -1 on failure
+}
+
+/* stream_opened_size: plaintext size of a `clen`-byte secretstream payload
+   in `cs`-byte chunks (one ABYTES per frame, the last one may be short).
+   Returns 0 and sets *out, or -1 if no valid stream has that length. */
+int stream_opened_size(size_t clen, size_t cs, size_t *out){
+    const size_t ab = crypto_secretstream_xchacha20poly1305_ABYTES;
+    const size_t frame = cs + ab; // sealed chunk size
+    if (clen < ab) return -1; // not even a final chunk
+    size_t nframes = (clen + frame - 1) / frame; // last frame may be short
+    if (clen - (nframes - 1) * frame < ab) return -1; // trailing fragment cannot hold a tag
+    *out = clen - nframes * ab;
+    return 0;
+}
+
+/* stream_pull_buf: open a whole in-memory secretstream payload `src` of
+   `clen` bytes into `dst` (stream_opened_size bytes). The stream must end
+   with TAG_FINAL exactly at its last frame. Bytes already written to `dst`
+   are unauthenticated on failure; callers discard them.
+   Returns 0 on success, -1 on failure. */
+int stream_pull_buf(const stream_hdr_t *h, const unsigned char *key,
+                    const unsigned char *src, size_t clen, unsigned char *dst){
+    const size_t frame = (size_t)h->chunk_size + crypto_secretstream_xchacha20poly1305_ABYTES;
+    size_t plain;
+    if (stream_opened_size(clen, h->chunk_size, &plain) != 0){
+        fprintf(stderr, "decryption failed (truncated stream)\n");
+        return -1;
+    }
+    const size_t nframes = (clen + frame - 1) / frame;
+
+    crypto_secretstream_xchacha20poly1305_state st;
+    if (crypto_secretstream_xchacha20poly1305_init_pull(&st, h->ss_header, key) != 0){
+        fprintf(stderr, "secretstream init_pull failed\n");
+        return -1;
+    }
+    unsigned char empty[1]; // target for an all-empty stream (dst may be NULL)
+    if (!dst) dst = empty;
+    int rc = -1; // default to failure
+    for (size_t i = 0; i < nframes; ++i){
+        size_t n = (i + 1 < nframes) ? frame : clen - i * frame; // short last frame
+        unsigned long long plen = 0ULL;
+        unsigned char tag = 0;
+        if (crypto_secretstream_xchacha20poly1305_pull(&st, dst, &plen, &tag, src, n,
+                                                       h->raw, h->aad_len) != 0){
+            fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
+            break;
+        }
+        src += n; dst += plen;
+        int final = (tag & crypto_secretstream_xchacha20poly1305_TAG_FINAL) != 0;
+        if (final != (i + 1 == nframes)){ // FINAL must be the last frame, and only it
+            fprintf(stderr, "decryption failed (truncated or extended stream)\n");
+            break;
+        }
+        if (final) rc = 0;
+    }
+    sodium_memzero(&st, sizeof st); // scrub stream state
+    return rc;
+}
+
+/* pull_mapped: secretstream decryption of a mapped input (header `h`
+   already parsed) straight into a mapped output sized from the payload
+   length. On any failure the output is truncated to 0 bytes.
+   Returns 0 on success, -1 on failure. */
+static int pull_mapped(int in_fd, int out_fd, const stream_hdr_t *h, const unsigned char *key){
+    vault_map_t im, om;
+    if (map_fd_input(in_fd, &im) != 0) return -1;
+    size_t out_len = 0;
+    if (im.len < h->raw_len || stream_opened_size(im.len - h->raw_len, h->chunk_size, &out_len) != 0){
+        fprintf(stderr, "decryption failed (truncated stream)\n");
+        unmap_file(&im, 0);
+        return -1;
+    }
+    if (map_fd_output(out_fd, out_len, &om) != 0){ unmap_file(&im, 0); return -1; }
+
+    uint64_t t = stats_now();
+    int rc = stream_pull_buf(h, key, im.base + h->raw_len, im.len - h->raw_len, om.base);
+    stats_add(STATS_CRYPT, t, out_len); // page faults do the I/O, so it lands here too
+    stats_count(STATS_CHUNKS, out_len / h->chunk_size + 1);
+
+    unmap_file(&im, 0);
+    if (unmap_file(&om, rc == 0 ? out_len : 0) != 0) rc = -1; // drop plaintext on failure
+    return rc;
 }
 
 /* decrypt_file_stream: streamed decryption for secretstream format.
-   - Reads and validates header (magic/version)
-   - KDF using recorded params from header
+   - Reads and validates header (magic/version; v1..v4 accepted)
+   - Chunk-independent files (STREAM_FLAG_CHUNKED) go to decrypt_chunked
+     (decrypt_chunked_resume with g_resume)
+   - Key from the session cache using the recorded salt/params (v2/v3 add
+     the per-file subkey step, v4 unwraps a key slot)
    - Binds same header bytes as AAD
    - Pulls chunks until FINAL tag
+   - With g_use_mmap (--mmap) input and output are memory-mapped; with
+     g_pipeline (--pipeline) reads and writes overlap the crypto
    Writes plaintext to out_path. Returns 0 on success, -1 on failure. */
 int decrypt_file_stream(const char *in_path, const char *out_path, char *pwd){
     FILE *in = fopen(in_path, "rb"); // open input for reading
     if (!in){ perror("fopen in"); return -1; } // fail if cannot open
-    FILE *out = fopen(out_path, "wb"); // open output for writing
-    if (!out){ perror("fopen out"); fclose(in); return -1; } // clean up input on failure
+    stats_count(STATS_SYS_OPEN, 1);
+    vault_out_t o; // temp output, renamed over out_path on success
+    FILE *out = out_open(&o, out_path, g_use_mmap) == 0 ? out_stream(&o, g_use_mmap ? "w+b" : "wb") : NULL;
+    if (!out){ out_abort(&o); fclose(in); return -1; } // clean up input on failure
 
     stream_hdr_t hdr;
-    if (read_all(in, &hdr, sizeof hdr) != 0){
-        fprintf(stderr, "short or missing header\n");
-        fclose(in); fclose(out); // close streams
-        return -1;
-    }
-    if (memcmp(hdr.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)) != 0 ||
-        hdr.version != STREAMSEAL_VERSION){
-        fprintf(stderr, "bad magic/version (not StreamSeal)\n");
-        fclose(in); fclose(out); // close streams
+    if (stream_hdr_read(in, &hdr) != 0){ // parse v1 or v2 header
+        fprintf(stderr, "bad or short header (not StreamSeal)\n");
+        fclose(in); out_abort(&o); // close streams, drop the temp
         return -1;
     }
 
     unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
-    if (crypto_pwhash(key, sizeof key,
-                      pwd, strlen(pwd),
-                      hdr.salt,
-                      (unsigned long long)hdr.kdf_opslimit,
-                      (size_t)hdr.kdf_mem_kib * 1024ULL,
-                      crypto_pwhash_ALG_ARGON2ID13) != 0){
+    if (session_file_key(pwd, &hdr, key, sizeof key) != 0){ // cached master -> file key
         fprintf(stderr, "KDF failed\n");
-        fclose(in); fclose(out); // close streams
+        fclose(in); out_abort(&o); // close streams, drop the temp
         return -1;
     }
-    sodium_memzero(pwd, strlen(pwd)); /* done with password */ // scrub pwd promptly
 
+    // Chunk-independent layout: open every chunk in parallel with pread/pwrite.
+    if (hdr.flags & STREAM_FLAG_CHUNKED){
+        if (g_resume){ // journaled partial output instead of the temp
+            out_abort(&o);
+            int rc = decrypt_chunked_resume(in, out_path, &hdr, key, chunk_threads());
+            sodium_memzero(key, sizeof key); // scrub key
+            fclose(in);
+            return rc;
+        }
+        int rc = decrypt_chunked(in, out, &hdr, key, chunk_threads());
+        sodium_memzero(key, sizeof key); // scrub key
+        return close_streams(in, &o, rc);
+    }
+
+    int rc = g_use_mmap && !STREAM_CODEC(hdr.flags) ? pull_mapped(fileno(in), fileno(out), &hdr, key) // zero-copy path
+                        : decrypt_stream_range(in, out, &hdr, key, 0, UINT64_MAX); // whole stream
+
+    sodium_memzero(key, sizeof key); // scrub key
+    return close_streams(in, &o, rc); // 0 on success, -1 on failure
+}
+
+/* decrypt_stream_range: pull secretstream chunks from `in` (positioned just
+   after header `h`) and write plaintext bytes [off, off + len) to `out`.
+   Every chunk is authenticated before any of it is written; the loop stops
+   once the window is complete. Input that ends before the FINAL chunk is
+   an error. A NULL `out` only authenticates (vault verify): plaintext is
+   dropped in the reused chunk buffer. Compressed files go to stream_pull_codec.
+   Returns 0 on success, -1 on failure. */
+int decrypt_stream_range(FILE *in, FILE *out, const stream_hdr_t *h, const unsigned char *key,
+                         uint64_t off, uint64_t len){
+    if (STREAM_CODEC(h->flags)) return stream_pull_codec(in, out, h, key, off, len); // variable-length frames
     crypto_secretstream_xchacha20poly1305_state st;
-    if (crypto_secretstream_xchacha20poly1305_init_pull(&st, hdr.ss_header, key) != 0){
+    if (crypto_secretstream_xchacha20poly1305_init_pull(&st, h->ss_header, key) != 0){
         fprintf(stderr, "secretstream init_pull failed\n");
-        sodium_memzero(key, sizeof key); // scrub key
-        fclose(in); fclose(out); // close streams
         return -1;
     }
 
-    const unsigned char *aad = (const unsigned char *)&hdr; // same header AAD as on encrypt
-    const size_t aad_len = offsetof(stream_hdr_t, ss_header); // AAD excludes ss_header
+    const unsigned char *aad = h->raw; // same header AAD as on encrypt
+    const size_t aad_len = h->aad_len; // AAD excludes ss_header
+    const uint64_t end = (len > UINT64_MAX - off) ? UINT64_MAX : off + len; // window end (saturating)
 
-    unsigned char inbuf[STREAM_CHUNK + crypto_secretstream_xchacha20poly1305_ABYTES]; // ciphertext chunk
-    unsigned char outbuf[STREAM_CHUNK]; // plaintext chunk
+    if (g_pipeline && out){ // overlapped read/crypt/write (vault_pipeline.c)
+        stream_xform_t x = { &st, h, off, end, 0 };
+        int prc = off >= end ? 0 // empty window
+                : pipeline_run(in, out, (size_t)h->chunk_size + crypto_secretstream_xchacha20poly1305_ABYTES,
+                               h->chunk_size, 0, open_chunk, &x); // plaintext out
+        sodium_memzero(&st, sizeof st); // scrub stream state
+        return prc;
+    }
+
+    const size_t cs = h->chunk_size; // header-recorded (bounded by stream_hdr_parse)
+    const size_t frame = cs + crypto_secretstream_xchacha20poly1305_ABYTES; // ciphertext chunk size
+    unsigned char *inbuf = buf_alloc(frame, BUF_PLAIN); // ciphertext chunk
+    unsigned char *outbuf = buf_alloc(cs, BUF_SECRET); // plaintext chunk (locked, pooled)
+    uint64_t pos = 0; // plaintext offset of outbuf[0]
     int rc = -1; // default to failure
+    if (!inbuf || !outbuf){
+        fprintf(stderr, "out of memory\n");
+        buf_free(inbuf); buf_free(outbuf);
+        sodium_memzero(&st, sizeof st);
+        return -1;
+    }
 
     // Stream loop: read encrypted chunks, pull into plaintext and write out.
     for (;;) {
-        size_t n = fread(inbuf, 1, sizeof inbuf, in); // read next ciphertext chunk
+        if (pos >= end) { rc = 0; break; } // window complete
+        uint64_t t = stats_now();
+        size_t n = fread(inbuf, 1, frame, in); // read next ciphertext chunk
         if (n == 0){
-            if (feof(in)) { rc = 0; break; } /* clean EOF only if FINAL already seen */ // allow EOF if final was processed
-            perror("fread"); break; // read error
+            if (feof(in)) fprintf(stderr, "decryption failed (stream ended before its FINAL chunk)\n"); // truncated
+            else perror("fread"); // read error
+            break;
         }
+        stats_add(STATS_READ, t, n);
 
         unsigned long long plen = 0ULL;
         unsigned char tag = 0;
+        t = stats_now();
         if (crypto_secretstream_xchacha20poly1305_pull(
                 &st, outbuf, &plen, &tag, inbuf, (unsigned long long)n, aad, aad_len) != 0){
             fprintf(stderr, "decryption failed (wrong password or corrupted data)\n");
             break;
         }
-        if (write_all(out, outbuf, (size_t)plen) != 0){
+        stats_add(STATS_CRYPT, t, plen);
+        stats_count(STATS_CHUNKS, 1);
+
+        // Emit the part of this chunk that overlaps [off, end).
+        uint64_t lo = off > pos ? off - pos : 0; // first wanted byte in chunk
+        uint64_t hi = end - pos < plen ? end - pos : plen; // one past last wanted byte
+        if (!out) lo = hi; // verify: nothing to emit
+        t = stats_now();
+        if (lo < hi && write_all(out, outbuf + lo, (size_t)(hi - lo)) != 0){
             perror("write chunk");
             break;
         }
+        if (lo < hi) stats_add(STATS_WRITE, t, hi - lo);
+        pos += plen;
         if (tag & crypto_secretstream_xchacha20poly1305_TAG_FINAL){
             /* Next read should be EOF; we accept it and stop */
             rc = 0; // mark success after final tag
@@ -172,9 +516,63 @@ int decrypt_file_stream(const char *in_path, const char *out_path, char *pwd){
         }
     }
 
-    sodium_memzero(key, sizeof key); // scrub key
-    fclose(in); // close input
-    if (fclose(out) != 0) rc = -1; // close output, propagate error if close fails
+    buf_free(inbuf); buf_free(outbuf); // plaintext is wiped on release
+    sodium_memzero(&st, sizeof st); // scrub stream state
     return rc; // 0 on success, -1 on failure
 }
 
+/* encrypt_pipe: secretstream-encrypt everything on `in` to `out` (stdin to
+   stdout for `vault encrypt -`). The size is unknown up front, so the
+   header gets the default chunk size (or --chunk-size) and the chunk that
+   hits EOF is the FINAL one, as for any non-regular input.
+   Returns 0 on success, -1 on failure. */
+int encrypt_pipe(FILE *in, FILE *out, char *pwd){
+    stream_hdr_t hdr;
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    uint32_t flags = (uint32_t)g_codec << STREAM_CODEC_SHIFT; // compression (0 = off)
+    if (stream_hdr_new(&hdr, flags, 0, stream_chunk_for(STREAM_CHUNK), pwd, key) != 0){ // header fields + file key
+        sodium_memzero(key, sizeof key);
+        return -1;
+    }
+
+    crypto_secretstream_xchacha20poly1305_state st;
+    int rc = -1;
+    if (crypto_secretstream_xchacha20poly1305_init_push(&st, hdr.ss_header, key) != 0 ||
+        stream_hdr_encode(&hdr) != 0) // AAD = header prefix
+        fprintf(stderr, "secretstream init_push failed\n");
+    else
+        rc = g_codec    ? stream_push_codec(in, out, &hdr, &st)
+           : g_pipeline ? push_pipelined(in, out, &hdr, &st) : push_stdio(in, out, &hdr, &st);
+
+    sodium_memzero(key, sizeof key); // scrub key
+    sodium_memzero(&st, sizeof st); // scrub stream state
+    if (fflush(out) != 0){ perror("write"); rc = -1; } // e.g. EPIPE downstream
+    return rc;
+}
+
+/* decrypt_pipe: decrypt a StreamSeal stream read from `in` in one forward
+   pass to `out` (stdin to stdout for `vault decrypt -`). Each chunk's
+   plaintext is written only after that chunk authenticates. Input that
+   ends before the FINAL chunk (secretstream) or before the chunk count
+   the header pins (chunked layout) fails, but earlier chunks have already
+   been written by then. Returns 0 on success, -1 on failure. */
+int decrypt_pipe(FILE *in, FILE *out, char *pwd){
+    stream_hdr_t hdr;
+    if (stream_hdr_read(in, &hdr) != 0){ // legacy SIMPL1 needs the whole file: not streamable
+        fprintf(stderr, "bad or short header (not a StreamSeal stream)\n");
+        return -1;
+    }
+
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if (session_file_key(pwd, &hdr, key, sizeof key) != 0){ // cached master -> file key
+        fprintf(stderr, "KDF failed\n");
+        return -1;
+    }
+
+    int rc = (hdr.flags & STREAM_FLAG_CHUNKED)
+           ? decrypt_chunked_seq(in, out, &hdr, key) // independent chunks, read in order
+           : decrypt_stream_range(in, out, &hdr, key, 0, UINT64_MAX); // whole stream
+    sodium_memzero(key, sizeof key); // scrub key
+    if (fflush(out) != 0){ perror("write"); rc = -1; }
+    return rc;
+}
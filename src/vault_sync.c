@@ -0,0 +1,339 @@
+#if defined(__linux__)
+#define _DEFAULT_SOURCE /* realpath() */
+#endif
+#include "../include/header.h"
+
+/* Incremental sync (`vault sync <src> <dst>`).
+
+   Mirrors the regular files under `src` into `dst` as `<rel>.enc` and
+   keeps a manifest of what was encrypted: per source path its size,
+   mtime and ctime (nanoseconds), and with --hash a BLAKE2b hash of the
+   contents keyed with a random per-destination key. A re-run only
+   encrypts files that are new, whose metadata changed, or whose output
+   is missing, and removes the outputs of sources that are gone, so a
+   nightly run costs one stat per unchanged file instead of a full
+   re-encryption. With --hash a file whose metadata changed but whose
+   size and hash did not (touched, restored with new times) is not
+   re-encrypted either.
+
+   The manifest lives at dst/SYNC_MANIFEST and is itself a StreamSeal
+   stream of text lines, so paths, sizes and the hash key stay secret:
+
+       streamseal-manifest 1
+       key <hex>
+       F <size> <mtime_ns> <ctime_ns> <hash hex or -> <path>
+
+   It is rewritten crash-safe after the run's outputs are durable, so a
+   crash leaves the previous manifest and at worst re-encrypts files. */
+
+#define SYNC_MAGIC "streamseal-manifest 1"
+
+/* One manifest entry (a source file and its output). */
+typedef struct {
+    char    *path;        /* relative to the source directory */
+    uint64_t size;
+    int64_t  mtime, ctime; /* nanoseconds */
+    unsigned char hash[SYNC_HASH_BYTES];
+    int      hashed;      /* hash is valid */
+    int      seen;        /* present in this run (else pruned) */
+} sync_ent_t;
+
+/* Run state; also the path_walk context. */
+typedef struct {
+    sync_ent_t *e;
+    size_t n, cap;
+    size_t n_old;         /* entries loaded from the manifest (sorted) */
+    unsigned char key[crypto_generichash_KEYBYTES]; /* content hash key */
+    size_t root_len;      /* strip this prefix (the source directory) */
+    const char *dst;
+    size_t dst_len;
+    char  *pwd;
+    int    hash;          /* --hash */
+    size_t encrypted, unchanged, pruned, failed;
+} sync_t;
+
+/* ent_cmp: order entries by path (qsort/bsearch). */
+static int ent_cmp(const void *a, const void *b){
+    return strcmp(((const sync_ent_t *)a)->path, ((const sync_ent_t *)b)->path);
+}
+
+/* ent_find: the manifest entry for `rel`, or NULL. */
+static sync_ent_t *ent_find(sync_t *s, const char *rel){
+    sync_ent_t k;
+    k.path = (char *)rel;
+    return s->n_old ? bsearch(&k, s->e, s->n_old, sizeof *s->e, ent_cmp) : NULL;
+}
+
+/* ent_add: append an entry for `rel` (fields zeroed). NULL when out of memory. */
+static sync_ent_t *ent_add(sync_t *s, const char *rel){
+    if (s->n == s->cap){
+        size_t cap = s->cap ? s->cap * 2 : 256;
+        sync_ent_t *e = realloc(s->e, cap * sizeof *e);
+        if (!e){ fprintf(stderr, "sync: out of memory\n"); return NULL; }
+        s->e = e; s->cap = cap;
+    }
+    sync_ent_t *e = &s->e[s->n];
+    memset(e, 0, sizeof *e);
+    size_t len = strlen(rel);
+    if (!(e->path = malloc(len + 1))){ fprintf(stderr, "sync: out of memory\n"); return NULL; }
+    memcpy(e->path, rel, len + 1);
+    s->n++;
+    return e;
+}
+
+/* out_name: destination path of source `rel`: dst/rel.enc. */
+static int out_name(const sync_t *s, const char *rel, char *out, size_t cap){
+    int n = snprintf(out, cap, "%.*s/%s.enc", (int)s->dst_len, s->dst, rel);
+    return n > 0 && (size_t)n < cap ? 0 : -1;
+}
+
+/* same_meta: non-zero if `a` and `b` show the same size, mtime and ctime. */
+static int same_meta(const struct stat *a, const struct stat *b){
+    return a->st_size == b->st_size && ST_NS(*a, st_mtim) == ST_NS(*b, st_mtim) &&
+           ST_NS(*a, st_ctim) == ST_NS(*b, st_ctim);
+}
+
+/* hash_file: keyed BLAKE2b of the contents of `path`. Fails unless the
+   file still has the metadata in `was` afterwards, so a hash is never
+   recorded for contents other than the ones the metadata stands for. */
+static int hash_file(const char *path, const unsigned char *key, const struct stat *was,
+                     unsigned char out[SYNC_HASH_BYTES]){
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0){ perror(path); return -1; }
+    stats_count(STATS_SYS_OPEN, 1);
+    crypto_generichash_state st;
+    crypto_generichash_init(&st, key, crypto_generichash_KEYBYTES, SYNC_HASH_BYTES);
+    unsigned char buf[64 * 1024];
+    int rc = 0;
+    for (;;){
+        uint64_t t = stats_now();
+        ssize_t n = read(fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0){ perror(path); rc = -1; break; }
+        if (n == 0) break;
+        stats_add(STATS_READ, t, (uint64_t)n);
+        crypto_generichash_update(&st, buf, (unsigned long long)n);
+    }
+    struct stat now;
+    if (rc == 0 && (fstat(fd, &now) != 0 || !same_meta(&now, was))) rc = -1; // changed while hashing
+    close(fd);
+    stats_count(STATS_SYS_CLOSE, 1);
+    if (rc == 0) crypto_generichash_final(&st, out, SYNC_HASH_BYTES);
+    sodium_memzero(buf, sizeof buf); // scrub plaintext
+    sodium_memzero(&st, sizeof st);
+    return rc;
+}
+
+/* manifest_parse: load the decrypted manifest text `buf` (NUL-terminated). */
+static int manifest_parse(sync_t *s, char *buf){
+    char *line = buf, *nl;
+    int ok = 1;
+    for (int no = 0; ok && *line && (nl = strchr(line, '\n')) != NULL; ++no, line = nl + 1){
+        *nl = '\0';
+        if (no == 0){ ok = strcmp(line, SYNC_MAGIC) == 0; continue; }
+        if (no == 1){
+            ok = strncmp(line, "key ", 4) == 0 &&
+                 sodium_hex2bin(s->key, sizeof s->key, line + 4, strlen(line + 4), NULL, NULL, NULL) == 0;
+            continue;
+        }
+        unsigned long long size = 0;
+        long long mt = 0, ct = 0;
+        char hex[2 * SYNC_HASH_BYTES + 1];
+        int at = 0;
+        ok = sscanf(line, "F %llu %lld %lld %64s%n", &size, &mt, &ct, hex, &at) == 4 &&
+             line[at] == ' ' && line[at + 1] != '\0';
+        sync_ent_t *e = ok ? ent_add(s, line + at + 1) : NULL;
+        if (!e){ ok = 0; continue; }
+        e->size = size; e->mtime = mt; e->ctime = ct;
+        e->hashed = strcmp(hex, "-") != 0;
+        if (e->hashed)
+            ok = sodium_hex2bin(e->hash, sizeof e->hash, hex, strlen(hex), NULL, NULL, NULL) == 0;
+    }
+    if (!ok || *line){ fprintf(stderr, "sync: malformed manifest\n"); return -1; }
+    qsort(s->e, s->n, sizeof *s->e, ent_cmp); // written sorted; sorted again for bsearch
+    s->n_old = s->n;
+    return 0;
+}
+
+/* manifest_load: read `path` into `s`; a missing manifest starts empty
+   with a fresh hash key. */
+static int manifest_load(sync_t *s, const char *path){
+    FILE *in = fopen(path, "rb");
+    if (!in){
+        if (errno != ENOENT){ perror(path); return -1; }
+        randombytes_buf(s->key, sizeof s->key); // first run into this destination
+        return 0;
+    }
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *mem = open_memstream(&buf, &len);
+    if (!mem){ perror("open_memstream"); fclose(in); return -1; }
+    int rc = decrypt_pipe(in, mem, s->pwd);
+    fclose(in);
+    fclose(mem);
+    if (rc == 0) rc = manifest_parse(s, buf);
+    else fprintf(stderr, "%s: cannot read the manifest (remove it to re-encrypt everything)\n", path);
+    if (buf) sodium_memzero(buf, len); // scrub paths and the hash key
+    free(buf);
+    return rc;
+}
+
+/* manifest_save: write the entries still present to `path`, atomically. */
+static int manifest_save(sync_t *s, const char *path){
+    qsort(s->e, s->n, sizeof *s->e, ent_cmp);
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *mem = open_memstream(&buf, &len);
+    if (!mem){ perror("open_memstream"); return -1; }
+    char hex[2 * sizeof s->key + 1];
+    sodium_bin2hex(hex, sizeof hex, s->key, sizeof s->key);
+    fprintf(mem, "%s\nkey %s\n", SYNC_MAGIC, hex);
+    for (size_t i = 0; i < s->n; ++i){
+        const sync_ent_t *e = &s->e[i];
+        if (!e->seen) continue; // pruned
+        if (e->hashed) sodium_bin2hex(hex, sizeof hex, e->hash, sizeof e->hash);
+        fprintf(mem, "F %llu %lld %lld %s %s\n", (unsigned long long)e->size, (long long)e->mtime,
+                (long long)e->ctime, e->hashed ? hex : "-", e->path);
+    }
+    sodium_memzero(hex, sizeof hex);
+    int rc = -1;
+    FILE *in = NULL;
+    if (fclose(mem) != 0 || !(in = fmemopen(buf, len, "rb")))
+        perror("manifest");
+    else {
+        vault_out_t o;
+        FILE *out = NULL;
+        if (out_open(&o, path, 0) == 0 && !(out = out_stream(&o, "wb"))) out_abort(&o);
+        if (out && encrypt_pipe(in, out, s->pwd) != 0) out_abort(&o);
+        else if (out) rc = out_commit(&o);
+    }
+    if (in) fclose(in);
+    if (buf) sodium_memzero(buf, len);
+    free(buf);
+    return rc;
+}
+
+/* sync_one: path_walk visitor; encrypt one source file unless the manifest
+   shows it unchanged. Per-file failures are counted, not fatal. */
+static int sync_one(const char *path, void *ctx){
+    sync_t *s = ctx;
+    const char *rel = path + s->root_len;
+    while (*rel == '/') ++rel; // relative to the source directory
+
+    struct stat st, os;
+    if (lstat(path, &st) != 0){ perror(path); s->failed++; return 0; }
+    stats_count(STATS_SYS_STAT, 1);
+    if (!S_ISREG(st.st_mode)){ stats_count(STATS_SKIPPED, 1); return 0; } // replaced meanwhile
+    char out[PATH_MAX];
+    if (strchr(rel, '\n') || out_name(s, rel, out, sizeof out) != 0){
+        fprintf(stderr, "%s: name cannot be synced\n", path);
+        s->failed++;
+        return 0;
+    }
+
+    int64_t mt = ST_NS(st, st_mtim), ct = ST_NS(st, st_ctim);
+    sync_ent_t *e = ent_find(s, rel);
+    if (e) e->seen = 1;
+    unsigned char h[SYNC_HASH_BYTES];
+    int hashed = 0;
+    if (e && e->size == (uint64_t)st.st_size && stat(out, &os) == 0){ // output still there
+        stats_count(STATS_SYS_STAT, 1);
+        if (e->mtime == mt && e->ctime == ct){
+            if (s->hash && !e->hashed) e->hashed = hash_file(path, s->key, &st, e->hash) == 0; // --hash newly on
+            s->unchanged++;
+            stats_count(STATS_SKIPPED, 1);
+            return 0;
+        }
+        hashed = s->hash && hash_file(path, s->key, &st, h) == 0;
+        if (hashed && e->hashed && sodium_memcmp(h, e->hash, sizeof h) == 0){
+            e->mtime = mt; e->ctime = ct; // same bytes, new times
+            s->unchanged++;
+            stats_count(STATS_SKIPPED, 1);
+            return 0;
+        }
+    } else if (s->hash) {
+        hashed = hash_file(path, s->key, &st, h) == 0;
+    }
+
+    if (make_parents(out, s->dst_len) != 0){ s->failed++; return 0; }
+    stats_file_t *sf = stats_file_begin(path); // --stats: per-file record
+    int rc = encrypt_file_stream(path, out, s->pwd);
+    stats_file_end(sf, rc);
+    if (rc != 0){ s->failed++; return 0; } // old output and entry stay; retried next run
+    struct stat after;
+    if (hashed && (lstat(path, &after) != 0 || !same_meta(&after, &st))) hashed = 0; // written meanwhile
+    if (!e && !(e = ent_add(s, rel))) return -1;
+    e->size = (uint64_t)st.st_size; e->mtime = mt; e->ctime = ct; // as before encrypting:
+    e->hashed = hashed; e->seen = 1;                                 // a later write shows up next run
+    if (hashed) memcpy(e->hash, h, sizeof h);
+    s->encrypted++;
+    return 0;
+}
+
+/* sync_prune: remove the outputs of manifest entries whose source is gone. */
+static void sync_prune(sync_t *s){
+    char out[PATH_MAX];
+    for (size_t i = 0; i < s->n_old; ++i){
+        sync_ent_t *e = &s->e[i];
+        if (e->seen) continue;
+        if (out_name(s, e->path, out, sizeof out) == 0 && unlink(out) != 0 && errno != ENOENT){
+            perror(out);
+            e->seen = 1; // keep it listed and try again next run
+            s->failed++;
+            continue;
+        }
+        s->pruned++;
+    }
+}
+
+/* sync_dir: bring `dst` (created if missing) up to date with the regular
+   files under `src`, encrypting only new or changed files and pruning the
+   outputs of deleted ones. `hash` also records and compares keyed content
+   hashes. Prints a one-line summary. Returns 0 when every file synced. */
+int sync_dir(const char *src, const char *dst, char *pwd, int hash){
+    struct stat st;
+    if (lstat(src, &st) != 0){ perror(src); return -1; }
+    if (!S_ISDIR(st.st_mode)){ fprintf(stderr, "%s: not a directory\n", src); return -1; }
+    int made = mkdir(dst, 0700) == 0;
+    if (!made && !(errno == EEXIST && stat(dst, &st) == 0 && S_ISDIR(st.st_mode))){
+        perror(dst);
+        return -1;
+    }
+    char rs[PATH_MAX], rd[PATH_MAX];
+    if (!realpath(src, rs) || !realpath(dst, rd)){ perror("realpath"); return -1; }
+    size_t rl = strlen(rs);
+    if (strncmp(rd, rs, rl) == 0 && (rd[rl] == '\0' || rd[rl] == '/' || rl == 1)){
+        fprintf(stderr, "%s: destination is inside the source tree\n", dst);
+        if (made) rmdir(dst);
+        return -1;
+    }
+
+    sync_t s;
+    memset(&s, 0, sizeof s);
+    s.root_len = strlen(src);
+    s.dst = dst;
+    s.dst_len = strlen(dst);
+    while (s.dst_len > 1 && dst[s.dst_len - 1] == '/') --s.dst_len; // "dst/" -> "dst"
+    s.pwd = pwd;
+    s.hash = hash;
+
+    char mpath[PATH_MAX];
+    int rc = -1;
+    if (snprintf(mpath, sizeof mpath, "%.*s/%s", (int)s.dst_len, dst, SYNC_MANIFEST) >= (int)sizeof mpath)
+        fprintf(stderr, "%s: path too long\n", dst);
+    else if (manifest_load(&s, mpath) == 0){
+        commit_begin(); // outputs share the directory-run group commit
+        int walked = path_walk(WALK_ALL, src, sync_one, &s);
+        if (commit_end() == 0){ // outputs durable: now the manifest may list them
+            if (walked == 0) sync_prune(&s); // an incomplete walk must not prune
+            rc = manifest_save(&s, mpath) == 0 && walked == 0 && s.failed == 0 ? 0 : -1;
+        }
+        printf("sync: %zu encrypted, %zu unchanged, %zu pruned, %zu failed\n",
+               s.encrypted, s.unchanged, s.pruned, s.failed);
+    }
+
+    for (size_t i = 0; i < s.n; ++i) free(s.e[i].path);
+    free(s.e);
+    sodium_memzero(s.key, sizeof s.key);
+    return rc;
+}
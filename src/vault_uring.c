@@ -0,0 +1,436 @@
+#if defined(__linux__) && defined(HAVE_IO_URING)
+#define _DEFAULT_SOURCE /* syscall(), MAP_POPULATE */
+#endif
+#include "../include/header.h"
+
+/* io_uring batch engine (--uring).
+
+   For trees of many small files the per-file syscalls (open, read, write,
+   close on both sides) cost more than the crypto. This engine keeps up to
+   `depth` files in flight on one io_uring and moves each through
+
+     OPEN_IN -> READ... -> CLOSE_IN -> (seal/open in memory) -> OPEN_OUT
+             -> WRITE... -> (committer: closed after the batch's data sync)
+
+   so one io_uring_enter submits and reaps work for many files at once.
+   Files larger than URING_FILE_MAX, legacy SIMPL1 files, chunked files and
+   compressed files (either way) are handed to the regular per-file function. Output only appears after
+   the input authenticated, and a failed write removes the partial output.
+
+   The ring is driven through raw syscalls (no liburing). Built only when
+   the makefile finds <linux/io_uring.h> (HAVE_IO_URING); otherwise, or when
+   the kernel refuses io_uring, uring_run returns -2 and the caller falls
+   back to the regular engine. */
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/* Mapped submission/completion rings of one io_uring instance. */
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void  *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+    unsigned to_submit;             /* queued SQEs not yet handed to the kernel */
+} ring_t;
+
+enum { S_FREE, S_OPEN_IN, S_READ, S_CLOSE_IN, S_OPEN_OUT, S_WRITE, S_CLOSE_FAIL };
+
+/* One file in flight. */
+typedef struct {
+    int state;
+    int fd;                          /* descriptor of the current step */
+    int fallback;                    /* too large / other format: use the regular path */
+    int out_created;                 /* temp output exists and must go on failure */
+    unsigned long seq;               /* commit_ticket of the output descriptor */
+    char path[4096], out[4096], tmp[4096]; /* input, final output, hidden temp */
+    unsigned char *ibuf, *obuf;      /* whole input, whole output */
+    size_t ilen, olen, done;         /* bytes read, bytes to write, bytes written */
+    stats_file_t *stats;             /* per-file record (--stats), or NULL */
+} slot_t;
+
+/* Engine state shared by the walk visitor and the completion handler. */
+typedef struct {
+    ring_t r;
+    slot_t *slots;
+    int depth, busy;
+    encrypt_func f;
+    char *pwd;
+    const char *suffix;
+    size_t ok, failed;
+} uring_t;
+
+static int sys_setup(unsigned entries, struct io_uring_params *p){
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+static int sys_enter(int fd, unsigned submit, unsigned wait, unsigned flags){
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+static int sys_register(int fd, unsigned op, void *arg, unsigned n){
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+/* ring_probe: non-zero if the kernel supports every opcode the engine uses. */
+static int ring_probe(int fd){
+    const size_t sz = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *p = calloc(1, sz);
+    if (!p) return 0;
+    int ok = sys_register(fd, IORING_REGISTER_PROBE, p, 256) == 0; // probe itself needs 5.6+
+    const int ops[] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE };
+    for (size_t i = 0; ok && i < sizeof ops / sizeof ops[0]; ++i)
+        ok = ops[i] <= p->last_op && (p->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    free(p);
+    return ok;
+}
+
+/* ring_close: unmap the rings and close the instance. */
+static void ring_close(ring_t *r){
+    if (r->sqes && r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr && r->cq_ptr != MAP_FAILED) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr && r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_len);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+}
+
+/* ring_open: create an io_uring with `entries` SQEs and map its rings.
+   Returns 0 on success, -1 if io_uring is unavailable. */
+static int ring_open(ring_t *r, unsigned entries){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    memset(r, 0, sizeof *r);
+    r->fd = sys_setup(entries, &p); // ENOSYS/EPERM when the kernel or a sandbox says no
+    if (r->fd < 0) return -1;
+    if (!ring_probe(r->fd)){ ring_close(r); return -1; }
+
+    r->sq_len   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len   = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    r->sqes   = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sq_ptr == MAP_FAILED || r->cq_ptr == MAP_FAILED || r->sqes == MAP_FAILED){ ring_close(r); return -1; }
+
+    unsigned char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+/* ring_sqe: queue one operation for slot `tag`. The SQ holds at least one
+   entry per slot and a slot has one operation in flight, so it never fills. */
+static void ring_sqe(ring_t *r, uint8_t op, int fd, const void *addr, unsigned len,
+                     uint64_t off, uint32_t op_flags, uint64_t tag){
+    unsigned tail = *r->sq_tail; // only this thread writes the tail
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *e = &r->sqes[idx];
+    memset(e, 0, sizeof *e);
+    e->opcode = op;
+    e->fd = fd;
+    e->addr = (uint64_t)(uintptr_t)addr;
+    e->len = len;
+    e->off = off;
+    e->open_flags = op_flags; // union with rw_flags; 0 for read/write
+    e->user_data = tag;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE); // publish the entry
+    r->to_submit++;
+    if (op == IORING_OP_OPENAT) stats_count(STATS_SYS_OPEN, 1); // reads/writes are counted on completion
+    if (op == IORING_OP_CLOSE)  stats_count(STATS_SYS_CLOSE, 1);
+}
+
+/* ---------- per-file state machine ---------- */
+
+/* target_path: output path for `in`, named like encrypt_inplace /
+   decrypt_inplace name theirs. Returns 0 on success, -1 if too long. */
+static int target_path(const uring_t *u, const char *in, char *out, size_t cap){
+    int dec = u->f == decrypt_inplace;
+    const char *ext = dec ? ((u->suffix && *u->suffix) ? u->suffix : ".dec") : ".enc";
+    if (build_path(in, ext, out, cap) != 0) return -1;
+    if (dec && strcmp(out, in) == 0){ // never overwrite the input
+        if (strlen(out) + 4 + 1 >= cap) return -1;
+        strcat(out, ".out");
+    }
+    return 0;
+}
+
+/* seal_slot: build the secretstream file for the bytes read into
+   s->ibuf; --compress sets s->fallback. Returns 0 on success, -1 on failure. */
+static int seal_slot(uring_t *u, slot_t *s){
+    if (g_codec){ s->fallback = 1; return 0; } // variable-length frames: regular path
+    stream_hdr_t h;
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    crypto_secretstream_xchacha20poly1305_state st;
+    int rc = -1;
+    if (stream_hdr_new(&h, 0, 0, stream_chunk_for(s->ilen), u->pwd, key) == 0 &&
+        crypto_secretstream_xchacha20poly1305_init_push(&st, h.ss_header, key) == 0 &&
+        stream_hdr_encode(&h) == 0){ // same file encrypt_file_stream writes
+        memcpy(s->obuf, h.raw, h.raw_len); // header first
+        s->olen = h.raw_len + stream_sealed_size(s->ilen, h.chunk_size);
+        rc = stream_push_buf(&st, &h, s->ibuf, s->ilen, s->obuf + h.raw_len);
+        if (rc == 0) stats_count(STATS_CHUNKS, s->ilen / h.chunk_size + 1);
+    }
+    sodium_memzero(key, sizeof key); // scrub key
+    sodium_memzero(&st, sizeof st); // scrub stream state
+    return rc;
+}
+
+/* open_slot: authenticate and decrypt the secretstream file read into
+   s->ibuf. Other formats set s->fallback. Returns 0 on success, -1 on failure. */
+static int open_slot(uring_t *u, slot_t *s){
+    stream_hdr_t h;
+    if (s->ilen >= sizeof MAGIC && memcmp(s->ibuf, MAGIC, sizeof MAGIC) == 0){ s->fallback = 1; return 0; } // legacy SIMPL1
+    if (stream_hdr_parse(s->ibuf, s->ilen, &h) != 0){
+        fprintf(stderr, "bad or short header (not StreamSeal)\n");
+        return -1;
+    }
+    if (h.flags & (STREAM_FLAG_CHUNKED | STREAM_CODEC_MASK)){ s->fallback = 1; return 0; } // own readers
+    if (stream_opened_size(s->ilen - h.raw_len, h.chunk_size, &s->olen) != 0){
+        fprintf(stderr, "decryption failed (truncated stream)\n");
+        return -1;
+    }
+
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    int rc = -1;
+    if (session_file_key(u->pwd, &h, key, sizeof key) != 0) fprintf(stderr, "KDF failed\n");
+    else rc = stream_pull_buf(&h, key, s->ibuf + h.raw_len, s->ilen - h.raw_len, s->obuf);
+    if (rc == 0) stats_count(STATS_CHUNKS, s->olen / h.chunk_size + 1);
+    sodium_memzero(key, sizeof key); // scrub key
+    return rc;
+}
+
+/* finish: report one file and release its slot. */
+static void finish(uring_t *u, slot_t *s, int rc){
+    if (rc == 0) u->ok++; else u->failed++;
+    printf("[%s] %s\n", rc == 0 ? " OK " : "FAIL", s->path);
+    stats_file_end(s->stats, rc);
+    s->stats = NULL;
+    sodium_memzero(s->ibuf, s->ilen); // plaintext on encrypt
+    sodium_memzero(s->obuf, s->olen); // plaintext on decrypt
+    s->state = S_FREE;
+    u->busy--;
+}
+
+/* fail: abandon the file in slot `s`, closing any open descriptor through
+   the ring first and removing a partial output. */
+static void fail(uring_t *u, slot_t *s){
+    if (s->fd >= 0 && s->state != S_CLOSE_FAIL){
+        s->state = S_CLOSE_FAIL;
+        ring_sqe(&u->r, IORING_OP_CLOSE, s->fd, NULL, 0, 0, 0, (uint64_t)(s - u->slots));
+        s->fd = -1;
+        return;
+    }
+    if (s->out_created) unlink(s->tmp); // never leave a partial result
+    finish(u, s, -1);
+}
+
+/* step: advance slot `s` after its current operation completed with `res`
+   (a byte count, a descriptor or -errno). */
+static void step(uring_t *u, slot_t *s, int res){
+    ring_t *r = &u->r;
+    const uint64_t tag = (uint64_t)(s - u->slots);
+    const size_t cap = URING_FILE_MAX;
+
+    switch (s->state){
+    case S_OPEN_IN:
+        if (res < 0){ fprintf(stderr, "open %s: %s\n", s->path, strerror(-res)); fail(u, s); return; }
+        s->fd = res;
+        s->state = S_READ;
+        ring_sqe(r, IORING_OP_READ, s->fd, s->ibuf, (unsigned)cap, 0, 0, tag); // whole file in one read, usually
+        return;
+
+    case S_READ:
+        if (res < 0){ fprintf(stderr, "read %s: %s\n", s->path, strerror(-res)); fail(u, s); return; }
+        stats_add(STATS_READ, stats_now(), (uint64_t)res); // asynchronous: bytes and calls, no time
+        s->ilen += (size_t)res;
+        if (res > 0 && s->ilen < cap){ // short read: continue until EOF
+            ring_sqe(r, IORING_OP_READ, s->fd, s->ibuf + s->ilen, (unsigned)(cap - s->ilen), s->ilen, 0, tag);
+            return;
+        }
+        if (s->ilen == cap) s->fallback = 1; // too large for the batch path
+        s->state = S_CLOSE_IN;
+        ring_sqe(r, IORING_OP_CLOSE, s->fd, NULL, 0, 0, 0, tag);
+        s->fd = -1;
+        return;
+
+    case S_CLOSE_IN: {
+        uint64_t t = stats_now();
+        int rc = s->fallback ? 0 : (u->f == decrypt_inplace ? open_slot(u, s) : seal_slot(u, s));
+        if (!s->fallback) stats_add(STATS_CRYPT, t, s->ilen);
+        if (rc != 0){ fail(u, s); return; }
+        if (s->fallback){ // regular per-file path (same report line)
+            sodium_memzero(s->ibuf, s->ilen); s->ilen = 0;
+            finish(u, s, u->f(s->path, u->pwd, u->suffix) == 0 ? 0 : -1);
+            return;
+        }
+        if (out_tmp_name(s->out, s->tmp, sizeof s->tmp) != 0){ fprintf(stderr, "path too long: %s\n", s->out); fail(u, s); return; }
+        s->state = S_OPEN_OUT; // written under a hidden name, renamed in by the committer
+        ring_sqe(r, IORING_OP_OPENAT, AT_FDCWD, s->tmp, 0600, 0, O_WRONLY | O_CREAT | O_EXCL, tag);
+        return;
+    }
+
+    case S_OPEN_OUT:
+        if (res < 0){ fprintf(stderr, "open %s: %s\n", s->out, strerror(-res)); fail(u, s); return; }
+        s->fd = res;
+        s->seq = commit_ticket();
+        s->out_created = 1;
+        s->state = S_WRITE;
+        res = 0; // nothing written yet
+        /* fall through */
+    case S_WRITE:
+        if (res < 0){ fprintf(stderr, "write %s: %s\n", s->out, strerror(-res)); fail(u, s); return; }
+        if (res > 0) stats_add(STATS_WRITE, stats_now(), (uint64_t)res); // asynchronous: bytes and calls, no time
+        s->done += (size_t)res;
+        if (s->done < s->olen){
+            ring_sqe(r, IORING_OP_WRITE, s->fd, s->obuf + s->done, (unsigned)(s->olen - s->done), s->done, 0, tag);
+            return;
+        }
+        s->out_created = 0; // the committer owns the temp and its descriptor now
+        finish(u, s, commit_named(s->fd, s->seq, s->tmp, s->out, g_delete_on_success ? s->path : NULL)); // --rm once durable
+        s->fd = -1;
+        return;
+
+    case S_CLOSE_FAIL:
+        fail(u, s);
+        return;
+    }
+}
+
+/* reap: submit queued operations, wait for at least `wait` completions and
+   advance every slot that completed. Returns 0, or -1 if the ring broke. */
+static int reap(uring_t *u, unsigned wait){
+    ring_t *r = &u->r;
+    for (;;){
+        int n = sys_enter(r->fd, r->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+        stats_count(STATS_SYS_URING, 1);
+        if (n < 0 && errno == EINTR) continue; // retry interrupted waits
+        if (n < 0){ perror("io_uring_enter"); return -1; }
+        r->to_submit = (unsigned)n >= r->to_submit ? 0 : r->to_submit - (unsigned)n; // kernel took n
+        break;
+    }
+
+    unsigned head = *r->cq_head; // only this thread moves the head
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail){
+        struct io_uring_cqe *c = &r->cqes[head & *r->cq_mask];
+        uint64_t tag = c->user_data;
+        int res = c->res;
+        __atomic_store_n(r->cq_head, ++head, __ATOMIC_RELEASE); // hand the CQE back first
+        stats_file_attach(u->slots[tag].stats); // account the step (and any fallback) to its file
+        step(u, &u->slots[tag], res); // may queue the slot's next operation
+        stats_file_attach(NULL);
+        tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    return 0;
+}
+
+/* admit: path_walk visitor. Waits for a free slot and starts the file. */
+static int admit(const char *file, void *ctx){
+    uring_t *u = ctx;
+    while (u->busy == u->depth)
+        if (reap(u, 1) != 0) return -1; // let in-flight files make room
+
+    slot_t *s = NULL;
+    for (int i = 0; i < u->depth && !s; ++i)
+        if (u->slots[i].state == S_FREE) s = &u->slots[i];
+
+    s->fd = -1; s->fallback = 0; s->out_created = 0;
+    s->ilen = s->olen = s->done = 0;
+    s->stats = stats_file_begin(file); // --stats: per-file record, attached per step
+    stats_file_attach(NULL);
+    u->busy++;
+    if (strlen(file) >= sizeof s->path || target_path(u, file, s->out, sizeof s->out) != 0){
+        snprintf(s->path, sizeof s->path, "%s", file);
+        fprintf(stderr, "path too long: %s\n", file);
+        finish(u, s, -1);
+        return 0; // keep going, like the pool
+    }
+    strcpy(s->path, file);
+    s->state = S_OPEN_IN;
+    ring_sqe(&u->r, IORING_OP_OPENAT, AT_FDCWD, s->path, 0, 0, O_RDONLY, (uint64_t)(s - u->slots));
+    if (u->r.to_submit >= (unsigned)u->depth / 2 + 1) return reap(u, 0); // submit in batches
+    return 0;
+}
+
+/* depth_fit: cap `depth` so its descriptors fit under RLIMIT_NOFILE next
+   to the group commit's queued outputs and the walker's directory window.
+   The soft limit is raised toward the hard one first when that is needed. */
+static int depth_fit(int depth){
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY) return depth;
+    const rlim_t reserved = COMMIT_GROUP_MAX + WALK_OPEN_MAX + URING_FD_SPARE;
+    const rlim_t need = reserved + (rlim_t)depth;
+    if (rl.rlim_cur < need && rl.rlim_cur < rl.rlim_max){
+        rlim_t cur = rl.rlim_cur;
+        rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || rl.rlim_max > need ? need : rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) rl.rlim_cur = cur; // keep the old limit
+    }
+    if (rl.rlim_cur >= need) return depth;
+    int fit = rl.rlim_cur > reserved ? (int)(rl.rlim_cur - reserved) : 1;
+    fprintf(stderr, "uring: RLIMIT_NOFILE %llu allows %d files in flight, not %d\n",
+            (unsigned long long)rl.rlim_cur, fit, depth);
+    return fit;
+}
+
+/* uring_run: process every file under `path` with up to `depth` files in
+   flight on one io_uring. Like the pool it does not stop at the first
+   failure and prints a per-file report and a summary.
+   Returns 0 if every file succeeded, -1 otherwise, and -2 (before touching
+   any file) when io_uring is not available. */
+int uring_run(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix, int depth){
+    if (depth < 1) depth = 1;
+    if (depth > URING_DEPTH_MAX) depth = URING_DEPTH_MAX;
+    depth = depth_fit(depth); // one descriptor per slot
+
+    uring_t u;
+    memset(&u, 0, sizeof u);
+    u.f = f; u.pwd = pwd; u.suffix = suffix; u.depth = depth;
+    if (ring_open(&u.r, (unsigned)depth) != 0) return -2; // kernel or sandbox refuses io_uring
+
+    const size_t obuf_cap = STREAM_HDR_MAX + stream_sealed_size(URING_FILE_MAX, STREAM_CHUNK_MIN); // worst case: most tags
+    u.slots = calloc((size_t)depth, sizeof *u.slots);
+    int rc = u.slots ? 0 : -1;
+    const int dec = f == decrypt_inplace; // plaintext is the output, not the input
+    for (int i = 0; rc == 0 && i < depth; ++i){
+        u.slots[i].ibuf = buf_alloc(URING_FILE_MAX, dec ? BUF_PLAIN : BUF_SECRET);
+        u.slots[i].obuf = buf_alloc(obuf_cap, dec ? BUF_SECRET : BUF_PLAIN);
+        if (!u.slots[i].ibuf || !u.slots[i].obuf) rc = -1;
+    }
+    if (rc != 0){
+        fprintf(stderr, "uring: out of memory\n");
+    } else {
+        int walked = path_walk(walk, path, admit, &u); // feed files as slots free up
+        while (u.busy > 0) // drain
+            if (reap(&u, 1) != 0) break;
+        printf("%zu file(s): %zu ok, %zu failed (io_uring, depth %d)\n", u.ok + u.failed, u.ok, u.failed, depth);
+        if (walked != 0 || u.failed || u.busy) rc = -1;
+    }
+
+    for (int i = 0; u.slots && i < depth; ++i){ buf_free(u.slots[i].ibuf); buf_free(u.slots[i].obuf); }
+    free(u.slots);
+    ring_close(&u.r);
+    return rc;
+}
+
+#else /* no io_uring on this platform */
+
+/* uring_run: io_uring is not available in this build. */
+int uring_run(encrypt_func f, unsigned walk, const char *path, char *pwd, const char *suffix, int depth){
+    (void)f; (void)walk; (void)path; (void)pwd; (void)suffix; (void)depth;
+    return -2; // caller falls back to the regular engine
+}
+
+#endif
@@ -5,15 +5,83 @@
 void usage(const char *prog) {
     fprintf(stderr,  // print a multi-line formatted usage message
         "Usage:\n"
-        "  %s init-user\n"
-        "  %s encrypt <path> [--rm]\n"
-        "  %s decrypt <path> [suffix] [--rm]\n"
+        "  %s init-user [--kdf-profile P]\n"
+        "  %s encrypt <path> [--rm] [--jobs N] [--mmap|--pipeline] [--uring]\n"
+        "          [--chunk-size S] [--compress C] [--cipher C] [--inode-order] [--stats]\n"
+        "          [--resume] [--stats-json F]\n"
+        "  %s decrypt <path> [suffix] [--rm] [--jobs N] [--mmap|--pipeline] [--uring]\n"
+        "          [--resume] [--inode-order] [--stats] [--stats-json F]\n"
+        "  %s cat <file> [--offset X] [--length Y] [--pipeline]\n"
+        "  %s pack <dir> <out.seal> [--chunk-size S] [--inode-order] [--stats]\n"
+        "  %s unpack <in.seal> <dir> [--stats]\n"
+        "  %s verify <path> [--jobs N] [--inode-order] [--stats]\n"
+        "  %s sync <src> <dst> [--hash] [--chunk-size S] [--compress C] [--cipher C]\n"
+        "          [--stats]\n"
+        "  %s migrate <path> [--jobs N] [--inode-order] [--stats]\n"
+        "  %s rekey <path>\n"
+        "  %s agent [--ttl S] | agent stop\n"
+        "  %s calibrate [--target-ms N] [--max-mem S] [--kdf-profile F]\n"
         "\n"
         "Options:\n"
         "  --rm, --delete   Remove source on success (opt-in)\n"
-        "\n"
+        "  -j, --jobs N     Process directory files with N worker threads\n"
+        "                   (0 = one per CPU, max 1024); prints a per-file report\n"
+        "  --uring          Batch many small files through io_uring (Linux;\n"
+        "                   falls back to the regular engine if unavailable)\n"
+        "  --uring-depth D  Files in flight for --uring (default 64, max 1024)\n"
+        "  --chunk-size S   encrypt: plaintext bytes per chunk, 4K..16M\n"
+        "                   (default: picked per file size, stored in header)\n"
+        "  --compress C     encrypt: compress each chunk before sealing it,\n"
+        "                   C = zstd[:1-19] or lz4[:1-12] (decrypt detects it)\n"
+        "  --cipher C       encrypt: AEAD for chunked files (4 MiB and up), C = auto,\n"
+        "                   xchacha20, aes256gcm or aegis256 (auto = AEGIS-256\n"
+        "                   or AES-256-GCM on CPUs with AES instructions)\n"
+        "  --resume         Journal chunked files (4 MiB and up) so a run that\n"
+        "                   was interrupted continues where it stopped; files\n"
+        "                   whose output is already there are skipped\n"
+        "  --pipeline       Overlap reading, crypto and writing of each file\n"
+        "                   on separate threads (helps slow disks/NFS)\n"
+        "  --mmap           Memory-map input and output files instead of\n"
+        "                   copying them through read/write buffers\n"
+        "  --inode-order    Visit each directory's entries in inode order\n"
+        "                   (better locality on HDD-backed volumes)\n"
+        "  --stats          Print per-phase time, bytes and call counts,\n"
+        "                   files ok/failed/skipped and peak RSS to stderr\n"
+        "  --stats-json F   Write one JSON line per file and a summary line\n"
+        "                   to F (\"-\" = stderr)\n"
+        "  --hash           sync: also keep keyed BLAKE2b content hashes, so\n"
+        "                   touched but unmodified files are not re-encrypted\n"
+        "  --ttl S          agent: seconds to keep the keys (default 3600)\n"
+        "  --kdf-profile P  Argon2id limits for new keys (encrypt, init-user,\n"
+        "                   rekey, ...): a profile file or interactive,\n"
+        "                   moderate, sensitive (default: ./kdf.profile if\n"
+        "                   present, else moderate); calibrate: file to write\n"
+        "  --target-ms N    calibrate: time per Argon2id stretch (default 500)\n"
+        "  --max-mem S      calibrate: Argon2id memory cap, K/M/G suffix\n"
+        "                   (default: RAM/8, at most 1G; 8M..2G)\n"
+        "  --no-agent       Ask for the password even if an agent is running\n"
+        "  --offset X       cat: first plaintext byte to print (default 0)\n"
+        "  --length Y       cat: number of bytes to print (default: to EOF)\n"
+        "\n",
+        prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog); // substitute executable name in all lines
+    fprintf(stderr,  // notes (a second string: C99 only guarantees 4095-byte literals)
         "Notes:\n"
+        "  • <path> \"-\" means stdin -> stdout (encrypt and decrypt), e.g.\n"
+        "    tar c dir | %s encrypt - > dir.tar.enc\n"
+        "  • pack/unpack: \"-\" as the container means stdout/stdin.\n"
+        "  • verify: checks every .enc file authenticates in full, writing\n"
+        "    nothing; directories use one worker per CPU unless --jobs is given.\n"
+        "  • sync: re-runs encrypt only new or changed files into <dst> and\n"
+        "    remove outputs whose source is gone (manifest in <dst>).\n"
+        "  • migrate: re-encrypts legacy SIMPL1 .enc files into the streamed\n"
+        "    format in place; directories use one worker per CPU by default.\n"
+        "  • rekey: changes the password of user.pass and of every encrypted\n"
+        "    file under <path> by rewriting only their headers.\n"
+        "  • agent: asks for the password once and serves its Argon2id keys to\n"
+        "    your later commands over a private socket until --ttl expires.\n"
+        "  • calibrate: times Argon2id on this host and writes the limits that\n"
+        "    fit --target-ms within --max-mem; decrypt reads them from each file.\n"
         "  • Symlinks and special files (devices, fifos, sockets) are skipped.\n",
-        prog, prog, prog); // substitute executable name in all lines
+        prog); // substitute executable name in all lines
 }
 
@@ -0,0 +1,60 @@
+#include "../include/header.h"
+
+/* verify_stream: authenticate every chunk of the StreamSeal file open on
+   `in` without writing plaintext anywhere. */
+static int verify_stream(FILE *in, char *pwd){
+    stream_hdr_t hdr;
+    if (stream_hdr_read(in, &hdr) != 0){ // parse v1..v4 header
+        fprintf(stderr, "bad or short header (not StreamSeal)\n");
+        return -1;
+    }
+
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if (session_file_key(pwd, &hdr, key, sizeof key) != 0){ // cached master -> file key
+        fprintf(stderr, "KDF failed\n");
+        return -1;
+    }
+
+    int rc;
+    if (hdr.flags & STREAM_FLAG_CHUNKED){
+        rc = decrypt_chunked(in, NULL, &hdr, key, chunk_threads()); // size pinned by the header
+    } else {
+        rc = decrypt_stream_range(in, NULL, &hdr, key, 0, UINT64_MAX); // up to the FINAL chunk
+        if (rc == 0 && fgetc(in) != EOF){
+            fprintf(stderr, "data after the FINAL chunk\n");
+            rc = -1;
+        }
+    }
+    sodium_memzero(key, sizeof key); // scrub key
+    return rc;
+}
+
+/* verify_file: check that `in_path` decrypts and authenticates in full
+   under `pwd` (streamed or legacy SIMPL1), discarding the plaintext, so
+   an integrity audit costs reads only. Nothing is written. `garbage` is
+   unused (encrypt_func signature, for the worker pool).
+   Returns 0 if the file is intact, -1 otherwise. */
+int verify_file(const char *in_path, char *pwd, const char *garbage){
+    (void)garbage;
+    if (!in_path || !pwd) return -1;
+
+    unsigned char m[6];
+    int rc;
+    stats_file_t *st = stats_file_begin(in_path); // --stats: per-file record
+    if (read_magic(in_path, m) == 0 && memcmp(m, MAGIC, 6) == 0){
+        rc = decrypt_file(in_path, NULL, pwd); // legacy: one AEAD over the whole file
+    } else {
+        FILE *in = fopen(in_path, "rb");
+        if (!in){
+            perror(in_path);
+            rc = -1;
+        } else {
+            stats_count(STATS_SYS_OPEN, 1);
+            rc = verify_stream(in, pwd);
+            fclose(in);
+            stats_count(STATS_SYS_CLOSE, 1);
+        }
+    }
+    stats_file_end(st, rc);
+    return rc == 0 ? 0 : -1;
+}
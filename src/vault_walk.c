@@ -0,0 +1,330 @@
+#if defined(__linux__)
+#define _DEFAULT_SOURCE /* DT_* types, syscall() */
+#endif
+#include "../include/header.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+/* Directory walker.
+
+   Iterative depth-first walk with an explicit stack of open directory
+   descriptors: children are reached with openat/fstatat relative to their
+   parent, so neither the depth of the tree nor the length of its paths is
+   limited by a fixed buffer or by PATH_MAX. The path handed to the visitor
+   is built in a growable buffer. (The per-file operations still open that
+   path by name, so a file whose full path exceeds PATH_MAX is reported as
+   failed instead of being skipped.)
+
+   Each directory is read in one go with getdents64 (readdir elsewhere).
+   The entry type comes from d_type, so fstatat is only issued for entries
+   the filesystem reports as DT_UNKNOWN. With g_walk_inode_order
+   (--inode-order) a directory's entries are visited in inode order, which
+   roughly follows on-disk layout on HDD-backed ext4/XFS volumes.
+
+   At most WALK_OPEN_MAX descriptors stay open. Deeper ancestors are closed
+   and reopened through ".." on the way back up; their device and inode are
+   checked so a directory moved during the walk is reported, not silently
+   replaced. */
+
+#define WALK_BUF      (32 * 1024)  /* getdents64 buffer */
+
+enum { WT_UNKNOWN, WT_REG, WT_DIR, WT_OTHER };
+
+/* One directory entry; `name` indexes the frame's name arena. */
+typedef struct {
+    uint64_t ino;
+    size_t   name;
+    int      type;     /* WT_* */
+} walk_ent_t;
+
+/* One directory on the stack. */
+typedef struct {
+    int     dfd;        /* descriptor, or -1 while closed (deep trees) */
+    dev_t   dev;
+    ino_t   ino;        /* identity, checked when reopened through ".." */
+    size_t  path_len;   /* length of this directory's path in the buffer */
+    walk_ent_t *ents;
+    size_t  n, next, cap; /* entries read, next to visit, allocated */
+    char   *names;      /* NUL-terminated names */
+    size_t  names_len, names_cap;
+} walk_frame_t;
+
+/* Walk state: the stack and the visitor's path buffer. */
+typedef struct {
+    walk_frame_t *st;
+    size_t depth, cap;
+    char  *path;
+    size_t path_cap;
+} walker_t;
+
+/* path_fit: make room for `len` bytes plus NUL in the path buffer. */
+static int path_fit(walker_t *w, size_t len){
+    if (len < w->path_cap) return 0;
+    size_t cap = w->path_cap ? w->path_cap : 256;
+    while (cap <= len) cap *= 2;
+    char *p = realloc(w->path, cap);
+    if (!p){ fprintf(stderr, "walk: out of memory\n"); return -1; }
+    w->path = p; w->path_cap = cap;
+    return 0;
+}
+
+/* path_child: set the path buffer to `parent_len` bytes + "/" + `name`. */
+static int path_child(walker_t *w, size_t parent_len, const char *name){
+    size_t nlen = strlen(name);
+    int slash = parent_len == 0 || w->path[parent_len - 1] != '/'; // "dir/" stays "dir/name"
+    if (path_fit(w, parent_len + slash + nlen) != 0) return -1;
+    if (slash) w->path[parent_len] = '/';
+    memcpy(w->path + parent_len + slash, name, nlen + 1);
+    return 0;
+}
+
+/* ent_type: map a d_type to WT_*. */
+static int ent_type(unsigned char d_type){
+#if defined(DT_UNKNOWN)
+    switch (d_type){
+    case DT_REG:     return WT_REG;
+    case DT_DIR:     return WT_DIR;
+    case DT_UNKNOWN: return WT_UNKNOWN;
+    default:         return WT_OTHER; // symlinks, devices, FIFOs, sockets
+    }
+#else
+    (void)d_type;
+    return WT_UNKNOWN;
+#endif
+}
+
+/* frame_add: record one entry (skips "." and ".."). */
+static int frame_add(walk_frame_t *fr, const char *name, uint64_t ino, int type){
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) return 0;
+    size_t nlen = strlen(name) + 1;
+    if (fr->names_len + nlen > fr->names_cap){
+        size_t cap = fr->names_cap ? fr->names_cap * 2 : 1024;
+        while (cap < fr->names_len + nlen) cap *= 2;
+        char *p = realloc(fr->names, cap);
+        if (!p) return -1;
+        fr->names = p; fr->names_cap = cap;
+    }
+    if (fr->n == fr->cap){
+        size_t cap = fr->cap ? fr->cap * 2 : 16;
+        walk_ent_t *p = realloc(fr->ents, cap * sizeof *p);
+        if (!p) return -1;
+        fr->ents = p; fr->cap = cap;
+    }
+    memcpy(fr->names + fr->names_len, name, nlen);
+    fr->ents[fr->n].ino = ino;
+    fr->ents[fr->n].name = fr->names_len;
+    fr->ents[fr->n].type = type;
+    fr->n++;
+    fr->names_len += nlen;
+    return 0;
+}
+
+#if defined(__linux__) && defined(SYS_getdents64)
+/* Kernel record returned by getdents64. */
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+#endif
+
+/* frame_read: read every entry of the frame's directory. */
+static int frame_read(walk_frame_t *fr){
+    uint64_t t = stats_now();
+#if defined(__linux__) && defined(SYS_getdents64)
+    char *buf = malloc(WALK_BUF);
+    if (!buf) return -1;
+    for (;;){
+        long n = syscall(SYS_getdents64, fr->dfd, buf, WALK_BUF);
+        if (n < 0){ free(buf); return -1; }
+        if (n == 0) break;
+        for (long off = 0; off < n; ){
+            const struct linux_dirent64 *d = (const struct linux_dirent64 *)(buf + off);
+            if (frame_add(fr, d->d_name, d->d_ino, ent_type(d->d_type)) != 0){ free(buf); return -1; }
+            off += d->d_reclen;
+        }
+    }
+    free(buf);
+#else
+    int fd = dup(fr->dfd); // closedir closes it; the frame keeps its own
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir){ if (fd >= 0) close(fd); return -1; }
+    struct dirent *e;
+    errno = 0;
+    while ((e = readdir(dir)) != NULL){
+#if defined(DT_UNKNOWN)
+        int type = ent_type(e->d_type);
+#else
+        int type = WT_UNKNOWN;
+#endif
+        if (frame_add(fr, e->d_name, (uint64_t)e->d_ino, type) != 0){ closedir(dir); return -1; }
+    }
+    int err = errno;
+    closedir(dir);
+    if (err){ errno = err; return -1; }
+#endif
+    stats_add(STATS_WALK, t, 0);
+    return 0;
+}
+
+/* by_inode: qsort order for --inode-order. */
+static int by_inode(const void *a, const void *b){
+    uint64_t x = ((const walk_ent_t *)a)->ino, y = ((const walk_ent_t *)b)->ino;
+    return x < y ? -1 : x > y;
+}
+
+/* walk_push: push directory `dfd` (owned) whose path is the first
+   `path_len` bytes of the path buffer, and read its entries. */
+static int walk_push(walker_t *w, int dfd, size_t path_len){
+    if (w->depth == w->cap){
+        size_t cap = w->cap ? w->cap * 2 : 16;
+        walk_frame_t *p = realloc(w->st, cap * sizeof *p);
+        if (!p){ close(dfd); fprintf(stderr, "walk: out of memory\n"); return -1; }
+        w->st = p; w->cap = cap;
+    }
+    walk_frame_t *fr = &w->st[w->depth++];
+    memset(fr, 0, sizeof *fr);
+    fr->dfd = dfd;
+    fr->path_len = path_len;
+    struct stat st;
+    if (fstat(dfd, &st) != 0 || frame_read(fr) != 0){
+        w->path[path_len] = '\0';
+        fprintf(stderr, "%s: %s\n", w->path, strerror(errno));
+        return -1;
+    }
+    stats_count(STATS_SYS_STAT, 1);
+    fr->dev = st.st_dev; fr->ino = st.st_ino;
+    if (g_walk_inode_order) qsort(fr->ents, fr->n, sizeof *fr->ents, by_inode);
+
+    // Keep a bounded window of descriptors: close the ancestor falling out of it.
+    if (w->depth > WALK_OPEN_MAX){
+        walk_frame_t *old = &w->st[w->depth - 1 - WALK_OPEN_MAX];
+        if (old->dfd >= 0){ close(old->dfd); old->dfd = -1; stats_count(STATS_SYS_CLOSE, 1); }
+    }
+    return 0;
+}
+
+/* walk_pop: drop the top frame, reopening its parent through ".." if the
+   parent's descriptor was closed. */
+static int walk_pop(walker_t *w){
+    walk_frame_t *top = &w->st[w->depth - 1];
+    int rc = 0;
+    if (w->depth > 1 && w->st[w->depth - 2].dfd < 0){
+        walk_frame_t *up = &w->st[w->depth - 2];
+        struct stat st;
+        up->dfd = openat(top->dfd, "..", O_RDONLY | O_DIRECTORY);
+        stats_count(STATS_SYS_OPEN, 1);
+        if (up->dfd < 0 || fstat(up->dfd, &st) != 0 || st.st_dev != up->dev || st.st_ino != up->ino){
+            w->path[up->path_len] = '\0';
+            fprintf(stderr, "%s: directory moved during the walk\n", w->path);
+            rc = -1;
+        }
+    }
+    if (top->dfd >= 0){ close(top->dfd); stats_count(STATS_SYS_CLOSE, 1); }
+    free(top->ents); free(top->names);
+    w->depth--;
+    return rc;
+}
+
+/* skip_file: files a walk with filter `walk` never visits (see path_walk). */
+static int skip_file(unsigned walk, const char *name){
+    return strcmp(name, "user.pass") == 0 ||                              /* never touch creds */
+           strcmp(name, KDF_PROFILE_FILE) == 0 ||                         // calibrate output
+           strncmp(name, OUT_TMP_PREFIX, strlen(OUT_TMP_PREFIX)) == 0 || // uncommitted output
+           ((walk & WALK_NO_MANIFEST) && strcmp(name, SYNC_MANIFEST) == 0) || // sync bookkeeping
+           ((walk & WALK_NO_ENC) && ends_with(name, ".enc")) ||           // already encrypted
+           ((walk & WALK_NO_DEC) && ends_with(name, ".dec")) ||           // decrypt output
+           ((walk & WALK_ENC_ONLY) && !ends_with(name, ".enc"));          // ciphertext only
+}
+
+/* path_walk: visit every regular file under `path` that filter `walk`
+   (WALK_*) admits, calling `visit(file, ctx)` for each.
+   - Regular files: always skips user.pass, kdf.profile and uncommitted output
+     temps; WALK_ENCRYPT also skips .enc files, WALK_DECRYPT .dec files, and
+     WALK_CIPHERTEXT (verify, migrate) visits .enc files only. Sync manifests
+     are left to whole-tree walks (WALK_ALL), which copy or rekey them like
+     any other file.
+   - Directories: walked depth-first without recursion (skips . and ..).
+   - Skips symlinks/devices/FIFOs/sockets: only regular files and
+     directories are handled, and directories are opened with O_NOFOLLOW.
+   Stops at the first non-zero visit result and returns it; returns -1 on
+   stat/open/read errors, 0 when everything was visited. */
+int path_walk(unsigned walk, const char *path, file_visitor visit, void *ctx){
+    struct stat st;
+    uint64_t t = stats_now();
+    if (lstat(path, &st) != 0) { perror("lstat"); return -1; } // fetch metadata without following symlinks
+    stats_add(STATS_WALK, t, 0);
+    stats_count(STATS_SYS_STAT, 1);
+
+    if (S_ISREG(st.st_mode)){
+        if (skip_file(walk, base_name(path))){ stats_count(STATS_SKIPPED, 1); return 0; }
+        return visit(path, ctx); // hand this regular file to the visitor
+    }
+    if (!S_ISDIR(st.st_mode)){ stats_count(STATS_SKIPPED, 1); return 0; } // symlink, device, fifo, socket
+
+    walker_t w;
+    memset(&w, 0, sizeof w);
+    size_t root_len = strlen(path);
+    if (path_fit(&w, root_len) != 0) return -1;
+    memcpy(w.path, path, root_len + 1);
+
+    t = stats_now();
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    if (dfd < 0){ perror("opendir"); free(w.path); return -1; }
+    stats_add(STATS_WALK, t, 0);
+    stats_count(STATS_SYS_OPEN, 1);
+
+    int rc = walk_push(&w, dfd, root_len);
+    while (rc == 0 && w.depth > 0){
+        walk_frame_t *top = &w.st[w.depth - 1];
+        if (top->next == top->n){ rc = walk_pop(&w); continue; } // directory done
+
+        const walk_ent_t *e = &top->ents[top->next++];
+        const char *name = top->names + e->name;
+        if (path_child(&w, top->path_len, name) != 0){ rc = -1; break; }
+
+        int type = e->type;
+        if (type == WT_UNKNOWN){ // filesystem without d_type: ask
+            t = stats_now();
+            if (fstatat(top->dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0){
+                fprintf(stderr, "%s: %s\n", w.path, strerror(errno));
+                rc = -1; break;
+            }
+            stats_add(STATS_WALK, t, 0);
+            stats_count(STATS_SYS_STAT, 1);
+            type = S_ISREG(st.st_mode) ? WT_REG : S_ISDIR(st.st_mode) ? WT_DIR : WT_OTHER;
+        }
+
+        if (type == WT_REG){
+            if (skip_file(walk, name)){ stats_count(STATS_SKIPPED, 1); continue; }
+            rc = visit(w.path, ctx); // stop at the first non-zero result
+        } else if (type == WT_DIR){
+            t = stats_now();
+            dfd = openat(top->dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+            if (dfd < 0 && (errno == ENOTDIR || errno == ELOOP)){ // replaced by a non-directory meanwhile
+                stats_count(STATS_SKIPPED, 1);
+                continue;
+            }
+            if (dfd < 0){ fprintf(stderr, "%s: %s\n", w.path, strerror(errno)); rc = -1; break; }
+            stats_add(STATS_WALK, t, 0);
+            stats_count(STATS_SYS_OPEN, 1);
+            rc = walk_push(&w, dfd, strlen(w.path)); // top may move: not used below
+        } else {
+            stats_count(STATS_SKIPPED, 1); // symlink, device, fifo, socket
+        }
+    }
+
+    while (w.depth > 0){ // error exit: release what is left
+        walk_frame_t *top = &w.st[w.depth - 1];
+        if (top->dfd >= 0){ close(top->dfd); stats_count(STATS_SYS_CLOSE, 1); }
+        free(top->ents); free(top->names);
+        w.depth--;
+    }
+    free(w.st);
+    free(w.path);
+    return rc;
+}
@@ -0,0 +1,107 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+#include <time.h>
+
+/* quiet_serve: start an agent for `pw` with stdout/stderr silenced. */
+static int quiet_serve(char *pw, uint64_t ttl){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    int rc = agent_serve(pw, ttl);
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* slot_salt: Argon2id salt of key slot 0 in the header of `p`. */
+static void slot_salt(const char *p, unsigned char salt[16]){
+    FILE *f = fopen(p, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    memcpy(salt, h.slots[0].salt, 16);
+}
+
+/* gone: non-zero once `p` no longer exists (waits up to 5 s). */
+static int gone(const char *p){
+    struct stat st;
+    struct timespec ts = { 0, 10 * 1000 * 1000 };   // 10 ms
+    for (int i = 0; i < 500; ++i){
+        if (lstat(p, &st) != 0) return 1;
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+/* main: key agent tests.
+   - Without an agent, session_begin_agent fails and nothing changes.
+   - Files written with the agent's keys decrypt with the password and the
+     other way round, streamed and SIMPL1 alike; agent runs share its salt.
+   - A second agent is refused; requests with out-of-bounds Argon2id limits
+     are refused; `agent stop` wipes it and removes the socket. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char root[] = "/tmp/vault-agent-XXXXXX";
+    assert(mkdtemp(root));
+    char sock[512], plain[512], a[512], b[512], legacy[512], dec[512];
+    snprintf(sock, sizeof sock, "%s/agent.sock", root);
+    snprintf(plain, sizeof plain, "%s/plain", root);
+    snprintf(a, sizeof a, "%s/a.enc", root);
+    snprintf(b, sizeof b, "%s/b.enc", root);
+    snprintf(legacy, sizeof legacy, "%s/legacy.enc", root);
+    snprintf(dec, sizeof dec, "%s/dec", root);
+    assert(setenv(AGENT_SOCK_ENV, sock, 1) == 0);    // private socket for this test
+
+    // 1) No agent yet.
+    assert(session_begin_agent() == -1);
+    unsigned char salt[16], salt2[16];
+    assert(agent_run_salt(salt) == -1 && agent_stop() == -1);
+
+    // 2) Start one (socket 0600); a second one is refused.
+    char pw[] = "agent pass", empty[] = "", typed[] = "agent pass";
+    assert(quiet_serve(pw, 60) == 0);
+    struct stat st;
+    assert(lstat(sock, &st) == 0 && S_ISSOCK(st.st_mode) && (st.st_mode & 077) == 0);
+    char again[] = "agent pass";
+    assert(quiet_serve(again, 60) == -1);
+
+    // 3) Agent session: encrypt two files, they share the agent's run salt.
+    write_random(plain, STREAM_PARALLEL_MIN + 17);
+    assert(session_begin_agent() == 0);
+    assert(encrypt_file_stream(plain, a, empty) == 0);
+    session_end();
+    assert(session_begin_agent() == 0);              // a later run
+    assert(encrypt_file_stream(plain, b, empty) == 0);
+    session_end();
+    assert(agent_run_salt(salt) == 0);
+    slot_salt(a, salt2); assert(memcmp(salt, salt2, 16) == 0);
+    slot_salt(b, salt2); assert(memcmp(salt, salt2, 16) == 0);
+
+    // 4) The password opens them without the agent, and a SIMPL1 file written
+    //    with the password opens through the agent.
+    assert(session_begin(typed) == 0);
+    assert(decrypt_file_stream(a, dec, typed) == 0 && same_file(plain, dec));
+    assert(decrypt_file_stream(b, dec, typed) == 0 && same_file(plain, dec));
+    assert(encrypt_file(plain, legacy, typed) == 0);
+    session_end();
+    assert(session_begin_agent() == 0);
+    assert(decrypt_file(legacy, dec, empty) == 0 && same_file(plain, dec));
+    session_end();
+
+    // 5) Limits beyond kdf_limits_ok are refused without stretching.
+    unsigned char key[crypto_kdf_KEYBYTES];
+    assert(agent_master_key(salt, 2, KDF_MEM_MAX_KIB + 1, key) == -1);
+    assert(agent_master_key(salt, KDF_OPSLIMIT_MAX + 1, 8192, key) == -1);
+    assert(agent_master_key(salt, 0, 8192, key) == -1);
+
+    // 6) Stop: the socket goes away and later runs fall back to the password.
+    assert(agent_stop() == 0);
+    assert(gone(sock));
+    assert(session_begin_agent() == -1);
+
+    unlink(plain); unlink(a); unlink(b); unlink(legacy); unlink(dec);
+    assert(rmdir(root) == 0);
+    return 0;
+}
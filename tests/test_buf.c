@@ -0,0 +1,48 @@
+#include "../include/header.h"
+
+/* main: buffer pool tests.
+   - A released buffer is handed out again for the same kind and a similar
+     size, and secret buffers come back wiped.
+   - Secret and plain buffers are never mixed, and a block more than twice
+     the size asked for is not reused.
+   - A per-file alloc/free cycle keeps using one block. */
+int main(void){
+    assert(sodium_init() >= 0);
+
+    // 1) Reuse, wiped on release.
+    unsigned char *a = buf_alloc(100000, BUF_SECRET);
+    assert(a);
+    memset(a, 0xAB, 100000);
+    buf_free(a);
+    unsigned char *b = buf_alloc(99000, BUF_SECRET);
+    assert(b == a);                                  // same block back
+    for (size_t i = 0; i < 100000; ++i) assert(b[i] == 0);
+
+    // 2) Kinds and sizes.
+    unsigned char *c = buf_alloc(100000, BUF_PLAIN);
+    assert(c && c != b);
+    memset(c, 0xCD, 100000);
+    buf_free(c);
+    unsigned char *d = buf_alloc(100000, BUF_PLAIN);
+    assert(d == c);                                  // plain: reused, not wiped (ciphertext)
+    unsigned char *e = buf_alloc(1000, BUF_SECRET);
+    assert(e && e != b);                             // b is in use
+    buf_free(b);
+    unsigned char *f = buf_alloc(1000, BUF_SECRET);
+    assert(f != b);                                  // 100 KB block is too big for 1 KB
+    unsigned char *g = buf_alloc(0, BUF_PLAIN);      // empty files still get a buffer
+    assert(g);
+
+    // 3) One sodium_malloc for a whole run of files.
+    buf_free(e); buf_free(f);
+    buf_pool_drain();
+    unsigned char *h = buf_alloc(STREAM_CHUNK, BUF_SECRET), *first = h;
+    for (int i = 0; i < 100; ++i){
+        buf_free(h);
+        h = buf_alloc(STREAM_CHUNK, BUF_SECRET);
+        assert(h == first);
+    }
+    buf_free(h); buf_free(d); buf_free(g);
+    buf_pool_drain();
+    return 0;
+}
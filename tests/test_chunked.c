@@ -0,0 +1,134 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* swap_chunks: exchange ciphertext chunks i and j of a chunked file in place
+   (`ab` tag bytes per chunk, from the header's cipher suite). */
+static void swap_chunks(const char *p, uint32_t chunk, size_t ab, long i, long j){
+    const long csz = (long)chunk + (long)ab; // sealed chunk size
+    unsigned char *a = malloc(csz), *b = malloc(csz); assert(a && b);
+    FILE *f = fopen(p, "r+b"); assert(f);
+    fseek(f, STREAM_HDR_SIZE + i * csz, SEEK_SET); assert(fread(a, 1, csz, f) == (size_t)csz);
+    fseek(f, STREAM_HDR_SIZE + j * csz, SEEK_SET); assert(fread(b, 1, csz, f) == (size_t)csz);
+    fseek(f, STREAM_HDR_SIZE + i * csz, SEEK_SET); assert(fwrite(b, 1, csz, f) == (size_t)csz);
+    fseek(f, STREAM_HDR_SIZE + j * csz, SEEK_SET); assert(fwrite(a, 1, csz, f) == (size_t)csz);
+    fclose(f); free(a); free(b);
+}
+
+/* check_range: `cat_file` of [off, off+len) in `enc` must equal the same
+   slice of `plain` (clamped at EOF). */
+static void check_range(const char *plain, const char *enc, const char *tmp, uint64_t off, uint64_t len){
+    FILE *out = fopen(tmp, "wb"); assert(out);       // sink for the range
+    char pw[] = "p@ss";
+    assert(cat_file(enc, off, len, out, pw) == 0);   // ranged decrypt
+    fclose(out);
+
+    unsigned char *p = NULL, *r = NULL; size_t pl = 0, rl = 0;
+    assert(read_file(plain, &p, &pl) == 0);
+    assert(read_file(tmp, &r, &rl) == 0);
+    size_t want = off >= pl ? 0 : (len > pl - off ? pl - off : (size_t)len); // expected slice length
+    assert(rl == want);
+    assert(want == 0 || memcmp(p + off, r, want) == 0); // same bytes as plaintext
+    buf_free(p); buf_free(r);
+}
+
+/* main: chunk-independent layout tests.
+   - Large file picks STREAM_FLAG_CHUNKED and roundtrips (odd tail size).
+   - cat_file returns exact byte ranges for chunked and secretstream files.
+   - Truncation (last chunk dropped) and chunk reordering must fail.
+   - A failed decrypt leaves no plaintext behind.
+   - Chunk size is picked per file size, can be overridden, is honored on
+     decrypt, and out-of-bounds header values are rejected. */
+int main(void){
+    assert(sodium_init() >= 0);                      // libsodium must initialize
+
+    char dir[] = "/tmp/ss-chunked-XXXXXX";
+    assert(mkdtemp(dir) && "mkdtemp failed");        // create temp directory
+
+    char plain[512], enc[512], dec[512], bad[512], bad_dec[512];
+    snprintf(plain,   sizeof plain,   "%s/big.bin", dir);  // plaintext
+    snprintf(enc,     sizeof enc,     "%s/big.enc", dir);  // ciphertext
+    snprintf(dec,     sizeof dec,     "%s/big.dec", dir);  // roundtrip output
+    snprintf(bad,     sizeof bad,     "%s/bad.enc", dir);  // mutated ciphertext
+    snprintf(bad_dec, sizeof bad_dec, "%s/bad.dec", dir);  // output for mutated input
+
+    // 1) Roundtrip: threshold + a partial tail chunk.
+    write_random(plain, STREAM_PARALLEL_MIN + 12345);
+    char pw[] = "p@ss";
+    assert(encrypt_file_stream(plain, enc, pw) == 0); // large → chunked layout
+
+    stream_hdr_t h;
+    FILE *f = fopen(enc, "rb"); assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(h.flags & STREAM_FLAG_CHUNKED);           // parallel layout chosen
+    assert(h.plain_size == STREAM_PARALLEL_MIN + 12345); // size pinned in header
+    assert(h.chunk_size == stream_chunk_for(h.plain_size) && h.chunk_size > STREAM_CHUNK); // big file: bigger chunks
+
+    char pw2[] = "p@ss";
+    assert(decrypt_file_stream(enc, dec, pw2) == 0); // decrypt in parallel
+    assert(same_file(plain, dec));                   // exact roundtrip
+
+    // 2) Ranged reads (`vault cat`): across a chunk boundary, inside the tail, past EOF.
+    check_range(plain, enc, bad_dec, h.chunk_size - 100, 4096);
+    check_range(plain, enc, bad_dec, STREAM_PARALLEL_MIN + 12000, 1000);
+    check_range(plain, enc, bad_dec, STREAM_PARALLEL_MIN + 99999, 10);
+
+    // Secretstream files (below the threshold) answer the same ranges sequentially.
+    char small[512], small_enc[512];
+    snprintf(small,     sizeof small,     "%s/small.bin", dir);
+    snprintf(small_enc, sizeof small_enc, "%s/small.enc", dir);
+    write_random(small, 3 * STREAM_CHUNK + 7);
+    char pw3[] = "p@ss";
+    assert(encrypt_file_stream(small, small_enc, pw3) == 0);
+    check_range(small, small_enc, bad_dec, STREAM_CHUNK + 5, STREAM_CHUNK);
+    check_range(small, small_enc, bad_dec, 0, UINT64_MAX);
+
+    // 3) Truncation: drop the final chunk.
+    unsigned char *buf = NULL; size_t len = 0;
+    assert(read_file(enc, &buf, &len) == 0);
+    size_t tail = (size_t)(h.plain_size % h.chunk_size); // plaintext in the last chunk
+    assert(write_file(bad, buf, len - (tail + cipher_abytes((int)STREAM_CIPHER(h.flags)))) == 0);
+    buf_free(buf);
+    assert(quiet_decrypt(bad, bad_dec, pw) == -1);       // chunk count mismatch
+
+    // 4) Reordering: swap two full chunks.
+    assert(read_file(enc, &buf, &len) == 0);
+    assert(write_file(bad, buf, len) == 0);
+    buf_free(buf);
+    swap_chunks(bad, h.chunk_size, cipher_abytes((int)STREAM_CIPHER(h.flags)), 1, 2);
+    unlink(bad_dec);                                 // left over from the range checks
+    assert(quiet_decrypt(bad, bad_dec, pw) == -1);       // nonce binds chunk index
+    struct stat st;
+    assert(stat(bad_dec, &st) != 0);                 // no unauthenticated plaintext left
+
+    // 5) Chunk size override: small chunks in both layouts, honored on decrypt.
+    g_chunk_size = STREAM_CHUNK_MIN;
+    char pw4[] = "p@ss", pw5[] = "p@ss";
+    assert(encrypt_file_stream(plain, enc, pw4) == 0); // chunked layout, 4 KiB chunks
+    f = fopen(enc, "rb"); assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(h.chunk_size == STREAM_CHUNK_MIN);
+    assert(decrypt_file_stream(enc, dec, pw5) == 0 && same_file(plain, dec));
+    check_range(plain, enc, bad_dec, 3 * STREAM_CHUNK_MIN - 7, 3 * STREAM_CHUNK_MIN);
+
+    write_random(small, 5 * STREAM_CHUNK_MIN + 3);  // secretstream layout
+    assert(encrypt_file_stream(small, small_enc, pw4) == 0);
+    check_range(small, small_enc, bad_dec, 0, UINT64_MAX);
+    check_range(small, small_enc, bad_dec, 2 * STREAM_CHUNK_MIN + 1, STREAM_CHUNK_MIN);
+    g_chunk_size = 0;
+
+    // Tiny files get a single small chunk.
+    assert(stream_chunk_for(0) == STREAM_CHUNK_MIN);
+    assert(stream_chunk_for(5000) == 8192);
+    assert(stream_chunk_for(STREAM_CHUNK) == STREAM_CHUNK);
+
+    // 6) A header asking for a chunk above STREAM_CHUNK_MAX is rejected.
+    assert(read_file(small_enc, &buf, &len) == 0);
+    unsigned char *csf = buf + 6 + 2 + 4;            // LE chunk_size, after magic, version, flags
+    csf[3] = 0x40;                                   // now >= 1 GiB
+    assert(write_file(bad, buf, len) == 0);
+    buf_free(buf);
+    assert(quiet_decrypt(bad, bad_dec, pw) == -1);       // refused before any allocation
+    unlink(small); unlink(small_enc);
+
+    unlink(plain); unlink(enc); unlink(dec); unlink(bad); unlink(bad_dec);
+    rmdir(dir);                                      // remove temp directory
+    return 0;                                        // all chunked tests passed
+}
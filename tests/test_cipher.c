@@ -0,0 +1,109 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* patch: copy `src` to `dst` with byte `off` xored with `x`. */
+static void patch(const char *src, const char *dst, long off, unsigned char x){
+    unsigned char *buf = NULL; size_t len = 0;
+    assert(read_file(src, &buf, &len) == 0 && (size_t)off < len);
+    buf[off] ^= x;
+    assert(write_file(dst, buf, len) == 0);
+    buf_free(buf);
+}
+
+/* check_range: cat_file of [off, off+len) in `enc` equals that slice of `plain`. */
+static void check_range(const char *plain, const char *enc, const char *tmp, uint64_t off, uint64_t len, char *pw){
+    FILE *out = fopen(tmp, "wb"); assert(out);
+    assert(cat_file(enc, off, len, out, pw) == 0);
+    fclose(out);
+    unsigned char *p = NULL, *r = NULL; size_t pl = 0, rl = 0;
+    assert(read_file(plain, &p, &pl) == 0 && read_file(tmp, &r, &rl) == 0);
+    assert(rl == len && memcmp(p + off, r, rl) == 0);
+    buf_free(p); buf_free(r);
+}
+
+/* main: cipher suite tests.
+   - Names parse and print back; auto picks by CPU capability.
+   - Every suite this build and CPU run seals the chunked layout with its
+     id in the header and its tag size, roundtrips, answers ranges, and
+     rejects a flipped byte, swapped chunks and a changed suite id.
+   - Small files stay XChaCha20 secretstreams whatever --cipher says, and
+     a suite id on a secretstream or an unknown id is rejected. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "cipher pass";
+    assert(session_begin(pw) == 0);                  // one Argon2id for the run
+    char dir[] = "/tmp/vault-cipher-XXXXXX";
+    assert(mkdtemp(dir));
+    char plain[512], enc[512], dec[512], bad[512];
+    snprintf(plain, sizeof plain, "%s/p", dir);
+    snprintf(enc, sizeof enc, "%s/p.enc", dir);
+    snprintf(dec, sizeof dec, "%s/p.dec", dir);
+    snprintf(bad, sizeof bad, "%s/bad.enc", dir);
+
+    // 1) Names and the automatic pick.
+    int id = 0;
+    assert(cipher_parse("auto", &id) == 0 && id == CIPHER_AUTO);
+    for (int i = 0; i < CIPHER_COUNT; ++i) assert(cipher_parse(cipher_name(i), &id) == 0 && id == i);
+    assert(cipher_parse("rot13", &id) == -1);
+    assert(cipher_available(CIPHER_XCHACHA20));
+    g_cipher = CIPHER_AUTO;
+    int pick = cipher_pick();
+    assert(cipher_available(pick));
+    assert((pick == CIPHER_XCHACHA20) == !crypto_aead_aes256gcm_is_available());
+
+    // 2) Every available suite on the chunked layout.
+    const uint64_t size = STREAM_PARALLEL_MIN + 777;
+    write_random(plain, size);
+    for (int c = 0; c < CIPHER_COUNT; ++c){
+        if (!cipher_available(c)) continue;
+        g_cipher = c;
+        assert(encrypt_file_stream(plain, enc, pw) == 0);
+        stream_hdr_t h;
+        FILE *f = fopen(enc, "rb"); assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+        assert((h.flags & STREAM_FLAG_CHUNKED) && STREAM_CIPHER(h.flags) == (uint32_t)c);
+        uint64_t n = (size + h.chunk_size - 1) / h.chunk_size;
+        struct stat st;
+        assert(stat(enc, &st) == 0 && (uint64_t)st.st_size == STREAM_HDR_SIZE + size + n * cipher_abytes(c));
+        assert(decrypt_file_stream(enc, dec, pw) == 0 && same_file(plain, dec));
+        check_range(plain, enc, dec, h.chunk_size - 10, 20, pw); // across a chunk boundary
+        check_range(plain, enc, dec, size - 5, 5, pw);           // tail
+
+        patch(enc, bad, (long)st.st_size - 1, 0x01); // last tag byte
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+        patch(enc, bad, STREAM_HDR_SIZE + 3, 0x80);   // first chunk
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+        // Another suite id (bits 12..15 of the flags, byte 9): AAD mismatch.
+        patch(enc, bad, 9, (unsigned char)((((c + 1) % CIPHER_COUNT) ^ c) << 4));
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+
+        // Swap chunks 0 and 1.
+        unsigned char *buf = NULL; size_t len = 0;
+        assert(read_file(enc, &buf, &len) == 0);
+        const size_t csz = h.chunk_size + cipher_abytes(c);
+        unsigned char *tmp = malloc(csz); assert(tmp);
+        memcpy(tmp, buf + STREAM_HDR_SIZE, csz);
+        memcpy(buf + STREAM_HDR_SIZE, buf + STREAM_HDR_SIZE + csz, csz);
+        memcpy(buf + STREAM_HDR_SIZE + csz, tmp, csz);
+        assert(write_file(bad, buf, len) == 0);
+        free(tmp); buf_free(buf);
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+    }
+
+    // 3) Small files stay secretstreams; suite ids elsewhere are rejected.
+    g_cipher = CIPHER_AES256GCM;
+    write_random(plain, 1000);
+    assert(encrypt_file_stream(plain, enc, pw) == 0);
+    stream_hdr_t h;
+    FILE *f = fopen(enc, "rb"); assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(!(h.flags & STREAM_FLAG_CHUNKED) && STREAM_CIPHER(h.flags) == CIPHER_XCHACHA20);
+    patch(enc, bad, 9, (unsigned char)(CIPHER_AES256GCM << 4)); // suite id on a secretstream
+    f = fopen(bad, "rb"); assert(f && stream_hdr_read(f, &h) == -1); fclose(f);
+    patch(enc, bad, 9, 0xF0);                                   // unknown suite
+    f = fopen(bad, "rb"); assert(f && stream_hdr_read(f, &h) == -1); fclose(f);
+    g_cipher = CIPHER_AUTO;
+
+    session_end();
+    unlink(plain); unlink(enc); unlink(dec); unlink(bad);
+    assert(rmdir(dir) == 0);
+    return 0;
+}
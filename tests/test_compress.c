@@ -0,0 +1,132 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* write_text: create `p` with `n` bytes of repetitive log-like text. */
+static void write_text(const char *p, size_t n){
+    FILE *f = fopen(p, "wb"); assert(f);
+    for (size_t i = 0; i < n; ){
+        char line[96];
+        int k = snprintf(line, sizeof line, "2026-01-01T00:00:%02zu host=app%zu level=INFO msg=\"request ok\" id=%zu\n",
+                         i % 60, i % 7, i % 1000);
+        size_t m = (size_t)k < n - i ? (size_t)k : n - i;
+        assert(fwrite(line, 1, m, f) == m);
+        i += m;
+    }
+    fclose(f);
+}
+
+/* file_size: size of `p` in bytes. */
+static long file_size(const char *p){
+    struct stat st;
+    assert(stat(p, &st) == 0);
+    return (long)st.st_size;
+}
+
+/* roundtrip: encrypt `plain` with the current codec, check the header and
+   decrypt it back with every backend flag. */
+static void roundtrip(const char *plain, const char *enc, const char *dec){
+    char pw[] = "p@ss";
+    assert(encrypt_file_stream(plain, enc, pw) == 0);
+    FILE *f = fopen(enc, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(STREAM_CODEC(h.flags) == (uint32_t)g_codec && !(h.flags & STREAM_FLAG_CHUNKED));
+    int codec = g_codec;
+    g_codec = CODEC_NONE;                            // decrypt needs no flag
+    for (int mode = 0; mode < 3; ++mode){
+        g_use_mmap = mode == 1; g_pipeline = mode == 2; // both fall back to the buffered loop
+        unlink(dec);
+        assert(decrypt_file_stream(enc, dec, pw) == 0);
+        assert(same_file(plain, dec));
+    }
+    g_use_mmap = g_pipeline = 0;
+    g_codec = codec;
+}
+
+/* main: per-chunk compression tests.
+   - --compress values parse with their level ranges.
+   - For each codec built in: compressible text shrinks and round-trips
+     (also past STREAM_PARALLEL_MIN, which stays a secretstream), random
+     data is stored raw at one byte plus a length per chunk, ranges and
+     stdin/stdout mode work, and truncation, a forged length and a flipped
+     byte all fail. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "p@ss";
+    const char *plain = "cmp_plain.bin", *enc = "cmp_plain.enc", *dec = "cmp_plain.dec", *bad = "cmp_bad.enc";
+
+    // 1) Option syntax.
+    int id = 0, level = 0;
+    assert(codec_parse("zstd", &id, &level) == 0 && id == CODEC_ZSTD && level == 3);
+    assert(codec_parse("zstd:19", &id, &level) == 0 && level == 19);
+    assert(codec_parse("lz4", &id, &level) == 0 && id == CODEC_LZ4 && level == 1);
+    assert(codec_parse("lz4:9", &id, &level) == 0 && level == 9);
+    assert(codec_parse("zstd:20", &id, &level) == -1);
+    assert(codec_parse("lz4:0", &id, &level) == -1);
+    assert(codec_parse("zstd:", &id, &level) == -1);
+    assert(codec_parse("gzip", &id, &level) == -1);
+
+    const char *specs[] = { "zstd", "zstd:19", "lz4", "lz4:9" };
+    for (size_t s = 0; s < sizeof specs / sizeof specs[0]; ++s){
+        assert(codec_parse(specs[s], &g_codec, &g_codec_level) == 0);
+        if (!codec_available(g_codec)) continue;     // codec not built in
+
+        // 2) Compressible text: much smaller, exact roundtrip.
+        const size_t tsz = 5 * STREAM_CHUNK + 3;
+        write_text(plain, tsz);
+        roundtrip(plain, enc, dec);
+        assert(file_size(enc) < (long)tsz / 3);
+
+        // 3) Incompressible data: stored raw, bounded overhead.
+        write_random(plain, tsz);
+        roundtrip(plain, enc, dec);
+        long frames = (long)(tsz / STREAM_CHUNK) + 1;
+        assert(file_size(enc) == (long)STREAM_HDR_SIZE + (long)tsz +
+                                 frames * (4 + 1 + crypto_secretstream_xchacha20poly1305_ABYTES));
+
+        // 4) Large files stay one compressed secretstream.
+        write_text(plain, STREAM_PARALLEL_MIN + 17);
+        roundtrip(plain, enc, dec);
+
+        // 5) Ranges (cat) across chunk boundaries.
+        FILE *out = fopen(dec, "wb"); assert(out);
+        const size_t at = 256 * 1024 - 10;           // straddles the first 256 KiB chunk
+        assert(cat_file(enc, at, 20, out, pw) == 0);
+        fclose(out);
+        unsigned char *p = NULL, *r = NULL; size_t pl = 0, rl = 0;
+        assert(read_file(plain, &p, &pl) == 0 && read_file(dec, &r, &rl) == 0);
+        assert(rl == 20 && memcmp(p + at, r, 20) == 0);
+        buf_free(r);
+
+        // 6) Damage: truncation, a forged frame length, a flipped byte.
+        unsigned char *c = NULL; size_t cl = 0;
+        assert(read_file(enc, &c, &cl) == 0);
+        assert(write_file(bad, c, cl - 1) == 0);
+        unlink(dec);
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+        assert(write_file(bad, c, STREAM_HDR_SIZE) == 0);
+        assert(quiet_decrypt(bad, dec, pw) == -1);       // no frames at all
+        c[STREAM_HDR_SIZE] ^= 1;                     // first frame's length
+        assert(write_file(bad, c, cl) == 0);
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+        c[STREAM_HDR_SIZE] ^= 1;
+        c[STREAM_HDR_SIZE + 4 + 3] ^= 0x40;          // inside the first sealed frame
+        assert(write_file(bad, c, cl) == 0);
+        assert(quiet_decrypt(bad, dec, pw) == -1);
+        assert(access(dec, F_OK) != 0);              // nothing left behind
+        buf_free(c);
+
+        // 7) stdin/stdout mode.
+        FILE *in = fopen(plain, "rb"); out = fopen(enc, "wb"); assert(in && out);
+        assert(encrypt_pipe(in, out, pw) == 0);
+        fclose(in); fclose(out);
+        in = fopen(enc, "rb"); out = fopen(dec, "wb"); assert(in && out);
+        assert(decrypt_pipe(in, out, pw) == 0);
+        fclose(in); fclose(out);
+        assert(same_file(plain, dec));
+        buf_free(p);
+    }
+    g_codec = CODEC_NONE;
+
+    unlink(plain); unlink(enc); unlink(dec); unlink(bad);
+    return 0;
+}
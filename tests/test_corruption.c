@@ -13,10 +13,10 @@ static int file_copy(const char *src, const char *dst){
     unsigned char *buf = NULL; size_t len = 0;       // init buffer/length
     if (read_file(src, &buf, &len) != 0) return -1;  // read source fully
     if (write_file(dst, buf, len) != 0){             // write to destination
-        sodium_free(buf);                            // free on failure
+        buf_free(buf);                            // free on failure
         return -1;
     }
-    sodium_free(buf);                                // free on success
+    buf_free(buf);                                // free on success
     return 0;
 }
 
@@ -107,7 +107,7 @@ int main(void){
 
     // --- Test 2: Corrupt payload byte (single chunk, quiet expected error logs) ---
     assert(file_copy(enc, enc_bad_ct) == 0);         // duplicate ciphertext to mutate payload
-    assert(mutate_file_byte(enc_bad_ct, (long)sizeof(stream_hdr_t) + 5) == 0); // flip a byte in first ciphertext chunk
+    assert(mutate_file_byte(enc_bad_ct, (long)STREAM_HDR_SIZE + 5) == 0); // flip a byte in first ciphertext chunk
 
     int saved_err_2 = dup(STDERR_FILENO);            // save stderr again
     FILE *devnull_2 = fopen("/dev/null","w");        // open /dev/null sink
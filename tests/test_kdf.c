@@ -0,0 +1,217 @@
+#include "../include/header.h"
+
+#include <pthread.h>
+
+/* write_text: create `p` holding the string `s`. */
+static void write_text(const char *p, const char *s){
+    FILE *f = fopen(p, "w"); assert(f);
+    assert(fputs(s, f) >= 0);
+    fclose(f);
+}
+
+/* quiet_load: kdf_profile_load with stderr silenced (expected failures). */
+static int quiet_load(const char *spec){
+    int saved = dup(STDERR_FILENO);                  // save current stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull) dup2(fileno(devnull), STDERR_FILENO); // redirect stderr → /dev/null
+    int rc = kdf_profile_load(spec);
+    fflush(stderr);
+    if (saved >= 0){ dup2(saved, STDERR_FILENO); close(saved); } // restore stderr
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* quiet_rekey: rekey_tree on `p` with stdout/stderr silenced. */
+static int quiet_rekey(const char *p, char *old_pw, const char *new_pw){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    int rc = rekey_tree(p, old_pw, new_pw);
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* slot_limits: Argon2id limits of the first non-empty key slot of `enc`. */
+static void slot_limits(const char *enc, uint32_t *ops, uint32_t *mem){
+    FILE *f = fopen(enc, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    int i = 0;
+    while (i < STREAM_KEY_SLOTS && h.slots[i].kdf_opslimit == 0) ++i;
+    assert(i < STREAM_KEY_SLOTS);
+    *ops = h.slots[i].kdf_opslimit;
+    *mem = h.slots[i].kdf_mem_kib;
+}
+
+/* count_visit: path_walk visitor counting the files it is handed. */
+static int count_visit(const char *path, void *ctx){
+    (void)path;
+    ++*(int *)ctx;
+    return 0;
+}
+
+/* One concurrent session_master_key request (section 9). */
+typedef struct {
+    char *pw;
+    const unsigned char *salt;
+    unsigned char key[crypto_kdf_KEYBYTES];
+    int rc;
+} kdf_job_t;
+
+/* kdf_job: thread body for a kdf_job_t. */
+static void *kdf_job(void *arg){
+    kdf_job_t *j = arg;
+    j->rc = session_master_key(j->pw, j->salt, 1, 8192, j->key);
+    return NULL;
+}
+
+/* main: KDF profile tests.
+   - Without a profile the limits stay MODERATE; presets and profile files
+     set them, and invalid profiles are rejected without changing them.
+   - calibrate stays within its memory cap and writes a 0600 profile that
+     loads back.
+   - New key slots, user.pass and rekeyed slots use the profile's limits;
+     decrypt reads the limits from the file, not the profile, and the
+     walker never encrypts the profile.
+   - Headers and profiles with limits above the ceilings are rejected.
+   - Concurrent cache misses (more salts than cache slots) each get the
+     key of their own salt. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char cwd[PATH_MAX];
+    assert(getcwd(cwd, sizeof cwd));
+    char root[] = "/tmp/vault-kdf-XXXXXX";
+    assert(mkdtemp(root));
+    assert(chdir(root) == 0);                        // kdf.profile and user.pass live here
+    const uint32_t mod_ops = (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE;
+    const uint32_t mod_mem = (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024);
+
+    // 1) Defaults and presets.
+    assert(kdf_profile_load(NULL) == 0 && g_kdf_opslimit == mod_ops && g_kdf_mem_kib == mod_mem);
+    assert(kdf_profile_load("interactive") == 0);
+    assert(g_kdf_opslimit == crypto_pwhash_OPSLIMIT_INTERACTIVE &&
+           g_kdf_mem_kib == crypto_pwhash_MEMLIMIT_INTERACTIVE / 1024);
+    assert(kdf_profile_load("moderate") == 0 && g_kdf_opslimit == mod_ops && g_kdf_mem_kib == mod_mem);
+
+    // 2) Calibration respects the cap and round-trips through the file.
+    kdf_profile_t p, q;
+    assert(kdf_calibrate(0, 16 * 1024, &p) == -1);
+    assert(kdf_calibrate(200, KDF_MEM_MIN_KIB - 1, &p) == -1);
+    assert(kdf_calibrate(200, 16 * 1024, &p) == 0);
+    assert(p.mem_kib >= KDF_MEM_MIN_KIB && p.mem_kib <= 16 * 1024 && p.mem_kib % 1024 == 0);
+    assert(p.opslimit >= crypto_pwhash_OPSLIMIT_MIN && p.opslimit <= KDF_OPSLIMIT_MAX && p.measured_ms > 0);
+    assert(p.target_ms == 200 && p.mem_cap_kib == 16 * 1024);
+    assert(kdf_profile_write(KDF_PROFILE_FILE, &p) == 0);
+    struct stat st;
+    assert(stat(KDF_PROFILE_FILE, &st) == 0 && (st.st_mode & 077) == 0);
+    assert(kdf_profile_read(KDF_PROFILE_FILE, &q) == 0 && memcmp(&p, &q, sizeof p) == 0);
+    assert(kdf_mem_default() >= KDF_MEM_MIN_KIB && kdf_mem_default() <= KDF_MEM_CAP_KIB);
+
+    // 3) Invalid profiles fail and leave the limits alone.
+    write_text("bad", "opslimit 0\nmem_kib 8192\n");
+    assert(quiet_load("bad") == -1 && g_kdf_opslimit == mod_ops);
+    write_text("bad", "opslimit 2\n");               // no mem_kib
+    assert(quiet_load("bad") == -1 && g_kdf_mem_kib == mod_mem);
+    write_text("bad", "opslimit two\nmem_kib 8192\n");
+    assert(quiet_load("bad") == -1);
+    assert(quiet_load("missing.profile") == -1);
+    assert(unlink("bad") == 0);
+
+    // 4) A small profile reaches new key slots and user.pass.
+    write_text(KDF_PROFILE_FILE, "# comment\ntarget_ms 50\nopslimit 2\nmem_kib 8192\n");
+    assert(kdf_profile_load(NULL) == 0 && g_kdf_opslimit == 2 && g_kdf_mem_kib == 8192);
+    char pw[] = "kdf pass";
+    assert(session_begin(pw) == 0);
+    assert(mkdir("tree", 0700) == 0);
+    write_text("tree/a", "profile limits\n");
+    assert(encrypt_file_stream("tree/a", "tree/a.enc", pw) == 0);
+    uint32_t ops = 0, mem = 0;
+    slot_limits("tree/a.enc", &ops, &mem);
+    assert(ops == 2 && mem == 8192);
+    assert(user_set_password(pw) == 0);
+    unsigned char *x = NULL; size_t xl = 0;
+    assert(read_file("user.pass", &x, &xl) == 0);
+    char hash[crypto_pwhash_STRBYTES + 1] = { 0 };
+    memcpy(hash, x, xl < crypto_pwhash_STRBYTES ? xl : crypto_pwhash_STRBYTES);
+    buf_free(x);
+    assert(strstr(hash, "m=8192,t=2,") && crypto_pwhash_str_verify(hash, pw, strlen(pw)) == 0);
+    session_end();
+
+    // 5) Decrypt takes the limits from the file, whatever the profile says.
+    assert(kdf_profile_load("moderate") == 0);
+    assert(session_begin(pw) == 0);
+    assert(decrypt_file_stream("tree/a.enc", "tree/a.dec", pw) == 0);
+    session_end();
+
+    // 6) Rekeyed slots get the profile's limits too.
+    write_text(KDF_PROFILE_FILE, "opslimit 1\nmem_kib 16384\n");
+    assert(kdf_profile_load(NULL) == 0);
+    assert(session_begin(pw) == 0);
+    assert(quiet_rekey("tree/a.enc", pw, "new kdf pass") == 0);
+    session_end();
+    slot_limits("tree/a.enc", &ops, &mem);
+    assert(ops == 1 && mem == 16384);
+
+    // 7) The walker never hands the profile to encrypt.
+    assert(rename(KDF_PROFILE_FILE, "tree/" KDF_PROFILE_FILE) == 0);
+    int n = 0;
+    assert(path_walk(WALK_ENCRYPT, "tree", count_visit, &n) == 0 && n == 2); // a and a.dec
+    n = 0;
+    assert(path_walk(WALK_ALL, "tree", count_visit, &n) == 0 && n == 3);            // .enc too
+
+    // 8) Limits beyond the ceilings are refused in headers, before Argon2id.
+    assert(kdf_limits_ok(crypto_pwhash_OPSLIMIT_MIN, crypto_pwhash_MEMLIMIT_MIN / 1024));
+    assert(!kdf_limits_ok(KDF_OPSLIMIT_MAX + 1, 8192) && !kdf_limits_ok(2, KDF_MEM_MAX_KIB + 1ULL));
+    assert(!kdf_limits_ok(0, 8192));
+    stream_hdr_t h;
+    FILE *f = fopen("tree/a.enc", "rb"); assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    int used = 0;
+    while (h.slots[used].kdf_opslimit == 0) ++used;  // rekey moved the key to another slot
+    const size_t slot = 8 + 4 + 4 + 8 + sizeof h.ss_header + // v4: mem_kib, then opslimit
+                        (size_t)used * (4 + 4 + 16 + 24 + sizeof h.slots[0].wrapped);
+    unsigned char *e = NULL; size_t el = 0;
+    assert(read_file("tree/a.enc", &e, &el) == 0);
+    memset(e + slot, 0xff, 4);                       // 4 TiB of Argon2id memory
+    assert(write_file("tree/bad.enc", e, el) == 0);
+    f = fopen("tree/bad.enc", "rb"); assert(f && stream_hdr_read(f, &h) == -1); fclose(f);
+    buf_free(e);
+    assert(read_file("tree/a.enc", &e, &el) == 0);
+    e[slot + 4] = 0xff; e[slot + 5] = 0xff;          // 65535 passes
+    assert(write_file("tree/bad.enc", e, el) == 0);
+    buf_free(e);
+    f = fopen("tree/bad.enc", "rb"); assert(f && stream_hdr_read(f, &h) == -1); fclose(f);
+    write_text("bad", "opslimit 2\nmem_kib 4194304\n"); // 4 GiB
+    assert(quiet_load("bad") == -1);
+    unlink("bad"); unlink("tree/bad.enc");
+
+    // 9) Concurrent misses: workers sharing a salt share its derivation,
+    //    other salts are stretched meanwhile, and no slot is evicted while
+    //    it is still being derived.
+    enum { NSALT = SESSION_CACHE_SLOTS + 2, NJOB = 2 * NSALT };
+    unsigned char salts[NSALT][16];
+    kdf_job_t jobs[NJOB];
+    pthread_t th[NJOB];
+    randombytes_buf(salts, sizeof salts);
+    assert(session_begin(pw) == 0);
+    for (int i = 0; i < NJOB; ++i){
+        jobs[i].pw = pw; jobs[i].salt = salts[i % NSALT];
+        assert(pthread_create(&th[i], NULL, kdf_job, &jobs[i]) == 0);
+    }
+    for (int i = 0; i < NJOB; ++i) assert(pthread_join(th[i], NULL) == 0);
+    for (int i = 0; i < NJOB; ++i){
+        unsigned char want[crypto_kdf_KEYBYTES];
+        assert(crypto_pwhash(want, sizeof want, pw, strlen(pw), salts[i % NSALT], 1, 8192 * 1024,
+                             crypto_pwhash_ALG_ARGON2ID13) == 0);
+        assert(jobs[i].rc == 0 && memcmp(jobs[i].key, want, sizeof want) == 0);
+    }
+    session_end();
+
+    unlink("tree/a"); unlink("tree/a.enc"); unlink("tree/a.dec"); unlink("tree/" KDF_PROFILE_FILE);
+    unlink("user.pass");
+    assert(rmdir("tree") == 0);
+    assert(chdir(cwd) == 0 && rmdir(root) == 0);
+    return 0;
+}
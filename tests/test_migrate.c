@@ -0,0 +1,124 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* snapshot: heap copy of file `p` (length in `n`), for unchanged checks. */
+static unsigned char *snapshot(const char *p, size_t *n){
+    unsigned char *x = NULL;
+    assert(read_file(p, &x, n) == 0);
+    unsigned char *copy = malloc(*n ? *n : 1); assert(copy);
+    memcpy(copy, x, *n);
+    buf_free(x);
+    return copy;
+}
+
+/* is_simple: non-zero if file `p` starts with the SIMPL1 magic. */
+static int is_simple(const char *p){
+    unsigned char m[6];
+    return read_magic(p, m) == 0 && memcmp(m, MAGIC, 6) == 0;
+}
+
+/* quiet: migrate file `p` (or directory `p` on a 4-worker pool) under `pw`
+   with stdout/stderr silenced. */
+static int quiet(const char *p, char *pw, int pool){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    int rc = pool ? pool_run(migrate_file, WALK_CIPHERTEXT, p, pw, NULL, 4) : migrate_file(p, pw, NULL);
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* main: migrate tests.
+   - A directory run turns every SIMPL1 .enc file into a stream that
+     decrypts to the same bytes and keeps the file's mode, leaves
+     streamed files and non-.enc files alone, fails on a tampered SIMPL1
+     file without touching it and leaves no temp files behind.
+   - A wrong password fails and keeps the file; an odd --chunk-size is
+     rounded to whole ChaCha20 blocks. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "migrate pass";
+    assert(session_begin(pw) == 0);
+    char root[] = "/tmp/vault-migrate-XXXXXX", out[] = "/tmp/vault-migrate-out-XXXXXX";
+    assert(mkdtemp(root) && mkdtemp(out));
+    char sub[64], a[512], b[512], c[512], bad[512], raw[512], plain[512], dec[512];
+    snprintf(sub, sizeof sub, "%s/sub", root);
+    assert(mkdir(sub, 0700) == 0);
+    snprintf(a, sizeof a, "%s/a.enc", root);
+    snprintf(b, sizeof b, "%s/b.enc", sub);
+    snprintf(c, sizeof c, "%s/c.enc", root);
+    snprintf(bad, sizeof bad, "%s/bad.enc", sub);
+    snprintf(raw, sizeof raw, "%s/raw", root);
+    snprintf(plain, sizeof plain, "%s/plain", out);
+    snprintf(dec, sizeof dec, "%s/dec", out);
+
+    const size_t big = 2 * SIMPLE_CHUNK + 65;
+    unsigned char *m = malloc(big); assert(m);
+    randombytes_buf(m, big);
+    unsigned char salt[16], key[crypto_kdf_KEYBYTES];
+    randombytes_buf(salt, sizeof salt);
+    assert(session_master_key(pw, salt, (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE,
+                              (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024), key) == 0);
+
+    // 1) A tree of SIMPL1, streamed, tampered and non-.enc files.
+    seal_oneshot(a, m, 0, salt, key);
+    seal_oneshot(b, m, big, salt, key);
+    assert(chmod(b, 0640) == 0);                     // mode carries over
+    seal_oneshot(bad, m, 1000, salt, key);
+    FILE *f = fopen(bad, "r+b"); assert(f);
+    assert(fseek(f, (long)sizeof(simple_hdr_t) + 10, SEEK_SET) == 0);
+    int byte = fgetc(f); assert(byte != EOF);
+    assert(fseek(f, (long)sizeof(simple_hdr_t) + 10, SEEK_SET) == 0);
+    fputc(byte ^ 0xff, f);                           // damaged payload
+    fclose(f);
+    seal_oneshot(raw, m, 100, salt, key);            // SIMPL1 bytes, but not a .enc file
+    f = fopen(plain, "wb"); assert(f);
+    assert(fwrite(m, 1, 5000, f) == 5000); fclose(f);
+    assert(encrypt_file_stream(plain, c, pw) == 0);
+    size_t cl = 0, badl = 0, rawl = 0;
+    unsigned char *c0 = snapshot(c, &cl), *bad0 = snapshot(bad, &badl), *raw0 = snapshot(raw, &rawl);
+
+    assert(quiet(root, pw, 1) == -1);                // bad.enc fails, the rest migrate
+    assert(!is_simple(a) && !is_simple(b));
+    assert(decrypt_file_stream(a, dec, pw) == 0 && same_bytes(dec, m, 0));
+    assert(decrypt_file_stream(b, dec, pw) == 0 && same_bytes(dec, m, big));
+    assert(verify_file(b, pw, NULL) == 0);
+    assert(same_bytes(c, c0, cl) && same_bytes(bad, bad0, badl) && same_bytes(raw, raw0, rawl));
+    assert(count_entries(root) == 4 && count_entries(sub) == 2); // no temps left behind
+    struct stat st;
+    assert(stat(b, &st) == 0 && (st.st_mode & 07777) == 0640);
+
+    // 2) Re-running is a no-op for migrated files.
+    assert(unlink(bad) == 0);
+    size_t bl = 0;
+    unsigned char *b0 = snapshot(b, &bl);
+    assert(quiet(root, pw, 1) == 0 && same_bytes(b, b0, bl));
+    assert(quiet(c, pw, 0) == 0 && same_bytes(c, c0, cl));
+
+    // 3) Wrong password: fails, file kept.
+    char wrong[] = "wrong pass";
+    seal_oneshot(a, m, 100, salt, key);
+    size_t al = 0;
+    unsigned char *a0 = snapshot(a, &al);
+    assert(quiet(a, wrong, 0) == -1 && same_bytes(a, a0, al));
+
+    // 4) An odd chunk size is rounded down to whole ChaCha20 blocks.
+    g_chunk_size = 5000;
+    seal_oneshot(a, m, 20000, salt, key);
+    assert(quiet(a, pw, 0) == 0 && !is_simple(a));
+    f = fopen(a, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(h.chunk_size == 5000 / SIMPLE_BLOCK * SIMPLE_BLOCK);
+    assert(decrypt_file_stream(a, dec, pw) == 0 && same_bytes(dec, m, 20000));
+    g_chunk_size = 0;
+
+    free(m); free(c0); free(bad0); free(raw0); free(b0); free(a0);
+    session_end();
+    unlink(a); unlink(b); unlink(c); unlink(raw); unlink(plain); unlink(dec);
+    assert(rmdir(sub) == 0 && rmdir(root) == 0 && rmdir(out) == 0);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* write_mode: create `p` holding `n` random bytes with mode `mode`. */
+static void write_mode(const char *p, size_t n, mode_t mode){
+    write_random(p, n);
+    assert(chmod(p, mode) == 0);
+}
+
+/* same_mode: non-zero if files `a` and `b` have identical contents and mode. */
+static int same_mode(const char *a, const char *b){
+    struct stat sa, sb;
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0 || (sa.st_mode & 0777) != (sb.st_mode & 0777)) return 0;
+    return same_file(a, b);
+}
+
+/* quiet_unpack: run unpack_dir with stderr silenced (expected failures). */
+static int quiet_unpack(const char *in, const char *dir){
+    int saved = dup(STDERR_FILENO);                  // save current stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull) dup2(fileno(devnull), STDERR_FILENO); // redirect stderr → /dev/null
+    char pw[] = "p@ss";
+    int rc = unpack_dir(in, dir, pw);                // attempt unpack
+    fflush(stderr);
+    if (saved >= 0){ dup2(saved, STDERR_FILENO); close(saved); } // restore stderr
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* seal_raw: write a pack container at `p` whose plaintext is exactly one
+   PACK_FILE record for `rel` (4 bytes of content), then PACK_END. */
+static void seal_raw(const char *p, const char *rel, int type){
+    unsigned char plain[512], rec[PACK_REC_SIZE] = { 0 };
+    size_t plen = strlen(rel), n = 0;
+    rec[0] = (unsigned char)type;
+    rec[1] = 0x80; rec[2] = 0x01;                    // mode 0600
+    rec[5] = 4;                                      // size 4
+    rec[13] = (unsigned char)plen;
+    memcpy(plain + n, rec, sizeof rec); n += sizeof rec;
+    memcpy(plain + n, rel, plen); n += plen;
+    memcpy(plain + n, "data", 4); n += 4;
+    memset(rec, 0, sizeof rec); rec[0] = PACK_END;
+    memcpy(plain + n, rec, sizeof rec); n += sizeof rec;
+
+    stream_hdr_t h;
+    unsigned char key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    unsigned char c[sizeof plain + crypto_secretstream_xchacha20poly1305_ABYTES];
+    unsigned long long clen = 0;
+    crypto_secretstream_xchacha20poly1305_state st;
+    char pw[] = "p@ss";
+    assert(stream_hdr_new(&h, STREAM_FLAG_PACK, 0, STREAM_CHUNK, pw, key) == 0);
+    assert(crypto_secretstream_xchacha20poly1305_init_push(&st, h.ss_header, key) == 0);
+    assert(stream_hdr_encode(&h) == 0);
+    assert(crypto_secretstream_xchacha20poly1305_push(&st, c, &clen, plain, n, h.raw, h.aad_len,
+                                                      crypto_secretstream_xchacha20poly1305_TAG_FINAL) == 0);
+    FILE *f = fopen(p, "wb"); assert(f);
+    assert(fwrite(h.raw, 1, h.raw_len, f) == h.raw_len && fwrite(c, 1, (size_t)clen, f) == (size_t)clen);
+    fclose(f);
+}
+
+/* main: pack container tests.
+   - A tree (nested directories, empty and multi-chunk files, modes) packs
+     into one container with one header and unpacks identically; user.pass
+     and symlinks are left out.
+   - Repacking into the packed tree leaves the old container out.
+   - Truncated, extended and tampered containers fail; a plain stream is
+     not a container.
+   - Absolute, ".." and empty path components and unknown records are
+     rejected before anything is written. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "p@ss";
+
+    char root[] = "/tmp/vault-pack-XXXXXX";
+    assert(mkdtemp(root));
+    char src[512], out[512], seal[512], p[1024], q[1024];
+    snprintf(src,  sizeof src,  "%s/src", root);
+    snprintf(out,  sizeof out,  "%s/out", root);
+    snprintf(seal, sizeof seal, "%s/tree.seal", root);
+
+    // 1) Roundtrip.
+    assert(mkdir(src, 0755) == 0);
+    snprintf(p, sizeof p, "%s/sub", src);        assert(mkdir(p, 0700) == 0);
+    snprintf(p, sizeof p, "%s/sub/deeper", src); assert(mkdir(p, 0755) == 0);
+    const struct { const char *name; size_t size; mode_t mode; } files[] = {
+        { "a.txt", 10, 0640 },
+        { "sub/b.bin", 3 * STREAM_CHUNK + 5, 0600 },   // spans several chunks
+        { "sub/deeper/empty", 0, 0755 },
+        { "sub/deeper/c.txt", STREAM_CHUNK - PACK_REC_SIZE, 0644 },
+    };
+    const int nfiles = (int)(sizeof files / sizeof files[0]);
+    for (int i = 0; i < nfiles; ++i){
+        snprintf(p, sizeof p, "%s/%s", src, files[i].name);
+        write_mode(p, files[i].size, files[i].mode);
+    }
+    snprintf(p, sizeof p, "%s/user.pass", src); write_mode(p, 4, 0600);
+    snprintf(p, sizeof p, "%s/link", src);      assert(symlink("a.txt", p) == 0);
+
+    assert(pack_dir(src, seal, pw) == 0);
+    FILE *f = fopen(seal, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0 && (h.flags & STREAM_FLAG_PACK)); fclose(f);
+    assert(unpack_dir(seal, out, pw) == 0);
+    for (int i = 0; i < nfiles; ++i){
+        snprintf(p, sizeof p, "%s/%s", src, files[i].name);
+        snprintf(q, sizeof q, "%s/%s", out, files[i].name);
+        assert(same_mode(p, q));                     // contents and mode
+    }
+    snprintf(q, sizeof q, "%s/user.pass", out); assert(access(q, F_OK) != 0);
+    snprintf(q, sizeof q, "%s/link", out);      assert(access(q, F_OK) != 0);
+    assert(unpack_dir(seal, out, pw) == 0);          // unpacking again replaces the files
+    rm_tree(out);
+
+    // 2) Repack into the tree itself: the old container is not packed.
+    snprintf(q, sizeof q, "%s/self.seal", src);
+    assert(pack_dir(src, q, pw) == 0);
+    assert(pack_dir(src, q, pw) == 0);
+    assert(unpack_dir(q, out, pw) == 0);
+    snprintf(p, sizeof p, "%s/self.seal", out); assert(access(p, F_OK) != 0);
+    snprintf(p, sizeof p, "%s/a.txt", out);     assert(access(p, F_OK) == 0);
+    rm_tree(out); unlink(q);
+
+    // 3) Damage.
+    struct stat st;
+    assert(stat(seal, &st) == 0);
+    snprintf(p, sizeof p, "%s/cut.seal", root);
+    unsigned char *buf = NULL; size_t len = 0;
+    assert(read_file(seal, &buf, &len) == 0 && len == (size_t)st.st_size);
+    assert(write_file(p, buf, len - 1) == 0);
+    assert(quiet_unpack(p, out) == -1);              // truncated
+    assert(write_file(p, buf, STREAM_HDR_SIZE + STREAM_CHUNK + crypto_secretstream_xchacha20poly1305_ABYTES) == 0);
+    assert(quiet_unpack(p, out) == -1);              // cut at a chunk boundary
+    f = fopen(seal, "ab"); assert(f); fputc(0, f); fclose(f);
+    assert(quiet_unpack(seal, out) == -1);           // extended
+    buf[len / 2] ^= 1;
+    assert(write_file(p, buf, len) == 0);
+    assert(quiet_unpack(p, out) == -1);              // tampered
+    buf_free(buf);
+    snprintf(q, sizeof q, "%s/a.txt", src);
+    assert(encrypt_file_stream(q, p, pw) == 0);
+    assert(quiet_unpack(p, out) == -1);              // a plain file stream is not a pack
+    rm_tree(out);
+
+    // 4) Hostile paths and records.
+    const char *bad[] = { "../evil", "/tmp/evil", "a//b", "a/./b", "a/..", "dir/" };
+    for (size_t i = 0; i < sizeof bad / sizeof bad[0]; ++i){
+        seal_raw(p, bad[i], PACK_FILE);
+        assert(quiet_unpack(p, out) == -1);
+        snprintf(q, sizeof q, "%s/evil", root); assert(access(q, F_OK) != 0);
+        rm_tree(out);
+    }
+    seal_raw(p, "x", 'Z');
+    assert(quiet_unpack(p, out) == -1);              // unknown record type
+    rm_tree(out);
+    seal_raw(p, "ok", PACK_FILE);
+    assert(quiet_unpack(p, out) == 0);               // the same container, well formed
+    snprintf(q, sizeof q, "%s/ok", out); assert(access(q, F_OK) == 0);
+
+    rm_tree(root);
+    return 0;
+}
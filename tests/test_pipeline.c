@@ -0,0 +1,136 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+#include <sys/wait.h>
+
+/* feed: read end of a pipe that a child process fills with the first `len`
+   bytes of `path` (all of it for -1), then closes. Release with unfeed. */
+static FILE *feed(const char *path, long len){
+    int fds[2];
+    assert(pipe(fds) == 0);
+    fflush(NULL);                                    // no duplicated stdio buffers in the child
+    pid_t pid = fork(); assert(pid >= 0);
+    if (pid == 0){
+        close(fds[0]);
+        int fd = open(path, O_RDONLY);
+        char buf[4096];
+        ssize_t n;
+        while (fd >= 0 && len != 0 && (n = read(fd, buf, len > 0 && len < (long)sizeof buf ? (size_t)len : sizeof buf)) > 0){
+            if (write(fds[1], buf, (size_t)n) != n) break;
+            if (len > 0) len -= n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    FILE *f = fdopen(fds[0], "rb"); assert(f);
+    return f;
+}
+
+/* unfeed: close a feed() stream and reap its writer. */
+static void unfeed(FILE *f){
+    fclose(f);
+    int status = 0;
+    assert(wait(&status) > 0);
+}
+
+/* pipe_crypt: run encrypt_pipe/decrypt_pipe from a pipe carrying the first
+   `len` bytes of `in` into file `out`, stderr silenced. */
+static int pipe_crypt(int (*fn)(FILE *, FILE *, char *), const char *in, long len, const char *out){
+    char pw[] = "p@ss";
+    FILE *src = feed(in, len), *dst = fopen(out, "wb"); assert(dst);
+    int saved = dup(STDERR_FILENO);
+    FILE *devnull = fopen("/dev/null", "w");
+    if (devnull) dup2(fileno(devnull), STDERR_FILENO);
+    int rc = fn(src, dst, pw);
+    fflush(stderr);
+    if (saved >= 0){ dup2(saved, STDERR_FILENO); close(saved); }
+    if (devnull) fclose(devnull);
+    fclose(dst); unfeed(src);
+    return rc;
+}
+
+/* main: pipelined streaming tests.
+   - Files roundtrip with --pipeline on either side (ciphertext layout is
+     the same as the sequential loop's), including empty files and exact
+     chunk multiples.
+   - Ranged reads (`vault cat`) through the pipeline return exact bytes.
+   - A stream cut before its FINAL chunk fails, with or without --pipeline.
+   - stdin/stdout mode (encrypt_pipe/decrypt_pipe) over real pipes: both
+     layouts decrypt in one pass, truncation fails after only authenticated
+     chunks were written, and extended chunked input fails. */
+int main(void){
+    assert(sodium_init() >= 0);                      // libsodium must initialize
+
+    char dir[] = "/tmp/ss-pipe-XXXXXX";
+    assert(mkdtemp(dir) && "mkdtemp failed");        // create temp directory
+
+    char plain[512], enc[512], dec[512];
+    snprintf(plain, sizeof plain, "%s/p.bin", dir);  // plaintext
+    snprintf(enc,   sizeof enc,   "%s/p.enc", dir);  // ciphertext
+    snprintf(dec,   sizeof dec,   "%s/p.dec", dir);  // roundtrip output
+
+    // 1) Roundtrips, pipelined on the encrypt side, the decrypt side or both.
+    const size_t sizes[] = { 0, 100, 2 * STREAM_CHUNK, 13 * STREAM_CHUNK + 999 };
+    for (size_t k = 0; k < sizeof sizes / sizeof sizes[0]; ++k){
+        write_random(plain, sizes[k]);
+        for (int mode = 1; mode < 4; ++mode){
+            char pw[] = "p@ss", pw2[] = "p@ss";
+            g_pipeline = mode & 1;
+            assert(encrypt_file_stream(plain, enc, pw) == 0);
+            g_pipeline = (mode >> 1) & 1;
+            assert(decrypt_file_stream(enc, dec, pw2) == 0);
+            assert(same_file(plain, dec));           // exact roundtrip
+        }
+    }
+
+    // 2) Ranged read through the pipeline: spans chunks, starts mid-chunk.
+    g_pipeline = 1;
+    FILE *out = fopen(dec, "wb"); assert(out);
+    char pw[] = "p@ss";
+    assert(cat_file(enc, STREAM_CHUNK + 10, 3 * STREAM_CHUNK, out, pw) == 0);
+    fclose(out);
+    unsigned char *p = NULL, *r = NULL; size_t pl = 0, rl = 0;
+    assert(read_file(plain, &p, &pl) == 0 && read_file(dec, &r, &rl) == 0);
+    assert(rl == 3 * STREAM_CHUNK && memcmp(p + STREAM_CHUNK + 10, r, rl) == 0);
+    buf_free(p); buf_free(r);
+
+    // 3) Truncation at a frame boundary: the FINAL chunk never arrives.
+    struct stat st;
+    assert(stat(enc, &st) == 0);
+    assert(truncate(enc, STREAM_HDR_SIZE + 4 * (STREAM_CHUNK + crypto_secretstream_xchacha20poly1305_ABYTES)) == 0);
+    assert(quiet_decrypt(enc, dec, pw) == -1);           // missing FINAL tag
+    g_pipeline = 0;
+    assert(quiet_decrypt(enc, dec, pw) == -1);           // sequential loop too
+
+    // 4) One-pass streams over pipes (`vault encrypt -` / `vault decrypt -`).
+    const size_t psz = 3 * STREAM_CHUNK + 7;
+    write_random(plain, psz);
+    for (int mode = 0; mode < 2; ++mode){
+        g_pipeline = mode;
+        assert(pipe_crypt(encrypt_pipe, plain, -1, enc) == 0);
+        assert(pipe_crypt(decrypt_pipe, enc, -1, dec) == 0);
+        assert(same_file(plain, dec));               // exact roundtrip
+    }
+    g_pipeline = 0;
+    long frame = STREAM_CHUNK + crypto_secretstream_xchacha20poly1305_ABYTES;
+    assert(pipe_crypt(decrypt_pipe, enc, STREAM_HDR_SIZE + 2 * frame, dec) == -1); // no FINAL
+    assert(stat(dec, &st) == 0 && st.st_size == 2 * STREAM_CHUNK); // only authenticated chunks
+    assert(pipe_crypt(decrypt_pipe, enc, STREAM_HDR_SIZE + frame + 9, dec) == -1); // torn frame
+
+    // Chunked layout (made from a regular file) also streams in order.
+    write_random(plain, STREAM_PARALLEL_MIN + 123);
+    char pw5[] = "p@ss";
+    assert(encrypt_file_stream(plain, enc, pw5) == 0);
+    FILE *fe = fopen(enc, "rb"); stream_hdr_t h;
+    assert(fe && stream_hdr_read(fe, &h) == 0 && (h.flags & STREAM_FLAG_CHUNKED)); fclose(fe);
+    assert(pipe_crypt(decrypt_pipe, enc, -1, dec) == 0);
+    assert(same_file(plain, dec));
+    assert(stat(enc, &st) == 0);
+    assert(pipe_crypt(decrypt_pipe, enc, (long)st.st_size - 1, dec) == -1); // truncated
+    FILE *fa = fopen(enc, "ab"); assert(fa); fputc(0, fa); fclose(fa);
+    assert(pipe_crypt(decrypt_pipe, enc, -1, dec) == -1); // extended
+
+    unlink(plain); unlink(enc); unlink(dec);
+    rmdir(dir);                                      // remove temp directory
+    return 0;                                        // all pipeline tests passed
+}
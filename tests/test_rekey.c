@@ -0,0 +1,192 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* quiet_rekey: run rekey_tree on `p` with stdout/stderr silenced. */
+static int quiet_rekey(const char *p, const char *old_pw, const char *new_pw){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    char pw[64];
+    snprintf(pw, sizeof pw, "%s", old_pw);
+    assert(session_begin(pw) == 0);                  // as main does after login
+    int rc = rekey_tree(p, pw, new_pw);
+    session_end();
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* opens: non-zero if `enc` authenticates in full under `pw` (verify_file,
+   stderr silenced). */
+static int opens(const char *enc, const char *pw){
+    int saved = dup(STDERR_FILENO);                  // save current stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull) dup2(fileno(devnull), STDERR_FILENO); // redirect stderr → /dev/null
+    char buf[64];
+    snprintf(buf, sizeof buf, "%s", pw);
+    int rc = verify_file(enc, buf, NULL);
+    fflush(stderr);
+    if (saved >= 0){ dup2(saved, STDERR_FILENO); close(saved); } // restore stderr
+    if (devnull) fclose(devnull);
+    return rc == 0;
+}
+
+/* user_is: non-zero if user.pass in the current directory holds `pw`. */
+static int user_is(const char *pw){
+    unsigned char *x = NULL; size_t xl = 0;
+    assert(read_file("user.pass", &x, &xl) == 0);
+    char hash[crypto_pwhash_STRBYTES] = { 0 };
+    assert(xl < sizeof hash);
+    memcpy(hash, x, xl);
+    buf_free(x);
+    return crypto_pwhash_str_verify(hash, pw, strlen(pw)) == 0;
+}
+
+/* slots_used: number of non-empty key slots in the header of `p`. */
+static int slots_used(const char *p){
+    FILE *f = fopen(p, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(h.version == STREAMSEAL_VERSION);
+    int n = 0;
+    for (int i = 0; i < STREAM_KEY_SLOTS; ++i) n += h.slots[i].kdf_opslimit != 0;
+    return n;
+}
+
+/* put_le: store the low `n` bytes of `v` little-endian at `p`; returns p + n. */
+static unsigned char *put_le(unsigned char *p, uint64_t v, int n){
+    for (int i = 0; i < n; ++i) p[i] = (unsigned char)(v >> (8 * i));
+    return p + n;
+}
+
+/* write_v3: encrypt `n` random bytes at `p` in the v3 layout (salt and
+   file_id in the header, key derived from the password), as older
+   releases wrote it. Cheap Argon2id limits keep the test fast. */
+static void write_v3(const char *p, size_t n, char *pw){
+    unsigned char h[STREAM_HDR_V3_SIZE] = { 0 }, *q = h;
+    const uint32_t mem = (uint32_t)(crypto_pwhash_MEMLIMIT_MIN / 1024), ops = (uint32_t)crypto_pwhash_OPSLIMIT_MIN;
+    unsigned char salt[16]; uint64_t id = 0;
+    randombytes_buf(salt, sizeof salt);
+    randombytes_buf(&id, sizeof id);
+    memcpy(q, STREAM_MAGIC, 6); q += 6;
+    q = put_le(q, STREAMSEAL_VERSION_V3, 2);
+    q = put_le(q, mem, 4);
+    q = put_le(q, ops, 4);
+    memcpy(q, salt, sizeof salt); q += sizeof salt;
+    q = put_le(q, id, 8);
+    q = put_le(q, 0, 4);                             // flags
+    q = put_le(q, STREAM_CHUNK, 4);                  // chunk_size
+    q = put_le(q, 0, 8);                             // plain_size
+
+    unsigned char master[crypto_kdf_KEYBYTES], key[crypto_kdf_KEYBYTES];
+    assert(session_master_key(pw, salt, ops, mem, master) == 0);
+    assert(crypto_kdf_derive_from_key(key, sizeof key, id, SESSION_KDF_CONTEXT, master) == 0);
+    crypto_secretstream_xchacha20poly1305_state st;
+    assert(crypto_secretstream_xchacha20poly1305_init_push(&st, q, key) == 0);
+    unsigned char *m = malloc(n + 1), *c = malloc(n + crypto_secretstream_xchacha20poly1305_ABYTES);
+    assert(m && c);
+    randombytes_buf(m, n);
+    unsigned long long clen = 0;
+    assert(crypto_secretstream_xchacha20poly1305_push(&st, c, &clen, m, n, h, (size_t)(q - h),
+                                                      crypto_secretstream_xchacha20poly1305_TAG_FINAL) == 0);
+    FILE *f = fopen(p, "wb"); assert(f);
+    assert(fwrite(h, 1, sizeof h, f) == sizeof h && fwrite(c, 1, (size_t)clen, f) == (size_t)clen);
+    fclose(f); free(m); free(c);
+}
+
+/* main: password change tests.
+   - Every layout (secretstream, chunked, empty, pack container, sync
+     manifest) moves to the new password with one key slot left, and the
+     payload bytes are not touched; plaintext files, read-only ones
+     included, are skipped.
+   - user.pass follows, the old password no longer opens anything, and a
+     second rekey works from the other slot.
+   - A v3 file (no key slots, still decrypted) or a file under another
+     password makes rekey fail before anything changes. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char cwd[PATH_MAX];
+    assert(getcwd(cwd, sizeof cwd));
+    char root[] = "/tmp/vault-rekey-XXXXXX";
+    assert(mkdtemp(root));
+    assert(chdir(root) == 0);                        // user.pass lives in the working directory
+
+    char pw1[] = "old pass", pw2[] = "new pass", pw3[] = "newer pass", other[] = "other";
+    assert(user_set_password(pw1) == 0);
+    assert(mkdir("tree", 0700) == 0 && mkdir("tree/src", 0700) == 0);
+
+    // 1) One file per layout, all under pw1.
+    const char *files[] = { "tree/stream.enc", "tree/chunked.enc", "tree/empty.enc", "tree/pack.seal",
+                            "tree/dst/" SYNC_MANIFEST };
+    const int nfiles = (int)(sizeof files / sizeof files[0]);
+    write_random("tree/p", 3 * STREAM_CHUNK + 1);
+    assert(session_begin(pw1) == 0);
+    assert(encrypt_file_stream("tree/p", files[0], pw1) == 0);
+    write_random("tree/p", STREAM_PARALLEL_MIN + 3);
+    assert(encrypt_file_stream("tree/p", files[1], pw1) == 0);
+    write_random("tree/p", 0);
+    assert(encrypt_file_stream("tree/p", files[2], pw1) == 0);
+    write_random("tree/src/a", 100);
+    assert(pack_dir("tree/src", files[3], pw1) == 0);
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), dn = open("/dev/null", O_WRONLY); // sync prints a summary
+    dup2(dn, STDOUT_FILENO);
+    assert(sync_dir("tree/src", "tree/dst", pw1, 0) == 0);
+    fflush(stdout); dup2(so, STDOUT_FILENO); close(so); close(dn);
+    session_end();
+    write_random("tree/plain.txt", 50);             // not StreamSeal: skipped
+    assert(chmod("tree/plain.txt", 0444) == 0);     // header probe must not need write access
+
+    unsigned char *before[8]; size_t blen[8];
+    for (int i = 0; i < nfiles; ++i){
+        assert(opens(files[i], pw1) && slots_used(files[i]) == 1);
+        assert(read_file(files[i], &before[i], &blen[i]) == 0);
+    }
+
+    // 2) pw1 -> pw2: headers only.
+    assert(quiet_rekey("tree", pw1, pw2) == 0);
+    assert(user_is(pw2) && !user_is(pw1));
+    for (int i = 0; i < nfiles; ++i){
+        assert(opens(files[i], pw2) && !opens(files[i], pw1));
+        assert(slots_used(files[i]) == 1);
+        unsigned char *after = NULL; size_t alen = 0;
+        assert(read_file(files[i], &after, &alen) == 0);
+        assert(alen == blen[i]);
+        assert(memcmp(after, before[i], STREAM_SLOT_OFF(0)) == 0); // prefix + ss_header
+        assert(memcmp(after + STREAM_HDR_SIZE, before[i] + STREAM_HDR_SIZE, alen - STREAM_HDR_SIZE) == 0); // payload
+        assert(memcmp(after + STREAM_SLOT_OFF(0), before[i] + STREAM_SLOT_OFF(0), STREAM_HDR_SIZE - STREAM_SLOT_OFF(0)) != 0);
+        buf_free(after);
+        buf_free(before[i]);
+    }
+    fflush(stdout);
+    so = dup(STDOUT_FILENO); dn = open("/dev/null", O_WRONLY);
+    dup2(dn, STDOUT_FILENO);
+    assert(sync_dir("tree/src", "tree/dst", pw2, 0) == 0); // manifest opens with the new password
+    fflush(stdout); dup2(so, STDOUT_FILENO); close(so); close(dn);
+
+    // 3) pw2 -> pw3: the new slot goes where the old one was.
+    assert(quiet_rekey("tree", pw2, pw3) == 0);
+    assert(user_is(pw3));
+    for (int i = 0; i < nfiles; ++i)
+        assert(opens(files[i], pw3) && !opens(files[i], pw2) && slots_used(files[i]) == 1);
+
+    // 4) Files that cannot be rekeyed stop the run before anything changes.
+    write_v3("tree/old.enc", 1000, pw3);
+    assert(opens("tree/old.enc", pw3));             // v3 still decrypts
+    assert(quiet_rekey("tree", pw3, pw1) == -1);
+    assert(user_is(pw3));
+    for (int i = 0; i < nfiles; ++i) assert(opens(files[i], pw3) && !opens(files[i], pw1));
+    assert(unlink("tree/old.enc") == 0);
+
+    write_random("tree/p", 10);
+    assert(encrypt_file_stream("tree/p", "tree/other.enc", other) == 0);
+    assert(quiet_rekey("tree", pw3, pw1) == -1);     // wrong password for one file
+    assert(user_is(pw3) && opens("tree/other.enc", other));
+    for (int i = 0; i < nfiles; ++i) assert(opens(files[i], pw3));
+
+    assert(chdir(cwd) == 0);
+    rm_tree(root);
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* quiet: encrypt (`dec` 0) or decrypt `in` to `out` with stdout/stderr silenced. */
+static int quiet(int dec, const char *in, const char *out, char *pw){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    int rc = dec ? decrypt_file_stream(in, out, pw) : encrypt_file_stream(in, out, pw);
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* interrupt: leave the state of a run on `in` (header `h`) stopped after
+   `done` chunks: `prefix` (`plen` bytes) followed by junk as the partial
+   output of `out`, and a journal that says `done` chunks are durable. */
+static void interrupt(int dec, const char *in, const char *out, const stream_hdr_t *h, uint64_t done,
+                      const unsigned char *prefix, size_t plen){
+    char part[PATH_MAX], jpath[PATH_MAX];
+    assert(resume_paths(out, part, jpath, sizeof part) == 0);
+    unsigned char *buf = malloc(plen + 5000); assert(buf);
+    memcpy(buf, prefix, plen);
+    randombytes_buf(buf + plen, 5000);               // a torn window past the mark
+    assert(write_file(part, buf, plen + 5000) == 0);
+    free(buf);
+    int fd = open(in, O_RDONLY); assert(fd >= 0);
+    resume_jnl_t j;
+    assert(resume_ident(&j, dec, fd, h) == 0);
+    close(fd);
+    j.done = done;
+    assert(resume_save(jpath, &j, plen) == 0);
+}
+
+/* leftovers: non-zero if the partial output or journal of `out` exists. */
+static int leftovers(const char *out){
+    char part[PATH_MAX], jpath[PATH_MAX];
+    assert(resume_paths(out, part, jpath, sizeof part) == 0);
+    return access(part, F_OK) == 0 || access(jpath, F_OK) == 0;
+}
+
+/* main: --resume tests.
+   - Encrypt and decrypt with g_resume roundtrip and leave no partial
+     output or journal behind.
+   - An encrypt stopped after k chunks continues from the partial file's
+     header and key slot: the result is byte-identical to an uninterrupted
+     run. A decrypt keeps the first k chunks and redoes the rest.
+   - A changed input (even one with its size and mtime put back) or a
+     torn journal starts over; a failed decrypt keeps its journal and no
+     output.
+   - The inplace helpers skip inputs whose output is finished and redo the
+     ones with a journal; an output even 1 ns older than the input's ctime
+     is not finished. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "resume pass";
+    assert(session_begin(pw) == 0);                  // one Argon2id for the run
+    char dir[] = "/tmp/vault-resume-XXXXXX";
+    assert(mkdtemp(dir));
+    char plain[512], enc[512], ref[512], dec[512], part[PATH_MAX], jpath[PATH_MAX];
+    snprintf(plain, sizeof plain, "%s/p", dir);
+    snprintf(enc, sizeof enc, "%s/p.enc", dir);
+    snprintf(ref, sizeof ref, "%s/ref.enc", dir);
+    snprintf(dec, sizeof dec, "%s/p.dec", dir);
+    assert(resume_paths(enc, part, jpath, sizeof part) == 0);
+    assert(strstr(part, "/" OUT_TMP_PREFIX "p.enc.part") && strstr(jpath, "/" OUT_TMP_PREFIX "p.enc.journal"));
+
+    // 1) Plain roundtrip under --resume.
+    g_resume = 1;
+    g_chunk_size = 64 * 1024;                        // many chunks per file
+    const uint64_t size = STREAM_PARALLEL_MIN + 12345;
+    write_random(plain, size);
+    assert(quiet(0, plain, ref, pw) == 0 && !leftovers(ref));
+    assert(quiet(1, ref, dec, pw) == 0 && !leftovers(dec) && same_file(plain, dec));
+    struct stat st;
+    assert(stat(ref, &st) == 0 && (st.st_mode & 077) == 0);
+    stream_hdr_t h;
+    FILE *f = fopen(ref, "rb"); assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+    assert(h.flags & STREAM_FLAG_CHUNKED);
+    const uint64_t k = 7, csz = h.chunk_size + cipher_abytes((int)STREAM_CIPHER(h.flags));
+
+    // 2) Encrypt stopped after k chunks: same header, key and bytes as ref.
+    unsigned char *r = NULL; size_t rl = 0;
+    assert(read_file(ref, &r, &rl) == 0);
+    interrupt(0, plain, enc, &h, k, r, (size_t)(h.raw_len + k * csz));
+    assert(quiet(0, plain, enc, pw) == 0 && !leftovers(enc) && same_file(ref, enc));
+    buf_free(r);
+
+    // 3) Decrypt stopped after k chunks: the first k are taken as done.
+    unsigned char *marked = malloc((size_t)(k * h.chunk_size)); assert(marked);
+    memset(marked, 'x', (size_t)(k * h.chunk_size));
+    interrupt(1, ref, dec, &h, k, marked, (size_t)(k * h.chunk_size));
+    assert(quiet(1, ref, dec, pw) == 0 && !leftovers(dec));
+    unsigned char *p = NULL, *d = NULL; size_t pl = 0, dl = 0;
+    assert(read_file(plain, &p, &pl) == 0 && read_file(dec, &d, &dl) == 0 && pl == dl);
+    assert(memcmp(d, marked, (size_t)(k * h.chunk_size)) == 0);
+    assert(memcmp(d + k * h.chunk_size, p + k * h.chunk_size, pl - (size_t)(k * h.chunk_size)) == 0);
+    buf_free(p); buf_free(d);
+    free(marked);
+
+    // 4) A torn journal starts over, as does a changed input.
+    marked = malloc((size_t)(k * h.chunk_size)); assert(marked);
+    memset(marked, 'x', (size_t)(k * h.chunk_size));
+    interrupt(1, ref, dec, &h, k, marked, (size_t)(k * h.chunk_size));
+    free(marked);
+    char dpart[PATH_MAX], djpath[PATH_MAX];
+    assert(resume_paths(dec, dpart, djpath, sizeof dpart) == 0);
+    f = fopen(djpath, "r+b"); assert(f);
+    assert(fseek(f, 30, SEEK_SET) == 0);
+    fputc('!', f);                                   // check no longer matches
+    fclose(f);
+    assert(quiet(1, ref, dec, pw) == 0 && !leftovers(dec) && same_file(plain, dec));
+    assert(read_file(ref, &r, &rl) == 0);
+
+    // Same size and mtime, new content (cp -p, touch -d): the ctime differs,
+    // so the run starts over with a new key instead of reusing ref's nonces.
+    struct stat st0;
+    assert(stat(plain, &st0) == 0);
+    interrupt(0, plain, enc, &h, k, r, (size_t)(h.raw_len + k * csz));
+    write_random(plain, size);                       // rewritten in place
+    struct timespec ts[2] = { { 0, UTIME_OMIT }, st0.st_mtim };
+    assert(utimensat(AT_FDCWD, plain, ts, 0) == 0);  // mtime set back
+    assert(stat(plain, &st) == 0 && st.st_size == st0.st_size && st.st_ino == st0.st_ino);
+    assert(st.st_mtim.tv_sec == st0.st_mtim.tv_sec && st.st_mtim.tv_nsec == st0.st_mtim.tv_nsec);
+    assert(quiet(0, plain, enc, pw) == 0 && !leftovers(enc));
+    unsigned char *e = NULL; size_t el = 0;
+    assert(read_file(enc, &e, &el) == 0 && el == rl);
+    assert(memcmp(e, r, h.raw_len) != 0);            // fresh header, not the partial one
+    buf_free(e);
+    assert(quiet(1, enc, dec, pw) == 0 && same_file(plain, dec));
+
+    interrupt(0, plain, enc, &h, k, r, (size_t)(h.raw_len + k * csz));
+    write_random(plain, size + 1);                   // another input
+    assert(quiet(0, plain, enc, pw) == 0 && !leftovers(enc));
+    assert(quiet(1, enc, dec, pw) == 0 && same_file(plain, dec));
+
+    // 5) A tampered input fails: no output, the journal stays for a retry.
+    unlink(dec);
+    r[rl - 1] ^= 1;                                  // last tag byte
+    assert(write_file(enc, r, rl) == 0);
+    buf_free(r);
+    assert(quiet(1, enc, dec, pw) == -1);
+    assert(access(dec, F_OK) != 0 && access(djpath, F_OK) == 0 && access(dpart, F_OK) == 0);
+    unlink(djpath); unlink(dpart);
+
+    // 6) encrypt_inplace skips a finished output and redoes a journaled one.
+    assert(write_file(enc, (const unsigned char *)"finished", 8) == 0);
+    assert(resume_skip(plain, enc));
+    struct stat ps;
+    assert(stat(plain, &ps) == 0);
+    struct timespec tm[2] = { ps.st_ctim, ps.st_ctim };   // output written as the input last changed
+    assert(utimensat(AT_FDCWD, enc, tm, 0) == 0 && resume_skip(plain, enc));
+    if (tm[1].tv_nsec > 0) --tm[1].tv_nsec; else { --tm[1].tv_sec; tm[1].tv_nsec = 999999999; }
+    assert(utimensat(AT_FDCWD, enc, tm, 0) == 0 && !resume_skip(plain, enc)); // 1 ns older: redone
+    tm[1] = ps.st_ctim;
+    assert(utimensat(AT_FDCWD, enc, tm, 0) == 0);
+    assert(encrypt_inplace(plain, pw, NULL) == 0);
+    assert(stat(enc, &st) == 0 && st.st_size == 8); // kept as is
+    assert(write_file(jpath, (const unsigned char *)"torn", 4) == 0); // an unfinished run
+    assert(!resume_skip(plain, enc));
+    assert(encrypt_inplace(plain, pw, NULL) == 0 && !leftovers(enc));
+    assert(quiet(1, enc, dec, pw) == 0 && same_file(plain, dec));
+    assert(resume_skip(enc, dec));                   // decrypt direction: same rule
+    assert(stat(enc, &ps) == 0);
+    tm[0] = tm[1] = ps.st_ctim;
+    if (tm[1].tv_nsec > 0) --tm[1].tv_nsec; else { --tm[1].tv_sec; tm[1].tv_nsec = 999999999; }
+    assert(utimensat(AT_FDCWD, dec, tm, 0) == 0 && !resume_skip(enc, dec));
+    g_resume = 0;
+
+    g_chunk_size = 0;
+    session_end();
+    unlink(plain); unlink(enc); unlink(ref); unlink(dec);
+    assert(rmdir(dir) == 0);
+    return 0;
+}
@@ -7,6 +7,17 @@ static void write_file_simple(const char *p, const char *s){
     fclose(f);                                       // close file
 }
 
+/* count_temps: number of uncommitted output temps left in `dir`. */
+static int count_temps(const char *dir){
+    DIR *d = opendir(dir); assert(d);
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)))
+        if (strncmp(e->d_name, OUT_TMP_PREFIX, strlen(OUT_TMP_PREFIX)) == 0) n++;
+    closedir(d);
+    return n;
+}
+
 /* main: end-to-end roundtrip test for encrypt_inplace/decrypt_inplace.
    Verifies delete-on-success, file presence, and final plaintext integrity. */
 int main(void){
@@ -42,6 +53,135 @@ int main(void){
     fread(buf,1,sizeof buf,f); fclose(f);            // read and close
     assert(strcmp(buf,"hello") == 0);                // verify roundtrip content
 
+    // 4) Directory run: one password buffer, several files, one run salt
+    char a[512], b[512], a_enc[512], b_enc[512];
+    snprintf(a,     sizeof a,     "%s/a.txt", dir);     // first plaintext
+    snprintf(b,     sizeof b,     "%s/b.txt", dir);     // second plaintext
+    snprintf(a_enc, sizeof a_enc, "%s/a.enc", dir);     // expected outputs
+    snprintf(b_enc, sizeof b_enc, "%s/b.enc", dir);
+    write_file_simple(a, "first");
+    write_file_simple(b, "second");
+    unlink(dec);                                     // leave only a.txt/b.txt to encrypt
+
+    char pw3[] = "testpw";                           // shared across the whole walk
+    assert(session_begin(pw3) == 0);                 // one Argon2id for the run
+    assert(path_handler(encrypt_inplace, WALK_ENCRYPT, dir, pw3, NULL) == 0); // encrypt both files
+    assert(access(a_enc, F_OK) == 0 && access(b_enc, F_OK) == 0);
+
+    struct stat st;
+    stream_hdr_t ha, hb;                             // both headers share the run salt
+    FILE *fa = fopen(a_enc, "rb"); assert(fa && stream_hdr_read(fa, &ha) == 0); fclose(fa);
+    FILE *fb = fopen(b_enc, "rb"); assert(fb && stream_hdr_read(fb, &hb) == 0); fclose(fb);
+    assert(ha.version == STREAMSEAL_VERSION);
+    assert(memcmp(ha.slots[0].salt, hb.slots[0].salt, sizeof ha.slots[0].salt) == 0); // same master key
+    assert(ha.slots[1].kdf_opslimit == 0 && hb.slots[1].kdf_opslimit == 0); // one password
+    unsigned char ka[crypto_kdf_KEYBYTES], kb[crypto_kdf_KEYBYTES];
+    assert(session_file_key(pw3, &ha, ka, sizeof ka) == 0 && session_file_key(pw3, &hb, kb, sizeof kb) == 0);
+    assert(memcmp(ka, kb, sizeof ka) != 0);          // distinct random payload keys
+    stream_hdr_t hx = ha;
+    hx.flags ^= STREAM_FLAG_PACK;                    // slot is bound to the header prefix
+    assert(session_open_slot(pw3, &hx, ka) == -1);
+
+    session_end();                                   // fresh session: keys re-derived from the header salt
+    g_jobs = 4;                                      // decrypt through the worker pool
+    assert(path_handler(decrypt_inplace, WALK_DECRYPT, dir, pw3, ".dec") == 0); // decrypt both files
+    g_jobs = 1;
+    snprintf(dec, sizeof dec, "%s/b.dec", dir);
+    f = fopen(dec,"rb"); assert(f);
+    memset(buf, 0, sizeof buf);
+    fread(buf,1,sizeof buf,f); fclose(f);
+    assert(strcmp(buf,"second") == 0);               // second file used the same password
+    assert(access(a_enc, F_OK) != 0);                // --rm ran after the group commit
+    assert(count_temps(dir) == 0);                   // every output renamed into place
+    assert(stat(dec, &st) == 0 && (st.st_mode & 077) == 0); // plaintext is private
+    session_end();
+
+    // 5) io_uring batch engine (or its fallback): more files than slots,
+    //    an empty file, and one too large for the batch path.
+    char udir[512], up[3][1024], ud[3][1024];
+    const size_t usz[3] = { 0, 20000, URING_FILE_MAX + 5 };
+    unsigned char *ubuf[3];
+    snprintf(udir, sizeof udir, "%s/many", dir);
+    assert(mkdir(udir, 0700) == 0);
+    for (int i = 0; i < 3; ++i){
+        snprintf(up[i], sizeof up[i], "%s/f%d.bin", udir, i);
+        snprintf(ud[i], sizeof ud[i], "%s/f%d.dec", udir, i);
+        ubuf[i] = malloc(usz[i] + 1); assert(ubuf[i]);
+        randombytes_buf(ubuf[i], usz[i]);
+        assert(write_file(up[i], ubuf[i], usz[i]) == 0);
+    }
+    g_uring_depth = 2;                               // fewer slots than files
+    assert(session_begin(pw3) == 0);
+    assert(path_handler(encrypt_inplace, WALK_ENCRYPT, udir, pw3, NULL) == 0);
+    assert(path_handler(decrypt_inplace, WALK_DECRYPT, udir, pw3, ".dec") == 0);
+    for (int i = 0; i < 3; ++i){
+        unsigned char *got = NULL; size_t glen = 0;
+        assert(read_file(ud[i], &got, &glen) == 0);
+        assert(glen == usz[i] && memcmp(got, ubuf[i], glen) == 0); // exact roundtrip
+        buf_free(got); free(ubuf[i]);
+    }
+    assert(count_temps(udir) == 0);                  // ring-written temps committed too
+    session_end();
+    g_uring_depth = 0;
+
+    // 6) --stats-json: one line per file (the three .dec files above plus
+    //    a skipped .enc), then the run summary.
+    char sj[1024], skip[1024], line[4096];
+    snprintf(sj,   sizeof sj,   "%s/stats.jsonl", dir);
+    snprintf(skip, sizeof skip, "%s/old.enc", udir);
+    write_file_simple(skip, "not really encrypted");
+    assert(stats_begin(0, sj) == 0);
+    assert(session_begin(pw3) == 0);
+    assert(path_handler(encrypt_inplace, WALK_ENCRYPT, udir, pw3, NULL) == 0);
+    session_end();
+    stats_end();
+    assert(g_stats == 0);
+    FILE *sf = fopen(sj, "r"); assert(sf);
+    int files = 0, summary = 0;
+    while (fgets(line, sizeof line, sf)){
+        if (strstr(line, "\"type\":\"file\"")){
+            files++;
+            assert(strstr(line, "\"ok\":true"));
+            assert(!strstr(line, "\"chunks\":0,") && !strstr(line, "\"chunks\":0}")); // every file sealed chunks
+        } else {
+            assert(strstr(line, "\"type\":\"summary\""));
+            assert(strstr(line, "\"files_ok\":3,") && strstr(line, "\"files_failed\":0,"));
+            assert(strstr(line, "\"files_skipped\":1,"));
+            summary++;
+        }
+    }
+    fclose(sf);
+    assert(files == 3 && summary == 1);
+
+    // 7) Group commit: an output that cannot be renamed into place fails
+    //    commit_end, not the commit that happened to fill its batch.
+    char gdir[512], gp[1024];
+    snprintf(gdir, sizeof gdir, "%s/group", dir);
+    snprintf(gp, sizeof gp, "%s/blocked", gdir);
+    assert(mkdir(gdir, 0700) == 0 && mkdir(gp, 0700) == 0);
+    snprintf(gp, sizeof gp, "%s/blocked/x", gdir);
+    write_file_simple(gp, "x");                      // a non-empty directory: rename fails
+    commit_begin();
+    for (int i = 0; i < COMMIT_GROUP_MAX; ++i){
+        if (i == 0) snprintf(gp, sizeof gp, "%s/blocked", gdir);
+        else snprintf(gp, sizeof gp, "%s/f%03d", gdir, i);
+        vault_out_t o;
+        assert(out_open(&o, gp, 0) == 0);
+        assert(write(o.fd, "data", 4) == 4);
+        fflush(stderr);
+        int se = dup(STDERR_FILENO), nul = open("/dev/null", O_WRONLY);
+        dup2(nul, STDERR_FILENO);                    // the expected "commit failed" line
+        int rc = out_commit(&o);                     // the last one flushes the batch
+        dup2(se, STDERR_FILENO); close(se); close(nul);
+        assert(rc == 0);
+    }
+    assert(commit_end() == -1);                      // the blocked output's failure
+    assert(count_temps(gdir) == 0);
+    snprintf(gp, sizeof gp, "%s/f%03d", gdir, COMMIT_GROUP_MAX - 1);
+    assert(stat(gp, &st) == 0 && st.st_size == 4);   // the others are in place
+    commit_begin();                                  // a new group starts clean
+    assert(commit_end() == 0);
+
     return 0;                                        // success
 }
 
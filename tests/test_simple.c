@@ -0,0 +1,122 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* quiet_simple: decrypt_file with stdout silenced (it reports there). */
+static int quiet_simple(const char *in, const char *out, char *pw){
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);                  // save current stdout
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull) dup2(fileno(devnull), STDOUT_FILENO); // redirect stdout → /dev/null
+    int rc = decrypt_file(in, out, pw);
+    fflush(stdout);
+    if (saved >= 0){ dup2(saved, STDOUT_FILENO); close(saved); } // restore stdout
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* open_oneshot: non-zero if the SIMPL1 file `p` opens with libsodium's
+   one-shot AEAD under password `pw` and yields `m` (`n` bytes). */
+static int open_oneshot(const char *p, char *pw, const unsigned char *m, size_t n){
+    unsigned char *x = NULL; size_t xl = 0;
+    assert(read_file(p, &x, &xl) == 0);
+    simple_hdr_t h;
+    assert(xl >= sizeof h + crypto_aead_chacha20poly1305_ietf_ABYTES);
+    memcpy(&h, x, sizeof h);
+    unsigned char key[crypto_kdf_KEYBYTES];
+    assert(session_master_key(pw, h.salt, (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE,
+                              (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024), key) == 0);
+    unsigned char *d = malloc(xl); assert(d);
+    unsigned long long dl = 0;
+    int ok = crypto_aead_chacha20poly1305_ietf_decrypt(d, &dl, NULL, x + sizeof h, xl - sizeof h, NULL, 0,
+                                                       h.nonce, key) == 0 &&
+             dl == n && memcmp(d, m, n) == 0;
+    free(d); buf_free(x);
+    return ok;
+}
+
+/* flip: invert byte `off` of file `p`. */
+static void flip(const char *p, long off){
+    FILE *f = fopen(p, "r+b"); assert(f);
+    assert(fseek(f, off, SEEK_SET) == 0);
+    int b = fgetc(f); assert(b != EOF);
+    assert(fseek(f, off, SEEK_SET) == 0);
+    fputc(b ^ 0xff, f);
+    fclose(f);
+}
+
+/* main: constant-memory SIMPL1 tests.
+   - Files sealed by libsodium's one-shot AEAD decrypt piecewise at every
+     size around the ChaCha20 block and SIMPLE_CHUNK boundaries, and
+     encrypt_file's output opens with the one-shot AEAD.
+   - A flipped byte anywhere, a truncated or an extended file fails in the
+     tag pass: no output is created and verify (NULL output) fails too. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "simple pass";
+    char root[] = "/tmp/vault-simple-XXXXXX";
+    assert(mkdtemp(root));
+    char enc[512], dec[512], plain[512];
+    snprintf(enc, sizeof enc, "%s/f.enc", root);
+    snprintf(dec, sizeof dec, "%s/f.dec", root);
+    snprintf(plain, sizeof plain, "%s/f", root);
+
+    const size_t big = 3 * SIMPLE_CHUNK + 100;
+    unsigned char *m = malloc(big); assert(m);
+    randombytes_buf(m, big);
+
+    // 1) One-shot -> piecewise, one salt so Argon2id runs once.
+    unsigned char salt[16], key[crypto_kdf_KEYBYTES];
+    randombytes_buf(salt, sizeof salt);
+    assert(session_master_key(pw, salt, (uint32_t)crypto_pwhash_OPSLIMIT_MODERATE,
+                              (uint32_t)(crypto_pwhash_MEMLIMIT_MODERATE / 1024), key) == 0);
+    const size_t sizes[] = { 0, 1, 15, 16, 17, 63, 64, 65, 1000, SIMPLE_CHUNK - 1, SIMPLE_CHUNK,
+                             SIMPLE_CHUNK + 1, 2 * SIMPLE_CHUNK + 64, big };
+    for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i){
+        seal_oneshot(enc, m, sizes[i], salt, key);
+        assert(quiet_simple(enc, dec, pw) == 0 && same_bytes(dec, m, sizes[i]));
+        assert(quiet_simple(enc, NULL, pw) == 0);   // verify
+        assert(unlink(dec) == 0);
+    }
+
+    // 2) Damage fails before anything is written.
+    seal_oneshot(enc, m, big, salt, key);
+    struct stat st;
+    assert(stat(enc, &st) == 0);
+    const long offs[] = { (long)sizeof(simple_hdr_t), (long)sizeof(simple_hdr_t) + SIMPLE_CHUNK + 3,
+                          (long)st.st_size - 20, (long)st.st_size - 1 };
+    for (size_t i = 0; i < sizeof offs / sizeof offs[0]; ++i){
+        flip(enc, offs[i]);
+        assert(quiet_simple(enc, dec, pw) == -1 && stat(dec, &st) != 0);
+        assert(quiet_simple(enc, NULL, pw) == -1);
+        flip(enc, offs[i]);                          // restore
+    }
+    assert(quiet_simple(enc, dec, pw) == 0 && unlink(dec) == 0);
+    assert(stat(enc, &st) == 0);
+    assert(truncate(enc, st.st_size - 1) == 0);
+    assert(quiet_simple(enc, dec, pw) == -1 && stat(dec, &st) != 0);
+    seal_oneshot(enc, m, 100, salt, key);
+    FILE *f = fopen(enc, "ab"); assert(f); fputc(0, f); fclose(f);
+    assert(quiet_simple(enc, dec, pw) == -1 && stat(dec, &st) != 0);
+    char wrong[] = "wrong pass";
+    seal_oneshot(enc, m, 100, salt, key);
+    assert(quiet_simple(enc, dec, wrong) == -1 && stat(dec, &st) != 0);
+
+    // 3) encrypt_file (piecewise) -> one-shot.
+    const size_t esizes[] = { 0, 2 * SIMPLE_CHUNK + 65 };
+    for (size_t i = 0; i < sizeof esizes / sizeof esizes[0]; ++i){
+        f = fopen(plain, "wb"); assert(f);
+        assert(fwrite(m, 1, esizes[i], f) == esizes[i]); fclose(f);
+        assert(encrypt_file(plain, enc, pw) == 0);
+        assert(stat(enc, &st) == 0 &&
+               (size_t)st.st_size == sizeof(simple_hdr_t) + esizes[i] + crypto_aead_chacha20poly1305_ietf_ABYTES);
+        assert(open_oneshot(enc, pw, m, esizes[i]));
+        assert(quiet_simple(enc, dec, pw) == 0 && same_bytes(dec, m, esizes[i]));
+        assert(unlink(dec) == 0);
+    }
+
+    free(m);
+    session_end();
+    unlink(plain); unlink(enc);
+    assert(rmdir(root) == 0);
+    return 0;
+}
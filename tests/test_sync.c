@@ -0,0 +1,144 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* same_plain: non-zero if `enc` decrypts to exactly the contents of `plain`. */
+static int same_plain(const char *plain, const char *enc){
+    char pw[] = "p@ss";
+    const char *dec = "sync_check.dec";
+    unlink(dec);
+    if (decrypt_file_stream(enc, dec, pw) != 0) return 0;
+    unsigned char *x = NULL, *y = NULL; size_t xl = 0, yl = 0;
+    if (read_file(plain, &x, &xl) != 0) return 0;    // read original
+    if (read_file(dec, &y, &yl) != 0){ buf_free(x); return 0; } // read decrypted copy
+    int same = xl == yl && memcmp(x, y, xl) == 0;    // compare length + bytes
+    buf_free(x); buf_free(y);
+    unlink(dec);
+    return same;
+}
+
+/* ino_of: inode of `p`, or 0 if it does not exist. A re-encrypted output
+   is renamed into place, so a changed inode means it was rewritten. */
+static ino_t ino_of(const char *p){
+    struct stat st;
+    return stat(p, &st) == 0 ? st.st_ino : 0;
+}
+
+/* run_sync: sync_dir with stdout/stderr silenced. */
+static int run_sync(const char *src, const char *dst, int hash){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    char pw[] = "p@ss";
+    int rc = sync_dir(src, dst, pw, hash);
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* main: incremental sync tests.
+   - The first run mirrors the tree as <rel>.enc under an encrypted manifest.
+   - A re-run rewrites nothing; a modified file, a missing output and a
+     new file are encrypted, and a deleted source's output is pruned.
+   - A touched but unmodified file is re-encrypted without --hash and left
+     alone with it (hashes are recorded on the first --hash run).
+   - A damaged manifest and a destination inside the source fail without
+     writing anything. */
+int main(void){
+    assert(sodium_init() >= 0);
+
+    char root[] = "/tmp/vault-sync-XXXXXX";
+    assert(mkdtemp(root));
+    char src[512], dst[512], man[1024], p[1024], q[1024];
+    snprintf(src, sizeof src, "%s/src", root);
+    snprintf(dst, sizeof dst, "%s/dst", root);
+    snprintf(man, sizeof man, "%s/%s", dst, SYNC_MANIFEST);
+
+    const char *files[] = { "a.txt", "b.enc", "sub/c.bin", "sub/deeper/d", "sub/deeper/e with space" };
+    const int nfiles = (int)(sizeof files / sizeof files[0]);
+    ino_t ino[8];
+    assert(mkdir(src, 0755) == 0);
+    snprintf(p, sizeof p, "%s/sub", src);        assert(mkdir(p, 0755) == 0);
+    snprintf(p, sizeof p, "%s/sub/deeper", src); assert(mkdir(p, 0755) == 0);
+    for (int i = 0; i < nfiles; ++i){
+        snprintf(p, sizeof p, "%s/%s", src, files[i]);
+        write_random(p, i == 2 ? 3 * STREAM_CHUNK + 1 : 100 + (size_t)i);
+    }
+    snprintf(p, sizeof p, "%s/user.pass", src); write_random(p, 4);
+
+    // 1) First run: everything, manifest is a StreamSeal stream.
+    assert(run_sync(src, dst, 0) == 0);
+    for (int i = 0; i < nfiles; ++i){
+        snprintf(p, sizeof p, "%s/%s", src, files[i]);
+        snprintf(q, sizeof q, "%s/%s.enc", dst, files[i]);
+        assert(same_plain(p, q));
+        ino[i] = ino_of(q);
+    }
+    snprintf(q, sizeof q, "%s/user.pass.enc", dst); assert(access(q, F_OK) != 0);
+    FILE *f = fopen(man, "rb"); stream_hdr_t h;
+    assert(f && stream_hdr_read(f, &h) == 0); fclose(f);
+
+    // 2) Nothing changed: nothing rewritten.
+    assert(run_sync(src, dst, 0) == 0);
+    for (int i = 0; i < nfiles; ++i){
+        snprintf(q, sizeof q, "%s/%s.enc", dst, files[i]);
+        assert(ino_of(q) == ino[i]);
+    }
+
+    // 3) Churn: modify, delete, add, lose an output.
+    snprintf(p, sizeof p, "%s/a.txt", src);
+    f = fopen(p, "ab"); assert(f); fputs("more", f); fclose(f);
+    snprintf(p, sizeof p, "%s/sub/c.bin", src);         assert(unlink(p) == 0);
+    snprintf(p, sizeof p, "%s/sub/new", src);           write_random(p, 7);
+    snprintf(q, sizeof q, "%s/sub/deeper/d.enc", dst);  assert(unlink(q) == 0);
+    assert(run_sync(src, dst, 0) == 0);
+    snprintf(p, sizeof p, "%s/a.txt", src); snprintf(q, sizeof q, "%s/a.txt.enc", dst);
+    assert(same_plain(p, q) && ino_of(q) != ino[0]);
+    snprintf(q, sizeof q, "%s/sub/c.bin.enc", dst);     assert(access(q, F_OK) != 0);
+    snprintf(p, sizeof p, "%s/sub/new", src); snprintf(q, sizeof q, "%s/sub/new.enc", dst);
+    assert(same_plain(p, q));
+    snprintf(p, sizeof p, "%s/sub/deeper/d", src); snprintf(q, sizeof q, "%s/sub/deeper/d.enc", dst);
+    assert(same_plain(p, q));
+    snprintf(q, sizeof q, "%s/b.enc.enc", dst);         assert(ino_of(q) == ino[1]);
+    snprintf(q, sizeof q, "%s/sub/deeper/e with space.enc", dst); assert(ino_of(q) == ino[4]);
+
+    // 4) Touched, same bytes: --hash leaves it, plain metadata does not.
+    assert(run_sync(src, dst, 1) == 0);                 // records hashes
+    snprintf(p, sizeof p, "%s/b.enc", src); snprintf(q, sizeof q, "%s/b.enc.enc", dst);
+    assert(ino_of(q) == ino[1]);
+    struct timespec ts[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+    assert(utimensat(AT_FDCWD, p, ts, 0) == 0);
+    assert(run_sync(src, dst, 1) == 0);
+    assert(ino_of(q) == ino[1]);
+    ts[1].tv_sec += 60;
+    assert(utimensat(AT_FDCWD, p, ts, 0) == 0);
+    assert(run_sync(src, dst, 0) == 0);
+    assert(ino_of(q) != ino[1] && same_plain(p, q));
+
+    // 5) Damaged manifest: fails, nothing rewritten.
+    unsigned char *buf = NULL; size_t len = 0;
+    assert(read_file(man, &buf, &len) == 0);
+    buf[len - 1] ^= 1;
+    assert(write_file(man, buf, len) == 0);
+    buf_free(buf);
+    snprintf(p, sizeof p, "%s/a.txt", src);
+    f = fopen(p, "ab"); assert(f); fputs("again", f); fclose(f);
+    snprintf(q, sizeof q, "%s/a.txt.enc", dst);
+    ino_t before = ino_of(q);
+    assert(run_sync(src, dst, 0) == -1);
+    assert(ino_of(q) == before);
+    assert(unlink(man) == 0);                            // starting over re-encrypts everything
+    assert(run_sync(src, dst, 0) == 0);
+    assert(ino_of(q) != before && same_plain(p, q));
+
+    // 6) Destination inside the source tree.
+    snprintf(q, sizeof q, "%s/inner", src);
+    assert(run_sync(src, q, 0) == -1);
+    assert(access(q, F_OK) != 0);
+    assert(run_sync(src, src, 0) == -1);
+
+    rm_tree(root);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include "../include/header.h"
+
+/* Fixture helpers shared by the tests (tests/test_util.c). */
+void write_random(const char *p, size_t n);
+int  same_file(const char *a, const char *b);
+int  quiet_decrypt(const char *in, const char *out, char *pw);
+void rm_tree(const char *p);
+void seal_oneshot(const char *p, const unsigned char *m, size_t n, const unsigned char salt[16],
+                  const unsigned char *key);
+int  same_bytes(const char *p, const unsigned char *m, size_t n);
+int  count_entries(const char *d);
+
+#endif /* TEST_UTIL_H */
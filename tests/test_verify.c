@@ -0,0 +1,118 @@
+#include "../include/header.h"
+#include "test_util.h"
+
+/* quiet: verify file `p` (or directory `p` on a 4-worker pool) with
+   stdout/stderr silenced. */
+static int quiet(const char *p, int pool){
+    fflush(stdout);
+    int so = dup(STDOUT_FILENO), se = dup(STDERR_FILENO); // save stdout/stderr
+    FILE *devnull = fopen("/dev/null", "w");         // open /dev/null sink
+    if (devnull){ dup2(fileno(devnull), STDOUT_FILENO); dup2(fileno(devnull), STDERR_FILENO); }
+    char pw[] = "p@ss";
+    int rc = pool ? pool_run(verify_file, WALK_CIPHERTEXT, p, pw, NULL, 4) : verify_file(p, pw, NULL);
+    fflush(stdout); fflush(stderr);
+    if (so >= 0){ dup2(so, STDOUT_FILENO); close(so); } // restore
+    if (se >= 0){ dup2(se, STDERR_FILENO); close(se); }
+    if (devnull) fclose(devnull);
+    return rc;
+}
+
+/* damage: rewrite `src` into `dst` truncated by `cut` bytes, extended by
+   one byte (`cut` < 0), or with byte `flip` inverted (`flip` >= 0). */
+static void damage(const char *src, const char *dst, long cut, long flip){
+    unsigned char *buf = NULL; size_t len = 0;
+    assert(read_file(src, &buf, &len) == 0);
+    if (flip >= 0) buf[flip] ^= 0xff;
+    FILE *f = fopen(dst, "wb"); assert(f);
+    assert(fwrite(buf, 1, cut > 0 ? len - (size_t)cut : len, f) == (cut > 0 ? len - (size_t)cut : len));
+    if (cut < 0) fputc(0, f);
+    fclose(f);
+    buf_free(buf);
+}
+
+/* main: verify tests.
+   - Every format verifies without writing anything: secretstream, the
+     chunked layout, compressed (when built in), legacy SIMPL1, a pack
+     container, an empty file.
+   - Truncated, extended and tampered copies of each fail.
+   - A directory run verifies only .enc files, reports every file and
+     fails if any one does. */
+int main(void){
+    assert(sodium_init() >= 0);
+    char pw[] = "p@ss";
+
+    char root[] = "/tmp/vault-verify-XXXXXX";
+    assert(mkdtemp(root));
+    char plain[512], p[1024], q[1024];
+    snprintf(plain, sizeof plain, "%s/plain", root);
+
+    // 1) One good file per format.
+    struct { const char *name; size_t size; int how; } cases[] = {
+        { "stream.enc",  3 * STREAM_CHUNK + 5,     0 },   // secretstream
+        { "chunked.enc", STREAM_PARALLEL_MIN + 9,  0 },   // chunked layout
+        { "empty.enc",   0,                        0 },
+        { "zstd.enc",    2 * STREAM_CHUNK,         1 },   // compressed
+        { "legacy.enc",  1000,                     2 },   // SIMPL1
+        { "tree.enc",    0,                        3 },   // pack container
+    };
+    const int ncases = (int)(sizeof cases / sizeof cases[0]);
+    for (int i = 0; i < ncases; ++i){
+        snprintf(p, sizeof p, "%s/%s", root, cases[i].name);
+        write_random(plain, cases[i].size);
+        if (cases[i].how == 1 && (codec_parse("zstd", &g_codec, &g_codec_level) != 0 || !codec_available(g_codec)))
+            g_codec = CODEC_NONE;                    // not built in: plain stream instead
+        if (cases[i].how == 2) assert(encrypt_file(plain, p, pw) == 0);
+        else if (cases[i].how == 3){
+            snprintf(q, sizeof q, "%s/t", root);
+            assert(mkdir(q, 0700) == 0);
+            snprintf(q, sizeof q, "%s/t/f", root); write_random(q, 5000);
+            snprintf(q, sizeof q, "%s/t", root);
+            assert(pack_dir(q, p, pw) == 0);
+            snprintf(q, sizeof q, "%s/t/f", root); unlink(q);
+            snprintf(q, sizeof q, "%s/t", root);   rmdir(q);
+        }
+        else assert(encrypt_file_stream(plain, p, pw) == 0);
+        g_codec = CODEC_NONE;
+    }
+    unlink(plain);
+
+    int before = count_entries(root);
+    for (int i = 0; i < ncases; ++i){
+        snprintf(p, sizeof p, "%s/%s", root, cases[i].name);
+        assert(quiet(p, 0) == 0);
+        g_pipeline = 1;                              // ignored: nothing to overlap writes with
+        assert(quiet(p, 0) == 0);
+        g_pipeline = 0;
+    }
+    assert(count_entries(root) == before);          // nothing written
+    assert(quiet(root, 1) == 0);                    // whole directory on the pool
+
+    // 2) Damaged copies fail; they are named .bad, so the pool still passes.
+    snprintf(q, sizeof q, "%s/copy.bad", root);
+    for (int i = 0; i < ncases; ++i){
+        snprintf(p, sizeof p, "%s/%s", root, cases[i].name);
+        struct stat st; assert(stat(p, &st) == 0);
+        damage(p, q, 1, -1);                         assert(quiet(q, 0) == -1); // truncated
+        damage(p, q, -1, -1);                        assert(quiet(q, 0) == -1); // extended
+        damage(p, q, 0, (long)st.st_size - 1);       assert(quiet(q, 0) == -1); // last tag
+        damage(p, q, 0, (long)st.st_size / 2);       assert(quiet(q, 0) == -1); // middle
+    }
+    assert(quiet(root, 1) == 0);                    // .bad is not a .enc file
+
+    // 3) One bad .enc fails the directory run.
+    snprintf(p, sizeof p, "%s/stream.enc", root);
+    snprintf(q, sizeof q, "%s/zz.enc", root);
+    damage(p, q, 0, 100);
+    assert(quiet(root, 1) == -1);
+
+    DIR *d = opendir(root); assert(d);
+    struct dirent *e;
+    while ((e = readdir(d))){
+        if (e->d_name[0] == '.') continue;
+        snprintf(p, sizeof p, "%s/%s", root, e->d_name);
+        assert(unlink(p) == 0);
+    }
+    closedir(d);
+    assert(rmdir(root) == 0);
+    return 0;
+}
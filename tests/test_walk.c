@@ -0,0 +1,138 @@
+#include "../include/header.h"
+
+#define DEEP_LEVELS 120                              /* more than the walker's open-descriptor window */
+#define DEEP_NAME   "dddddddddddddddddddddddddddddddddddddddd" /* 40 chars: paths pass PATH_MAX */
+
+/* Visitor state: files seen, longest path, inode order check. */
+typedef struct {
+    int    files;
+    size_t longest;
+    int    stop_at;          /* return 7 on this visit (0 = never) */
+    int    check_order;      /* lstat each file and require ascending inodes */
+    ino_t  last_ino;
+    int    ordered;
+} seen_t;
+
+/* count: path_walk visitor. */
+static int count(const char *path, void *ctx){
+    seen_t *s = ctx;
+    s->files++;
+    if (strlen(path) > s->longest) s->longest = strlen(path);
+    if (s->check_order){
+        struct stat st;
+        assert(lstat(path, &st) == 0);
+        if (st.st_ino < s->last_ino) s->ordered = 0;
+        s->last_ino = st.st_ino;
+    }
+    return s->files == s->stop_at ? 7 : 0;
+}
+
+/* touch_at: create an empty file `name` in directory `dfd`. */
+static void touch_at(int dfd, const char *name){
+    int fd = openat(dfd, name, O_WRONLY | O_CREAT | O_TRUNC, 0600); assert(fd >= 0);
+    close(fd);
+}
+
+/* touch: create an empty file at `dir`/`name`. */
+static void touch(const char *dir, const char *name){
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY); assert(dfd >= 0);
+    touch_at(dfd, name);
+    close(dfd);
+}
+
+/* rm_chain: remove `levels` nested DEEP_NAME directories (each holding "f")
+   below `dfd` without building their full paths. */
+static void rm_chain(int dfd, int levels){
+    if (levels == 0) return;
+    int child = openat(dfd, DEEP_NAME, O_RDONLY | O_DIRECTORY); assert(child >= 0);
+    rm_chain(child, levels - 1);
+    close(child);
+    assert(unlinkat(dfd, "f", 0) == 0);
+    assert(unlinkat(dfd, DEEP_NAME, AT_REMOVEDIR) == 0);
+}
+
+/* main: directory walker tests.
+   - Only regular files reach the visitor; user.pass, output temps, files
+     already in the target state and symlinks are skipped. The ciphertext
+     filter sees .enc files only; whole-tree walks also see sync manifests.
+   - Trees deeper than the descriptor window and paths longer than
+     PATH_MAX are walked completely.
+   - --inode-order visits a directory's files by ascending inode.
+   - The first non-zero visitor result stops the walk and is returned. */
+int main(void){
+    assert(sodium_init() >= 0);
+
+    char dir[] = "/tmp/vault-walk-XXXXXX";
+    assert(mkdtemp(dir));
+    char sub[512], deeper[512], link[512], flat[512], deep[512];
+    snprintf(sub,    sizeof sub,    "%s/sub", dir);
+    snprintf(deeper, sizeof deeper, "%s/sub/deeper", dir);
+    snprintf(link,   sizeof link,   "%s/link", dir);
+    snprintf(flat,   sizeof flat,   "%s/flat", dir);
+    snprintf(deep,   sizeof deep,   "%s/deep", dir);
+
+    // 1) Filtering.
+    assert(mkdir(sub, 0700) == 0 && mkdir(deeper, 0700) == 0);
+    touch(dir, "a.txt"); touch(dir, "user.pass"); touch(dir, "b.enc"); touch(dir, OUT_TMP_PREFIX "a.txt-0");
+    touch(sub, "c.txt"); touch(deeper, "d.txt");
+    assert(symlink("a.txt", link) == 0);
+    seen_t s = { 0 };
+    assert(path_walk(WALK_ENCRYPT, dir, count, &s) == 0);
+    assert(s.files == 3);                            // a.txt, c.txt, d.txt
+    memset(&s, 0, sizeof s);
+    assert(path_walk(WALK_DECRYPT, dir, count, &s) == 0);
+    assert(s.files == 4);                            // b.enc too
+    memset(&s, 0, sizeof s);
+    assert(path_walk(WALK_ENCRYPT, link, count, &s) == 0 && s.files == 0); // symlink root skipped
+    touch(sub, SYNC_MANIFEST);
+    memset(&s, 0, sizeof s);
+    assert(path_walk(WALK_CIPHERTEXT, dir, count, &s) == 0);
+    assert(s.files == 1);                            // verify, migrate: b.enc only
+    memset(&s, 0, sizeof s);
+    assert(path_walk(WALK_ENCRYPT, dir, count, &s) == 0 && s.files == 3); // manifest left alone
+    memset(&s, 0, sizeof s);
+    assert(path_walk(WALK_ALL, dir, count, &s) == 0);
+    assert(s.files == 5);                            // whole tree, manifest included
+
+    // 2) Deep tree: DEEP_LEVELS nested directories, a file in each.
+    assert(mkdir(deep, 0700) == 0);
+    int dfd = open(deep, O_RDONLY | O_DIRECTORY); assert(dfd >= 0);
+    for (int i = 0; i < DEEP_LEVELS; ++i){
+        assert(mkdirat(dfd, DEEP_NAME, 0700) == 0);
+        touch_at(dfd, "f");
+        int next = openat(dfd, DEEP_NAME, O_RDONLY | O_DIRECTORY); assert(next >= 0);
+        close(dfd);
+        dfd = next;
+    }
+    close(dfd);
+    memset(&s, 0, sizeof s);
+    assert(path_walk(WALK_ENCRYPT, deep, count, &s) == 0);
+    assert(s.files == DEEP_LEVELS);                  // nothing lost on the way back up
+    assert(s.longest > PATH_MAX);                    // no fixed path buffer
+
+    // 3) Inode order within a directory.
+    assert(mkdir(flat, 0700) == 0);
+    for (int i = 0; i < 64; ++i){
+        char name[32];
+        snprintf(name, sizeof name, "f%02d", (i * 37) % 64); // creation order != name order
+        touch(flat, name);
+    }
+    g_walk_inode_order = 1;
+    memset(&s, 0, sizeof s);
+    s.check_order = 1; s.ordered = 1;
+    assert(path_walk(WALK_ENCRYPT, flat, count, &s) == 0);
+    assert(s.files == 64 && s.ordered);
+    g_walk_inode_order = 0;
+
+    // 4) A visitor error stops the walk.
+    memset(&s, 0, sizeof s);
+    s.stop_at = 2;
+    assert(path_walk(WALK_ENCRYPT, flat, count, &s) == 7);
+    assert(s.files == 2);
+
+    // Cleanup.
+    dfd = open(deep, O_RDONLY | O_DIRECTORY); assert(dfd >= 0);
+    rm_chain(dfd, DEEP_LEVELS);
+    close(dfd);
+    return 0;
+}